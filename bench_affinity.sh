@@ -0,0 +1,48 @@
+#!/bin/bash
+#Compare throughput and tail latency of a market run with and without a thread placement.
+#$1: config file (without CPU_* items)
+#$2: seconds of each run (default 10)
+#$3: placement appended to the config in the pinned run (default: director and market on cpu 0, desks spread)
+
+if [ $# -eq 0 ]; then
+    echo "ERRORE: wrong usage of $(basename $0) tool" 1>&2
+    echo "Correct usage: $(basename $0) <config_path> [seconds] [placement]" 1>&2
+    exit -1
+fi
+if [ ! -f "$1" ]; then
+    echo "$0:File $1 is not a regular file or it doesn't exist." 1>&2
+    exit -1
+fi
+SECS=${2:-10}
+PLACEMENT=${3:-"CPU_DIRECTOR=0
+CPU_MARKET=0
+CPU_DESKS=spread"}
+TMP=$(mktemp -d)
+
+#p50 and p99 of sorted values read from stdin
+percentiles() {
+    awk '{a[NR]=$1} END{ if(NR == 0) exit; i=int(NR*0.5)+1; j=int(NR*0.99)+1; if(i>NR) i=NR; if(j>NR) j=NR; printf "%.3f/%.3f", a[i], a[j]}'
+}
+
+#$1: label, $2: config
+run() {
+    rm -f "$TMP/log.txt"
+    ./bin/main "$2" "$TMP/log.txt" < /dev/null > /dev/null &
+    PID=$!
+    sleep "$SECS"
+    kill -s HUP $PID
+    wait $PID
+    #Users/s, then p50/p99 of time in queue and in market (s)
+    grep '^\[User' "$TMP/log.txt" | sed 's/.*tot_time_market=\([0-9.]*\) tot_time_queue=\([0-9.]*\).*/\1 \2/' > "$TMP/times.txt"
+    N=$(wc -l < "$TMP/times.txt")
+    QUEUE=$(cut -d' ' -f2 "$TMP/times.txt" | sort -g | percentiles)
+    MARKET=$(cut -d' ' -f1 "$TMP/times.txt" | sort -g | percentiles)
+    printf "%-9s users=%-8d users/s=%-10.1f queue p50/p99=%-18s market p50/p99=%s\n" "$1" $N $(echo "$N $SECS" | awk '{print $1/$2}') "$QUEUE" "$MARKET"
+}
+
+(cat "$1"; echo) > "$TMP/unpinned.txt"
+(cat "$1"; echo; echo "$PLACEMENT") > "$TMP/pinned.txt"
+echo "cpus=$(nproc) run=${SECS}s placement: $(echo $PLACEMENT)"
+run unpinned "$TMP/unpinned.txt"
+run pinned "$TMP/pinned.txt"
+rm -r "$TMP"
@@ -0,0 +1,40 @@
+#!/bin/bash
+#Compare wall time of the virtual-time engines on the same simulation.
+#$1: chain file
+#$2: simulated ms (default 600000)
+#$3: worker counts (default "1 2 4 8")
+
+if [ $# -eq 0 ]; then
+    echo "ERRORE: wrong usage of $(basename $0) tool" 1>&2
+    echo "Correct usage: $(basename $0) <chain_path> [duration_ms] [workers]" 1>&2
+    exit -1
+fi
+if [ ! -f "$1" ]; then
+    echo "$0:File $1 is not a regular file or it doesn't exist." 1>&2
+    exit -1
+fi
+MS=${2:-600000}
+WORKERS=${3:-"1 2 4 8"}
+TMP=$(mktemp -d)
+
+#$1: label, other arguments: options of vsim
+run() {
+    LABEL=$1
+    shift
+    ./bin/vsim "$@" --chain "$MS" "$CHAIN" "$TMP/log.txt" > /dev/null || { echo "$LABEL: run failed" 1>&2; return; }
+    WALL=$(grep -o 'wall_time=[0-9.]*' "$TMP/log.txt" | cut -d= -f2)
+    DIGEST=$(grep '^\[Sim\]: engine' "$TMP/log.txt" | grep -o 'digest=[0-9a-f]*')
+    ROLLED=$(grep -o 'rolled_back=[0-9]*' "$TMP/log.txt")
+    [ -z "$BASE" ] && BASE=$WALL
+    printf "%-16s wall=%-8s speedup=%-6s %s %s\n" "$LABEL" "$WALL" $(echo "$BASE $WALL" | awk '{printf "%.2f", $1/$2}') "$DIGEST" "$ROLLED"
+}
+
+CHAIN=$1
+BASE=""
+echo "cpus=$(nproc) simulated=${MS}ms"
+run sequential
+for W in $WORKERS; do
+    run "conservative/$W" --workers "$W"
+    run "optimistic/$W" --workers "$W" --optimistic
+done
+rm -r "$TMP"
@@ -0,0 +1,34 @@
+#!/bin/bash
+#Run a market at increasing time scales and report how late its timers fire.
+#$1: config file (without TIME_SCALE)
+#$2: real seconds of each run (default 5)
+#$3: scales (default "1 10 100 1000")
+
+if [ $# -eq 0 ]; then
+    echo "ERRORE: wrong usage of $(basename $0) tool" 1>&2
+    echo "Correct usage: $(basename $0) <config_path> [seconds] [scales]" 1>&2
+    exit -1
+fi
+if [ ! -f "$1" ]; then
+    echo "$0:File $1 is not a regular file or it doesn't exist." 1>&2
+    exit -1
+fi
+SECS=${2:-5}
+SCALES=${3:-"1 10 100 1000"}
+TMP=$(mktemp -d)
+
+echo "cpus=$(nproc) run=${SECS}s"
+for SCALE in $SCALES; do
+    (cat "$1"; echo; echo "TIME_SCALE=$SCALE") > "$TMP/config.txt"
+    rm -f "$TMP/log.txt"
+    ./bin/main "$TMP/config.txt" "$TMP/log.txt" < /dev/null > /dev/null &
+    PID=$!
+    sleep "$SECS"
+    kill -s HUP $PID
+    wait $PID
+    N=$(grep -c '^\[User' "$TMP/log.txt")
+    #Users per simulated second: a faithful scale keeps it constant
+    printf "scale=%-6s users=%-8d users_per_sim_s=%-10.1f %s\n" "$SCALE" $N $(echo "$N $SECS $SCALE" | awk '{print $1/($2*$3)}') \
+        "$(grep '^\[Timers\]' "$TMP/log.txt" | cut -d' ' -f4-)"
+done
+rm -r "$TMP"
@@ -0,0 +1,35 @@
+/**
+ * @file Affinity.h
+ * @brief Header file for Affinity.c
+ */
+#ifndef	_AFFINITY_H
+#define	_AFFINITY_H
+
+#include <Arena.h>
+
+#define AFFINITY_MAX_CPUS 1024 /**< Highest cpu index + 1 accepted in a placement */
+#define AFFINITY_SPREAD "spread" /**< Cpu list keyword: all the cpus, interleaved across NUMA nodes */
+
+typedef struct Placement Placement;
+
+/**
+ * @brief Thread placement of a market. A cpu equal to -1 or an empty list means that the threads are not pinned.
+ */
+struct Placement {
+    int director; /**< cpu of the director threads */
+    int market; /**< cpu of the market thread (which also writes the user log) */
+    int * desks; /**< cpus assigned round robin to desk threads (desk i runs on desks[i % nDesks]) */
+    int nDesks; /**< number of cpus in desks */
+    int * users; /**< cpus where user threads are allowed to run */
+    int nUsers; /**< number of cpus in users */
+};
+
+int Placement_init(Placement * p_p, Arena * p_a, long p_director, long p_market, const char * p_desks, const char * p_users);
+void Placement_pinDirector(Placement * p_p);
+void Placement_pinMarket(Placement * p_p);
+void Placement_pinDesk(Placement * p_p, int p_desk);
+void Placement_pinUser(Placement * p_p);
+int Affinity_parseList(const char * p_str, int * p_cpus, int p_max);
+int Affinity_spread(int * p_cpus, int p_max);
+
+#endif	/* _AFFINITY_H */
@@ -0,0 +1,47 @@
+/**
+ * @file ArrivalProcess.h
+ * @brief Header file for ArrivalProcess.c
+ */
+#ifndef	_ARRIVALPROCESS_H
+#define	_ARRIVALPROCESS_H
+
+#include <stdint.h>
+#include <time.h>
+#include <ArrivalTrace.h>
+
+#define ARRIVAL_BATCH 1024 /**< Arrivals generated at once */
+#define ARRIVAL_MAX_RATES 64 /**< Maximum number of periods in a rate profile */
+
+typedef struct ArrivalProcess ArrivalProcess;
+
+/**
+ * @brief Generator of customers for the open market: arrivals follow a Poisson process whose rate is
+ *        piecewise constant (a profile of rates, one for each period, repeated cyclically).
+ *        Arrivals are generated in batches of #ARRIVAL_BATCH records and consumed by the market thread only.
+ */
+struct ArrivalProcess {
+    double rates[ARRIVAL_MAX_RATES]; /**< arrivals per ms in each period */
+    int nRates; /**< number of periods in the profile */
+    long period; /**< length of each period (simulated ms) */
+    long P; /**< maximum number of products of a customer */
+    long T; /**< maximum shopping time of a customer (ms) */
+    long speed; /**< 1 real time, >1 accelerated, 0 virtual time (no wait) */
+    uint64_t rng; /**< state of the random generator */
+    double t; /**< simulated time of the last generated arrival (ms) */
+    ArrivalRecord batch[ARRIVAL_BATCH]; /**< arrivals generated and not yet consumed */
+    int nBatch; /**< arrivals in batch */
+    int next; /**< next arrival to consume in batch */
+    struct timespec tStart; /**< real time corresponding to simulated time 0 */
+    uint64_t admitted; /**< arrivals consumed */
+    uint64_t doorWait; /**< sum of the delays between arrival and admission (simulated ms) */
+};
+
+ArrivalProcess * ArrivalProcess_init(const char * p_rates, long p_period, long p_speed, long p_P, long p_T);
+void ArrivalProcess_delete(ArrivalProcess * p_a);
+void ArrivalProcess_start(ArrivalProcess * p_a);
+uint64_t ArrivalProcess_now(ArrivalProcess * p_a);
+const ArrivalRecord * ArrivalProcess_peek(ArrivalProcess * p_a);
+void ArrivalProcess_pop(ArrivalProcess * p_a, uint64_t p_now);
+struct timespec ArrivalProcess_deadline(ArrivalProcess * p_a, const ArrivalRecord * p_rec);
+
+#endif	/* _ARRIVALPROCESS_H */
@@ -0,0 +1,66 @@
+/**
+ * @file ArrivalTrace.h
+ * @brief Header file for ArrivalTrace.c
+ */
+#ifndef	_ARRIVALTRACE_H
+#define	_ARRIVALTRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <time.h>
+
+#define ARRIVAL_TRACE_MAGIC 0x5452524DU /**< "MRRT": magic number at the begining of a binary arrival trace */
+#define ARRIVAL_TRACE_VERSION 1U /**< Binary format version */
+#define ARRIVAL_TRACE_RELEASE (64L * 1024 * 1024) /**< Bytes of consumed records after which mapped pages are released */
+
+typedef struct ArrivalTraceHeader ArrivalTraceHeader;
+typedef struct ArrivalRecord ArrivalRecord;
+typedef struct ArrivalTrace ArrivalTrace;
+
+/**
+ * @brief Header placed at offset 0 of a binary arrival trace file.
+ */
+struct ArrivalTraceHeader {
+    uint32_t magic; /**< must be ARRIVAL_TRACE_MAGIC */
+    uint32_t version; /**< must be ARRIVAL_TRACE_VERSION */
+    uint64_t count; /**< number of ArrivalRecord following the header */
+};
+
+/**
+ * @brief A single recorded customer. Records are sorted by arrival time.
+ */
+struct ArrivalRecord {
+    uint64_t arrival; /**< arrival time in ms from the begining of the trace */
+    uint32_t products; /**< number of products in the basket */
+    uint32_t shoppingTime; /**< time spent in shopping area in ms */
+};
+
+/**
+ * @brief Read-only view of a binary arrival trace mapped in memory.
+ * Records are consumed sequentially, so pages already read are given back to the kernel
+ * and traces larger than the available RAM can be replayed.
+ */
+struct ArrivalTrace {
+    pthread_mutex_t lock; /**< lock variable */
+    int fd; /**< file descriptor of the trace file */
+    size_t mapLen; /**< length of the mapping */
+    unsigned char * map; /**< begining of the mapping */
+    const ArrivalRecord * recs; /**< first record */
+    uint64_t count; /**< number of records */
+    uint64_t next; /**< next record to consume */
+    size_t released; /**< bytes at the begining of the mapping already released */
+    long speed; /**< replay speed: 1 real time, >1 accelerated, 0 virtual time (no wait) */
+    int isStarted; /**< 1 if tStart and base are set */
+    uint64_t base; /**< arrival time of the first record consumed */
+    struct timespec tStart; /**< time when the first record has been consumed */
+};
+
+ArrivalTrace * ArrivalTrace_open(const char * p_path, long p_speed);
+void ArrivalTrace_close(ArrivalTrace * p_t);
+int ArrivalTrace_next(ArrivalTrace * p_t, ArrivalRecord * p_rec);
+int ArrivalTrace_waitArrival(ArrivalTrace * p_t, const ArrivalRecord * p_rec);
+int64_t ArrivalTrace_due(ArrivalTrace * p_t, const ArrivalRecord * p_rec);
+int ArrivalTrace_isExhausted(ArrivalTrace * p_t);
+
+#endif	/* _ARRIVALTRACE_H */
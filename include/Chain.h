@@ -0,0 +1,51 @@
+/**
+ * @file Chain.h
+ * @brief Header file for Chain.c
+ */
+#ifndef	_CHAIN_H
+#define	_CHAIN_H
+
+#include <stdio.h>
+#include <TMarket.h>
+#include <TExecutor.h>
+
+typedef struct Chain Chain;
+typedef struct StoreStats StoreStats;
+
+/**
+ * @brief Results of a store, taken from its log counters and its desks.
+ */
+struct StoreStats {
+    long users; /**< users logged at their exit */
+    long clients; /**< users served by the desks */
+    long products; /**< products processed by the desks */
+    long closures; /**< desk closures */
+};
+
+/**
+ * @brief A chain of markets simulated in the same process.
+ *        Each store has its own configuration, pay area, director and log file, while markets, users, desks and
+ *        directors of all the stores run as tasks on a single #Executor with one worker per core.
+ */
+struct Chain {
+    Market ** stores; /**< markets of the chain */
+    char ** confs; /**< configuration file of each store */
+    int n; /**< number of stores */
+    int shard; /**< the chain owns the stores listed at positions shard, shard + nShards, ... of the chain file */
+    int nShards; /**< number of shards of the chain file (1: all the stores) */
+    Executor * executor; /**< workers shared by all the stores */
+    FILE * f_log; /**< chain log: summary of each store and chain aggregate (NULL for a shard) */
+};
+
+Chain * Chain_init(const char * p_chain, const char * p_log);
+int Chain_askOverwrite(const char * p_chain, const char * p_log);
+Chain * Chain_initShard(const char * p_chain, const char * p_log, int p_shard, int p_nShards, int p_overwrite);
+int Chain_storeId(Chain * p_c, int p_i);
+void Chain_storeStats(Chain * p_c, int p_i, StoreStats * p_s);
+int Chain_startThreads(Chain * p_c);
+int Chain_joinThreads(Chain * p_c);
+void Chain_Signal(Chain * p_c);
+void Chain_log(Chain * p_c);
+int Chain_delete(Chain * p_c);
+
+#endif	/* _CHAIN_H */
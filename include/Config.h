@@ -6,14 +6,16 @@
 #define	_CONFIG_H
 
 #include <stdio.h>
+#include <Arena.h>
 
 /**
  * @brief Max string length expected from a config file
  */
 #define MAX_DIM_STR_CONF 1024
+#define CONFIG_ARENA_CHUNK 4096 /**< Chunk size of the arena used by #Config_checkFile when none is given */
 
 int Config_getValue(FILE * p_f, const char * p_key, char * p_buff);
-int Config_checkFile(FILE * p_f);
+int Config_checkFile(FILE * p_f, Arena * p_a);
 int Config_parseLong(long * p_x, char * p_str_value);
 
 #endif	/* _CONFIG_H */
@@ -0,0 +1,65 @@
+/**
+ * @file Arena.h
+ * @brief Header file of Arena.c
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define ARENA_ALIGN 16 /**< Alignment of each allocation */
+#define CACHE_LINE 64 /**< Size of a cache line: fields written by different threads are kept on different lines */
+
+typedef struct Arena Arena;
+typedef struct ArenaChunk ArenaChunk;
+typedef struct Pool Pool;
+
+/**
+ * @brief Memory region obtained from the heap and owned by an Arena.
+ */
+struct ArenaChunk {
+    ArenaChunk * next; /**< previous chunk obtained by the arena */
+    size_t size; /**< usable bytes in data */
+    size_t used; /**< bytes of data already given */
+    unsigned char * data; /**< usable memory (ARENA_ALIGN aligned) */
+};
+
+/**
+ * @brief Region allocator: memory is given in bump-pointer fashion from big chunks and
+ *        it is given back to the heap all at once by #Arena_release.
+ */
+struct Arena {
+    pthread_mutex_t lock; /**< lock variable */
+    size_t chunkSize; /**< default size of a new chunk */
+    ArenaChunk * chunks; /**< chunks obtained from the heap (the first one is the current) */
+    Pool * pools; /**< pools allocated inside the arena */
+    long nChunks; /**< number of chunks obtained from the heap */
+};
+
+/**
+ * @brief Thread safe pool of fixed-size blocks carved from an Arena.
+ *        Freed blocks are kept in a free list and reused.
+ */
+struct Pool {
+    pthread_mutex_t lock; /**< lock variable */
+    Arena * arena; /**< arena where blocks are carved */
+    Pool * next; /**< next pool of the same arena */
+    size_t blockSize; /**< size of a single block */
+    long grow; /**< number of blocks carved each time the free list is empty */
+    void * free; /**< free list */
+    long nFree; /**< blocks in free list */
+    long nTot; /**< blocks carved */
+};
+
+int Arena_init(Arena * p_a, size_t p_chunkSize);
+void * Arena_alloc(Arena * p_a, size_t p_size);
+void * Arena_allocAligned(Arena * p_a, size_t p_size, size_t p_align);
+void Arena_release(Arena * p_a);
+
+Pool * Pool_init(Arena * p_a, size_t p_blockSize, long p_prealloc, long p_grow);
+void * Pool_alloc(Pool * p_p);
+void Pool_free(Pool * p_p, void * p_block);
+
+#endif	/* ARENA_H */
@@ -0,0 +1,37 @@
+/**
+ * @file DeskBoard.h
+ * @brief Header file of DeskBoard.c
+ */
+
+#ifndef DESKBOARD_H
+#define DESKBOARD_H
+
+#include <stdint.h>
+#include <Arena.h>
+
+typedef struct DeskBoard DeskBoard;
+
+/**
+ * @brief Last status reported by each desk in the current round, with the aggregates the director decides on.
+ *        A round ends when every desk reported at least once. The aggregates are updated in O(1) for each report,
+ *        and a new round starts in O(1): reports of older rounds are recognized by their round number.
+ *        #DeskBoard_count recomputes the aggregates from scratch (SIMD), to verify and resynchronize them.
+ */
+struct DeskBoard {
+    int n; /**< number of desks */
+    int s2; /**< users in queue from which an open desk is busy (S2 of the market, >0) */
+    int32_t round; /**< current round */
+    int nReported; /**< desks which reported in the current round */
+    int nNoWork; /**< desks reported open with at most one user in queue, in the current round */
+    int nBusy; /**< desks reported open with at least s2 users in queue, in the current round */
+    int32_t * users; /**< users in queue reported by each desk, -1 if it was closed */
+    int32_t * rounds; /**< round of the last report of each desk */
+};
+
+int DeskBoard_init(DeskBoard * p_b, Arena * p_a, int p_n, int p_s2);
+int DeskBoard_report(DeskBoard * p_b, int p_id, int p_isOpen, int p_users);
+void DeskBoard_nextRound(DeskBoard * p_b);
+void DeskBoard_count(const DeskBoard * p_b, int * p_noWork, int * p_busy);
+int DeskBoard_verify(DeskBoard * p_b);
+
+#endif	/* DESKBOARD_H */
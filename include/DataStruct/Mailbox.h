@@ -0,0 +1,37 @@
+/**
+ * @file Mailbox.h
+ * @brief Header file of Mailbox.c
+ */
+
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <stdatomic.h>
+
+#define MAILBOX_USER 0x1u /**< News: a user has been added to the queue of the owner */
+#define MAILBOX_STATE 0x2u /**< News: the state of the owner changed */
+#define MAILBOX_WAKE 0x4u /**< News: anything else (market closing, shopping area empty) */
+#define MAILBOX_WAITING 0x80000000u /**< The owner is sleeping, or about to sleep: posters must wake it up */
+
+typedef struct Mailbox Mailbox;
+
+/**
+ * @brief Wakeup word of a thread (futex): other threads post news, the owner takes all of them with one wait.
+ *        Posting costs a system call only when the owner is sleeping.
+ *        The owner can also be a task (see #Mailbox_initTask): instead of sleeping it parks, and the first post
+ *        after that calls wake to run it again.
+ */
+struct Mailbox {
+    atomic_uint word; /**< news posted and not yet taken, and #MAILBOX_WAITING */
+    void (*wake)(void *); /**< task owner: called to run it again once parked (NULL: the owner is a thread) */
+    void * wakeArg; /**< argument of wake */
+};
+
+void Mailbox_init(Mailbox * p_b);
+void Mailbox_initTask(Mailbox * p_b, void (*p_wake)(void *), void * p_arg);
+void Mailbox_post(Mailbox * p_b, unsigned p_news);
+unsigned Mailbox_take(Mailbox * p_b);
+unsigned Mailbox_wait(Mailbox * p_b);
+int Mailbox_park(Mailbox * p_b);
+
+#endif	/* MAILBOX_H */
@@ -8,23 +8,45 @@
 
 #include <TMarket.h>
 #include <TCashDesk.h>
+#include <stdatomic.h>
 
 
 typedef struct Market Market;
 typedef struct CashDesk CashDesk;
 typedef struct PayArea PayArea;
+typedef struct DeskHeap DeskHeap;
+
+/**
+ * @brief Min-heap of the open desks keyed on the length of their queues (ties on the lower index).
+ */
+struct DeskHeap {
+    int * dims; /**< users in queue of each desk, -1 if the desk is closed */
+    int * heap; /**< desk indices: heap[0] is the open desk with the shortest queue */
+    int * pos; /**< position in heap of each desk */
+    int n; /**< desks in heap */
+};
+
 /**
  * @brief Data structure used to store information about a PayArea.
  * A pay area is made of a limited set of cash desks.
+ * Desks are opened and closed holding the lock, while users join a queue and queries read the
+ * desk states and queue lengths without it.
  * 
  */
 struct PayArea {
     pthread_mutex_t lock;  /**< lock variable */
     Market * market;    /**< market where the payment area is located */
     int nTot;    /**< number of all desks */
-    int nOpen;  /**< number of open desks*/
-    int nClose; /**< number of closed desk*/
+    atomic_int nOpen;  /**< number of open desks (written under lock, read without) */
+    atomic_int nClose; /**< number of closed desk (written under lock, read without) */
     CashDesk ** desks; /**< Array of cashdesk */ 
+    UQueueLinks * links; /**< Links of the users in the desk queues */
+    DeskHeap jockeyHeap; /**< Scratch heap of #PayArea_jockey (used under lock) */
+    DeskHeap closeHeap; /**< Scratch heap of #PayArea_tryCloseDesk (used by the director only, without lock) */
+    int * movers; /**< Scratch array of #PayArea_jockey: users leaving a queue */
+    int * moveTo; /**< Scratch array of #PayArea_jockey: desk chosen by each user of movers */
+    int * chainFirst; /**< Scratch array of #PayArea_tryCloseDesk: first user moved to each desk */
+    int * chainLast; /**< Scratch array of #PayArea_tryCloseDesk: last user moved to each desk */
 };
 
 PayArea * PayArea_init(Market * p_m, int p_tot, int p_open);
@@ -33,10 +55,12 @@ int PayArea_isEmpty(PayArea *p_a);
 void PayArea_Signal(PayArea *p_a);
 void PayArea_tryOpenDesk(PayArea *p_a);
 void PayArea_tryCloseDesk(PayArea *p_a);
-void PayArea_addUser(PayArea * p_a, User * p_u);
+void PayArea_addUser(PayArea * p_a, int p_u);
+int PayArea_jockey(void * p_arg);
 
 void PayArea_startDeskThreads(PayArea *p_a);
 void PayArea_joinDeskThreads(PayArea *p_a);
+int PayArea_isEnded(PayArea *p_a);
 
 void PayArea_Lock(PayArea * p_a);
 void PayArea_Unlock(PayArea * p_a);
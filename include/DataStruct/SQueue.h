@@ -7,10 +7,12 @@
 #define SQueue_h
 
 #define MAX_STRING_NODE 1024 /**< Max length for node string representation. Used by #SQueue_print */
+#define SQUEUE_SPARE_MAX 64 /**< Max number of free nodes kept by a queue created with #SQueue_initPool */
 
 #include <stdio.h>
 #include <errno.h>
 #include <pthread.h>
+#include <Arena.h>
 
 typedef	void (*funDealloc)(void *); /**< function to dealloc data inside nodes */
 typedef	void (*funMap)(void *); /**< function to applay to data contained in each node of the list */
@@ -29,26 +31,34 @@ struct Node {
 
 /**
  * @brief SQueue is a mutable thread safe queue in which generic elements (void *) can be added or removed
+ *        Queues are allocated #CACHE_LINE aligned: everything written by a push or a pop (lock, ends and length)
+ *        is on the first line, the conditions, touched only when a thread waits, are on their own lines.
  * 
  */
 struct SQueue{
     pthread_mutex_t lock;  /**< lock variable */
-    pthread_cond_t cv_full; /**< used to wait when is full */
-    pthread_cond_t cv_empty; /**< used to wait when is empty */ 
-    long n;  /**< number of element currently in the queue */
-    long max;  /**< is the max number of elements that queue can contain (<=0: no limit) */
     Node * h; /**< head pointer */
     Node * t; /**< tail pointer */
+    long n;  /**< number of element currently in the queue */
+    Node * spare; /**< free nodes kept for next pushes (only with a pool) */
+    long nSpare; /**< number of nodes in spare */
+    long max;  /**< is the max number of elements that queue can contain (<=0: no limit) */
+    Pool * nodes; /**< pool where nodes are taken (NULL: nodes are malloc'd) */
+    _Alignas(CACHE_LINE) pthread_cond_t cv_full; /**< used to wait when is full */
+    pthread_cond_t cv_empty; /**< used to wait when is empty */ 
 };
 
 
 
 SQueue * SQueue_init(long p_max);
+SQueue * SQueue_initPool(long p_max, Pool * p_nodes);
 int SQueue_deleteQueue(SQueue * p_q, funDealloc p_funNodeDel);
 int SQueue_push(SQueue * p_q, void * p_new);
 int SQueue_pushWait(SQueue * p_q, void * p_new);
+int SQueue_pushAll(SQueue * p_q, void ** p_news, long p_n);
 int SQueue_pop(SQueue * p_q, void ** p_removed);
 int SQueue_popWait(SQueue * p_q, void ** p_removed);
+long SQueue_popAll(SQueue * p_q, void ** p_removed, long p_max);
 int SQueue_isEmpty(SQueue * p_q);
 int SQueue_isFull(SQueue * p_q);
 void SQueue_print(SQueue * p_q, funPrint p_funPrint);
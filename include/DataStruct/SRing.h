@@ -0,0 +1,33 @@
+/**
+ * @file SRing.h
+ * @brief Header file of SRing.c
+ */
+
+#ifndef SRING_H
+#define SRING_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define SRING_CACHE_LINE 64 /**< head and tail are kept on different cache lines */
+
+typedef struct SRing SRing;
+
+/**
+ * @brief Lock-free ring of fixed-size messages with a single producer and a single consumer.
+ *        It has no pointers inside, so it can be placed in memory shared by different processes.
+ */
+struct SRing {
+    _Alignas(SRING_CACHE_LINE) atomic_ulong head; /**< next slot to read (written by the consumer) */
+    _Alignas(SRING_CACHE_LINE) atomic_ulong tail; /**< next slot to write (written by the producer) */
+    _Alignas(SRING_CACHE_LINE) unsigned long cap; /**< number of slots (power of 2) */
+    size_t msgSize; /**< size of each message */
+    _Alignas(SRING_CACHE_LINE) unsigned char data[]; /**< slots */
+};
+
+size_t SRing_size(unsigned long p_cap, size_t p_msgSize);
+SRing * SRing_init(void * p_mem, unsigned long p_cap, size_t p_msgSize);
+int SRing_push(SRing * p_r, const void * p_msg);
+int SRing_pop(SRing * p_r, void * p_msg);
+
+#endif	/* SRING_H */
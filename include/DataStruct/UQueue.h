@@ -0,0 +1,60 @@
+/**
+ * @file UQueue.h
+ * @brief Header file of UQueue.c
+ */
+
+#ifndef UQUEUE_H
+#define UQUEUE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <Arena.h>
+
+#define UQUEUE_NONE -1 /**< No user / no queue */
+
+typedef struct UQueue UQueue;
+typedef struct UQueueLinks UQueueLinks;
+
+/**
+ * @brief Links of the users shared by a group of #UQueue: a user is in at most one queue of the group.
+ *        Entry u of each array belongs to user u and it is written under the lock of the queue where u is (or by the
+ *        owner of a detached chain, see #UQueue_detach). queue[u] is also read under the lock of any other queue of
+ *        the group (see #UQueue_remove), so it is atomic.
+ */
+struct UQueueLinks {
+    int cap; /**< number of users */
+    int32_t * next; /**< next user in the same queue (towards the tail) */
+    int32_t * prev; /**< previous user in the same queue (towards the head) */
+    _Atomic int32_t * queue; /**< id of the queue where the user is, #UQUEUE_NONE if none */
+    int32_t * visits; /**< queues visited by each user, incremented each time it enters a queue of the group (NULL: not counted) */
+};
+
+/**
+ * @brief Thread safe FIFO queue of users (indexes in the #UserStore), doubly linked through #UQueueLinks:
+ *        push, pop and removal of any user are O(1) and never allocate.
+ */
+struct UQueue {
+    pthread_mutex_t lock; /**< lock variable */
+    int id; /**< number of the queue in its group */
+    int32_t head; /**< first user, #UQUEUE_NONE if empty */
+    int32_t tail; /**< last user, #UQUEUE_NONE if empty */
+    atomic_int n; /**< number of users (it can be read without lock) */
+    UQueueLinks * links; /**< links of the group */
+};
+
+UQueueLinks * UQueueLinks_init(Arena * p_a, int p_cap);
+int UQueue_init(UQueue * p_q, int p_id, UQueueLinks * p_links);
+void UQueue_delete(UQueue * p_q);
+void UQueue_push(UQueue * p_q, int p_u);
+int UQueue_pop(UQueue * p_q, int * p_u);
+int UQueue_remove(UQueue * p_q, int p_u);
+int UQueue_dim(UQueue * p_q);
+int UQueue_isEmpty(UQueue * p_q);
+void UQueue_Lock(UQueue * p_q);
+void UQueue_Unlock(UQueue * p_q);
+void UQueue_removeLocked(UQueue * p_q, int p_u);
+int UQueue_detach(UQueue * p_q, int * p_first);
+int UQueue_pushChain(UQueue * p_q, int p_first, int p_last);
+
+#endif	/* UQUEUE_H */
@@ -0,0 +1,45 @@
+/**
+ * @file WSDeque.h
+ * @brief Header file of WSDeque.c
+ */
+
+#ifndef WSDEQUE_H
+#define WSDEQUE_H
+
+#include <stdatomic.h>
+#include <Arena.h>
+
+#define WSDEQUE_ABORT ((void *) -1) /**< #WSDeque_steal lost a race with another thief or with the owner: try again later */
+
+typedef struct WSArray WSArray;
+typedef struct WSDeque WSDeque;
+
+/**
+ * @brief Circular array of a #WSDeque. Arrays replaced when the deque grows are kept until the deque is deleted,
+ *        because a thief may still be reading them.
+ */
+struct WSArray {
+    long cap; /**< capacity (power of 2) */
+    WSArray * prev; /**< array replaced by this one */
+    _Atomic(void *) items[]; /**< items, item i at i & (cap - 1) */
+};
+
+/**
+ * @brief Work-stealing deque (Chase-Lev): the owner pushes and pops at the bottom without locks, other threads
+ *        steal the oldest item at the top with a single compare and swap.
+ *        The two ends are on different cache lines (the deque must be allocated #CACHE_LINE aligned).
+ */
+struct WSDeque {
+    _Atomic(WSArray *) array; /**< current array */
+    _Alignas(CACHE_LINE) atomic_long top; /**< next item to steal (written by the thieves, and by the owner for the last item) */
+    _Alignas(CACHE_LINE) atomic_long bottom; /**< next free slot (written by the owner only) */
+};
+
+int WSDeque_init(WSDeque * p_d, long p_cap);
+void WSDeque_delete(WSDeque * p_d);
+int WSDeque_push(WSDeque * p_d, void * p_x);
+void * WSDeque_pop(WSDeque * p_d);
+void * WSDeque_steal(WSDeque * p_d);
+long WSDeque_dim(WSDeque * p_d);
+
+#endif	/* WSDEQUE_H */
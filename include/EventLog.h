@@ -0,0 +1,140 @@
+/**
+ * @file EventLog.h
+ * @brief Header file for EventLog.c
+ */
+#ifndef	_EVENTLOG_H
+#define	_EVENTLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define EVENT_LOG_MAGIC 0x4C56454DU /**< "MEVL": magic number at the begining of each chunk */
+#define EVENT_BUF_LEN 4096 /**< Events buffered by each thread before a flush */
+
+typedef enum EventType EventType;
+typedef enum TracePhase TracePhase;
+typedef enum TraceRole TraceRole;
+typedef struct EventRec EventRec;
+typedef struct EventChunk EventChunk;
+typedef struct Event Event;
+
+/**
+ * @brief State transitions recorded by the event log.
+ */
+enum EventType {
+    EV_SKIP,            /**< no transition: carries the high 32 bits of a delta too big for a single event (arg) */
+    EV_USER_SHOPPING,   /**< user id entered shopping area. arg: products, arg2: shopping time (ms) */
+    EV_USER_QUEUE,      /**< user id joined desk queue. arg: desk id */
+    EV_USER_AUTH,       /**< user id joined authorization queue */
+    EV_USER_CHANGE,     /**< user id changed queue. arg: new desk id, arg2: closed desk id */
+    EV_USER_SERVICE,    /**< desk started to serve user id. arg: desk id */
+    EV_USER_SERVED,     /**< user id served. arg: desk id */
+    EV_USER_EXIT,       /**< user id exit from the market */
+    EV_DESK_OPEN,       /**< desk id opened */
+    EV_DESK_CLOSE,      /**< desk id closed */
+    EV_SCOPE_BEGIN,     /**< calling thread entered a phase. arg: #TracePhase */
+    EV_SCOPE_END,       /**< calling thread left a phase. arg: #TracePhase */
+    EV_THREAD_NAME,     /**< calling thread has role arg (#TraceRole) with index id */
+    EV_TYPES            /**< number of event types */
+};
+
+/**
+ * @brief Phases of thread activity delimited by #TRACE_BEGIN and #TRACE_END.
+ */
+enum TracePhase {
+    PH_STARTUP,         /**< market startup */
+    PH_SHUTDOWN,        /**< market closing */
+    PH_IDLE,            /**< blocked in pthread_cond_wait waiting for work */
+    PH_SHOPPING,        /**< user sleeping in waitMs for shopping time */
+    PH_MOVE,            /**< user moving to a desk or to the authorization queue */
+    PH_SERVE,           /**< desk serving a user */
+    PH_DRAIN,           /**< desk or director emptying its queue on closing */
+    PH_NOTIFY_SLEEP,    /**< desk notifier sleeping in waitMs */
+    PH_DECIDE,          /**< director taking a decision on desks */
+    PH_EXIT,            /**< market processing exited users */
+    PH_LOCK_WAIT,       /**< waiting for a contended lock */
+    PH_TYPES            /**< number of phases */
+};
+
+/**
+ * @brief Roles of threads, used to name them in the exported trace.
+ */
+enum TraceRole {
+    TH_MARKET,          /**< market thread */
+    TH_DIRECTOR,        /**< director thread */
+    TH_AUTH,            /**< director thread handling authorizations */
+    TH_DESK,            /**< cash desk thread */
+    TH_NOTIFIER,        /**< cash desk notifier thread */
+    TH_USER,            /**< user thread */
+    TH_WORKER,          /**< executor worker, running tasks of market, users, desks and director */
+    TH_JOCKEY,          /**< director thread letting users change queue */
+    TH_TYPES            /**< number of roles */
+};
+
+/**
+ * @brief Fixed-size event as stored inside a chunk.
+ *        Timestamps are delta-encoded: each event stores the ns elapsed from the previous one of the same chunk.
+ */
+struct EventRec {
+    uint32_t delta; /**< ns since previous event in the chunk (0 for the first one) */
+    uint32_t info; /**< event type (low 8 bits) and second argument (high 24 bits) */
+    int32_t id; /**< user or desk id */
+    int32_t arg; /**< first argument */
+};
+
+/**
+ * @brief Header of a chunk: a run of events flushed at once by a single thread.
+ */
+struct EventChunk {
+    uint32_t magic; /**< must be EVENT_LOG_MAGIC */
+    uint32_t tid; /**< recording thread */
+    uint64_t base; /**< absolute timestamp (ns) of the first event */
+    uint32_t count; /**< number of EventRec following the header */
+    uint32_t pad; /**< unused */
+};
+
+/**
+ * @brief Decoded event with absolute timestamp.
+ */
+struct Event {
+    uint64_t ts; /**< absolute timestamp (ns) */
+    uint32_t tid; /**< recording thread */
+    uint32_t seq; /**< position of the event in the log (used as tie-break) */
+    EventType type; /**< event type */
+    int id; /**< user or desk id */
+    int arg; /**< first argument */
+    int arg2; /**< second argument */
+};
+
+extern int g_eventLogOn;
+
+/**
+ * @brief Record an event only if the event log is enabled.
+ */
+#define EVENT_RECORD(T, ID, ARG, ARG2) \
+    do {\
+        if(g_eventLogOn) EventLog_record((T), (ID), (ARG), (ARG2));\
+    } while(0)
+
+/**
+ * @brief Delimit a phase of the calling thread activity (see #TracePhase).
+ */
+#define TRACE_BEGIN(PH) EVENT_RECORD(EV_SCOPE_BEGIN, 0, (PH), 0)
+#define TRACE_END(PH) EVENT_RECORD(EV_SCOPE_END, 0, (PH), 0)
+/**
+ * @brief Name the calling thread (see #TraceRole).
+ */
+#define TRACE_THREAD_NAME(ROLE, ID) EVENT_RECORD(EV_THREAD_NAME, (ID), (ROLE), 0)
+
+int EventLog_open(const char * p_path);
+void EventLog_close(void);
+void EventLog_record(EventType p_type, int p_id, int p_arg, int p_arg2);
+void EventLog_flushThread(void);
+int EventLog_load(const char * p_path, Event ** p_events, size_t * p_n);
+const char * EventLog_typeName(EventType p_type);
+const char * EventLog_phaseName(TracePhase p_phase);
+void EventLog_threadName(TraceRole p_role, int p_id, char * p_buff, size_t p_size);
+void EventLog_lock(pthread_mutex_t * p_lock);
+
+#endif	/* _EVENTLOG_H */
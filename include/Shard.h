@@ -0,0 +1,63 @@
+/**
+ * @file Shard.h
+ * @brief Header file for Shard.c
+ */
+#ifndef	_SHARD_H
+#define	_SHARD_H
+
+#include <stdint.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <SRing.h>
+
+#define SHARD_RING_CAP 1024 /**< Messages in each ring */
+#define SHARD_POLL_MS 10 /**< Polling interval of the rings */
+#define SHARD_PROGRESS_MS 1000 /**< Progress report interval */
+
+typedef enum ShardMsgType ShardMsgType;
+typedef struct ShardMsg ShardMsg;
+typedef struct ShardLink ShardLink;
+
+/**
+ * @brief Messages exchanged by the coordinator and the shards.
+ */
+enum ShardMsgType {
+    SHARD_READY,    /**< shard -> coordinator: stores created (store: number of stores) */
+    SHARD_FAILED,   /**< shard -> coordinator: setup failed, the shard is exiting */
+    SHARD_START,    /**< coordinator -> shard: start the stores */
+    SHARD_HUP,      /**< coordinator -> shard: graceful closure (as SIGHUP) */
+    SHARD_QUIT,     /**< coordinator -> shard: fast closure (as SIGQUIT) */
+    SHARD_PROGRESS, /**< shard -> coordinator: users logged so far (users) */
+    SHARD_STORE,    /**< shard -> coordinator: final results of a store */
+    SHARD_DONE      /**< shard -> coordinator: all the stores are closed, no more messages */
+};
+
+/**
+ * @brief Fixed-size message carried by the rings.
+ */
+struct ShardMsg {
+    int32_t type; /**< #ShardMsgType */
+    int32_t store; /**< store id (position in the chain file) */
+    int64_t users; /**< users logged */
+    int64_t clients; /**< users served by the desks */
+    int64_t products; /**< products processed */
+    int64_t closures; /**< desk closures */
+};
+
+/**
+ * @brief Coordinator side of a shard: rings (in shared memory) and merged results.
+ */
+struct ShardLink {
+    SRing * control; /**< coordinator -> shard */
+    SRing * report; /**< shard -> coordinator */
+    pid_t pid; /**< shard process */
+    int isDone; /**< 1 when the shard has finished (or died) */
+    int isFailed; /**< 1 if the shard did not complete its run */
+    int stores; /**< stores owned by the shard */
+    ShardMsg tot; /**< results of the shard (users is also updated by progress reports) */
+    long closedUsers; /**< users of the stores whose results have been received */
+};
+
+int Shard_run(const char * p_chain, const char * p_log, int p_nShards, sigset_t * p_set);
+
+#endif	/* _SHARD_H */
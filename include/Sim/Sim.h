@@ -0,0 +1,177 @@
+/**
+ * @file Sim.h
+ * @brief Header file for Sim.c
+ */
+#ifndef	_SIM_H
+#define	_SIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <SimEvent.h>
+#include <SimModel.h>
+#include <Arena.h>
+
+#define SIM_MAX_WORKERS 256 /**< Maximum number of worker threads of the parallel engines */
+#define SIM_ARENA_CHUNK (1024L * 1024) /**< Size of each chunk of the simulation arena */
+#define SIM_GVT_EVENTS 4096 /**< Optimistic engine: events processed by a worker before it asks for a GVT round */
+#define SIM_GVT_IDLE_NS 1000000 /**< Optimistic engine: an idle worker asks for a GVT round after this time (ns) */
+#define SIM_OPTIMISM 8 /**< Optimistic engine: events are processed only up to GVT + SIM_OPTIMISM lookaheads */
+#define SIM_ANTI(p_type) (-1 - (p_type)) /**< Type of the anti-message of an event of type p_type, and vice versa */
+
+/**
+ * @brief Save the current value of p_x before the process p_lp modifies it (optimistic engine only).
+ */
+#define SIM_SAVE(p_lp, p_x) do { if((p_lp)->hist != NULL) Sim_save((p_lp), &(p_x), sizeof(p_x)); } while(0)
+
+typedef struct SimWorker SimWorker;
+typedef struct SimOutbox SimOutbox;
+typedef struct SimUndo SimUndo;
+typedef struct SimDone SimDone;
+typedef struct SimHistory SimHistory;
+typedef struct SimCancelSet SimCancelSet;
+typedef enum SimEngine SimEngine;
+
+/**
+ * @brief Execution engines. All of them produce the same results for the same seed.
+ */
+enum SimEngine {
+    SIM_SEQUENTIAL,  /**< one event list for all the logical processes */
+    SIM_CONSERVATIVE, /**< logical processes split among workers, synchronized by lookahead windows */
+    SIM_OPTIMISTIC   /**< logical processes split among workers, which run ahead and roll back (Time Warp) */
+};
+
+/**
+ * @brief Value of a piece of state before it was modified by a processed event.
+ */
+struct SimUndo {
+    void * addr; /**< modified memory */
+    long off; /**< position of the old value in #SimHistory.bytes */
+    long size; /**< bytes saved */
+};
+
+/**
+ * @brief An event processed by a process and not yet committed.
+ */
+struct SimDone {
+    SimEvent e; /**< the event */
+    int64_t seq; /**< events sent by the process before this one */
+    long undo; /**< first entry of #SimHistory.undo written by this event */
+    long out; /**< first entry of #SimHistory.out sent by this event */
+};
+
+/**
+ * @brief History of a process in the optimistic engine: what is needed to roll back the events
+ *        processed after the GVT. Older entries are discarded at each GVT round (fossil collection).
+ */
+struct SimHistory {
+    SimDone * done; /**< processed events, in order */
+    long nDone, capDone;
+    SimUndo * undo; /**< saved values, in order */
+    long nUndo, capUndo;
+    uint8_t * bytes; /**< old values of the undo entries */
+    long nBytes, capBytes;
+    SimEvent * out; /**< events sent, in order (to cancel them with anti-messages) */
+    long nOut, capOut;
+};
+
+/**
+ * @brief Pending events cancelled by an anti-message before being processed (open addressing on src and seq).
+ *        Whole events are compared: after a rollback the sender can send a different event with the same seq.
+ */
+struct SimCancelSet {
+    SimEvent * ev; /**< dst == -1: free */
+    long n; /**< events in the set */
+    long cap; /**< power of 2 */
+};
+
+/**
+ * @brief A logical process: the front (shopping area and director) or a desk of a store.
+ *        The front of a store is followed by its K desks in #Sim.lps.
+ */
+struct SimLP {
+    int id; /**< position in #Sim.lps */
+    int store; /**< store of the process */
+    int desk; /**< desk number, -1 for the front */
+    int worker; /**< worker which runs the process (parallel engines) */
+    int64_t seq; /**< events sent so far */
+    SimTime now; /**< time of the event being processed */
+    SimHistory * hist; /**< history for rollbacks (optimistic engine only, otherwise NULL) */
+    union {
+        SimFront * front;
+        SimDesk * desk;
+    } state; /**< model state */
+};
+
+/**
+ * @brief Events sent by a worker to the processes of another worker during a window.
+ */
+struct SimOutbox {
+    SimEvent * ev; /**< events */
+    long n; /**< events in ev */
+    long cap; /**< capacity of ev */
+    pthread_mutex_t lock; /**< optimistic engine: the outbox is filled and emptied while workers run */
+};
+
+/**
+ * @brief A worker thread of the parallel engines.
+ */
+struct SimWorker {
+    int id; /**< worker number */
+    Sim * sim; /**< simulation */
+    SimCalendar pending; /**< pending events of the processes of the worker */
+    SimOutbox * out; /**< out[w]: events for the processes of worker w */
+    SimTime next; /**< time of the first pending event at the end of the last window (or at the GVT round) */
+    long long events; /**< events processed */
+    SimCancelSet cancelled; /**< optimistic engine: pending events which must be skipped */
+    SimOutbox inbox; /**< optimistic engine: events being received */
+    long long rolledBack; /**< optimistic engine: events undone */
+    long long rollbacks; /**< optimistic engine: rollbacks */
+    long long antis; /**< optimistic engine: anti-messages sent */
+    pthread_t thread; /**< thread of the worker */
+};
+
+/**
+ * @brief A virtual-time simulation of one or more stores.
+ */
+struct Sim {
+    SimLP * lps; /**< logical processes */
+    int nLPs; /**< number of logical processes */
+    int * stores; /**< stores[i]: position in lps of the front of store i */
+    int nStores; /**< number of stores */
+    SimTime end; /**< events at end or later are not processed */
+    SimTime lookahead; /**< minimum delay of the events sent to another process */
+    SimEngine engine; /**< engine used by the run */
+    SimCalendar pending; /**< event list of the sequential engine */
+    SimWorker * workers; /**< workers of the parallel engines */
+    int nWorkers; /**< number of workers */
+    pthread_barrier_t barrier; /**< end of the phases of a window */
+    long long events; /**< events processed */
+    long long windows; /**< synchronization windows (conservative) or GVT rounds (optimistic) */
+    long long rolledBack; /**< events undone (optimistic) */
+    long long rollbacks; /**< rollbacks (optimistic) */
+    long long antis; /**< anti-messages sent (optimistic) */
+    atomic_int gvtRequest; /**< optimistic engine: 1 when a worker asks for a GVT round */
+    SimTime gvt; /**< optimistic engine: no event earlier than gvt can be rolled back */
+    int isStarted; /**< 1 once the first events are scheduled: then events must be in the future */
+    SimTime * trace; /**< delays (t - now) of the first events sent, NULL if not recorded (see #Sim_trace) */
+    long nTrace, capTrace; /**< delays recorded and to record */
+    double wallTime; /**< duration of the run (s) */
+    int isRun; /**< 1 after a run */
+    Arena arena; /**< processes and model state */
+};
+
+Sim * Sim_init(const char * p_path, int p_isChain, SimTime p_end, uint64_t p_seed);
+void Sim_delete(Sim * p_s);
+int Sim_runSequential(Sim * p_s);
+int Sim_runConservative(Sim * p_s, int p_workers);
+int Sim_runOptimistic(Sim * p_s, int p_workers);
+void Sim_save(SimLP * p_lp, void * p_addr, long p_size);
+int Sim_trace(Sim * p_s, long p_max);
+void Sim_send(Sim * p_s, SimLP * p_from, int p_dst, SimTime p_t, int p_type, int32_t p_a, int64_t p_b);
+void Sim_storeStats(Sim * p_s, int p_i, SimStoreStats * p_st);
+uint64_t Sim_digest(Sim * p_s);
+void Sim_log(Sim * p_s, FILE * p_f);
+
+#endif	/* _SIM_H */
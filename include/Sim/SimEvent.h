@@ -0,0 +1,87 @@
+/**
+ * @file SimEvent.h
+ * @brief Events of the virtual-time engine and their pending-event set.
+ */
+#ifndef	_SIMEVENT_H
+#define	_SIMEVENT_H
+
+#include <stdint.h>
+
+#define SIM_TIME_MAX INT64_MAX /**< No event */
+#define SIM_MS(x) ((SimTime)(x) * 1000000) /**< ms to #SimTime */
+
+typedef int64_t SimTime; /**< Virtual time (ns) */
+typedef struct SimEvent SimEvent;
+typedef struct SimHeap SimHeap;
+typedef struct SimCalendar SimCalendar;
+
+/**
+ * @brief Event sent by a logical process to itself or to another one.
+ *        Events are processed in (t, src, seq) order: the key does not depend on the order in which
+ *        logical processes were executed, so every engine delivers the same sequence to each process.
+ */
+struct SimEvent {
+    SimTime t; /**< time of the event */
+    int64_t seq; /**< number of events sent before by src */
+    int32_t src; /**< sender */
+    int32_t dst; /**< receiver */
+    int32_t type; /**< meaning depends on the model (see SimModel.h) */
+    int32_t a; /**< payload */
+    int64_t b; /**< payload */
+};
+
+/**
+ * @brief Binary min-heap of events. A zeroed heap is a valid empty heap.
+ */
+struct SimHeap {
+    SimEvent * ev; /**< events, ev[0] is the next one */
+    long n; /**< events in the heap */
+    long cap; /**< capacity of ev */
+};
+
+/**
+ * @brief Calendar queue of events (R. Brown, 1988): O(1) amortized push and pop.
+ *        Time is divided in days of #width ns; day d goes in bucket d % #nBuckets and a year is #nBuckets
+ *        days. Pop scans the buckets from the current day. The number of buckets follows the number of events
+ *        and the day width is tuned on the spacing of the next events.
+ *        Each bucket is a #SimHeap rather than a sorted list: model times are whole ms, so many events share
+ *        the same time and a bucket can't be split below that.
+ */
+struct SimCalendar {
+    SimHeap * bucket; /**< events of each day of the year */
+    long nBuckets; /**< number of buckets (power of 2) */
+    SimTime width; /**< duration of a day */
+    long cur; /**< bucket of the current day */
+    SimTime top; /**< end of the current day */
+    long n; /**< events in the calendar */
+    long ops; /**< operations since the last check of the width */
+    long steps; /**< empty days scanned since the last check of the width */
+    long resizes; /**< rebuilds (statistics) */
+};
+
+/**
+ * @brief Order of the events.
+ * @return int: 1 if p_1 comes before p_2
+ */
+static inline int SimEvent_before(const SimEvent * p_1, const SimEvent * p_2) {
+    if(p_1->t != p_2->t) return p_1->t < p_2->t;
+    if(p_1->src != p_2->src) return p_1->src < p_2->src;
+    return p_1->seq < p_2->seq;
+}
+
+int SimHeap_init(SimHeap * p_h, long p_cap);
+void SimHeap_delete(SimHeap * p_h);
+int SimHeap_push(SimHeap * p_h, const SimEvent * p_e);
+int SimHeap_pop(SimHeap * p_h, SimEvent * p_e);
+/**
+ * @brief Time of the next event, #SIM_TIME_MAX if the heap is empty.
+ */
+static inline SimTime SimHeap_next(const SimHeap * p_h) { return p_h->n > 0 ? p_h->ev[0].t : SIM_TIME_MAX; }
+
+int SimCalendar_init(SimCalendar * p_c);
+void SimCalendar_delete(SimCalendar * p_c);
+int SimCalendar_push(SimCalendar * p_c, const SimEvent * p_e);
+int SimCalendar_pop(SimCalendar * p_c, SimEvent * p_e);
+SimTime SimCalendar_next(SimCalendar * p_c);
+
+#endif	/* _SIMEVENT_H */
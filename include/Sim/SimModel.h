@@ -0,0 +1,117 @@
+/**
+ * @file SimModel.h
+ * @brief Header file for SimModel.c
+ */
+#ifndef	_SIMMODEL_H
+#define	_SIMMODEL_H
+
+#include <stdint.h>
+#include <SimEvent.h>
+#include <Arena.h>
+
+#define SIM_WALK_MS 10 /**< Delay of every interaction between the front and the desks of a store (ms). It is the minimum
+                            shopping time: a user chooses the desk in the last SIM_WALK_MS of shopping. */
+#define SIM_SERVICE_MIN_MS 20 /**< Minimum service constant of a desk (ms) */
+#define SIM_SERVICE_MAX_MS 80 /**< Maximum service constant of a desk (ms) */
+
+typedef struct Sim Sim;
+typedef struct SimLP SimLP;
+typedef struct SimParams SimParams;
+typedef struct SimFront SimFront;
+typedef struct SimDesk SimDesk;
+typedef struct SimStoreStats SimStoreStats;
+typedef enum SimEventType SimEventType;
+
+/**
+ * @brief Events of the store model.
+ */
+enum SimEventType {
+    SIM_EV_START,  /**< front: the first C users enter */
+    SIM_EV_CHOOSE, /**< front: user a chooses a desk (SIM_WALK_MS before the end of shopping) */
+    SIM_EV_AUTH,   /**< front: user a, without products, is authorized by the director and exits */
+    SIM_EV_BOUNCE, /**< desk -> front: user a was in the queue of a closed desk */
+    SIM_EV_EXIT,   /**< desk -> front: user a has been served */
+    SIM_EV_REPORT, /**< desk -> front: desk state a and users in queue b, read by the director */
+    SIM_EV_JOIN,   /**< front -> desk: user a with b products joins the queue */
+    SIM_EV_OPEN,   /**< front -> desk: the director opens the desk */
+    SIM_EV_CLOSE,  /**< front -> desk: the director closes the desk */
+    SIM_EV_DONE,   /**< desk: end of the current service */
+    SIM_EV_TICK    /**< desk: notification interval elapsed */
+};
+
+/**
+ * @brief Parameters of a store, read from a market configuration file.
+ */
+struct SimParams {
+    long K, KS, C, E, T, P, S1, S2, NP, TD;
+};
+
+/**
+ * @brief Shopping area and director of a store: one logical process.
+ */
+struct SimFront {
+    SimParams p; /**< parameters of the store */
+    uint64_t rng; /**< random state of the process */
+    int32_t * id; /**< user id of each slot */
+    int32_t * products; /**< products of each slot */
+    int32_t * changes; /**< queues visited by the user of each slot */
+    SimTime * tEntry; /**< entry time of the user of each slot */
+    SimTime * tQueue; /**< time when the user of each slot joined its first queue */
+    int32_t * freeSlots; /**< stack of free slots */
+    int nFree; /**< free slots */
+    int nextId; /**< id of the next user */
+    uint8_t * open; /**< desks open according to the director */
+    int nOpen; /**< open desks according to the director */
+    uint8_t * hasReport; /**< 1 if the desk has reported in the current round */
+    uint8_t * repOpen; /**< last state reported by each desk */
+    int32_t * repUsers; /**< last queue length reported by each desk */
+    int nReports; /**< desks which have reported in the current round */
+    long users; /**< users exited */
+    long productsOut; /**< products of the users exited */
+    long queueChanges; /**< queues visited by the users exited */
+    SimTime sumMarket; /**< total time in market of the users exited */
+    SimTime sumQueue; /**< total time in queue of the users exited */
+    uint64_t digest; /**< hash of the records of the users exited, in exit order */
+    long invalid; /**< impossible events met while running ahead (optimistic engine), undone by rollbacks */
+};
+
+/**
+ * @brief A desk of a store: one logical process.
+ */
+struct SimDesk {
+    int open; /**< 1 if open */
+    int busy; /**< 1 while serving */
+    long serviceConst; /**< service constant (ms) */
+    long NP; /**< ms for each product */
+    SimTime TD; /**< notification interval */
+    int32_t * qSlot; /**< queue (ring): slot of each user */
+    int32_t * qProducts; /**< queue (ring): products of each user */
+    int qHead, qLen, qCap; /**< ring position, length and capacity */
+    long clients; /**< users served */
+    long products; /**< products processed */
+    long closures; /**< closures */
+    SimTime openTime; /**< total open time */
+    SimTime lastOpen; /**< time of the last opening */
+    SimTime serviceTime; /**< total service time */
+    long invalid; /**< impossible events met while running ahead (optimistic engine), undone by rollbacks */
+};
+
+/**
+ * @brief Results of a store.
+ */
+struct SimStoreStats {
+    long users, clients, products, closures, queueChanges;
+    SimTime sumMarket, sumQueue, openTime;
+    uint64_t digest; /**< hash of all the results: equal digests mean equal runs */
+};
+
+int SimModel_load(const char * p_conf, SimParams * p_p);
+SimTime SimModel_lookahead(const SimParams * p_p);
+int SimModel_initFront(SimLP * p_lp, const SimParams * p_p, Arena * p_a, uint64_t p_seed);
+int SimModel_initDesk(SimLP * p_lp, const SimParams * p_p, int p_desk, Arena * p_a, uint64_t p_seed);
+void SimModel_start(Sim * p_s, SimLP * p_lp);
+void SimModel_handle(Sim * p_s, SimLP * p_lp, const SimEvent * p_e);
+void SimModel_finish(SimLP * p_lp, SimTime p_end);
+void SimModel_storeStats(SimLP * p_front, SimStoreStats * p_st);
+
+#endif	/* _SIMMODEL_H */
@@ -7,16 +7,19 @@
 
 #include <pthread.h>
 #include <signal.h>
-#include <SQueue.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <UQueue.h>
+#include <Mailbox.h>
+#include <TExecutor.h>
 #include <TMarket.h>
 
 typedef struct Market Market;
 typedef struct CashDesk CashDesk;
-typedef struct User User;
 typedef struct CashDeskNotify CashDeskNotify;
 typedef enum CashDeskState CashDeskState;
-extern volatile sig_atomic_t sig_hup;
-extern volatile sig_atomic_t sig_quit;
+extern atomic_int sig_hup;
+extern atomic_int sig_quit;
 
 enum CashDeskState {
     DESK_OPEN,
@@ -35,34 +38,56 @@ struct CashDeskNotify {
 
 /**
  * @brief Data structure used to store information about a cash desk.
+ *        Fields are grouped by the threads which write them, each group on its own cache lines
+ *        (desks are allocated #CACHE_LINE aligned), so that users and director reading the state of a desk
+ *        don't invalidate the counters of the desk thread, and vice versa.
  * 
  */
 struct CashDesk {
+    //Read-mostly: set by #CashDesk_init, state is changed only when the desk is opened or closed
     pthread_t thread;   /**< CaskDesk thread */
-    pthread_mutex_t lock;  /**< lock variable */
-    pthread_cond_t cv_DeskNews; /**< used to notify updates to CashDesk thread */
+    Market * market;  /**< Reference to the market where the director is. */
     int id; /** desk id */
     int serviceConst; /**< costant service time */
+    int notifyInterval; /**< notify interval to inform director thread in ms*/
+    atomic_int state;    /**< current cashdesk state (#CashDeskState), written under the lock of the pay area and read without locks */
+    //Written by the threads which wake up the desk
+    _Alignas(CACHE_LINE) Mailbox mailbox; /**< used to notify new users, state changes and closure to CashDesk thread */
+    //Written by the desk thread only (read by others once it ended, see #CashDesk_log)
+    _Alignas(CACHE_LINE) pthread_mutex_t lock;  /**< lock variable */
     int productsProcessed; /**< number of products processed */
     int usersProcessed; /**< number of users served */
     int numClosure; /**< number of closure */
-    int totOpenTime; /**< tot open time in ms */
-    float avgServiceTime; /**< average service time for a user*/
-    int notifyInterval; /**< notify interval to inform director thread in ms*/
-    CashDeskState state;    /**< current cashdesk state */
-    SQueue * usersPay; /**< Users waiting for payment. */
-    Market * market;  /**< Reference to the market where the director is. */
+    int64_t totOpenTime; /**< tot open time (real ns, clock of #getCurrentTimeNs) */
+    int64_t totServiceTime; /**< tot time spent serving users (real ns, clock of #getCurrentTimeNs) */
+    //State of a desk run by the executor of the market, kept between its tasks (see #Market)
+    ExecTask task; /**< serves the queue: it runs when woken up by the mailbox and when a service ends */
+    ExecTask notifyTask; /**< notifies the director every notifyInterval ms */
+    atomic_int nTasks; /**< tasks of the desk not ended yet (see #CashDesk_isEnded) */
+    CashDeskState lastState; /**< state seen by the last run of task */
+    int64_t lastOpenTime; /**< last opening (ns, clock of #getCurrentTimeNs) */
+    int64_t tService; /**< start of the current service (ns, clock of #getCurrentTimeNs) */
+    int servedUser; /**< user being served */
+    int isServing; /**< 1: task is waiting for the end of the service of servedUser */
+    //Written by the users joining the queue and by the desk thread serving it
+    _Alignas(CACHE_LINE) UQueue usersPay; /**< Users waiting for payment (users can leave it from any position, see #PayArea_jockey). */
 };
 
-CashDesk * CashDesk_init(Market * p_m, int p_id, int p_serviceConst, int p_notifyInterval, CashDeskState p_state);
+CashDesk * CashDesk_init(Market * p_m, int p_id, int p_serviceConst, int p_notifyInterval, CashDeskState p_state, UQueueLinks * p_links);
 int CashDesk_delete(CashDesk * p_c);
 int CashDesk_startThread(CashDesk * p_c);
 int CashDesk_joinThread(CashDesk * p_c);
+int CashDesk_isEnded(CashDesk * p_c);
+int CashDesk_notify(void * p_arg);
 void * CashDesk_notifyDirector(void * p_arg);
 void * CashDesk_main(void * p_arg);
 void CashDesk_Lock(CashDesk * p_m);
 void CashDesk_Unlock(CashDesk * p_m);
-void CashDesk_addUser(CashDesk * p_c, User * p_u);
+void CashDesk_Signal(CashDesk * p_c);
+void CashDesk_addUser(CashDesk * p_c, int p_u);
+void CashDesk_addUsers(CashDesk * p_c, int p_first, int p_last);
 void CashDesk_log(CashDesk * p_c);
+CashDeskState CashDesk_getState(CashDesk * p_c);
+void CashDesk_setState(CashDesk * p_c, CashDeskState p_state);
 
 #endif	/* _TCASHDESK_H */
\ No newline at end of file
@@ -7,15 +7,20 @@
 
 #include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <SQueue.h>
+#include <Mailbox.h>
+#include <DeskBoard.h>
+#include <TExecutor.h>
 #include <TCashDesk.h>
 #include <TMarket.h>
 #define DIRECTOR_NAME_MAX 100
+#define DIRECTOR_VERIFY_ROUNDS 64 /**< Rounds of desk reports between two full checks of the aggregates of the director */
 
 typedef struct Market Market;
 typedef struct Director Director;
-extern volatile sig_atomic_t sig_hup;
-extern volatile sig_atomic_t sig_quit;
+extern atomic_int sig_hup;
+extern atomic_int sig_quit;
 
 /**
  * @brief Data structure used to store information about a director.
@@ -28,14 +33,23 @@ struct Director {
     pthread_cond_t cv_Director_AuthNews; /**< used to notify updates to Director thread that handles auth queue */
     pthread_cond_t cv_Director_DesksNews; /**< used to notify updates to Director thread that handles cash desk notifications*/
     SQueue * notifications; /**< notification received from cashdesks */
+    DeskBoard board; /**< last status of each desk in the current round */
+    //State of a director run by the executor of the market (see #Market)
+    Mailbox mailbox; /**< used to notify new users in auth queue, desk notifications and closure to the director task */
+    ExecTask task; /**< authorizes the users and handles the desk notifications: it runs when woken up by the mailbox */
+    ExecTask jockeyTask; /**< lets users change queue every S ms (see #PayArea_jockey) */
+    atomic_int nTasks; /**< tasks of the director not ended yet (see #Director_isEnded) */
 };
 
 Director * Director_init(Market * m);
 int Director_startThread(Director * p_d);
 int Director_joinThread(Director * p_d);
+int Director_isEnded(Director * p_d);
 int Director_delete(Director * p_d);
 void * Director_main(void * p_arg);
 void Director_Lock(Director * p_d);
 void Director_Unlock(Director * p_d);
+void Director_SignalAuth(Director * p_d);
+void Director_SignalDesks(Director * p_d);
 
 #endif	/* _TDIRECTOR_H */
\ No newline at end of file
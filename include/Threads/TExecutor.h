@@ -0,0 +1,69 @@
+/**
+ * @file TExecutor.h
+ * @brief Header file for TExecutor.c
+ */
+#ifndef	_TEXECUTOR_H
+#define	_TEXECUTOR_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <WSDeque.h>
+
+typedef struct Executor Executor;
+typedef struct ExecWorker ExecWorker;
+typedef struct ExecTask ExecTask;
+
+/**
+ * @brief Task of an executor, embedded in the object it works on. A task must not block: waits are done by
+ *        submitting it again with #Executor_submitAt. A task is submitted again only once it has been run.
+ */
+struct ExecTask {
+    void (*fun)(ExecTask *); /**< task body */
+    ExecTask * next; /**< next task in the injection queue of the executor */
+    int64_t due; /**< when the task must run (ns, clock of #getCurrentTimeNs), 0: as soon as possible */
+};
+
+/**
+ * @brief Worker thread of an Executor. It runs the tasks of its deque, newest first, and when it has none it
+ *        steals the oldest task of another worker.
+ */
+struct ExecWorker {
+    WSDeque deque; /**< tasks ready to run (the worker pushes and pops, the others steal) */
+    pthread_t thread; /**< worker thread */
+    Executor * exec; /**< executor of the worker */
+    int id; /**< index of the worker */
+    unsigned seed; /**< seed of the victim choice */
+    ExecTask ** timers; /**< tasks waiting for their due time (min-heap on due, used by the worker only) */
+    int nTimers; /**< number of timers */
+    int capTimers; /**< capacity of timers */
+    atomic_long executed; /**< tasks run (written by the worker only) */
+    atomic_long stolen; /**< tasks stolen from other workers (written by the worker only) */
+};
+
+/**
+ * @brief Fixed pool of worker threads running many small tasks (for example all the desks of a market),
+ *        instead of one mostly idle thread for each of them.
+ *        Tasks submitted by threads out of the pool go through a shared injection queue.
+ */
+struct Executor {
+    ExecWorker * workers; /**< workers */
+    int nWorkers; /**< number of workers */
+    int nStarted; /**< workers started by #Executor_startThreads */
+    atomic_int nSleeping; /**< workers sleeping, or about to sleep: submitters must wake one up */
+    atomic_int nInjected; /**< tasks in the injection queue */
+    atomic_int isStopping; /**< 1 when the workers must terminate */
+    pthread_mutex_t lock; /**< lock variable (protects the injection queue and the sleep of the workers) */
+    pthread_cond_t cv_ExecNews; /**< used to notify new tasks or termination */
+    ExecTask * injectHead; /**< first task of the injection queue */
+    ExecTask * injectTail; /**< last task of the injection queue */
+};
+
+Executor * Executor_init(int p_nWorkers);
+int Executor_startThreads(Executor * p_e);
+int Executor_delete(Executor * p_e);
+void Executor_submit(Executor * p_e, ExecTask * p_t);
+void Executor_submitAt(Executor * p_e, ExecTask * p_t, int64_t p_due);
+void Executor_log(Executor * p_e, char * p_buff);
+
+#endif	/* _TEXECUTOR_H */
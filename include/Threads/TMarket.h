@@ -7,33 +7,57 @@
 
 #include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <TDirector.h>
 #include <SQueue.h>
 #include <TUser.h>
 #include <Config.h>
 #include <TCashDesk.h>
 #include <PayArea.h>
+#include <ArrivalTrace.h>
+#include <ArrivalProcess.h>
+#include <Arena.h>
+#include <Mailbox.h>
+#include <TExecutor.h>
+#include <Affinity.h>
 
 #define MARKET_NAME_MAX 100
+#define MARKET_ARENA_CHUNK (1024L * 1024) /**< Size of each chunk of the market arena */
+#define MARKET_SPARE_NODES 8 /**< Queue nodes preallocated for each user */
+#define MARKET_USER_STACK_KB 256 /**< Default stack size of user threads (KB, see USER_STACK) */
+#define MARKET_LAG_CHECK_NS 100000000 /**< Minimum interval between two checks of the timer lag (real ns) */
 
 typedef struct Market Market;
+typedef enum MarketPhase MarketPhase;
 typedef struct Director Director;
-typedef struct User User;
+typedef struct UserStore UserStore;
 typedef struct CashDesk CashDesk;
 typedef struct PayArea PayArea;
 
-extern volatile sig_atomic_t sig_hup;
-extern volatile sig_atomic_t sig_quit;
+extern atomic_int sig_hup;
+extern atomic_int sig_quit;
+
+/**
+ * @brief Progress of a market run by an executor: its task goes through the phases of #Market_main.
+ */
+enum MarketPhase {
+    MARKET_INIT, /**< task not run yet */
+    MARKET_STARTING, /**< trace replay: the first users are created at their arrival time */
+    MARKET_OPEN, /**< users exit and are readmitted */
+    MARKET_CLOSING, /**< waiting for the end of desks and director */
+    MARKET_CLOSING_USERS, /**< waiting for the end of the users */
+    MARKET_CLOSED /**< statistics logged, #Market_joinThread returns */
+};
 
 /**
  * @brief Data structure used to store information about a market.
+ *        Parameters read by all the threads don't share cache lines with the fields written while the market runs
+ *        (the market is allocated #CACHE_LINE aligned).
  * 
  */
 struct Market {
+    //Read-mostly: parameters and references set by #Market_init
     pthread_t thread;   /**< Market  thread */
-    pthread_mutex_t lock;  /**< lock variable */
-    pthread_mutex_t lock_Logfile;  /**< lock for log file */
-    pthread_cond_t cv_MarketNews; /**< used to notify updates to Market thread */
     long K; 	/**< Maximum number of open cashdesk. {K>0} */
     long KS; 	/**< Number of open cashdesks at opening. {0<KS<=K} */
     long C; 	/**< Maximum number of client allowed inside. {C >1} */
@@ -55,20 +79,73 @@ struct Market {
     SQueue * usersExit;  /**< Users who have left the market */
     SQueue * usersAuthQueue; /**< Users waiting for director authorization. */
     PayArea * payArea; /**< Payment area.*/
+    UserStore * users; /**< All users of the market. Queues contain user indexes in this store (see #USER_TO_PTR). */
+    ArrivalTrace * arrivals; /**< Recorded customer stream replayed instead of random customers (NULL if not used) */
+    ArrivalProcess * process; /**< Open market: customers arrive following this process, at most C at a time, instead of
+                                   being readmitted in groups of E (NULL if not used) */
+    Pool * poolNodes; /**< Pool of SQueue nodes */
+    Pool * poolMsgs; /**< Pool of CashDeskNotify messages */
+    Executor * executor; /**< Workers running market, users, desks and director as tasks (DESK_WORKERS>0, or the executor
+                              shared by the stores of a chain), NULL: each of them has its own threads */
+    int isExecutorShared; /**< 1: the executor is not owned by the market (chain), it is not deleted with it */
+    Placement placement; /**< Cpus where market, director, desks and users threads run */
+    long userStack; /**< Stack size of user threads (bytes) */
+    int isEventLogOwner; /**< 1: the market opened the event log (EVENT_LOG), which is closed with it */
+    int logDigits; /**< Decimals of the times (s) in the log: 6 (LOG_TIME=us) or 3 (LOG_TIME=ms) */
+    int64_t lagTolerance; /**< Largest p99 lag of each kind of timer (simulated ns, see LAG_TOLERANCE_MS), 0: not checked */
+    int isLagAbort; /**< 1: the run is aborted when the lag exceeds lagTolerance, 0: only a warning (LAG_ACTION) */
+    //Written by every user entering or leaving the shopping area
+    _Alignas(CACHE_LINE) atomic_long inShopping; /**< Users in shopping area, including the ones moving to a queue. Used to detect when desks and 
+                                 director can stop on closing. */
+    //Written by the market thread and by the threads which wake it up
+    _Alignas(CACHE_LINE) pthread_mutex_t lock;  /**< lock variable */
+    pthread_cond_t cv_MarketNews; /**< used to notify updates to Market thread */
+    Mailbox mailbox; /**< used to notify updates to the market task (market with an executor) */
+    atomic_int isArrivalArmed; /**< 1: arrivalTask is submitted (market with an executor) */
+    atomic_int isDone; /**< 1 when the market task ended (see #Market_joinThread) */
+    Mailbox done; /**< posted when the market task ended */
+    atomic_int isClosing; /**< 1 when the arrival trace of this market is over: it closes as on SIGHUP, while the other
+                               markets of the process go on (see #Market_isClosing) */
+    //Written by the market thread (or task) only
+    _Alignas(CACHE_LINE) int lagWarned; /**< Kinds of timers already reported as lagging (bit mask) */
+    int64_t lagChecked; /**< Last check of the lag (ns, clock of #getCurrentTimeNs) */
+    void ** exited; /**< users drained from exit queue */
+    void ** parked; /**< users out of the market waiting to be readmitted (already logged) */
+    long nParked; /**< users in parked */
+    long nFresh; /**< open market: parked users whose thread has not been started yet (parked[i] is user i) */
+    long numExit; /**< users exited and not yet replaced by a group of E */
+    long groupIn; /**< users of the group being readmitted already admitted (the others wait for their arrival) */
+    int createdUsers; /**< users created */
+    int64_t tStartup; /**< start time of the market, then time spent to create and admit the first users (ns) */
+    ArrivalRecord nextRecord; /**< record of the arrival trace taken but not admitted yet */
+    int isRecordPending; /**< 1: nextRecord waits for its arrival time */
+    MarketPhase phase; /**< progress of the market task */
+    ExecTask task; /**< market task: it runs when woken up by the mailbox */
+    ExecTask arrivalTask; /**< wakes up the market task at the next arrival */
+    //Written by the users logging their exit
+    _Alignas(CACHE_LINE) pthread_mutex_t lock_Logfile;  /**< lock for log file */
+    long usersOut; /**< Users logged at their exit (protected by lock_Logfile) */
+    //Written by the threads which allocate (mostly during setup)
+    _Alignas(CACHE_LINE) Arena arena; /**< Region where users, desks, director, queues and messages of the market are allocated */
     //CashDesk ** desks; /**< Array of cashdesk in the market */    
 };
 
-Market * Market_init(const char * p_conf, const char * p_log);
+Market * Market_init(const char * p_conf, const char * p_log, Executor * p_executor);
 void * Market_main(void * arg);
 int Market_startThread(Market * p_m);
 int Market_joinThread(Market * p_m);
 int Market_delete(Market * p_m);
 void Market_Lock(Market * p_m);
 void Market_Unlock(Market * p_m);
+void Market_Signal(Market * p_m);
+int Market_isClosing(Market * p_m);
+long Market_inShopping(Market * p_m);
+void Market_startMoving(Market * p_m);
+void Market_endMoving(Market * p_m);
 int Market_isEmpty(Market * p_m);
-void Market_FromShoppingToPay(Market * p_m, User * p_u);
-void Market_FromShoppingToAuth(Market * p_m, User * p_u);
-void Market_FromShoppingToExit(Market * p_m, User * p_u);
-void Market_moveToExit(Market * p_m, User * p_u);
+void Market_FromShoppingToPay(Market * p_m, int p_u);
+void Market_FromShoppingToAuth(Market * p_m, int p_u);
+void Market_FromShoppingToExit(Market * p_m, int p_u);
+void Market_moveToExit(Market * p_m, int p_u);
 void Market_log(Market * p_m, char * p_data);
 #endif	/* _TMARKET_H */
@@ -6,16 +6,21 @@
 #define	_TUSER_H
 
 #include <SQueue.h>
+#include <Mailbox.h>
+#include <TExecutor.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <TMarket.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <time.h>
 
 typedef enum UserState UserState;
 typedef struct Market Market;
-typedef struct User User;
-extern volatile sig_atomic_t sig_hup;
-extern volatile sig_atomic_t sig_quit;
+typedef struct UserStore UserStore;
+typedef struct UserThread UserThread;
+extern atomic_int sig_hup;
+extern atomic_int sig_quit;
 
 enum UserState {
     USR_READY,
@@ -24,33 +29,61 @@ enum UserState {
 };
 
 /**
- * @brief Data structure used to store information about a user.
- * 
+ * @brief Store a user (index in the #UserStore) in a generic container like SQueue.
  */
-struct User {
-    pthread_t thread;   /**< User thread */
-    pthread_mutex_t lock;  /**< lock variable */
-    pthread_cond_t cv_UserNews; /**< used to notify updates to User thread */
-    int id; /**< Numberic identification number. */
-    UserState state; /**< current user state */
-    int products;  /**< Number of products in cart. */  
-    int queueChanges; /**< Number of queue changed. */
-    struct timespec tMarketEntry;  /**< Entry time in the market */
-    struct timespec tMarketExit;  /**< Exit time from the market */
-    struct timespec tQueueStart;  /**< Time when users start to wait in a queue to pay o to be authorized for exit*/
-    int shoppingTime; /**< Time to spend in shopping area in ms. */
-    Market * market;  /**< Reference to the market where the user is. */
+#define USER_TO_PTR(U) ((void *)(intptr_t)(U))
+/**
+ * @brief Get back a user (index in the #UserStore) from a generic container like SQueue.
+ */
+#define USER_FROM_PTR(P) ((int)(intptr_t)(P))
+
+/**
+ * @brief Thread of a user, or its task when the market has an executor. Only used to start, run and join users (cold data).
+ */
+struct UserThread {
+    pthread_t thread; /**< User thread */
+    UserStore * store; /**< store of the user (the user index is the position in store->threads) */
+    ExecTask task; /**< user task: it runs when the mailbox of the user is posted and when its shopping time ends */
+    int isShopping; /**< 1: task is waiting for the end of the shopping time */
+};
+
+/**
+ * @brief Data structure used to store information about all users of a market, in structure-of-arrays layout.
+ *        A user is identified by its index in the store: the hot state of user i is spread in the i-th element of
+ *        the arrays below (41 bytes), so scans over many users touch only the fields they need.
+ *        Each user thread sleeps on its own mailbox: changing the state of a group of users wakes only them.
+ */
+struct UserStore {
+    int cap; /**< maximum number of users */
+    int n; /**< number of users created */
+    int32_t * id; /**< Numberic identification number (changes at each reuse). */
+    atomic_uchar * state; /**< current user state (#UserState): set by the market, then the user is woken up */
+    int32_t * products;  /**< Number of products in cart. */
+    int32_t * queueChanges; /**< Number of queue changed. */
+    int32_t * shoppingTime; /**< Time to spend in shopping area in ms. */
+    int64_t * tMarketEntry;  /**< Entry time in the market (ns) */
+    int64_t * tMarketExit;  /**< Exit time from the market (ns) */
+    int64_t * tQueueStart;  /**< Time when users start to wait in a queue to pay o to be authorized for exit (ns) */
+    UserThread * threads;   /**< User threads (cold) */
+    Mailbox * wake; /**< Wakeup of each user thread, posted when its state changes (cold) */
+    atomic_int nTasks; /**< user tasks started and not ended yet (market with an executor, see #UserStore_isEnded) */
+    Market * market;  /**< Reference to the market where the users are. */
 };
 
+UserStore * UserStore_init(Market * p_m, int p_cap);
+void UserStore_delete(UserStore * p_s);
+int UserStore_isEnded(UserStore * p_s);
 
-User * User_init(int p_products, int p_shoppingTime, Market * p_m);
-int User_startThread(User * p_u);
-int User_joinThread(User * p_u);
-int User_delete(User * p_u);
-void User_reset(User * p_u, int p_products, int p_shoppingTime, Market * p_m);
-void User_log(User * p_u);
+int User_init(UserStore * p_s, int p_products, int p_shoppingTime);
+int User_initAll(UserStore * p_s, int p_n);
+int User_startAll(UserStore * p_s, int p_from, int p_n);
+int User_startThread(UserStore * p_s, int p_u);
+int User_joinThread(UserStore * p_s, int p_u);
+void User_reset(UserStore * p_s, int p_u, int p_products, int p_shoppingTime);
+void User_setStateAll(UserStore * p_s, void ** p_users, long p_n, UserState p_state);
+void User_logAll(UserStore * p_s, void ** p_users, long p_n);
 int User_compare(void * p_u1, void * p_u2);
 
 void * User_main(void * arg);
 
-#endif	/* _TUSER_H */
\ No newline at end of file
+#endif	/* _TUSER_H */
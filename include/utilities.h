@@ -6,6 +6,7 @@
 #define	_UTILITIES_H
 
 #include <time.h>
+#include <stdint.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -46,9 +47,65 @@ extern _Thread_local unsigned int g_seed;
 	} while(0)
 
 //** Time utilities
+#define TIMER_LATE_NS 1000000 /**< A timer is late when it fires more than this (simulated ns) after its time */
+#define TIMER_LATE_MAX_PCT 1.0 /**< Percentage of late timers above which the time scale is not achievable */
+
+#define TIMER_HIST_BUCKETS 24 /**< Buckets of the lag histogram of #TimerStats */
+#define TIMER_CHECK_MIN 200 /**< Timers of a kind needed before their lag is checked against a tolerance */
+
+/**
+ * @brief Delays measured by the timer statistics.
+ */
+typedef enum TimerKind {
+	TIMER_SHOPPING, /**< shopping time of a user */
+	TIMER_SERVICE,  /**< service of a user at a desk */
+	TIMER_NOTIFY,   /**< notification interval of a desk */
+	TIMER_JOCKEY,   /**< queue change evaluation interval of the director */
+	TIMER_OTHER,    /**< any other #waitMs (trace replay) */
+	TIMER_ALL       /**< all the kinds (only for #getTimerStats) */
+} TimerKind;
+
+/**
+ * @brief Timers measured by #waitMs and by the tasks of an executor. Times are simulated ns; the lag is how late the timer fired.
+ */
+typedef struct TimerStats {
+	long long timers; /**< timers fired */
+	long long late; /**< timers late by more than #TIMER_LATE_NS */
+	int64_t sumLateNs; /**< total lateness of the late timers */
+	int64_t maxLateNs; /**< worst lateness */
+	int64_t sumReqNs; /**< total requested delay */
+	int64_t sumLagNs; /**< total lag of all the timers */
+	long long hist[TIMER_HIST_BUCKETS]; /**< hist[b]: timers with a lag in [2^(b-1), 2^b) us (hist[0]: less than 1 us) */
+} TimerStats;
+
+/**
+ * @brief Sources of #getCurrentTimeNs. Both are monotonic.
+ */
+typedef enum ClockSource {
+	CLOCK_SRC_MONOTONIC, /**< clock_gettime(CLOCK_MONOTONIC) */
+	CLOCK_SRC_TSC        /**< time stamp counter calibrated on CLOCK_MONOTONIC (invariant TSC on x86-64 only) */
+} ClockSource;
+
 int waitMs(long p_msec);
+int waitTimer(long p_msec, TimerKind p_kind);
+int waitRealMs(long p_msec);
 long elapsedTime(struct timespec p_start, struct timespec p_end);
 struct timespec getCurrentTime();
+int64_t getCurrentTimeNs();
+int canSetClockSource(ClockSource p_src);
+int setClockSource(ClockSource p_src);
+const char * getClockSourceName();
+int initCondClock(pthread_cond_t * p_cond);
+struct timespec clockDeadline(struct timespec p_t);
+double toSimSeconds(int64_t p_realNs);
+int canSetTimeScale(long p_scale);
+int setTimeScale(long p_scale);
+long getTimeScale();
+int64_t toRealNs(int64_t p_simNs);
+void timerFired(TimerKind p_kind, int64_t p_reqRealNs, int64_t p_lateRealNs);
+void getTimerStats(TimerKind p_kind, TimerStats * p_st);
+int64_t timerLagPercentile(const TimerStats * p_st, double p_pct);
+const char * getTimerKindName(TimerKind p_kind);
 
 //** Lock/Unlock utilities
 void Lock(pthread_mutex_t * p_lock);
@@ -0,0 +1,158 @@
+/**
+ * @file Affinity.c
+ * @brief   Thread placement: each thread of a market pins itself when it starts, following the #Placement
+ *          read from the config file. Threads created afterwards (for example the desk notifier) inherit
+ *          the affinity of their creator.
+ *          Cpu lists use the kernel syntax ("0-3,8,10-11") or the keyword #AFFINITY_SPREAD.
+ */
+#define _GNU_SOURCE /* cpu_set_t, pthread_setaffinity_np */
+
+#include <Affinity.h>
+#include <utilities.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#define MAX_CPULIST_STR 4096
+
+//Private functions
+/**
+ * @brief Restrict the calling thread to the p_n cpus in p_cpus. A failure (for example a cpu which is
+ *        not available) is reported and the thread keeps running unpinned.
+ */
+static void pAffinity_pin(const int * p_cpus, int p_n) {
+    cpu_set_t set;
+    int err = 0;
+    if(p_n <= 0) return;
+    CPU_ZERO(&set);
+    for(int i = 0; i < p_n; i++) CPU_SET(p_cpus[i], &set);
+    if((err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0)
+        ERR_MSG("Unable to set thread affinity (cpu %d, error %d): the thread is not pinned.\n", p_cpus[0], err);
+}
+
+/**
+ * @brief Parse a cpu list or #AFFINITY_SPREAD. The cpus are copied in p_a.
+ * @return int: number of cpus, -1 if p_str is not valid
+ */
+static int pPlacement_list(Arena * p_a, const char * p_str, int ** p_cpus) {
+    int buf[AFFINITY_MAX_CPUS];
+    int n = 0;
+    *p_cpus = NULL;
+    if(p_str == NULL || p_str[0] == '\0') return 0;
+    if(strcmp(p_str, AFFINITY_SPREAD) == 0) n = Affinity_spread(buf, AFFINITY_MAX_CPUS);
+    else n = Affinity_parseList(p_str, buf, AFFINITY_MAX_CPUS);
+    if(n <= 0) return -1;
+    if((*p_cpus = Arena_alloc(p_a, n * sizeof(int))) == NULL) return -1;
+    memcpy(*p_cpus, buf, n * sizeof(int));
+    return n;
+}
+
+/**
+ * @brief Parse a cpu list with the kernel syntax, for example "0-3,8,10-11".
+ *
+ * @param p_str string to parse.
+ * @param p_cpus where the cpus are placed, in the order they appear.
+ * @param p_max size of p_cpus. Cpus must be lower than #AFFINITY_MAX_CPUS.
+ * @return int: number of cpus, -1 if p_str is not valid
+ */
+int Affinity_parseList(const char * p_str, int * p_cpus, int p_max) {
+    const char * s = p_str;
+    char * end = NULL;
+    long from = 0, to = 0;
+    int n = 0;
+    while (*s != '\0') {
+        from = strtol(s, &end, 10);
+        if(end == s || from < 0) return -1;
+        to = from;
+        if(*end == '-') {
+            s = end + 1;
+            to = strtol(s, &end, 10);
+            if(end == s || to < from) return -1;
+        }
+        if(to >= AFFINITY_MAX_CPUS || n + (to - from + 1) > p_max) return -1;
+        for(long c = from; c <= to; c++) p_cpus[n++] = (int) c;
+        if(*end == ',') end++;
+        else if(*end != '\0' && *end != '\n') return -1;
+        else break;
+        s = end;
+    }
+    return n;
+}
+
+/**
+ * @brief Get all the online cpus, interleaved across NUMA nodes: first cpu of each node, then the second one, ...
+ *        Consecutive threads placed on this list are spread on different nodes (and different cores of a node).
+ *        Without NUMA information all the online cpus are returned in order.
+ *
+ * @param p_cpus where the cpus are placed.
+ * @param p_max size of p_cpus.
+ * @return int: number of cpus
+ */
+int Affinity_spread(int * p_cpus, int p_max) {
+    static int nodes[64][AFFINITY_MAX_CPUS];
+    int nNode[64];
+    int nNodes = 0, n = 0, isAdded = 1;
+    char path[128];
+    char line[MAX_CPULIST_STR];
+    FILE * f = NULL;
+    long nCpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for(int i = 0; i < 64; i++) {
+        sprintf(path, "/sys/devices/system/node/node%d/cpulist", i);
+        if((f = fopen(path, "r")) == NULL) continue;
+        if(fgets(line, sizeof(line), f) != NULL && (nNode[nNodes] = Affinity_parseList(line, nodes[nNodes], AFFINITY_MAX_CPUS)) > 0)
+            nNodes++;
+        fclose(f);
+    }
+    if(nNodes == 0) {
+        for(int c = 0; c < nCpu && c < p_max && c < AFFINITY_MAX_CPUS; c++) p_cpus[n++] = c;
+        return n;
+    }
+    for(int k = 0; isAdded && n < p_max; k++) {
+        isAdded = 0;
+        for(int i = 0; i < nNodes && n < p_max; i++) {
+            if(k >= nNode[i]) continue;
+            p_cpus[n++] = nodes[i][k];
+            isAdded = 1;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Init a placement.
+ *
+ * @param p_p placement to init.
+ * @param p_a arena where the cpu lists are allocated.
+ * @param p_director cpu of the director threads (-1: not pinned).
+ * @param p_market cpu of the market thread (-1: not pinned).
+ * @param p_desks cpus assigned round robin to the desks: cpu list, #AFFINITY_SPREAD or "" (not pinned).
+ *        With #AFFINITY_SPREAD the cpus of director and market are left to them when other cpus are available.
+ * @param p_users cpus where users are allowed to run: cpu list, #AFFINITY_SPREAD or "" (not pinned).
+ * @return int: result code:
+ * 1: good
+ * 0: a cpu list is not valid
+ */
+int Placement_init(Placement * p_p, Arena * p_a, long p_director, long p_market, const char * p_desks, const char * p_users) {
+    int n = 0;
+    if(p_director >= AFFINITY_MAX_CPUS || p_market >= AFFINITY_MAX_CPUS) return 0;
+    p_p->director = p_director < 0 ? -1 : (int) p_director;
+    p_p->market = p_market < 0 ? -1 : (int) p_market;
+    if((p_p->nDesks = pPlacement_list(p_a, p_desks, &p_p->desks)) == -1) return 0;
+    if((p_p->nUsers = pPlacement_list(p_a, p_users, &p_p->users)) == -1) return 0;
+    if(p_desks != NULL && strcmp(p_desks, AFFINITY_SPREAD) == 0) {
+        //Dedicated cores: remove director and market cpus from the spread list
+        for(int i = 0; i < p_p->nDesks; i++)
+            if(p_p->desks[i] != p_p->director && p_p->desks[i] != p_p->market) p_p->desks[n++] = p_p->desks[i];
+        if(n > 0) p_p->nDesks = n;
+    }
+    return 1;
+}
+
+void Placement_pinDirector(Placement * p_p) { if(p_p->director >= 0) pAffinity_pin(&p_p->director, 1); }
+void Placement_pinMarket(Placement * p_p) { if(p_p->market >= 0) pAffinity_pin(&p_p->market, 1); }
+void Placement_pinDesk(Placement * p_p, int p_desk) { if(p_p->nDesks > 0) pAffinity_pin(&p_p->desks[p_desk % p_p->nDesks], 1); }
+void Placement_pinUser(Placement * p_p) { pAffinity_pin(p_p->users, p_p->nUsers); }
@@ -0,0 +1,202 @@
+/**
+ * @file ArrivalProcess.c
+ * @brief   Generation of customers for the open market.
+ *          Arrivals follow a non-homogeneous Poisson process with a piecewise constant rate: the profile
+ *          gives the number of arrivals per hour in each period and it is repeated cyclically.
+ *          A single rate is a plain Poisson process.
+ *          Inter-arrival times are obtained by inversion of the integrated rate, so no arrival is
+ *          discarded, and they are generated in batches to keep the admission path short.
+ */
+#include <ArrivalProcess.h>
+#include <utilities.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#define MS_PER_HOUR 3600000.0
+
+//Private functions
+/**
+ * @brief xorshift64* generator: the process has its own state, so the sequence does not
+ *        depend on other users of #getRandom.
+ */
+static uint64_t pArrivalProcess_rand(ArrivalProcess * p_a) {
+    p_a->rng ^= p_a->rng >> 12;
+    p_a->rng ^= p_a->rng << 25;
+    p_a->rng ^= p_a->rng >> 27;
+    return p_a->rng * 0x2545F4914F6CDD1DULL;
+}
+/**
+ * @brief Uniform value in (0; 1].
+ */
+static double pArrivalProcess_uniform(ArrivalProcess * p_a) {
+    return ((pArrivalProcess_rand(p_a) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+/**
+ * @brief Advance p_a->t to the next arrival.
+ *        An Exp(1) amount of integrated rate is consumed, crossing periods when the current one is not enough.
+ */
+static void pArrivalProcess_nextTime(ArrivalProcess * p_a) {
+    double e = -log(pArrivalProcess_uniform(p_a));
+    double end = 0, rate = 0;
+    long idx = 0;
+    while (1) {
+        idx = (long)(p_a->t / p_a->period);
+        end = (double)(idx + 1) * p_a->period;
+        rate = p_a->rates[idx % p_a->nRates];
+        if(rate * (end - p_a->t) >= e) {
+            p_a->t += e / rate;
+            return;
+        }
+        e -= rate * (end - p_a->t);
+        p_a->t = end;
+    }
+}
+/**
+ * @brief Fill the batch with the next #ARRIVAL_BATCH arrivals.
+ */
+static void pArrivalProcess_generate(ArrivalProcess * p_a) {
+    for(int i = 0; i < ARRIVAL_BATCH; i++) {
+        pArrivalProcess_nextTime(p_a);
+        p_a->batch[i].arrival = (uint64_t) p_a->t;
+        p_a->batch[i].products = pArrivalProcess_rand(p_a) % (p_a->P + 1);
+        p_a->batch[i].shoppingTime = 10 + pArrivalProcess_rand(p_a) % (p_a->T - 9);
+    }
+    p_a->nBatch = ARRIVAL_BATCH;
+    p_a->next = 0;
+}
+
+/**
+ * @brief Create a new arrival process.
+ *
+ * @param p_rates rate profile: comma separated list of arrivals per hour, one for each period (at least one > 0).
+ * @param p_period length of each period in ms (>0).
+ * @param p_speed 1 real time, >1 accelerated by this factor, 0 virtual time (arrivals are not waited).
+ * @param p_P maximum number of products of a customer.
+ * @param p_T maximum shopping time of a customer in ms (>10).
+ * @return ArrivalProcess* pointer to the new process, NULL if the parameters are not valid.
+ */
+ArrivalProcess * ArrivalProcess_init(const char * p_rates, long p_period, long p_speed, long p_P, long p_T) {
+    ArrivalProcess * aux = NULL;
+    const char * str = p_rates;
+    char * end = NULL;
+    long rate = 0;
+    int isPositive = 0;
+
+    if(p_period <= 0 || p_speed < 0 || p_P < 0 || p_T <= 10) {
+        ERR_MSG("Invalid parameters for the arrival process.\n");
+        return NULL;
+    }
+    if((aux = malloc(sizeof(ArrivalProcess))) == NULL) {
+        ERR_SYS_MSG("An error occurred during memory allocation.");
+        return NULL;
+    }
+    aux->nRates = 0;
+    while (1) {
+        errno = 0;
+        rate = strtol(str, &end, 10);
+        if(end == str || errno != 0 || rate < 0 || aux->nRates == ARRIVAL_MAX_RATES || (*end != ',' && *end != '\0')) {
+            ERR_MSG("Invalid arrival rate profile %s: expected up to %d comma separated arrivals per hour.\n", p_rates, ARRIVAL_MAX_RATES);
+            free(aux);
+            return NULL;
+        }
+        aux->rates[aux->nRates++] = rate / MS_PER_HOUR;
+        isPositive = rate > 0 ? 1:isPositive;
+        if(*end == '\0') break;
+        str = end + 1;
+    }
+    if(!isPositive) {
+        ERR_MSG("Invalid arrival rate profile %s: at least one rate must be positive.\n", p_rates);
+        free(aux);
+        return NULL;
+    }
+    aux->period = p_period;
+    aux->speed = p_speed;
+    aux->P = p_P;
+    aux->T = p_T;
+    aux->rng = ((uint64_t) time(NULL) << 1) | 1;
+    aux->t = 0;
+    aux->nBatch = 0;
+    aux->next = 0;
+    aux->admitted = 0;
+    aux->doorWait = 0;
+    aux->tStart = getCurrentTime();
+    return aux;
+}
+
+/**
+ * @brief Dealloc an ArrivalProcess object.
+ *
+ * @param p_a ArrivalProcess object created with #ArrivalProcess_init (or NULL).
+ */
+void ArrivalProcess_delete(ArrivalProcess * p_a) {
+    free(p_a);
+}
+
+/**
+ * @brief Set the current real time as simulated time 0.
+ *
+ * @param p_a Requirements: p_a != NULL and must refer to an ArrivalProcess object created with #ArrivalProcess_init.
+ */
+void ArrivalProcess_start(ArrivalProcess * p_a) {
+    p_a->tStart = getCurrentTime();
+}
+
+/**
+ * @brief Get the current simulated time.
+ *
+ * @param p_a Requirements: p_a != NULL and must refer to an ArrivalProcess object created with #ArrivalProcess_init.
+ * @return uint64_t: simulated ms from #ArrivalProcess_start (UINT64_MAX in virtual time, every arrival is due).
+ */
+uint64_t ArrivalProcess_now(ArrivalProcess * p_a) {
+    if(p_a->speed == 0) return UINT64_MAX;
+    return (uint64_t) elapsedTime(p_a->tStart, getCurrentTime()) * p_a->speed;
+}
+
+/**
+ * @brief Get the next arrival, without consuming it.
+ *
+ * @param p_a Requirements: p_a != NULL and must refer to an ArrivalProcess object created with #ArrivalProcess_init.
+ * @return const ArrivalRecord*: next arrival (valid until #ArrivalProcess_pop).
+ */
+const ArrivalRecord * ArrivalProcess_peek(ArrivalProcess * p_a) {
+    if(p_a->next == p_a->nBatch) pArrivalProcess_generate(p_a);
+    return &p_a->batch[p_a->next];
+}
+
+/**
+ * @brief Consume the next arrival, which has been admitted in the market.
+ *
+ * @param p_a Requirements: p_a != NULL and must refer to an ArrivalProcess object created with #ArrivalProcess_init.
+ * @param p_now admission time, as returned by #ArrivalProcess_now.
+ */
+void ArrivalProcess_pop(ArrivalProcess * p_a, uint64_t p_now) {
+    const ArrivalRecord * rec = ArrivalProcess_peek(p_a);
+    if(p_a->speed != 0 && p_now > rec->arrival) p_a->doorWait += p_now - rec->arrival;
+    p_a->admitted++;
+    p_a->next++;
+}
+
+/**
+ * @brief Get the real time at which p_rec is due, to be used with pthread_cond_timedwait.
+ *
+ * @param p_a Requirements: p_a != NULL and must refer to an ArrivalProcess object created with #ArrivalProcess_init.
+ * @param p_rec arrival returned by #ArrivalProcess_peek.
+ * @return struct timespec: arrival time on the clock of #getCurrentTime (tStart in virtual time), real time
+ *         of the simulated arrival with a time scale (see #setTimeScale).
+ */
+struct timespec ArrivalProcess_deadline(ArrivalProcess * p_a, const ArrivalRecord * p_rec) {
+    struct timespec res = p_a->tStart;
+    //Rounded up, so that ArrivalProcess_now has reached p_rec->arrival when the deadline expires
+    uint64_t ms = p_a->speed == 0 ? 0 : (p_rec->arrival + p_a->speed - 1) / p_a->speed;
+    int64_t ns = ((int64_t) ms * 1000000 + getTimeScale() - 1) / getTimeScale();
+    res.tv_sec += ns / 1000000000LL;
+    res.tv_nsec += ns % 1000000000LL;
+    if(res.tv_nsec >= 1000000000L) {
+        res.tv_sec++;
+        res.tv_nsec -= 1000000000L;
+    }
+    return res;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file ArrivalTrace.c
+ * @brief   Replay of recorded customer streams.
+ *          A binary arrival trace is made of an #ArrivalTraceHeader followed by #ArrivalRecord items
+ *          sorted by arrival time (see bin/trace_convert to build one from a CSV file).
+ *          The file is memory mapped and consumed sequentially.
+ */
+#define _DEFAULT_SOURCE /* madvise */
+
+#include <ArrivalTrace.h>
+#include <utilities.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//Private functions
+/**
+ * @brief Give back to the kernel the pages containing records already consumed.
+ *        The mapping is read only, so released pages are simply read again from the file if needed.
+ * @param p_t target trace. Its lock must be held.
+ */
+static void pArrivalTrace_release(ArrivalTrace * p_t) {
+    long pageSize = sysconf(_SC_PAGESIZE);
+    size_t consumed = sizeof(ArrivalTraceHeader) + p_t->next * sizeof(ArrivalRecord);
+    size_t upTo = consumed - consumed % pageSize;
+
+    if(upTo - p_t->released < ARRIVAL_TRACE_RELEASE) return;
+    if(madvise(p_t->map + p_t->released, upTo - p_t->released, MADV_DONTNEED) == -1)
+        ERR_SYS_MSG("Unable to release consumed pages of the arrival trace.\n");
+    p_t->released = upTo;
+}
+
+/**
+ * @brief Open a binary arrival trace.
+ *
+ * @param p_path path of the binary trace file.
+ * @param p_speed replay speed: 1 real time, >1 accelerated by this factor, 0 virtual time (arrivals are not waited).
+ * @return ArrivalTrace* pointer to the new trace, NULL if the file can't be opened or it is not a valid trace.
+ */
+ArrivalTrace * ArrivalTrace_open(const char * p_path, long p_speed) {
+    ArrivalTrace * aux = NULL;
+    const ArrivalTraceHeader * h = NULL;
+    struct stat st;
+
+    if(p_speed < 0) {
+        ERR_MSG("Invalid replay speed %ld for arrival trace %s.\n", p_speed, p_path);
+        return NULL;
+    }
+    if((aux = malloc(sizeof(ArrivalTrace))) == NULL) {
+        ERR_SYS_MSG("An error occurred during memory allocation.");
+        return NULL;
+    }
+    aux->map = MAP_FAILED;
+    aux->speed = p_speed;
+    aux->next = 0;
+    aux->released = 0;
+    aux->isStarted = 0;
+    aux->base = 0;
+
+    if((aux->fd = open(p_path, O_RDONLY)) == -1) {
+        ERR_SYS_MSG("Unable to open arrival trace %s.\n", p_path);
+        goto err;
+    }
+    if(fstat(aux->fd, &st) == -1) {
+        ERR_SYS_MSG("Unable to get size of arrival trace %s.\n", p_path);
+        goto err;
+    }
+    if((size_t)st.st_size < sizeof(ArrivalTraceHeader)) {
+        ERR_MSG("File %s is too short to be an arrival trace.\n", p_path);
+        goto err;
+    }
+    aux->mapLen = st.st_size;
+    if((aux->map = mmap(NULL, aux->mapLen, PROT_READ, MAP_PRIVATE, aux->fd, 0)) == MAP_FAILED) {
+        ERR_SYS_MSG("Unable to map arrival trace %s.\n", p_path);
+        goto err;
+    }
+    if(madvise(aux->map, aux->mapLen, MADV_SEQUENTIAL) == -1)
+        ERR_SYS_MSG("madvise failed on arrival trace %s.\n", p_path);
+
+    h = (const ArrivalTraceHeader *) aux->map;
+    if(h->magic != ARRIVAL_TRACE_MAGIC || h->version != ARRIVAL_TRACE_VERSION) {
+        ERR_MSG("File %s is not an arrival trace (or it has an unsupported version).\n", p_path);
+        goto err;
+    }
+    if(h->count > (aux->mapLen - sizeof(ArrivalTraceHeader)) / sizeof(ArrivalRecord)) {
+        ERR_MSG("Arrival trace %s is truncated: %llu records declared.\n", p_path, (unsigned long long) h->count);
+        goto err;
+    }
+    aux->count = h->count;
+    aux->recs = (const ArrivalRecord *)(aux->map + sizeof(ArrivalTraceHeader));
+
+    if (pthread_mutex_init(&aux->lock, NULL) != 0) {
+        ERR_MSG("An error occurred during locking system initialization. Impossible to setup the arrival trace.");
+        goto err;
+    }
+    return aux;
+err:
+    if(aux->map != MAP_FAILED) munmap(aux->map, aux->mapLen);
+    if(aux->fd != -1) close(aux->fd);
+    free(aux);
+    return NULL;
+}
+
+/**
+ * @brief Unmap and dealloc an ArrivalTrace object.
+ *
+ * @param p_t Requirements: p_t != NULL and must refer to an ArrivalTrace object created with #ArrivalTrace_open.
+ */
+void ArrivalTrace_close(ArrivalTrace * p_t) {
+    if(p_t == NULL) return;
+    munmap(p_t->map, p_t->mapLen);
+    close(p_t->fd);
+    pthread_mutex_destroy(&p_t->lock);
+    free(p_t);
+}
+
+/**
+ * @brief Consume next record of the trace.
+ *
+ * @param p_t Requirements: p_t != NULL and must refer to an ArrivalTrace object created with #ArrivalTrace_open.
+ * @param p_rec where the record is copied.
+ * @return int: result code:
+ * 1: p_rec contains next record
+ * 0: trace exhausted
+ */
+int ArrivalTrace_next(ArrivalTrace * p_t, ArrivalRecord * p_rec) {
+    int res_fun = 0;
+    Lock(&p_t->lock);
+    if(p_t->next < p_t->count) {
+        *p_rec = p_t->recs[p_t->next];
+        if(!p_t->isStarted) {
+            p_t->isStarted = 1;
+            p_t->base = p_rec->arrival;
+            p_t->tStart = getCurrentTime();
+        }
+        p_t->next++;
+        pArrivalTrace_release(p_t);
+        res_fun = 1;
+    }
+    Unlock(&p_t->lock);
+    return res_fun;
+}
+
+/**
+ * @brief Wait until the arrival time of p_rec (scaled by the replay speed) is reached.
+ *        In virtual time (speed 0) it returns immediately.
+ *
+ * @param p_t Requirements: p_t != NULL and must refer to an ArrivalTrace object created with #ArrivalTrace_open.
+ * @param p_rec record previously returned by #ArrivalTrace_next.
+ * @return int: result code:
+ * 0: arrival time reached
+ * -1: an error occurred while waiting (errno set)
+ */
+int ArrivalTrace_waitArrival(ArrivalTrace * p_t, const ArrivalRecord * p_rec) {
+    long target = 0;
+    long now = 0;
+    if(p_t->speed == 0) return 0;
+    target = (long)((p_rec->arrival - p_t->base) / p_t->speed);
+    now = elapsedTime(p_t->tStart, getCurrentTime());
+    return target > now ? waitMs(target - now) : 0;
+}
+
+/**
+ * @brief Get the time at which the arrival of p_rec (scaled by the replay speed) is reached, without waiting for it.
+ *
+ * @param p_t Requirements: p_t != NULL and must refer to an ArrivalTrace object created with #ArrivalTrace_open.
+ * @param p_rec record previously returned by #ArrivalTrace_next.
+ * @return int64_t: arrival time (ns, clock of #getCurrentTimeNs), 0 in virtual time (speed 0)
+ */
+int64_t ArrivalTrace_due(ArrivalTrace * p_t, const ArrivalRecord * p_rec) {
+    if(p_t->speed == 0) return 0;
+    return (int64_t) p_t->tStart.tv_sec * 1000000000LL + p_t->tStart.tv_nsec +
+        toRealNs((int64_t) ((p_rec->arrival - p_t->base) / p_t->speed) * 1000000);
+}
+
+/**
+ * @brief Check if all records have been consumed.
+ *
+ * @param p_t Requirements: p_t != NULL and must refer to an ArrivalTrace object created with #ArrivalTrace_open.
+ * @return int: result code:
+ * 1: trace exhausted
+ * 0: there are records to consume
+ */
+int ArrivalTrace_isExhausted(ArrivalTrace * p_t) {
+    int res_fun = 0;
+    Lock(&p_t->lock);
+    res_fun = p_t->next >= p_t->count ? 1:0;
+    Unlock(&p_t->lock);
+    return res_fun;
+}
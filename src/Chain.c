@@ -0,0 +1,299 @@
+/**
+ * @file Chain.c
+ * @brief   Simulation of a chain of markets in a single process.
+ *          The chain file lists the configuration file of each store, one per line (lines starting with // are comments).
+ *          Store i logs its results in <chain_log>.<i>, while the chain log contains a summary of each store
+ *          and the chain aggregate.
+ *          A chain can also be split in shards, each one owning a subset of the stores (see Shard.c).
+ */
+#define _DEFAULT_SOURCE /* _SC_NPROCESSORS_ONLN */
+
+#include <Chain.h>
+#include <Config.h>
+#include <utilities.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//Private functions
+/**
+ * @brief Get the path of the log file of store p_i.
+ */
+static void pChain_storeLog(const char * p_log, int p_i, char * p_buff) {
+    sprintf(p_buff, "%s.%d", p_log, p_i);
+}
+
+/**
+ * @brief Read the configuration files listed in p_f and owned by the shard of p_c.
+ * @return int: number of stores read, -1 if an error occurred.
+ */
+static int pChain_readStores(Chain * p_c, FILE * p_f) {
+    char line[MAX_DIM_STR_CONF];
+    char ** aux = NULL;
+    size_t len = 0;
+    int cap = 0;
+    int pos = 0; //position of the store in the chain file
+    while (fgets(line, MAX_DIM_STR_CONF, p_f) != NULL) {
+        len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' ')) line[--len] = '\0';
+        if(len == 0 || strncmp(line, "//", 2) == 0) continue;
+        if(pos++ % p_c->nShards != p_c->shard) continue;
+        if(p_c->n == cap) {
+            cap = cap * 2 + 16;
+            if((aux = realloc(p_c->confs, cap * sizeof(char *))) == NULL) return -1;
+            p_c->confs = aux;
+        }
+        if((p_c->confs[p_c->n] = malloc(len + 1)) == NULL) return -1;
+        strcpy(p_c->confs[p_c->n++], line);
+    }
+    return p_c->n;
+}
+
+/**
+ * @brief Create a new chain: all the stores listed in the chain file are created with #Market_init.
+ *
+ * @param p_chain chain file: configuration file of each store, one per line.
+ * @param p_log path of the chain log. Store i logs in <p_log>.<i>.
+ * @return Chain* pointer to new chain, NULL if a problem occurred.
+ */
+Chain * Chain_init(const char * p_chain, const char * p_log) {
+    Chain * aux = NULL;
+    FILE * f_log = NULL;
+
+    //Check the log file paths
+    if(Chain_askOverwrite(p_chain, p_log) != 1) return NULL;
+    if((f_log = fopen(p_log, "w")) == NULL) {
+        ERR_SYS_MSG("Unable to open log file %s. Check the path and try again.", p_log);
+        return NULL;
+    }
+    if((aux = Chain_initShard(p_chain, p_log, 0, 1, 1)) == NULL) {
+        fclose(f_log);
+        return NULL;
+    }
+    aux->f_log = f_log;
+    return aux;
+}
+
+/**
+ * @brief Ask the user, once for the whole chain, if the chain log and the logs of its stores can be overwritten.
+ *        It must be called before the stores are created (with p_overwrite = 1, see #Chain_initShard), and before
+ *        forking the shards: only one process reads the answer from stdin.
+ *
+ * @param p_chain chain file: configuration file of each store, one per line.
+ * @param p_log path of the chain log. Store i logs in <p_log>.<i>.
+ * @return int: result code:
+ * 1: no log exists, or the user agreed to overwrite them
+ * 0: the user refused
+ * -1: the chain file can't be read
+ */
+int Chain_askOverwrite(const char * p_chain, const char * p_log) {
+    Chain stores = {NULL, NULL, 0, 0, 1, NULL, NULL};
+    FILE * f_chain = NULL;
+    char storeLog[MAX_DIM_STR_CONF + 16];
+    char userChoice;
+    int isFound = 0;
+
+    if((f_chain = fopen(p_chain, "r")) == NULL) {
+        ERR_SYS_MSG("Unable to open chain file %s. Check the path and try again.", p_chain);
+        return -1;
+    }
+    if(pChain_readStores(&stores, f_chain) < 0) {
+        ERR_SYS_MSG("An error occurred during memory allocation.");
+        stores.n = -1;
+    }
+    fclose(f_chain);
+    for(int i = 0; i < stores.n; i++) free(stores.confs[i]);
+    free(stores.confs);
+    if(stores.n < 0) return -1;
+    isFound = access(p_log, F_OK) == 0;
+    for(int i = 0; i < stores.n && !isFound; i++) {
+        pChain_storeLog(p_log, i, storeLog);
+        isFound = access(storeLog, F_OK) == 0;
+    }
+    if(!isFound) return 1;
+    printf("Log file %s (or the log of one of its stores) already exist. If you want to proceed they will be overwritten.", p_log);
+    do{
+        printf("\nDo you want to proceed?[y/n] ");
+        userChoice = getchar();
+    }while(userChoice != 'y' && userChoice != 'n');
+    return userChoice == 'y' ? 1:0;
+}
+
+/**
+ * @brief Create the part of a chain owned by a shard: the stores listed at positions p_shard, p_shard + p_nShards, ...
+ *        of the chain file. No chain log is written: the results of the stores are read with #Chain_storeStats.
+ *
+ * @param p_chain chain file: configuration file of each store, one per line.
+ * @param p_log path of the chain log. Store i (position in the chain file) logs in <p_log>.<i>.
+ * @param p_shard shard index, in [0; p_nShards).
+ * @param p_nShards number of shards.
+ * @param p_overwrite 1: existing logs of the stores are removed, 0: each store asks before overwriting its log.
+ * @return Chain* pointer to new chain, NULL if a problem occurred (or the shard has no stores).
+ */
+Chain * Chain_initShard(const char * p_chain, const char * p_log, int p_shard, int p_nShards, int p_overwrite) {
+    Chain * aux = NULL;
+    FILE * f_chain = NULL;
+    char storeLog[MAX_DIM_STR_CONF + 16];
+    long nCpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if(p_nShards <= 0 || p_shard < 0 || p_shard >= p_nShards) return NULL;
+    if((aux = calloc(1, sizeof(Chain))) == NULL) {
+        ERR_SYS_MSG("An error occurred during memory allocation.");
+        return NULL;
+    }
+    aux->shard = p_shard;
+    aux->nShards = p_nShards;
+    //Read the stores
+    if((f_chain = fopen(p_chain, "r")) == NULL) {
+        ERR_SYS_MSG("Unable to open chain file %s. Check the path and try again.", p_chain);
+        goto err;
+    }
+    if(pChain_readStores(aux, f_chain) <= 0) {
+        ERR_MSG("Chain file %s must list the configuration file of at least one store for each shard.\n", p_chain);
+        goto err;
+    }
+    fclose(f_chain);
+    f_chain = NULL;
+
+    //Executor shared by the stores: it must exist before the stores, whose actors run on it. Its workers are
+    //started with the stores, once the first store has set the clock source
+    if((aux->executor = Executor_init(nCpu > 0 ? nCpu : 1)) == NULL) {
+        ERR_MSG("An error occurred during executor creation. Impossible to setup the chain.");
+        goto err;
+    }
+    if((aux->stores = calloc(aux->n, sizeof(Market *))) == NULL) {
+        ERR_SYS_MSG("An error occurred during memory allocation.");
+        goto err;
+    }
+    for(int i = 0; i < aux->n; i++) {
+        pChain_storeLog(p_log, Chain_storeId(aux, i), storeLog);
+        if(p_overwrite) unlink(storeLog);
+        printf("[Chain]: setup of store %d (%s)...\n", Chain_storeId(aux, i), aux->confs[i]);
+        if((aux->stores[i] = Market_init(aux->confs[i], storeLog, aux->executor)) == NULL) {
+            ERR_MSG("An error occurred during setup of store %d. Impossible to setup the chain.", Chain_storeId(aux, i));
+            goto err;
+        }
+    }
+    return aux;
+err:
+    if(f_chain != NULL) fclose(f_chain);
+    Chain_delete(aux);
+    return NULL;
+}
+
+/**
+ * @brief Get the position in the chain file of the store p_i.
+ *
+ * @param p_c Requirements: p_c != NULL and must refer to a Chain object created with #Chain_init or #Chain_initShard.
+ * @param p_i store index in p_c, in [0; p_c->n).
+ * @return int: store id, used in its log file name and in the chain log.
+ */
+int Chain_storeId(Chain * p_c, int p_i) {
+    return p_c->shard + p_i * p_c->nShards;
+}
+
+/**
+ * @brief Get the results of the store p_i. Desk counters are final only after #Chain_joinThreads.
+ *
+ * @param p_c Requirements: p_c != NULL and must refer to a Chain object created with #Chain_init or #Chain_initShard.
+ * @param p_i store index in p_c, in [0; p_c->n).
+ * @param p_s where results are placed.
+ */
+void Chain_storeStats(Chain * p_c, int p_i, StoreStats * p_s) {
+    Market * m = p_c->stores[p_i];
+    Lock(&m->lock_Logfile);
+    p_s->users = m->usersOut;
+    Unlock(&m->lock_Logfile);
+    p_s->clients = p_s->products = p_s->closures = 0;
+    for(int j = 0; j < m->K; j++) {
+        p_s->clients += m->payArea->desks[j]->usersProcessed;
+        p_s->products += m->payArea->desks[j]->productsProcessed;
+        p_s->closures += m->payArea->desks[j]->numClosure;
+    }
+}
+
+/**
+ * @brief Start the workers of the chain and each store: its market task is submitted to the executor of the chain.
+ *
+ * @param p_c Requirements: p_c != NULL and must refer to a Chain object created with #Chain_init.
+ * @return int: 0 if all the stores have been started
+ */
+int Chain_startThreads(Chain * p_c) {
+    int res_fun = Executor_startThreads(p_c->executor);
+    for(int i = 0; i < p_c->n && res_fun == 0; i++) res_fun = Market_startThread(p_c->stores[i]);
+    return res_fun;
+}
+
+/**
+ * @brief Wait for the end of each store (see #Market_joinThread).
+ *
+ * @param p_c Requirements: p_c != NULL and must refer to a Chain object created with #Chain_init.
+ * @return int: 0 if all the stores ended
+ */
+int Chain_joinThreads(Chain * p_c) {
+    int res_fun = 0;
+    for(int i = 0; i < p_c->n && res_fun == 0; i++) res_fun = Market_joinThread(p_c->stores[i]);
+    return res_fun;
+}
+
+/**
+ * @brief Wake up the market of each store (see #Market_Signal).
+ *
+ * @param p_c Requirements: p_c != NULL and must refer to a Chain object created with #Chain_init.
+ */
+void Chain_Signal(Chain * p_c) {
+    for(int i = 0; i < p_c->n; i++) Market_Signal(p_c->stores[i]);
+}
+
+/**
+ * @brief Write to the chain log a summary of each store, the chain aggregate and the work of the executor.
+ *        It must be called after #Chain_joinThreads.
+ *
+ * @param p_c Requirements: p_c != NULL and must refer to a Chain object created with #Chain_init.
+ */
+void Chain_log(Chain * p_c) {
+    StoreStats s, tot = {0, 0, 0, 0};
+    char aux[MAXLINE];
+    for(int i = 0; i < p_c->n; i++) {
+        Chain_storeStats(p_c, i, &s);
+        if(p_c->f_log != NULL)
+            fprintf(p_c->f_log, "[Store %d]: config=%s users=%ld clients=%ld products=%ld closures=%ld\n",
+                Chain_storeId(p_c, i), p_c->confs[i], s.users, s.clients, s.products, s.closures);
+        tot.users += s.users;
+        tot.clients += s.clients;
+        tot.products += s.products;
+        tot.closures += s.closures;
+    }
+    if(p_c->f_log != NULL)
+        fprintf(p_c->f_log, "[Chain]: stores=%d users=%ld clients=%ld products=%ld closures=%ld\n",
+            p_c->n, tot.users, tot.clients, tot.products, tot.closures);
+    printf("[Chain]: stores=%d users=%ld clients=%ld products=%ld closures=%ld\n",
+        p_c->n, tot.users, tot.clients, tot.products, tot.closures);
+    Executor_log(p_c->executor, aux);
+    if(p_c->f_log != NULL) fprintf(p_c->f_log, "%s\n", aux);
+    printf("%s\n", aux);
+}
+
+/**
+ * @brief Dealloc a Chain object and all its stores.
+ *
+ * @warning This function should be called by only one thread when no store is running.
+ *
+ * @param p_c Chain object created with #Chain_init.
+ * @return int: result code:
+ *  1: p_c != NULL and the deallocation proceed witout errors.
+ *  -1: p_c == NULL
+ */
+int Chain_delete(Chain * p_c) {
+    if(p_c == NULL) return -1;
+    //Workers are stopped first: timers of the stores still pending (next arrival) are not run anymore
+    if(p_c->executor != NULL) Executor_delete(p_c->executor);
+    for(int i = 0; p_c->stores != NULL && i < p_c->n; i++)
+        if(p_c->stores[i] != NULL) Market_delete(p_c->stores[i]);
+    for(int i = 0; i < p_c->n; i++) free(p_c->confs[i]);
+    free(p_c->confs);
+    free(p_c->stores);
+    if(p_c->f_log != NULL) fclose(p_c->f_log);
+    free(p_c);
+    return 1;
+}
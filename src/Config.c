@@ -116,11 +116,13 @@ int Config_getValue(FILE * p_f, const char * p_key, char * p_buff){
  * @brief Check if p_f is a valid configuration file.
  * 
  * @param p_f 
+ * @param p_a arena where the labels found (and the nodes of the queue tracking them) are allocated: they are released
+ *            with it. NULL: a temporary arena is used.
  * @return int result code:
  * 1: is a a valid configuration file
  * 0: is not a a valid configuration file
  */
-int Config_checkFile(FILE * p_f){
+int Config_checkFile(FILE * p_f, Arena * p_a){
     char line[MAX_DIM_STR_CONF]; //line of config file
 	char str_label[MAX_DIM_STR_CONF];
 	char str_value[MAX_DIM_STR_CONF];
@@ -128,8 +130,16 @@ int Config_checkFile(FILE * p_f){
 	int line_len;	//Current line length
 	int res=1; //function result
 	char * aux;
-	SQueue  * q_labels = SQueue_init(-1); //track of valid lables encountered
+	Arena tmp;
+	Pool * nodes = NULL;
+	SQueue  * q_labels = NULL; //track of valid lables encountered
 
+	if(p_a == NULL) {
+		if(Arena_init(&tmp, CONFIG_ARENA_CHUNK) != 1) ERR_SYS_QUIT("An error occurred during a malloc");
+		p_a = &tmp;
+	}
+	if((nodes = Pool_init(p_a, sizeof(Node), 0, 16)) == NULL || (q_labels = SQueue_initPool(-1, nodes)) == NULL)
+		ERR_SYS_QUIT("An error occurred during a malloc");
 	rewind(p_f); //rewind the file at begining
 	while (fgets(line, MAX_DIM_STR_CONF, p_f) != NULL) {
 		line_count++;
@@ -143,7 +153,7 @@ int Config_checkFile(FILE * p_f){
 			res=0;
 		}else{//Good line format
 			if(SQueue_find(q_labels, str_label, cmpStr) < 0){//Label never encoutereed
-				if((aux = malloc(MAX_DIM_STR_CONF * sizeof(char))) == NULL) 
+				if((aux = Arena_alloc(p_a, strlen(str_label) + 1)) == NULL) 
 					ERR_SYS_QUIT("An error occurred during a malloc");
 				strcpy(aux, str_label);
 				SQueue_push(q_labels, aux);
@@ -153,7 +163,8 @@ int Config_checkFile(FILE * p_f){
 			}
 		}
 	}
-	SQueue_deleteQueue(q_labels, free);
+	SQueue_deleteQueue(q_labels, NULL);
+	if(p_a == &tmp) Arena_release(&tmp);
 	return res;
 }
 
@@ -0,0 +1,197 @@
+/**
+ * @file Arena.c
+ * @brief   An Arena is a thread safe region allocator. Memory is never given back piecemeal:
+ *          all chunks (and all pools carved inside them) are released at once by #Arena_release.
+ *          A Pool gives fixed-size blocks carved from an arena and recycles them through a free list,
+ *          so once a pool has reached its working size no heap allocation happens anymore.
+ */
+#include <Arena.h>
+#include <utilities.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+//Private functions
+static size_t pAlign(size_t p_size) { return (p_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1); }
+
+/**
+ * @brief Get a new chunk from the heap with at least p_size usable bytes.
+ * @param p_a target arena. Its lock must be held.
+ * @return ArenaChunk*: new chunk or NULL if the allocation failed
+ */
+//Bytes to skip in c so that the next allocation is p_align aligned
+static size_t pPad(ArenaChunk * c, size_t p_align) { return (p_align - (uintptr_t) (c->data + c->used) % p_align) % p_align; }
+
+static ArenaChunk * pArena_newChunk(Arena * p_a, size_t p_size) {
+    ArenaChunk * c = NULL;
+    size_t size = p_size > p_a->chunkSize ? p_size : p_a->chunkSize;
+    //Chunk header and data are obtained with a single malloc
+    if((c = malloc(pAlign(sizeof(ArenaChunk)) + size)) == NULL) return NULL;
+    c->data = (unsigned char *) c + pAlign(sizeof(ArenaChunk));
+    c->size = size;
+    c->used = 0;
+    c->next = p_a->chunks;
+    p_a->chunks = c;
+    p_a->nChunks++;
+    return c;
+}
+
+/**
+ * @brief Carve p_n blocks from the arena and put them in the free list.
+ * @param p_p target pool. Its lock must be held.
+ * @return int: result code:
+ * 1: good
+ * 0: arena allocation failed
+ */
+static int pPool_grow(Pool * p_p, long p_n) {
+    unsigned char * blocks = NULL;
+    if(p_n <= 0) return 1;
+    if((blocks = Arena_alloc(p_p->arena, p_p->blockSize * p_n)) == NULL) return 0;
+    for(long i = p_n - 1; i >= 0; i--) {
+        *(void **)(blocks + i * p_p->blockSize) = p_p->free;
+        p_p->free = blocks + i * p_p->blockSize;
+    }
+    p_p->nFree += p_n;
+    p_p->nTot += p_n;
+    return 1;
+}
+
+/**
+ * @brief Init an empty arena.
+ *
+ * @param p_a Requirements: p_a != NULL. Arena to init.
+ * @param p_chunkSize size of each chunk obtained from the heap (bigger requests get their own chunk).
+ * @return int: result code:
+ * 1: good
+ * 0: an error occurred during locking system initialization
+ */
+int Arena_init(Arena * p_a, size_t p_chunkSize) {
+    p_a->chunkSize = p_chunkSize;
+    p_a->chunks = NULL;
+    p_a->pools = NULL;
+    p_a->nChunks = 0;
+    if(pthread_mutex_init(&p_a->lock, NULL) != 0) return 0;
+    return 1;
+}
+
+/**
+ * @brief Allocate p_size bytes (ARENA_ALIGN aligned) from the arena.
+ *
+ * @param p_a Requirements: p_a != NULL and must refer to an Arena initialized with #Arena_init.
+ * @param p_size bytes required
+ * @return void*: allocated memory, NULL if the heap is exhausted
+ */
+void * Arena_alloc(Arena * p_a, size_t p_size) {
+    return Arena_allocAligned(p_a, p_size, ARENA_ALIGN);
+}
+
+/**
+ * @brief Allocate p_size bytes aligned to p_align (for example #CACHE_LINE, so that the object does not share
+ *        its first and last line with other objects).
+ *
+ * @param p_a Requirements: p_a != NULL and must refer to an Arena initialized with #Arena_init.
+ * @param p_size bytes required
+ * @param p_align Requirements: power of 2, multiple of ARENA_ALIGN.
+ * @return void*: allocated memory, NULL if the heap is exhausted
+ */
+void * Arena_allocAligned(Arena * p_a, size_t p_size, size_t p_align) {
+    ArenaChunk * c = NULL;
+    void * res = NULL;
+    size_t pad = 0;
+    p_size = pAlign(p_size);
+    Lock(&p_a->lock);
+    c = p_a->chunks;
+    if(c != NULL) pad = pPad(c, p_align);
+    if(c == NULL || c->size - c->used < pad + p_size) {
+        c = pArena_newChunk(p_a, p_size + p_align - ARENA_ALIGN);
+        if(c != NULL) pad = pPad(c, p_align);
+    }
+    if(c != NULL) {
+        res = c->data + c->used + pad;
+        c->used += pad + p_size;
+    }
+    Unlock(&p_a->lock);
+    return res;
+}
+
+/**
+ * @brief Give back to the heap all the memory of the arena. Pools allocated inside it are destroyed too.
+ *
+ * @warning This function should be called by only one thread when no other thread is using the arena.
+ *
+ * @param p_a Requirements: p_a != NULL and must refer to an Arena initialized with #Arena_init.
+ */
+void Arena_release(Arena * p_a) {
+    ArenaChunk * c = NULL;
+    for(Pool * p = p_a->pools; p != NULL; p = p->next) pthread_mutex_destroy(&p->lock);
+    while (p_a->chunks != NULL) {
+        c = p_a->chunks;
+        p_a->chunks = c->next;
+        free(c);
+    }
+    p_a->pools = NULL;
+    pthread_mutex_destroy(&p_a->lock);
+}
+
+/**
+ * @brief Create a new pool of fixed-size blocks inside the arena p_a.
+ *
+ * @param p_a Requirements: p_a != NULL and must refer to an Arena initialized with #Arena_init.
+ * @param p_blockSize size of each block.
+ * @param p_prealloc blocks carved immediately.
+ * @param p_grow blocks carved each time the pool is empty (>0).
+ * @return Pool*: new pool or NULL if an error occurred.
+ */
+Pool * Pool_init(Arena * p_a, size_t p_blockSize, long p_prealloc, long p_grow) {
+    Pool * aux = NULL;
+    if(p_grow <= 0) return NULL;
+    if((aux = Arena_alloc(p_a, sizeof(Pool))) == NULL) return NULL;
+    aux->arena = p_a;
+    aux->blockSize = pAlign(p_blockSize < sizeof(void *) ? sizeof(void *) : p_blockSize);
+    aux->grow = p_grow;
+    aux->free = NULL;
+    aux->nFree = 0;
+    aux->nTot = 0;
+    if(pthread_mutex_init(&aux->lock, NULL) != 0) return NULL;
+    if(pPool_grow(aux, p_prealloc) != 1) {
+        pthread_mutex_destroy(&aux->lock);
+        return NULL;
+    }
+    Lock(&p_a->lock);
+    aux->next = p_a->pools;
+    p_a->pools = aux;
+    Unlock(&p_a->lock);
+    return aux;
+}
+
+/**
+ * @brief Get a block from the pool.
+ *
+ * @param p_p Requirements: p_p != NULL and must refer to a Pool created with #Pool_init.
+ * @return void*: a block of p_p->blockSize bytes, NULL if the heap is exhausted.
+ */
+void * Pool_alloc(Pool * p_p) {
+    void * res = NULL;
+    Lock(&p_p->lock);
+    if(p_p->free != NULL || pPool_grow(p_p, p_p->grow) == 1) {
+        res = p_p->free;
+        p_p->free = *(void **) res;
+        p_p->nFree--;
+    }
+    Unlock(&p_p->lock);
+    return res;
+}
+
+/**
+ * @brief Give back a block to the pool.
+ *
+ * @param p_p Requirements: p_p != NULL and must refer to a Pool created with #Pool_init.
+ * @param p_block Requirements: block obtained from p_p with #Pool_alloc.
+ */
+void Pool_free(Pool * p_p, void * p_block) {
+    if(p_block == NULL) return;
+    Lock(&p_p->lock);
+    *(void **) p_block = p_p->free;
+    p_p->free = p_block;
+    p_p->nFree++;
+    Unlock(&p_p->lock);
+}
@@ -0,0 +1,131 @@
+/**
+ * @file DeskBoard.c
+ * @brief   Board of the desk reports read by the director.
+ *          Each report replaces the contribution of the previous report of the same desk in the current round,
+ *          so the aggregates always describe the last report of each desk, as if all of them were scanned.
+ */
+#include <DeskBoard.h>
+#include <stdint.h>
+#include <utilities.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//Private functions
+static void pDeskBoard_add(DeskBoard * p_b, int32_t p_users, int p_sign) {
+    if(p_users < 0) return; //closed
+    if(p_users <= 1) p_b->nNoWork += p_sign;
+    if(p_users >= p_b->s2) p_b->nBusy += p_sign;
+}
+
+/**
+ * @brief Create an empty board: no desk reported yet.
+ *
+ * @param p_b Requirements: p_b != NULL. Board to initialize.
+ * @param p_a arena where the arrays of the board are allocated.
+ * @param p_n number of desks (>0).
+ * @param p_s2 users in queue from which an open desk is busy (>0).
+ * @return int: result code:
+ * 1: good
+ * 0: memory allocation failed
+ */
+int DeskBoard_init(DeskBoard * p_b, Arena * p_a, int p_n, int p_s2) {
+    if((p_b->users = Arena_allocAligned(p_a, p_n * sizeof(int32_t), CACHE_LINE)) == NULL ||
+        (p_b->rounds = Arena_allocAligned(p_a, p_n * sizeof(int32_t), CACHE_LINE)) == NULL) {
+        ERR_MSG("An error occurred during desk board allocation.");
+        return 0;
+    }
+    p_b->n = p_n;
+    p_b->s2 = p_s2;
+    p_b->round = 0;
+    p_b->nReported = p_b->nNoWork = p_b->nBusy = 0;
+    for(int i = 0; i < p_n; i++) {
+        p_b->users[i] = -1;
+        p_b->rounds[i] = -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Record a report of desk p_id and update the aggregates (O(1)).
+ *
+ * @param p_b Requirements: p_b != NULL and initialized with #DeskBoard_init.
+ * @param p_id desk (0 <= p_id < n).
+ * @param p_isOpen 1 if the desk is open.
+ * @param p_users users in queue of the desk.
+ * @return int: 1 if every desk reported in the current round (time to decide), 0 otherwise
+ */
+int DeskBoard_report(DeskBoard * p_b, int p_id, int p_isOpen, int p_users) {
+    if(p_b->rounds[p_id] == p_b->round) pDeskBoard_add(p_b, p_b->users[p_id], -1);
+    else {
+        p_b->rounds[p_id] = p_b->round;
+        p_b->nReported++;
+    }
+    p_b->users[p_id] = p_isOpen ? p_users : -1;
+    pDeskBoard_add(p_b, p_b->users[p_id], 1);
+    return p_b->nReported == p_b->n;
+}
+
+/**
+ * @brief Forget the reports of the current round and start a new one (O(1), except once every 2^31 rounds).
+ */
+void DeskBoard_nextRound(DeskBoard * p_b) {
+    p_b->nReported = p_b->nNoWork = p_b->nBusy = 0;
+    if(p_b->round < INT32_MAX) {
+        p_b->round++;
+        return;
+    }
+    p_b->round = 0;
+    for(int i = 0; i < p_b->n; i++) p_b->rounds[i] = -1;
+}
+
+/**
+ * @brief Count from scratch, over the reports of the current round, the open desks with at most one user and the
+ *        open desks with at least s2 users. With SSE2 four desks are compared at once, without branches.
+ *
+ * @param p_b Requirements: p_b != NULL and initialized with #DeskBoard_init.
+ * @param p_noWork where the open desks with at most one user are placed.
+ * @param p_busy where the open desks with at least s2 users are placed.
+ */
+void DeskBoard_count(const DeskBoard * p_b, int * p_noWork, int * p_busy) {
+    int noWork = 0, busy = 0, i = 0;
+#ifdef __SSE2__
+    const __m128i round = _mm_set1_epi32(p_b->round), closed = _mm_set1_epi32(-1);
+    const __m128i two = _mm_set1_epi32(2), s2 = _mm_set1_epi32(p_b->s2 - 1);
+    __m128i accNoWork = _mm_setzero_si128(), accBusy = _mm_setzero_si128(), u, live;
+    int32_t lanes[4];
+    for(; i + 4 <= p_b->n; i += 4) {
+        u = _mm_load_si128((const __m128i *) (p_b->users + i));
+        live = _mm_cmpeq_epi32(_mm_load_si128((const __m128i *) (p_b->rounds + i)), round);
+        //Each comparison gives -1 where it holds: subtracting counts the desks
+        accNoWork = _mm_sub_epi32(accNoWork, _mm_and_si128(live, _mm_and_si128(_mm_cmpgt_epi32(u, closed), _mm_cmplt_epi32(u, two))));
+        accBusy = _mm_sub_epi32(accBusy, _mm_and_si128(live, _mm_cmpgt_epi32(u, s2)));
+    }
+    _mm_storeu_si128((__m128i *) lanes, accNoWork);
+    noWork = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm_storeu_si128((__m128i *) lanes, accBusy);
+    busy = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for(; i < p_b->n; i++) {
+        int live = p_b->rounds[i] == p_b->round;
+        noWork += live & (p_b->users[i] >= 0) & (p_b->users[i] <= 1);
+        busy += live & (p_b->users[i] >= p_b->s2);
+    }
+    *p_noWork = noWork;
+    *p_busy = busy;
+}
+
+/**
+ * @brief Compare the aggregates with a full count (#DeskBoard_count) and resynchronize them if they differ.
+ *
+ * @return int: 1 if the aggregates were right, 0 if they have been corrected
+ */
+int DeskBoard_verify(DeskBoard * p_b) {
+    int noWork = 0, busy = 0;
+    DeskBoard_count(p_b, &noWork, &busy);
+    if(noWork == p_b->nNoWork && busy == p_b->nBusy) return 1;
+    ERR_MSG("Desk board out of sync: no_work=%d (counted %d) busy=%d (counted %d).", p_b->nNoWork, noWork, p_b->nBusy, busy);
+    p_b->nNoWork = noWork;
+    p_b->nBusy = busy;
+    return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file Mailbox.c
+ * @brief   Wakeup word of a thread, built on a futex.
+ *          The owner sets #MAILBOX_WAITING only when the word holds no news, and sleeps only while the word is
+ *          still #MAILBOX_WAITING: news posted after the check make the futex wait return at once, so no wakeup
+ *          is lost without holding a lock.
+ */
+#define _DEFAULT_SOURCE /* syscall */
+
+#include <Mailbox.h>
+#include <utilities.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+void Mailbox_init(Mailbox * p_b) {
+    atomic_init(&p_b->word, 0);
+    p_b->wake = NULL;
+    p_b->wakeArg = NULL;
+}
+
+/**
+ * @brief Init a mailbox whose owner is a task: it parks with #Mailbox_park and p_wake(p_arg) is called by the
+ *        first post after that. The owner starts running (not parked).
+ *
+ * @param p_b Requirements: p_b != NULL.
+ * @param p_wake function which runs the owner again (for example submitting it to an executor).
+ * @param p_arg argument of p_wake.
+ */
+void Mailbox_initTask(Mailbox * p_b, void (*p_wake)(void *), void * p_arg) {
+    atomic_init(&p_b->word, 0);
+    p_b->wake = p_wake;
+    p_b->wakeArg = p_arg;
+}
+
+/**
+ * @brief Post p_news to the owner of p_b, waking it up if it is sleeping.
+ *        Changes made before the call are visible to the owner when it takes the news.
+ *
+ * @param p_b Requirements: p_b != NULL and initialized with #Mailbox_init.
+ * @param p_news one or more of #MAILBOX_USER, #MAILBOX_STATE and #MAILBOX_WAKE.
+ */
+void Mailbox_post(Mailbox * p_b, unsigned p_news) {
+    if((atomic_fetch_or(&p_b->word, p_news) & MAILBOX_WAITING) == 0) return;
+    if(p_b->wake == NULL) syscall(SYS_futex, &p_b->word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    //Task owner: only the poster which clears the flag runs it again
+    else if(atomic_fetch_and(&p_b->word, ~MAILBOX_WAITING) & MAILBOX_WAITING) p_b->wake(p_b->wakeArg);
+}
+
+/**
+ * @brief Take the news posted so far, without waiting (owner only).
+ *
+ * @return unsigned: news (0: none)
+ */
+unsigned Mailbox_take(Mailbox * p_b) {
+    return atomic_exchange(&p_b->word, 0) & ~MAILBOX_WAITING;
+}
+
+/**
+ * @brief Wait until some news are posted and take all of them (owner only).
+ *        It returns at once if news were posted after the last take.
+ *
+ * @return unsigned: news (never 0)
+ */
+unsigned Mailbox_wait(Mailbox * p_b) {
+    unsigned news = 0, idle = 0;
+    while ((news = Mailbox_take(p_b)) == 0) {
+        idle = 0;
+        if(atomic_compare_exchange_strong(&p_b->word, &idle, MAILBOX_WAITING) &&
+            syscall(SYS_futex, &p_b->word, FUTEX_WAIT_PRIVATE, MAILBOX_WAITING, NULL, NULL, 0) == -1 &&
+            errno != EAGAIN && errno != EINTR)
+            ERR_SYS_QUIT("An error occurred during mailbox wait.");
+    }
+    return news;
+}
+
+/**
+ * @brief Park a task owner (see #Mailbox_initTask) if no news were posted after the last take.
+ *        A parked owner must return without touching its data: the next post runs it again.
+ *
+ * @return int: 1 if the owner is parked, 0 if news are waiting (the owner must go on and take them)
+ */
+int Mailbox_park(Mailbox * p_b) {
+    unsigned idle = 0;
+    return atomic_compare_exchange_strong(&p_b->word, &idle, MAILBOX_WAITING);
+}
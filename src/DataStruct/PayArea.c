@@ -6,27 +6,84 @@
 #include <utilities.h>
 #include <PayArea.h>
 #include <TCashDesk.h>
+#include <EventLog.h>
 
 //Private functions
 static CashDesk * pGetRandomDesk(PayArea *p_a, CashDeskState p_state) {
-	//Choose a random open cashk desk
-	SQueue * selectedDesks = NULL;
-	void * aux = NULL;
-	CashDesk * deskChoosen = NULL;
-	if( (selectedDesks = SQueue_init(-1)) == NULL) 
-		ERR_QUIT("Malloc error.");
-	for(int i=0;i < p_a->nTot; i++) {//Get id of all desks currently open
-		if(p_a->desks[i]->state == p_state){
-			if(SQueue_push(selectedDesks, p_a->desks[i]) != 1)
-				ERR_QUIT("An error occurred during desk search. (1)");
-		}
+	//Choose a random desk in state p_state without locks: count the candidates, then take the k-th one.
+	//If states change between the two scans the choice is done again (with the lock of p_a held they can't change)
+	int nSelected = 0, k = 0;
+	while (1) {
+		nSelected = 0;
+		for(int i=0;i < p_a->nTot; i++)
+			if(CashDesk_getState(p_a->desks[i]) == p_state) nSelected++;
+		if(nSelected == 0) continue;
+		k = getRandom(0, nSelected-1);
+		for(int i=0;i < p_a->nTot; i++)
+			if(CashDesk_getState(p_a->desks[i]) == p_state && k-- == 0) return p_a->desks[i];
 	}
-	int r = getRandom(0,SQueue_dim(selectedDesks)-1);
-	if(SQueue_removePos(selectedDesks, r, &aux) != 1)
-		ERR_QUIT("An error occurred during desk search. (2)");
-	SQueue_deleteQueue(selectedDesks, NULL);
-	deskChoosen = (CashDesk *) aux;
-    return deskChoosen;
+}
+
+//Min-heap of desk indices keyed on dims: the open desk with the shortest queue is heap[0]
+static int pDeskHeap_less(DeskHeap *p_h, int p_x, int p_y) {
+	return p_h->dims[p_x] < p_h->dims[p_y] || (p_h->dims[p_x] == p_h->dims[p_y] && p_x < p_y);
+}
+
+static void pDeskHeap_swap(DeskHeap *p_h, int p_x, int p_y) {
+	int aux = p_h->heap[p_x];
+	p_h->heap[p_x] = p_h->heap[p_y];
+	p_h->heap[p_y] = aux;
+	p_h->pos[p_h->heap[p_x]] = p_x;
+	p_h->pos[p_h->heap[p_y]] = p_y;
+}
+
+static void pDeskHeap_siftUp(DeskHeap *p_h, int p_k) {
+	while (p_k > 0 && pDeskHeap_less(p_h, p_h->heap[p_k], p_h->heap[(p_k-1)/2])) {
+		pDeskHeap_swap(p_h, p_k, (p_k-1)/2);
+		p_k = (p_k-1)/2;
+	}
+}
+
+static void pDeskHeap_siftDown(DeskHeap *p_h, int p_k) {
+	int * h = p_h->heap, child = 0;
+	while ((child = 2*p_k + 1) < p_h->n) {
+		if(child + 1 < p_h->n && pDeskHeap_less(p_h, h[child+1], h[child])) child++;
+		if(!pDeskHeap_less(p_h, h[child], h[p_k])) break;
+		pDeskHeap_swap(p_h, p_k, child);
+		p_k = child;
+	}
+}
+
+static void pDeskHeap_build(DeskHeap *p_h, int p_nDesks) {
+	p_h->n = 0;
+	for(int i = 0; i < p_nDesks; i++) {
+		if(p_h->dims[i] < 0) continue;
+		p_h->pos[i] = p_h->n;
+		p_h->heap[p_h->n++] = i;
+	}
+	for(int k = p_h->n/2 - 1; k >= 0; k--) pDeskHeap_siftDown(p_h, k);
+}
+
+static void pDeskHeap_remove(DeskHeap *p_h, int p_desk) {
+	int k = p_h->pos[p_desk], moved = 0;
+	pDeskHeap_swap(p_h, k, --p_h->n);
+	if(k == p_h->n) return;
+	moved = p_h->heap[k];
+	pDeskHeap_siftUp(p_h, k);
+	pDeskHeap_siftDown(p_h, p_h->pos[moved]);
+}
+
+static void pDeskHeap_push(DeskHeap *p_h, int p_desk) {
+	p_h->pos[p_desk] = p_h->n;
+	p_h->heap[p_h->n++] = p_desk;
+	pDeskHeap_siftUp(p_h, p_h->n - 1);
+}
+
+static int pDeskHeap_init(DeskHeap *p_h, Arena *p_arena, int p_nDesks) {
+	p_h->n = 0;
+	return (p_h->dims = Arena_alloc(p_arena, p_nDesks * sizeof(int))) != NULL &&
+		(p_h->heap = Arena_alloc(p_arena, p_nDesks * sizeof(int))) != NULL &&
+		(p_h->pos = Arena_alloc(p_arena, p_nDesks * sizeof(int))) != NULL;
 }
 
 // static CashDesk * pGetLessBusyDesk(PayArea *p_a) {
@@ -63,19 +120,30 @@ PayArea * PayArea_init(Market * p_m, int p_tot, int p_open) {
     if(p_tot <= 0 || p_open <= 0)  ERR_QUIT("Invalid p_open or p_tot value. p_open: %d; p_tot: %d", p_open, p_tot);
     if(p_open <= 0 || p_open > p_tot) ERR_QUIT("Invalid p_open value. p_open: %d; p_tot: %d", p_open, p_tot);
     
-   	if( (aux = malloc(sizeof(PayArea))) == NULL)
+   	if( (aux = Arena_alloc(&p_m->arena, sizeof(PayArea))) == NULL)
         ERR_QUIT("An error occurred during memory allocation. (payarea malloc)");
     
     //Init array of desks
-	if( (aux->desks = malloc(p_tot * sizeof(CashDesk *))) == NULL)
+	if( (aux->desks = Arena_alloc(&p_m->arena, p_tot * sizeof(CashDesk *))) == NULL)
 		ERR_QUIT("An error occurred during memory allocation. (cashdesks array malloc)");
+	if(pDeskHeap_init(&aux->jockeyHeap, &p_m->arena, p_tot) != 1 ||
+		pDeskHeap_init(&aux->closeHeap, &p_m->arena, p_tot) != 1 ||
+		(aux->movers = Arena_alloc(&p_m->arena, p_m->C * sizeof(int))) == NULL ||
+		(aux->moveTo = Arena_alloc(&p_m->arena, p_m->C * sizeof(int))) == NULL ||
+		(aux->chainFirst = Arena_alloc(&p_m->arena, p_tot * sizeof(int))) == NULL ||
+		(aux->chainLast = Arena_alloc(&p_m->arena, p_tot * sizeof(int))) == NULL)
+		ERR_QUIT("An error occurred during memory allocation. (scratch arrays malloc)");
+	if( (aux->links = UQueueLinks_init(&p_m->arena, p_m->C)) == NULL)
+		ERR_QUIT("An error occurred during memory allocation. (desk queues links malloc)");
+	//Queue changes are counted by the desk queues, under the lock of the queue entered
+	aux->links->visits = p_m->users->queueChanges;
     aux->nTot = p_tot;
-    aux->nOpen = p_open;
-    aux->nClose = p_tot - p_open;      
+    atomic_init(&aux->nOpen, p_open);
+    atomic_init(&aux->nClose, p_tot - p_open);      
     aux->market = p_m;  
 	//Init all desks
 	for(int i = 0;i < aux->nTot; i++) {
-		if( (aux->desks[i] = CashDesk_init(p_m, i, p_m->TD, getRandom(20, 80), (i<p_open) ? DESK_OPEN:DESK_CLOSE)) == NULL )
+		if( (aux->desks[i] = CashDesk_init(p_m, i, p_m->TD, getRandom(20, 80), (i<p_open) ? DESK_OPEN:DESK_CLOSE, aux->links)) == NULL )
 			ERR_QUIT("An error occurred during cashdesk creation. Impossible to setup the market.");
 		
 	}
@@ -87,7 +155,7 @@ PayArea * PayArea_init(Market * p_m, int p_tot, int p_open) {
 }
 
 /**
- * @brief Dealloc a PayArea object.
+ * @brief Dealloc a PayArea object. Its memory belongs to the arena of the market and it is released with it.
  * 
  * @warning This function should be called by only one thread when no other thread is working on p_c object.
  *          Typically the main thread call this function after all slave threads have terminated.
@@ -98,12 +166,10 @@ void PayArea_delete(PayArea * p_a) {
     if(p_a == NULL) ERR_QUIT("An error occurred during PayArea deletion. p_a == NULL.");
     pthread_mutex_destroy(&p_a->lock);
 	for(int i = 0;i < p_a->nTot; i++) CashDesk_delete(p_a->desks[i]);
-	free(p_a->desks);
-    free(p_a);
 }
 
 /**
- * @brief Check if the payarea is empty (no users)
+ * @brief Check if the payarea is empty (no users). No lock is taken: the queue lengths are read one after the other.
  * 
  * @param p_a Requirements: p_a != NULL and must refer to a PayArea object created with #PayArea_init.
  * @return int: result code:
@@ -113,10 +179,8 @@ void PayArea_delete(PayArea * p_a) {
 int PayArea_isEmpty(PayArea *p_a) {
     int res_fun = 1;
     if(p_a == NULL) ERR_QUIT("p_a == NULL");
-	PayArea_Lock(p_a);
     for(int i = 0;i < p_a->nTot && res_fun == 1;i++) 
-		res_fun = SQueue_isEmpty(p_a->desks[i]->usersPay)!=1 ? 0:res_fun;
-	PayArea_Unlock(p_a);
+		res_fun = UQueue_isEmpty(&p_a->desks[i]->usersPay)!=1 ? 0:res_fun;
     return res_fun;
 }
 
@@ -146,6 +210,18 @@ void PayArea_joinDeskThreads(PayArea * p_a) {
         if(CashDesk_joinThread(p_a->desks[i])!=0) ERR_QUIT("An error occurred during cash desk thread join.");    
 }
 
+/**
+ * @brief Check if the tasks of all desks ended (market with an executor, see #CashDesk_isEnded).
+ * 
+ * @param p_a Requirements: p_a != NULL and must refer to a PayArea object created with #PayArea_init.
+ * @return int: 1 if all desks ended, 0 otherwise
+ */
+int PayArea_isEnded(PayArea * p_a) {
+    for(int i = 0; i < p_a->nTot; i++)
+        if(CashDesk_isEnded(p_a->desks[i]) != 1) return 0;
+    return 1;
+}
+
 
 /**
  * @brief Send signal to all desks.
@@ -154,7 +230,7 @@ void PayArea_joinDeskThreads(PayArea * p_a) {
  */
 void PayArea_Signal(PayArea *p_a) {
     if(p_a == NULL) ERR_QUIT("p_a == NULL");
-    for(int i=0;i<p_a->nTot;i++) Signal(&p_a->desks[i]->cv_DeskNews);
+    for(int i=0;i<p_a->nTot;i++) CashDesk_Signal(p_a->desks[i]);
 }
 
 /**
@@ -165,62 +241,170 @@ void PayArea_Signal(PayArea *p_a) {
 void PayArea_tryOpenDesk(PayArea *p_a) {
     CashDesk * selected = NULL;    
     PayArea_Lock(p_a);
-    if(p_a->nOpen != p_a->nTot) {
+    if(atomic_load(&p_a->nOpen) != p_a->nTot) {
         selected = pGetRandomDesk(p_a, DESK_CLOSE);
-        selected->state = DESK_OPEN;
-        p_a->nOpen++;
-        p_a->nClose--;
-        Signal(&selected->cv_DeskNews);
+        CashDesk_setState(selected, DESK_OPEN);
+        EVENT_RECORD(EV_DESK_OPEN, selected->id, 0, 0);
+        atomic_fetch_add(&p_a->nOpen, 1);
+        atomic_fetch_sub(&p_a->nClose, 1);
+        CashDesk_Signal(selected);
     }
     PayArea_Unlock(p_a);
 }
 
 /**
  * @brief Try to close a desk. This works only if there are at least 2 desks open.
+ *        Under the lock of p_a the desk is closed, its queue is detached with a single splice and the queue lengths
+ *        of the open desks are copied (O(K), whatever the length of the detached queue). Then, without the lock, the
+ *        users are dealt in order to the open desks with the shortest queues, kept in a min-heap, and each desk gets
+ *        its users appended with a single lock and a single wakeup.
+ *        It is called by the director only, which owns closeHeap, chainFirst and chainLast.
  * 
  * @param p_a 
  */
 void PayArea_tryCloseDesk(PayArea *p_a) {
+    Market * m = p_a->market;
+    UserStore * us = m->users;
+    UQueueLinks * l = p_a->links;
+    DeskHeap * h = &p_a->closeHeap;
     CashDesk * closedDesk = NULL;
-    CashDesk * moveToDesk = NULL;
-    void * data = NULL;
-    User * aux = NULL;
+    int first = UQUEUE_NONE, next = UQUEUE_NONE, best = 0;
+
+    //Users between two queues count as a user in shopping area (see #PayArea_jockey)
+    Market_startMoving(m);
+    if(Market_isClosing(m) || sig_quit) {
+        Market_endMoving(m);
+        return;
+    }
     PayArea_Lock(p_a);
-    if(p_a->nOpen >= 2) {
+    if(atomic_load(&p_a->nOpen) >= 2) {
         //closedDesk = pGetLessBusyDesk(p_a); //Removed because director tend to close always the same desk.
         closedDesk = pGetRandomDesk(p_a, DESK_OPEN);
-        closedDesk->state = DESK_CLOSE;
-        p_a->nOpen--;
-        p_a->nClose++;
-        //Move all users in queue to other randomly choosen open desks (is always possible to find one)
-        while (SQueue_pop(closedDesk->usersPay, &data) == 1) {
-            moveToDesk = pGetRandomDesk(p_a, DESK_OPEN);
-            aux = (User *) data;
-            aux->queueChanges++;	
-            CashDesk_addUser(moveToDesk, aux);
-        }
-        
-        Signal(&closedDesk->cv_DeskNews);
+        CashDesk_setState(closedDesk, DESK_CLOSE);
+        EVENT_RECORD(EV_DESK_CLOSE, closedDesk->id, 0, 0);
+        atomic_fetch_sub(&p_a->nOpen, 1);
+        atomic_fetch_add(&p_a->nClose, 1);
+        UQueue_detach(&closedDesk->usersPay, &first);
+        CashDesk_Signal(closedDesk);
+        for(int i = 0; i < p_a->nTot; i++)
+            h->dims[i] = CashDesk_getState(p_a->desks[i]) == DESK_OPEN ? UQueue_dim(&p_a->desks[i]->usersPay) : -1;
     }
     PayArea_Unlock(p_a);
+    if(closedDesk == NULL) {
+        Market_endMoving(m);
+        return;
+    }
+    //Each user goes to the open desk with the shortest queue, behind the ones already sent there (is always possible
+    //to find one: only the director closes desks). Detached users are in no queue, so their links are ours
+    for(int i = 0; i < p_a->nTot; i++) p_a->chainFirst[i] = p_a->chainLast[i] = UQUEUE_NONE;
+    pDeskHeap_build(h, p_a->nTot);
+    for(int u = first; u != UQUEUE_NONE; u = next) {
+        next = l->next[u];
+        best = h->heap[0];
+        l->next[u] = UQUEUE_NONE;
+        l->prev[u] = p_a->chainLast[best];
+        if(p_a->chainLast[best] == UQUEUE_NONE) p_a->chainFirst[best] = u;
+        else l->next[p_a->chainLast[best]] = u;
+        p_a->chainLast[best] = u;
+        h->dims[best]++;
+        pDeskHeap_siftDown(h, 0);
+    }
+    for(int i = 0; i < p_a->nTot; i++) {
+        if(p_a->chainFirst[i] == UQUEUE_NONE) continue;
+        for(int u = p_a->chainFirst[i]; u != UQUEUE_NONE; u = l->next[u])
+            EVENT_RECORD(EV_USER_CHANGE, us->id[u], p_a->desks[i]->id, closedDesk->id);
+        CashDesk_addUsers(p_a->desks[i], p_a->chainFirst[i], p_a->chainLast[i]);
+    }
+    Market_endMoving(m);
 }
 
 /**
  * @brief Add a new user to one randomly choosen open desk.
+ *        The lock of p_a is not taken, so arrivals don't wait for the director: if the desk is closed after it was
+ *        chosen, the user is either moved by #PayArea_tryCloseDesk (the queue was detached after the push) or still in
+ *        the queue of the closed desk, which it leaves to choose again.
  * 
  * @param p_a Requirements: p_a != NULL and must refer to a PayArea object created with #PayArea_init.
- * @param p_u Requirements: p_u != NULL and must refer to a User object created with #User_init. Target User.
+ * @param p_u Requirements: index of a user created with #User_init. Target User.
  */
-void PayArea_addUser(PayArea * p_a, User * p_u) {
+void PayArea_addUser(PayArea * p_a, int p_u) {
 	CashDesk * deskChoosen = NULL;	
+	CashDesk * lastDesk = NULL;
+	UserStore * us = p_a->market->users;
+    us->tQueueStart[p_u] = getCurrentTimeNs();
+    do {
+        deskChoosen = pGetRandomDesk(p_a, DESK_OPEN);
+        if(lastDesk == NULL) EVENT_RECORD(EV_USER_QUEUE, us->id[p_u], deskChoosen->id, 0);
+        else EVENT_RECORD(EV_USER_CHANGE, us->id[p_u], deskChoosen->id, lastDesk->id);
+        CashDesk_addUser(deskChoosen, p_u);
+        lastDesk = deskChoosen;
+    } while (CashDesk_getState(deskChoosen) != DESK_OPEN && UQueue_remove(&deskChoosen->usersPay, p_u) == 1);
+}
+
+/**
+ * @brief Queue jockeying: users waiting in a desk queue move to the open desk with the shortest queue, if there
+ *        they would have fewer users ahead. It is run every S ms by the director (thread or task):
+ *        the waiting users are moved by a single pass over the queues, without waking any of them.
+ *
+ *        Each queue is walked under its lock and the movers are unlinked in O(1) (see #UQueue), the shortest other
+ *        queue being kept in a min-heap of the open desks (O(1) per user that stays, O(log K) per mover), then they are added
+ *        to their new desk. While users are between two queues the pass counts as a user in shopping area,
+ *        so that on closing no desk stops before they reach their new queue.
+ *
+ * @param p_arg is expected as PayArea * object.
+ * @return int: 1 if the pass must be run again, 0 if the market is closing
+ */
+int PayArea_jockey(void * p_arg) {
+    PayArea * p_a = (PayArea *) p_arg;
+    Market * m = p_a->market;
+    UserStore * us = m->users;
+    UQueueLinks * l = p_a->links;
+    DeskHeap * h = &p_a->jockeyHeap;
+    CashDesk * from = NULL;
+    int best = 0, ahead = 0, nMovers = 0, next = UQUEUE_NONE;
+
+    Market_startMoving(m);
+    if(Market_isClosing(m) || sig_quit) {
+        Market_endMoving(m);
+        return 0;
+    }
     PayArea_Lock(p_a);
-	deskChoosen = pGetRandomDesk(p_a, DESK_OPEN);
-    p_u->tQueueStart = getCurrentTime();
-    p_u->queueChanges++;
-	CashDesk_addUser(deskChoosen, p_u);
-	Signal(&deskChoosen->cv_DeskNews);
-	PayArea_Unlock(p_a);
+    for(int i = 0; i < p_a->nTot && atomic_load(&p_a->nOpen) >= 2; i++)
+        h->dims[i] = CashDesk_getState(p_a->desks[i]) == DESK_OPEN ? UQueue_dim(&p_a->desks[i]->usersPay) : -1;
+    if(atomic_load(&p_a->nOpen) >= 2) pDeskHeap_build(h, p_a->nTot);
+    for(int i = 0; i < p_a->nTot && atomic_load(&p_a->nOpen) >= 2; i++) {
+        from = p_a->desks[i];
+        if(CashDesk_getState(from) != DESK_OPEN) continue;
+        //Users in front of the queue stay: a user moves if the shortest other queue has fewer users than the ones
+        //still ahead of it. The shortest other queue is the root of the heap once desk i is out of it, and it
+        //grows with each user moved there.
+        nMovers = 0;
+        ahead = 0;
+        pDeskHeap_remove(h, i);
+        UQueue_Lock(&from->usersPay);
+        for(int v = from->usersPay.head; v != UQUEUE_NONE; v = next) {
+            next = l->next[v];
+            best = h->heap[0];
+            if(h->dims[best] < ahead) {
+                UQueue_removeLocked(&from->usersPay, v);
+                p_a->movers[nMovers] = v;
+                p_a->moveTo[nMovers++] = best;
+                h->dims[best]++;
+                h->dims[i]--;
+                pDeskHeap_siftDown(h, 0);
+            } else ahead++;
+        }
+        UQueue_Unlock(&from->usersPay);
+        pDeskHeap_push(h, i);
+        for(int k = 0; k < nMovers; k++) {
+            EVENT_RECORD(EV_USER_CHANGE, us->id[p_a->movers[k]], p_a->desks[p_a->moveTo[k]]->id, from->id);
+            CashDesk_addUser(p_a->desks[p_a->moveTo[k]], p_a->movers[k]);
+        }
+    }
+    PayArea_Unlock(p_a);
+    Market_endMoving(m);
+    return 1;
 }
 
-void PayArea_Lock(PayArea * p_a) {Lock(&p_a->lock);}
+void PayArea_Lock(PayArea * p_a) {EventLog_lock(&p_a->lock);}
 void PayArea_Unlock(PayArea * p_a) {Unlock(&p_a->lock);}
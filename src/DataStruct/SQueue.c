@@ -15,25 +15,45 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <EventLog.h>
 
 //Private functions
-static Node * pSQueue_allocateNode() { return malloc(sizeof(Node));}
-static SQueue * pSQueue_allocQueue() { return malloc(sizeof(SQueue)); }
-static void pSQueue_freeNode(Node * n, funDealloc p_funDealloc) { 
+/**
+ * @brief Get a node for p_q. With a pool, nodes previously freed by p_q are reused first,
+ *        so the pool lock is taken only when the queue grows beyond its past size.
+ */
+static Node * pSQueue_allocateNode(SQueue * p_q) {
+    Node * aux = NULL;
+    if(p_q->nodes == NULL) return malloc(sizeof(Node));
+    if(p_q->spare == NULL) return Pool_alloc(p_q->nodes);
+    aux = p_q->spare;
+    p_q->spare = aux->next;
+    p_q->nSpare--;
+    return aux;
+}
+static SQueue * pSQueue_allocQueue(Pool * p_nodes) { return p_nodes == NULL ? aligned_alloc(CACHE_LINE, sizeof(SQueue)) : Arena_allocAligned(p_nodes->arena, sizeof(SQueue), CACHE_LINE); }
+static void pSQueue_freeNode(SQueue * p_q, Node * n, funDealloc p_funDealloc) { 
     if(p_funDealloc != NULL) 
         p_funDealloc(n->data); 
-    free(n); 
+    if(p_q->nodes == NULL) free(n);
+    else if(p_q->nSpare < SQUEUE_SPARE_MAX) {
+        n->next = p_q->spare;
+        p_q->spare = n;
+        p_q->nSpare++;
+    } else Pool_free(p_q->nodes, n);
 }
 static int pSQueue_isEmpty(SQueue * p_q);
 static int pSQueue_isFull(SQueue * p_q);
 static int pSQueue_pop(SQueue * p_q, void ** p_removed);
 static int pSQueue_push(SQueue * p_q, void * p_new);
-static void pSQueue_Lock(SQueue * p_q) {if(pthread_mutex_lock(&p_q->lock) != 0) ERR_QUIT("An error occurred during locking.");}
+static void pSQueue_Lock(SQueue * p_q) {EventLog_lock(&p_q->lock);}
 static void pSQueue_Unlock(SQueue * p_q) {if(pthread_mutex_unlock(&p_q->lock) != 0) ERR_QUIT("An error occurred during unlocking.");}
 static void pSQueue_WaitFull(SQueue * p_q) {if(pthread_cond_wait(&p_q->cv_full, &p_q->lock) != 0) ERR_QUIT("An error occurred during cond wait.");}
 static void pSQueue_WaitEmpty(SQueue * p_q) {if(pthread_cond_wait(&p_q->cv_empty, &p_q->lock) != 0) ERR_QUIT("An error occurred during cond wait.");}
 static void pSQueue_SignalEmpty(SQueue * p_q) {if(pthread_cond_signal(&p_q->cv_empty) != 0) ERR_QUIT("An error occurred during singal empty.");}
 static void pSQueue_SignalFull(SQueue * p_q) {if(pthread_cond_signal(&p_q->cv_full) != 0) ERR_QUIT("An error occurred during singal full.");}
+static void pSQueue_BroadcastEmpty(SQueue * p_q) {if(pthread_cond_broadcast(&p_q->cv_empty) != 0) ERR_QUIT("An error occurred during broadcast empty.");}
+static void pSQueue_BroadcastFull(SQueue * p_q) {if(pthread_cond_broadcast(&p_q->cv_full) != 0) ERR_QUIT("An error occurred during broadcast full.");}
 
 static int pSQueue_isEmpty(SQueue * p_q){
     return p_q->n == 0 ? 1:0;
@@ -51,14 +71,28 @@ static int pSQueue_isFull(SQueue * p_q){
  * @return SQueue* pointer to new queue allocated, NULL if a probelm occurred during allocation.
  */
 SQueue * SQueue_init(long p_max){    
+    return SQueue_initPool(p_max, NULL);
+}
+
+/**
+ * @brief Make a new empty queue whose nodes are taken from p_nodes instead of the heap.
+ *        The queue itself is allocated in the arena of p_nodes.
+ * @param p_max is the maximum number of elements for the queue (see #SQueue_init).
+ * @param p_nodes pool of blocks with size >= sizeof(Node) (NULL: nodes are malloc'd).
+ * @return SQueue* pointer to new queue allocated, NULL if a probelm occurred during allocation.
+ */
+SQueue * SQueue_initPool(long p_max, Pool * p_nodes){    
     SQueue * aux = NULL;
     
-    aux = pSQueue_allocQueue();
+    aux = pSQueue_allocQueue(p_nodes);
     if(aux != NULL){
         aux->max = p_max;
         aux->n = 0;
         aux->h = NULL;  
         aux->t = NULL;
+        aux->nodes = p_nodes;
+        aux->spare = NULL;
+        aux->nSpare = 0;
         //Locking system setup
         if (pthread_mutex_init(&(aux->lock), NULL) != 0 || 
             pthread_cond_init(&(aux->cv_empty), NULL) != 0 ||
@@ -66,10 +100,7 @@ SQueue * SQueue_init(long p_max){
     }
     return aux;
 err:
-    if(aux != NULL){
-        if(aux->h != NULL) free(aux->h);
-        free(aux);
-    }
+    if(aux != NULL && p_nodes == NULL) free(aux);
     return NULL;
 }
 /**
@@ -92,13 +123,18 @@ int SQueue_deleteQueue(SQueue * p_q, funDealloc p_f){
         aux = p_q->h;
         p_q->h= p_q->h->next;
         //Deallocate Node
-        pSQueue_freeNode(aux, p_f);
+        pSQueue_freeNode(p_q, aux, p_f);
+    }
+    while (p_q->spare != NULL) {
+        aux = p_q->spare;
+        p_q->spare = aux->next;
+        Pool_free(p_q->nodes, aux);
     }
     pSQueue_Unlock(p_q);
     pthread_mutex_destroy(&p_q->lock);
     pthread_cond_destroy(&p_q->cv_empty);
     pthread_cond_destroy(&p_q->cv_full);
-    free(p_q);
+    if(p_q->nodes == NULL) free(p_q); //Otherwise it belongs to the arena of the pool
     return 1;
 }
 
@@ -147,13 +183,37 @@ int SQueue_pushWait(SQueue * p_q, void * p_new){
     return res_fun;
 }
 
+/**
+ * @brief Add p_n elements in queue p_q with a single lock acquisition, only if there is room for all of them.
+ *        Elements are added in tail in the same order of p_news.
+ * 
+ * @param p_q Requirements: p_q != NULL and must refer to a SQueue object created with #SQueue_init. Target SQueue.
+ * @param p_news Requirements: p_news != NULL if p_n > 0. Array of new data to add.
+ * @param p_n number of elements in p_news.
+ * @return int: result code:
+ *  1: good
+ *  -1: invalid pointer p_q
+ *  -2: p_q has no room for p_n elements (nothing is added)
+ *  -3: an error occurred during Node creation (only the elements before the failure are added)
+ */
+int SQueue_pushAll(SQueue * p_q, void ** p_news, long p_n){
+    int res_fun = 1;
+    if(p_q == NULL) return -1;
+    pSQueue_Lock(p_q);
+    if(p_q->max > 0 && p_q->n + p_n > p_q->max) res_fun = -2;
+    for(long i = 0; i < p_n && res_fun == 1; i++) res_fun = pSQueue_push(p_q, p_news[i]);
+    if(p_n > 0 && res_fun != -2) pSQueue_BroadcastEmpty(p_q);
+    pSQueue_Unlock(p_q);
+    return res_fun;
+}
+
 static int pSQueue_push(SQueue * p_q, void * p_new){
     int res_fun = 0;
     if(pSQueue_isFull(p_q) == 1)//Is full
         res_fun = -2;
     else{
         //Init new node
-        Node * aux = pSQueue_allocateNode();
+        Node * aux = pSQueue_allocateNode(p_q);
         if(aux == NULL) return -3;
         aux->data = p_new;
         aux->next = NULL;
@@ -218,6 +278,26 @@ int SQueue_popWait(SQueue * p_q, void ** p_removed){
     return res_fun;    
 }
 
+/**
+ * @brief Remove up to p_max elements from p_q with a single lock acquisition. 
+ *        Removed elements are placed in p_removed from the head one.
+ * 
+ * @param p_q Requirements: p_q != NULL and must refer to a SQueue object created with #SQueue_init. Target SQueue.
+ * @param p_removed Requirements: p_removed != NULL and with room for p_max elements.
+ * @param p_max maximum number of elements to remove.
+ * @return long: number of removed elements (>=0), -1 if p_q == NULL, -3 if p_removed == NULL.
+ */
+long SQueue_popAll(SQueue * p_q, void ** p_removed, long p_max){
+    long n = 0;
+    if(p_q == NULL) return -1;
+    if(p_removed == NULL) return -3;
+    pSQueue_Lock(p_q);
+    while (n < p_max && pSQueue_pop(p_q, &p_removed[n]) == 1) n++;
+    if(n > 0) pSQueue_BroadcastFull(p_q);
+    pSQueue_Unlock(p_q);
+    return n;
+}
+
 static int pSQueue_pop(SQueue * p_q, void ** p_removed){
     int res_fun = 0;
     if(p_removed == NULL) return -3;
@@ -236,7 +316,7 @@ static int pSQueue_pop(SQueue * p_q, void ** p_removed){
         }
         //Free memory allocated only for Node struct.
         //Data contained inside node is not deallocated.
-        pSQueue_freeNode(aux, NULL);
+        pSQueue_freeNode(p_q, aux, NULL);
         p_q->n--;
         res_fun = 1;
     }
@@ -386,21 +466,21 @@ int SQueue_remove(SQueue * p_q, void * p_target, funCmp p_funCmp){
         if(cur != NULL){//Target found
             p_q->n--;
             if(p_q->h == p_q->t){//Only one element in queue
-                pSQueue_freeNode(cur, NULL);
+                pSQueue_freeNode(p_q, cur, NULL);
                 p_q->h = NULL;
                 p_q->t = NULL;
             }else{//At least two elements in queue
                 if(cur == p_q->h){//Target in head
                     aux = cur->next;
-                    pSQueue_freeNode(cur, NULL);
+                    pSQueue_freeNode(p_q, cur, NULL);
                     p_q->h = aux;
                 }else if(cur == p_q->t){//Target in tail
-                    pSQueue_freeNode(cur, NULL);
+                    pSQueue_freeNode(p_q, cur, NULL);
                     p_q->t = prev;
                     p_q->t->next = NULL;
                 }else{//Target in the middle of the queue (at least 3 elements)
                     prev->next = cur->next;
-                    pSQueue_freeNode(cur, NULL);
+                    pSQueue_freeNode(p_q, cur, NULL);
                 }
             }
         }
@@ -445,21 +525,21 @@ int SQueue_removePos(SQueue * p_q, int p_pos, void ** p_removed) {
         *p_removed = cur->data;
         p_q->n--;
         if(p_q->h == p_q->t){//Only one element in queue
-            pSQueue_freeNode(cur, NULL);
+            pSQueue_freeNode(p_q, cur, NULL);
             p_q->h = NULL;
             p_q->t = NULL;
         }else{//At least two elements in queue
             if(cur == p_q->h){//Target in head
                 aux = cur->next;
-                pSQueue_freeNode(cur, NULL);
+                pSQueue_freeNode(p_q, cur, NULL);
                 p_q->h = aux;
             }else if(cur == p_q->t){//Target in tail
-                pSQueue_freeNode(cur, NULL);
+                pSQueue_freeNode(p_q, cur, NULL);
                 p_q->t = prev;
                 p_q->t->next = NULL;
             }else{//Target in the middle of the queue (at least 3 elements)
                 prev->next = cur->next;
-                pSQueue_freeNode(cur, NULL);
+                pSQueue_freeNode(p_q, cur, NULL);
             }
         }
 
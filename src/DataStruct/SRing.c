@@ -0,0 +1,72 @@
+/**
+ * @file SRing.c
+ * @brief   Single producer, single consumer ring of fixed-size messages.
+ *          The producer owns tail and the consumer owns head: each one only reads the other index, so no lock
+ *          is needed. A message is published by the release store of tail and acquired by the consumer load.
+ */
+#include <SRing.h>
+#include <string.h>
+
+/**
+ * @brief Get the bytes needed by a ring.
+ *
+ * @param p_cap number of slots (power of 2).
+ * @param p_msgSize size of each message.
+ * @return size_t: bytes to pass to #SRing_init.
+ */
+size_t SRing_size(unsigned long p_cap, size_t p_msgSize) {
+    size_t size = sizeof(SRing) + p_cap * p_msgSize;
+    return (size + SRING_CACHE_LINE - 1) & ~(size_t)(SRING_CACHE_LINE - 1);
+}
+
+/**
+ * @brief Init an empty ring in p_mem.
+ *
+ * @param p_mem Requirements: at least #SRing_size bytes, SRING_CACHE_LINE aligned (for example obtained with mmap).
+ * @param p_cap number of slots (power of 2).
+ * @param p_msgSize size of each message.
+ * @return SRing*: the ring, NULL if p_cap is not a power of 2.
+ */
+SRing * SRing_init(void * p_mem, unsigned long p_cap, size_t p_msgSize) {
+    SRing * aux = (SRing *) p_mem;
+    if(p_cap == 0 || (p_cap & (p_cap - 1)) != 0) return NULL;
+    atomic_init(&aux->head, 0);
+    atomic_init(&aux->tail, 0);
+    aux->cap = p_cap;
+    aux->msgSize = p_msgSize;
+    return aux;
+}
+
+/**
+ * @brief Copy p_msg in the ring. Only one thread (or process) may push in a ring.
+ *
+ * @param p_r Requirements: p_r != NULL and must refer to a ring created with #SRing_init.
+ * @param p_msg message of p_r->msgSize bytes.
+ * @return int: result code:
+ * 1: pushed
+ * 0: the ring is full
+ */
+int SRing_push(SRing * p_r, const void * p_msg) {
+    unsigned long tail = atomic_load_explicit(&p_r->tail, memory_order_relaxed);
+    if(tail - atomic_load_explicit(&p_r->head, memory_order_acquire) == p_r->cap) return 0;
+    memcpy(p_r->data + (tail & (p_r->cap - 1)) * p_r->msgSize, p_msg, p_r->msgSize);
+    atomic_store_explicit(&p_r->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+/**
+ * @brief Copy the oldest message of the ring in p_msg. Only one thread (or process) may pop from a ring.
+ *
+ * @param p_r Requirements: p_r != NULL and must refer to a ring created with #SRing_init.
+ * @param p_msg where the message is copied (p_r->msgSize bytes).
+ * @return int: result code:
+ * 1: popped
+ * 0: the ring is empty
+ */
+int SRing_pop(SRing * p_r, void * p_msg) {
+    unsigned long head = atomic_load_explicit(&p_r->head, memory_order_relaxed);
+    if(head == atomic_load_explicit(&p_r->tail, memory_order_acquire)) return 0;
+    memcpy(p_msg, p_r->data + (head & (p_r->cap - 1)) * p_r->msgSize, p_r->msgSize);
+    atomic_store_explicit(&p_r->head, head + 1, memory_order_release);
+    return 1;
+}
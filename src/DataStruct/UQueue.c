@@ -0,0 +1,175 @@
+/**
+ * @file UQueue.c
+ * @brief   Queues of users linked through arrays indexed by user, so that a user waiting in the middle of a queue
+ *          can leave it in O(1) (queue jockeying) and no node is allocated.
+ */
+#include <UQueue.h>
+#include <utilities.h>
+
+/**
+ * @brief Create the links of a group of queues for p_cap users, allocated in p_a. No user is in a queue.
+ *
+ * @return UQueueLinks*: the links, NULL if the allocation failed.
+ */
+UQueueLinks * UQueueLinks_init(Arena * p_a, int p_cap) {
+    UQueueLinks * aux = NULL;
+    if((aux = Arena_alloc(p_a, sizeof(UQueueLinks))) == NULL ||
+        (aux->next = Arena_alloc(p_a, p_cap * sizeof(int32_t))) == NULL ||
+        (aux->prev = Arena_alloc(p_a, p_cap * sizeof(int32_t))) == NULL ||
+        (aux->queue = Arena_alloc(p_a, p_cap * sizeof(_Atomic int32_t))) == NULL) return NULL;
+    aux->cap = p_cap;
+    aux->visits = NULL;
+    for(int i = 0; i < p_cap; i++) {
+        aux->next[i] = aux->prev[i] = UQUEUE_NONE;
+        atomic_init(&aux->queue[i], UQUEUE_NONE);
+    }
+    return aux;
+}
+
+/**
+ * @brief Init an empty queue.
+ *
+ * @param p_q queue to init.
+ * @param p_id number of the queue, unique in the group of p_links.
+ * @param p_links links of the group.
+ * @return int: 1 good, 0 the lock can't be created
+ */
+int UQueue_init(UQueue * p_q, int p_id, UQueueLinks * p_links) {
+    if(pthread_mutex_init(&p_q->lock, NULL) != 0) return 0;
+    p_q->id = p_id;
+    p_q->head = p_q->tail = UQUEUE_NONE;
+    atomic_init(&p_q->n, 0);
+    p_q->links = p_links;
+    return 1;
+}
+
+void UQueue_delete(UQueue * p_q) {
+    pthread_mutex_destroy(&p_q->lock);
+}
+
+void UQueue_Lock(UQueue * p_q) {Lock(&p_q->lock);}
+void UQueue_Unlock(UQueue * p_q) {Unlock(&p_q->lock);}
+
+/**
+ * @brief Add p_u at the tail of p_q (counted in visits).
+ *
+ * @param p_u Requirements: user not in a queue of the group.
+ */
+void UQueue_push(UQueue * p_q, int p_u) {
+    UQueueLinks * l = p_q->links;
+    UQueue_Lock(p_q);
+    atomic_store_explicit(&l->queue[p_u], p_q->id, memory_order_relaxed);
+    if(l->visits != NULL) l->visits[p_u]++;
+    l->next[p_u] = UQUEUE_NONE;
+    l->prev[p_u] = p_q->tail;
+    if(p_q->tail == UQUEUE_NONE) p_q->head = p_u;
+    else l->next[p_q->tail] = p_u;
+    p_q->tail = p_u;
+    atomic_fetch_add_explicit(&p_q->n, 1, memory_order_relaxed);
+    UQueue_Unlock(p_q);
+}
+
+/**
+ * @brief Remove p_u from p_q, whatever its position (lock of p_q held).
+ *
+ * @param p_u Requirements: user in p_q.
+ */
+void UQueue_removeLocked(UQueue * p_q, int p_u) {
+    UQueueLinks * l = p_q->links;
+    if(l->prev[p_u] == UQUEUE_NONE) p_q->head = l->next[p_u];
+    else l->next[l->prev[p_u]] = l->next[p_u];
+    if(l->next[p_u] == UQUEUE_NONE) p_q->tail = l->prev[p_u];
+    else l->prev[l->next[p_u]] = l->prev[p_u];
+    l->next[p_u] = l->prev[p_u] = UQUEUE_NONE;
+    atomic_store_explicit(&l->queue[p_u], UQUEUE_NONE, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&p_q->n, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Remove the user at the head of p_q.
+ *
+ * @param p_u where the user is returned.
+ * @return int: 1 a user has been removed, 0 the queue is empty
+ */
+int UQueue_pop(UQueue * p_q, int * p_u) {
+    int res = 0;
+    UQueue_Lock(p_q);
+    if(p_q->head != UQUEUE_NONE) {
+        *p_u = p_q->head;
+        UQueue_removeLocked(p_q, p_q->head);
+        res = 1;
+    }
+    UQueue_Unlock(p_q);
+    return res;
+}
+
+/**
+ * @brief Remove p_u from p_q in O(1), whatever its position.
+ *
+ * @return int: 1 removed, 0 p_u is not in p_q (for example it has been popped in the meantime)
+ */
+int UQueue_remove(UQueue * p_q, int p_u) {
+    int res = 0;
+    UQueue_Lock(p_q);
+    if(atomic_load_explicit(&p_q->links->queue[p_u], memory_order_relaxed) == p_q->id) {
+        UQueue_removeLocked(p_q, p_u);
+        res = 1;
+    }
+    UQueue_Unlock(p_q);
+    return res;
+}
+
+/**
+ * @brief Detach all the users of p_q with a single splice: they stay linked in the same order through next and prev,
+ *        starting from p_first, and they are no longer in p_q (#UQueue_remove on p_q fails) until pushed again
+ *        (see #UQueue_pushChain).
+ *
+ * @param p_first where the first user is returned (#UQUEUE_NONE if the queue is empty).
+ * @return int: number of users detached
+ */
+int UQueue_detach(UQueue * p_q, int * p_first) {
+    UQueueLinks * l = p_q->links;
+    int n = 0;
+    UQueue_Lock(p_q);
+    *p_first = p_q->head;
+    for(int u = p_q->head; u != UQUEUE_NONE; u = l->next[u]) atomic_store_explicit(&l->queue[u], UQUEUE_NONE, memory_order_relaxed);
+    p_q->head = p_q->tail = UQUEUE_NONE;
+    n = atomic_exchange_explicit(&p_q->n, 0, memory_order_relaxed);
+    UQueue_Unlock(p_q);
+    return n;
+}
+
+/**
+ * @brief Append to p_q, with a single lock, the users linked from p_first to p_last (in this order, each counted in visits).
+ *
+ * @param p_first Requirements: users of the chain not in a queue of the group, next of p_last is #UQUEUE_NONE.
+ * @return int: number of users added
+ */
+int UQueue_pushChain(UQueue * p_q, int p_first, int p_last) {
+    UQueueLinks * l = p_q->links;
+    int n = 0;
+    UQueue_Lock(p_q);
+    for(int u = p_first; u != UQUEUE_NONE; u = l->next[u]) {
+        atomic_store_explicit(&l->queue[u], p_q->id, memory_order_relaxed);
+        if(l->visits != NULL) l->visits[u]++;
+        n++;
+    }
+    l->prev[p_first] = p_q->tail;
+    if(p_q->tail == UQUEUE_NONE) p_q->head = p_first;
+    else l->next[p_q->tail] = p_first;
+    p_q->tail = p_last;
+    atomic_fetch_add_explicit(&p_q->n, n, memory_order_relaxed);
+    UQueue_Unlock(p_q);
+    return n;
+}
+
+/**
+ * @brief Number of users in p_q. It is read without lock, so it can be already old when it is returned.
+ */
+int UQueue_dim(UQueue * p_q) {
+    return atomic_load_explicit(&p_q->n, memory_order_relaxed);
+}
+
+int UQueue_isEmpty(UQueue * p_q) {
+    return atomic_load(&p_q->n) == 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file WSDeque.c
+ * @brief   Chase-Lev work-stealing deque, with the C11 memory orders of Le, Pop, Cohen and Zappa Nardelli
+ *          ("Correct and Efficient Work-Stealing for Weak Memory Models", PPoPP 2013).
+ *          Items are published by the release store of bottom, so a thief which took an item sees all the
+ *          changes made by the owner before pushing it. Owner and thieves compete with a compare and swap on top
+ *          only for the last item.
+ */
+#include <WSDeque.h>
+#include <stdlib.h>
+#include <utilities.h>
+
+//Private functions
+static WSArray * pWSArray_new(long p_cap, WSArray * p_prev) {
+    WSArray * aux = NULL;
+    if((aux = malloc(sizeof(WSArray) + p_cap * sizeof(void *))) == NULL) return NULL;
+    aux->cap = p_cap;
+    aux->prev = p_prev;
+    return aux;
+}
+
+/**
+ * @brief Create an empty deque.
+ *
+ * @param p_d Requirements: p_d != NULL. Deque to initialize.
+ * @param p_cap initial capacity, rounded up to a power of 2. The deque grows when it is full.
+ * @return int: result code:
+ * 1: good
+ * 0: memory allocation failed
+ */
+int WSDeque_init(WSDeque * p_d, long p_cap) {
+    long cap = 16;
+    WSArray * a = NULL;
+    while (cap < p_cap) cap <<= 1;
+    if((a = pWSArray_new(cap, NULL)) == NULL) {
+        ERR_SYS_MSG("An error occurred during memory allocation.");
+        return 0;
+    }
+    atomic_init(&p_d->array, a);
+    atomic_init(&p_d->top, 0);
+    atomic_init(&p_d->bottom, 0);
+    return 1;
+}
+
+/**
+ * @brief Dealloc the arrays of p_d. Items still in the deque are not touched.
+ *
+ * @warning No other thread may use p_d.
+ */
+void WSDeque_delete(WSDeque * p_d) {
+    WSArray * a = atomic_load(&p_d->array), * prev = NULL;
+    for(; a != NULL; a = prev) {
+        prev = a->prev;
+        free(a);
+    }
+    atomic_store(&p_d->array, NULL);
+}
+
+/**
+ * @brief Push p_x at the bottom (owner only). When the array is full it is doubled.
+ *
+ * @return int: result code:
+ * 1: good
+ * 0: memory allocation failed (p_x not pushed)
+ */
+int WSDeque_push(WSDeque * p_d, void * p_x) {
+    long b = atomic_load_explicit(&p_d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&p_d->top, memory_order_acquire);
+    WSArray * a = atomic_load_explicit(&p_d->array, memory_order_relaxed), * grown = NULL;
+    if(b - t > a->cap - 1) {
+        if((grown = pWSArray_new(a->cap * 2, a)) == NULL) return 0;
+        for(long i = t; i < b; i++)
+            atomic_store_explicit(&grown->items[i & (grown->cap - 1)],
+                atomic_load_explicit(&a->items[i & (a->cap - 1)], memory_order_relaxed), memory_order_relaxed);
+        atomic_store_explicit(&p_d->array, grown, memory_order_release);
+        a = grown;
+    }
+    atomic_store_explicit(&a->items[b & (a->cap - 1)], p_x, memory_order_relaxed);
+    atomic_store_explicit(&p_d->bottom, b + 1, memory_order_release);
+    return 1;
+}
+
+/**
+ * @brief Pop the newest item at the bottom (owner only).
+ *
+ * @return void *: item, NULL if the deque is empty
+ */
+void * WSDeque_pop(WSDeque * p_d) {
+    long b = atomic_load_explicit(&p_d->bottom, memory_order_relaxed) - 1;
+    WSArray * a = atomic_load_explicit(&p_d->array, memory_order_relaxed);
+    long t = 0;
+    void * x = NULL;
+    atomic_store_explicit(&p_d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    t = atomic_load_explicit(&p_d->top, memory_order_relaxed);
+    if(t > b) {
+        //Empty
+        atomic_store_explicit(&p_d->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    x = atomic_load_explicit(&a->items[b & (a->cap - 1)], memory_order_relaxed);
+    if(t == b) {
+        //Last item: a thief may be taking it too
+        if(!atomic_compare_exchange_strong_explicit(&p_d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+            x = NULL;
+        atomic_store_explicit(&p_d->bottom, b + 1, memory_order_relaxed);
+    }
+    return x;
+}
+
+/**
+ * @brief Steal the oldest item at the top (any thread).
+ *
+ * @return void *: item, NULL if the deque is empty, #WSDEQUE_ABORT if another thread took the item first
+ */
+void * WSDeque_steal(WSDeque * p_d) {
+    long t = atomic_load_explicit(&p_d->top, memory_order_acquire);
+    long b = 0;
+    WSArray * a = NULL;
+    void * x = NULL;
+    atomic_thread_fence(memory_order_seq_cst);
+    b = atomic_load_explicit(&p_d->bottom, memory_order_acquire);
+    if(t >= b) return NULL;
+    a = atomic_load_explicit(&p_d->array, memory_order_acquire);
+    x = atomic_load_explicit(&a->items[t & (a->cap - 1)], memory_order_relaxed);
+    if(!atomic_compare_exchange_strong_explicit(&p_d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+        return WSDEQUE_ABORT;
+    return x;
+}
+
+/**
+ * @brief Number of items in the deque (a hint when other threads are using it).
+ */
+long WSDeque_dim(WSDeque * p_d) {
+    long b = atomic_load_explicit(&p_d->bottom, memory_order_acquire);
+    long t = atomic_load_explicit(&p_d->top, memory_order_acquire);
+    return b > t ? b - t : 0;
+}
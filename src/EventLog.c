@@ -0,0 +1,304 @@
+/**
+ * @file EventLog.c
+ * @brief   Compact binary recorder of simulation state transitions.
+ *
+ *          Each thread appends fixed-size events (#EventRec) to its own buffer, without any locking.
+ *          When the buffer is full, or when the thread terminates, the buffer is flushed to the shared
+ *          log file as a chunk (#EventChunk). Chunks of different threads are interleaved in the file:
+ *          #EventLog_load decodes them and merges all events by timestamp.
+ */
+#include <EventLog.h>
+#include <utilities.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+/**
+ * @brief Events recorded by a single thread and not yet flushed.
+ */
+typedef struct EventBuf {
+    uint32_t tid; /**< recording thread */
+    uint32_t n; /**< number of events in recs */
+    uint64_t base; /**< absolute timestamp of recs[0] */
+    uint64_t last; /**< absolute timestamp of last event */
+    EventRec recs[EVENT_BUF_LEN]; /**< buffered events */
+} EventBuf;
+
+int g_eventLogOn = 0; /**< 1 if events must be recorded. Set before starting any thread. */
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER; /**< protects g_f and g_nextTid */
+static FILE * g_f = NULL; /**< log file */
+static uint32_t g_nextTid = 0; /**< next id given to a recording thread */
+static pthread_key_t g_key; /**< used to flush the buffer of a thread on its termination */
+static _Thread_local EventBuf * t_buf = NULL; /**< buffer of the current thread */
+
+static const char * g_typeNames[EV_TYPES] = {
+    "skip", "shopping", "queue", "auth", "change", "service", "served", "exit", "desk_open", "desk_close",
+    "begin", "end", "thread_name"
+};
+static const char * g_phaseNames[PH_TYPES] = {
+    "startup", "shutdown", "idle", "shopping", "move", "serve", "drain", "notify sleep", "decide", "exit", "lock wait"
+};
+static const char * g_roleNames[TH_TYPES] = {
+    "Market", "Director", "Director auth", "CashDesk", "CashDesk notifier", "User", "Worker", "Director jockey"
+};
+
+//Private functions
+static uint64_t pNowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void pEventLog_flush(EventBuf * p_b) {
+    EventChunk h;
+    if(p_b->n == 0) return;
+    h.magic = EVENT_LOG_MAGIC;
+    h.tid = p_b->tid;
+    h.base = p_b->base;
+    h.count = p_b->n;
+    h.pad = 0;
+    Lock(&g_lock);
+    if(g_f != NULL) {
+        if(fwrite(&h, sizeof(h), 1, g_f) != 1 || fwrite(p_b->recs, sizeof(EventRec), p_b->n, g_f) != p_b->n)
+            ERR_SYS_MSG("An error occurred writing the event log.\n");
+    }
+    Unlock(&g_lock);
+    p_b->n = 0;
+}
+
+static void pEventLog_threadEnd(void * p_arg) {
+    EventBuf * b = (EventBuf *) p_arg;
+    pEventLog_flush(b);
+    free(b);
+}
+
+static EventBuf * pEventLog_getBuf() {
+    if(t_buf != NULL) return t_buf;
+    if((t_buf = malloc(sizeof(EventBuf))) == NULL)
+        ERR_SYS_QUIT("An error occurred during event buffer allocation.\n");
+    t_buf->n = 0;
+    Lock(&g_lock);
+    t_buf->tid = g_nextTid++;
+    Unlock(&g_lock);
+    if(pthread_setspecific(g_key, t_buf) != 0) ERR_QUIT("An error occurred during event buffer registration.\n");
+    return t_buf;
+}
+
+static int pEventCompare(const void * p_1, const void * p_2) {
+    const Event * e1 = (const Event *) p_1;
+    const Event * e2 = (const Event *) p_2;
+    if(e1->ts != e2->ts) return e1->ts < e2->ts ? -1:1;
+    if(e1->tid != e2->tid) return e1->tid < e2->tid ? -1:1;
+    return e1->seq < e2->seq ? -1:(e1->seq > e2->seq ? 1:0);
+}
+
+/**
+ * @brief Start recording events on file p_path. The log is shared by the whole process: it can be open only once
+ *        at a time, and it is closed by whoever opened it.
+ * @warning Must be called before any thread which records events is started.
+ *
+ * @param p_path path of the event log file (overwritten).
+ * @return int: result code:
+ * 1: recording enabled
+ * 0: an error occurred or the log is already open (recording unchanged)
+ */
+int EventLog_open(const char * p_path) {
+    if(g_eventLogOn) {
+        ERR_MSG("The event log is already open: only one store can set EVENT_LOG.\n");
+        return 0;
+    }
+    if((g_f = fopen(p_path, "wb")) == NULL) {
+        ERR_SYS_MSG("Unable to open event log %s.\n", p_path);
+        return 0;
+    }
+    if(pthread_key_create(&g_key, pEventLog_threadEnd) != 0) {
+        ERR_MSG("An error occurred during event log setup.\n");
+        fclose(g_f);
+        g_f = NULL;
+        return 0;
+    }
+    g_eventLogOn = 1;
+    return 1;
+}
+
+/**
+ * @brief Flush events of the calling thread and close the log file.
+ * @warning Other threads which recorded events must be already terminated.
+ */
+void EventLog_close(void) {
+    if(!g_eventLogOn) return;
+    if(t_buf != NULL) {
+        pEventLog_flush(t_buf);
+        pthread_setspecific(g_key, NULL);
+        free(t_buf);
+        t_buf = NULL;
+    }
+    g_eventLogOn = 0;
+    Lock(&g_lock);
+    if(fclose(g_f) != 0) ERR_SYS_MSG("An error occurred closing the event log.\n");
+    g_f = NULL;
+    Unlock(&g_lock);
+    pthread_key_delete(g_key);
+}
+
+/**
+ * @brief Append an event to the buffer of the calling thread. Use #EVENT_RECORD instead of calling it directly.
+ *
+ * @param p_type event type
+ * @param p_id user or desk id
+ * @param p_arg first argument (see #EventType)
+ * @param p_arg2 second argument (see #EventType). Must be in [0; 2^24).
+ */
+void EventLog_record(EventType p_type, int p_id, int p_arg, int p_arg2) {
+    EventBuf * b = pEventLog_getBuf();
+    uint64_t now = pNowNs();
+    uint64_t delta = 0;
+    EventRec * r = NULL;
+
+    //A too big delta needs an extra EV_SKIP event
+    if(b->n > 0 && now - b->last > UINT32_MAX && b->n + 1 >= EVENT_BUF_LEN) pEventLog_flush(b);
+    if(b->n == 0) {
+        b->base = now;
+        b->last = now;
+    }
+    delta = now - b->last;
+    if(delta > UINT32_MAX) {
+        r = &b->recs[b->n++];
+        r->delta = (uint32_t) delta;
+        r->info = EV_SKIP;
+        r->id = 0;
+        r->arg = (int32_t)(delta >> 32);
+        delta = 0;
+    }
+    r = &b->recs[b->n++];
+    r->delta = (uint32_t) delta;
+    r->info = (uint32_t) p_type | ((uint32_t) p_arg2 << 8);
+    r->id = p_id;
+    r->arg = p_arg;
+    b->last = now;
+    if(b->n == EVENT_BUF_LEN) pEventLog_flush(b);
+}
+
+/**
+ * @brief Flush events buffered by the calling thread.
+ */
+void EventLog_flushThread(void) {
+    if(g_eventLogOn && t_buf != NULL) pEventLog_flush(t_buf);
+}
+
+/**
+ * @brief Load an event log and merge events of all threads by timestamp.
+ *
+ * @param p_path path of the event log file.
+ * @param p_events where the array of decoded events is placed (to free with free()).
+ * @param p_n where the number of decoded events is placed.
+ * @return int: result code:
+ * 1: good
+ * 0: the file can't be read or it is not a valid event log
+ */
+int EventLog_load(const char * p_path, Event ** p_events, size_t * p_n) {
+    FILE * f = NULL;
+    EventChunk h;
+    EventRec r;
+    Event * events = NULL, * aux = NULL;
+    size_t n = 0, cap = 0;
+    uint64_t ts = 0;
+
+    if((f = fopen(p_path, "rb")) == NULL) {
+        ERR_SYS_MSG("Unable to open event log %s.\n", p_path);
+        return 0;
+    }
+    while (fread(&h, sizeof(h), 1, f) == 1) {
+        if(h.magic != EVENT_LOG_MAGIC) {
+            ERR_MSG("File %s is not a valid event log.\n", p_path);
+            goto err;
+        }
+        ts = h.base;
+        for(uint32_t i = 0; i < h.count; i++) {
+            if(fread(&r, sizeof(r), 1, f) != 1) {
+                ERR_MSG("Event log %s is truncated.\n", p_path);
+                goto err;
+            }
+            ts += r.delta;
+            if((r.info & 0xFF) == EV_SKIP) {
+                ts += (uint64_t)(uint32_t) r.arg << 32;
+                continue;
+            }
+            if(n == cap) {
+                cap = cap == 0 ? EVENT_BUF_LEN : cap * 2;
+                if((aux = realloc(events, cap * sizeof(Event))) == NULL) {
+                    ERR_SYS_MSG("An error occurred during memory allocation.");
+                    goto err;
+                }
+                events = aux;
+            }
+            events[n].ts = ts;
+            events[n].tid = h.tid;
+            events[n].seq = n;
+            events[n].type = (EventType)(r.info & 0xFF);
+            events[n].id = r.id;
+            events[n].arg = r.arg;
+            events[n].arg2 = (int)(r.info >> 8);
+            n++;
+        }
+    }
+    fclose(f);
+    qsort(events, n, sizeof(Event), pEventCompare);
+    *p_events = events;
+    *p_n = n;
+    return 1;
+err:
+    fclose(f);
+    free(events);
+    return 0;
+}
+
+/**
+ * @brief Get a printable name of an event type.
+ *
+ * @param p_type event type
+ * @return const char*: name of p_type
+ */
+const char * EventLog_typeName(EventType p_type) {
+    return (p_type >= 0 && p_type < EV_TYPES) ? g_typeNames[p_type] : "unknown";
+}
+
+/**
+ * @brief Get a printable name of a phase.
+ *
+ * @param p_phase phase
+ * @return const char*: name of p_phase
+ */
+const char * EventLog_phaseName(TracePhase p_phase) {
+    return (p_phase >= 0 && p_phase < PH_TYPES) ? g_phaseNames[p_phase] : "unknown";
+}
+
+/**
+ * @brief Build the name of a thread from its role, like "CashDesk 3".
+ *
+ * @param p_role thread role
+ * @param p_id thread index within its role (<0: no index)
+ * @param p_buff where the name is placed
+ * @param p_size size of p_buff
+ */
+void EventLog_threadName(TraceRole p_role, int p_id, char * p_buff, size_t p_size) {
+    const char * role = (p_role >= 0 && p_role < TH_TYPES) ? g_roleNames[p_role] : "Thread";
+    if(p_id < 0) snprintf(p_buff, p_size, "%s", role);
+    else snprintf(p_buff, p_size, "%s %d", role, p_id);
+}
+
+/**
+ * @brief Lock p_lock. If the event log is enabled and the lock is contended, the wait is traced as #PH_LOCK_WAIT.
+ *
+ * @param p_lock lock to acquire
+ */
+void EventLog_lock(pthread_mutex_t * p_lock) {
+    if(g_eventLogOn && pthread_mutex_trylock(p_lock) == 0) return;
+    TRACE_BEGIN(PH_LOCK_WAIT);
+    Lock(p_lock);
+    TRACE_END(PH_LOCK_WAIT);
+}
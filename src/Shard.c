@@ -0,0 +1,301 @@
+/**
+ * @file Shard.c
+ * @brief   Sharded run of a chain: the coordinator forks one process for each shard and each shard owns the
+ *          stores listed at positions shard, shard + nShards, ... of the chain file (see #Chain_initShard).
+ *          Coordinator and shards only talk through two lock-free rings for each shard, placed in anonymous
+ *          shared memory mapped before the fork: control messages go to the shards, progress and results
+ *          come back and are merged by the coordinator in the chain log.
+ */
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS */
+
+#include <Shard.h>
+#include <Chain.h>
+#include <utilities.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/**
+ * @brief Shard side of the control channel.
+ */
+typedef struct ShardCtx {
+    Chain * chain; /**< stores owned by the shard */
+    SRing * control; /**< coordinator -> shard */
+    SRing * report; /**< shard -> coordinator */
+    atomic_int isJoined; /**< 1 when all the stores are closed */
+} ShardCtx;
+
+//Private functions
+/**
+ * @brief Push p_msg, waiting for room if the ring is full.
+ */
+static void pShard_send(SRing * p_r, int p_type, int p_store, const StoreStats * p_s) {
+    ShardMsg msg = {p_type, p_store, 0, 0, 0, 0};
+    if(p_s != NULL) {
+        msg.users = p_s->users;
+        msg.clients = p_s->clients;
+        msg.products = p_s->products;
+        msg.closures = p_s->closures;
+    }
+    while (SRing_push(p_r, &msg) != 1) waitRealMs(1);
+}
+
+/**
+ * @brief Apply a closing request received from the coordinator.
+ * @return int: 1 if p_msg was a closing request, 0 otherwise
+ */
+static int pShard_close(ShardCtx * p_ctx, const ShardMsg * p_msg) {
+    if(p_msg->type == SHARD_HUP) sig_hup = 1;
+    else if(p_msg->type == SHARD_QUIT) sig_quit = 1;
+    else return 0;
+    if(p_ctx->chain != NULL) Chain_Signal(p_ctx->chain);
+    return 1;
+}
+
+/**
+ * @brief Control thread of a shard: it applies closing requests and reports progress, until the stores are closed.
+ */
+static void * pShard_control(void * p_arg) {
+    ShardCtx * ctx = (ShardCtx *) p_arg;
+    ShardMsg msg;
+    StoreStats progress = {0, 0, 0, 0};
+    long elapsed = 0;
+    while (!atomic_load(&ctx->isJoined)) {
+        while (SRing_pop(ctx->control, &msg) == 1) pShard_close(ctx, &msg);
+        waitRealMs(SHARD_POLL_MS);
+        elapsed += SHARD_POLL_MS;
+        if(elapsed >= SHARD_PROGRESS_MS) {
+            elapsed = 0;
+            progress.users = 0;
+            for(int i = 0; i < ctx->chain->n; i++) {
+                Lock(&ctx->chain->stores[i]->lock_Logfile);
+                progress.users += ctx->chain->stores[i]->usersOut;
+                Unlock(&ctx->chain->stores[i]->lock_Logfile);
+            }
+            pShard_send(ctx->report, SHARD_PROGRESS, -1, &progress);
+        }
+    }
+    return (void *) NULL;
+}
+
+/**
+ * @brief Body of a shard process. It never returns.
+ */
+static void pShard_main(const char * p_chain, const char * p_log, int p_shard, int p_nShards, ShardLink * p_l) {
+    ShardCtx ctx;
+    ShardMsg msg;
+    StoreStats s;
+    pthread_t thControl;
+
+    ctx.control = p_l->control;
+    ctx.report = p_l->report;
+    atomic_init(&ctx.isJoined, 0);
+    if((ctx.chain = Chain_initShard(p_chain, p_log, p_shard, p_nShards, 1)) == NULL) {
+        pShard_send(ctx.report, SHARD_FAILED, -1, NULL);
+        exit(1);
+    }
+    pShard_send(ctx.report, SHARD_READY, ctx.chain->n, NULL);
+    //Wait the start of all the shards (a closing request received before is kept)
+    while (1) {
+        if(SRing_pop(ctx.control, &msg) != 1) waitRealMs(1);
+        else if(msg.type == SHARD_START) break;
+        else pShard_close(&ctx, &msg);
+    }
+    if(Chain_startThreads(ctx.chain) != 0)
+        ERR_QUIT("[Shard %d]: an error occurred during stores startup.", p_shard);
+    if(pthread_create(&thControl, NULL, pShard_control, &ctx) != 0)
+        ERR_QUIT("[Shard %d]: an error occurred during control thread creation.", p_shard);
+    if(Chain_joinThreads(ctx.chain) != 0)
+        ERR_QUIT("[Shard %d]: an error occurred during stores join.", p_shard);
+    atomic_store(&ctx.isJoined, 1);
+    if(pthread_join(thControl, NULL) != 0)
+        ERR_QUIT("[Shard %d]: an error occurred during control thread join.", p_shard);
+    //The control thread is over: this thread is the only producer of the report ring
+    for(int i = 0; i < ctx.chain->n; i++) {
+        Chain_storeStats(ctx.chain, i, &s);
+        pShard_send(ctx.report, SHARD_STORE, Chain_storeId(ctx.chain, i), &s);
+    }
+    pShard_send(ctx.report, SHARD_DONE, -1, NULL);
+    Chain_delete(ctx.chain);
+    exit(0);
+}
+
+/**
+ * @brief Send p_type to all the shards still running.
+ */
+static void pShard_broadcast(ShardLink * p_links, int p_n, int p_type) {
+    for(int i = 0; i < p_n; i++)
+        if(!p_links[i].isDone) pShard_send(p_links[i].control, p_type, -1, NULL);
+}
+
+/**
+ * @brief Read all the messages sent by shard p_i. Store results are written in p_log.
+ */
+static void pShard_receive(ShardLink * p_l, int p_i, FILE * p_log) {
+    ShardMsg msg;
+    while (SRing_pop(p_l->report, &msg) == 1) {
+        switch (msg.type) {
+            case SHARD_READY:
+                p_l->stores = msg.store;
+                break;
+            case SHARD_FAILED:
+                p_l->isFailed = 1;
+                break;
+            case SHARD_PROGRESS:
+                p_l->tot.users = msg.users;
+                break;
+            case SHARD_STORE:
+                fprintf(p_log, "[Store %d]: shard=%d users=%ld clients=%ld products=%ld closures=%ld\n", msg.store, p_i,
+                    (long) msg.users, (long) msg.clients, (long) msg.products, (long) msg.closures);
+                p_l->tot.clients += msg.clients;
+                p_l->tot.products += msg.products;
+                p_l->tot.closures += msg.closures;
+                p_l->closedUsers += msg.users;
+                break;
+            case SHARD_DONE:
+                p_l->tot.users = p_l->closedUsers;
+                p_l->isDone = 1;
+                break;
+            default:
+                ERR_MSG("[Coordinator]: unexpected message %d from shard %d.\n", msg.type, p_i);
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Check if shard p_l died without sending #SHARD_DONE. Its last messages are read first.
+ */
+static void pShard_checkExit(ShardLink * p_l, int p_i, FILE * p_log) {
+    int status = 0;
+    if(p_l->pid <= 0 || waitpid(p_l->pid, &status, WNOHANG) != p_l->pid) return;
+    p_l->pid = 0;
+    pShard_receive(p_l, p_i, p_log);
+    if(!p_l->isDone || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        ERR_MSG("[Coordinator]: shard %d terminated without completing its run.\n", p_i);
+        p_l->isDone = 1;
+        p_l->isFailed = 1;
+    }
+}
+
+/**
+ * @brief Run a chain split in p_nShards processes and merge their results in the chain log.
+ *        SIGHUP and SIGQUIT received by the coordinator are forwarded to all the shards.
+ *
+ * @param p_chain chain file: configuration file of each store, one per line (at least one store for each shard).
+ * @param p_log path of the chain log. Store i logs in <p_log>.<i>.
+ * @param p_nShards number of shard processes (>0).
+ * @param p_set SIGHUP and SIGQUIT, already blocked in the calling thread.
+ * @return int: result code:
+ * 1: all the shards completed their run
+ * 0: an error occurred (partial results are logged)
+ */
+int Shard_run(const char * p_chain, const char * p_log, int p_nShards, sigset_t * p_set) {
+    ShardLink * links = NULL;
+    FILE * f_log = NULL;
+    unsigned char * mem = NULL;
+    size_t ringSize = SRing_size(SHARD_RING_CAP, sizeof(ShardMsg));
+    size_t memSize = ringSize * 2 * p_nShards;
+    struct timespec timeout = {0, SHARD_POLL_MS * 1000000L};
+    ShardMsg tot = {0, 0, 0, 0, 0, 0};
+    int nReady = 0, nDone = 0, nStores = 0, sig = 0, res_fun = 1;
+    long elapsed = 0;
+
+    if(p_nShards <= 0) return 0;
+    //Ask here, before the fork: the shards overwrite the logs of their stores without asking
+    if(Chain_askOverwrite(p_chain, p_log) != 1) return 0;
+    if((links = calloc(p_nShards, sizeof(ShardLink))) == NULL) {
+        ERR_SYS_MSG("An error occurred during memory allocation.");
+        return 0;
+    }
+    if((mem = mmap(NULL, memSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+        ERR_SYS_MSG("Unable to map the shared memory of the shards.");
+        free(links);
+        return 0;
+    }
+    //Start the shards
+    fflush(stdout);
+    for(int i = 0; i < p_nShards; i++) {
+        links[i].control = SRing_init(mem + ringSize * 2 * i, SHARD_RING_CAP, sizeof(ShardMsg));
+        links[i].report = SRing_init(mem + ringSize * (2 * i + 1), SHARD_RING_CAP, sizeof(ShardMsg));
+        if((links[i].pid = fork()) == -1) {
+            ERR_SYS_MSG("Unable to create shard %d.", i);
+            links[i].isDone = links[i].isFailed = 1;
+            res_fun = 0;
+        } else if(links[i].pid == 0) {
+            pShard_main(p_chain, p_log, i, p_nShards, &links[i]);
+        }
+    }
+    if((f_log = fopen(p_log, "w")) == NULL)
+        ERR_SYS_MSG("Unable to open log file %s. Results are only printed.", p_log);
+    if(f_log == NULL) f_log = stdout;
+
+    //Start the stores when all shards are ready (or close them if a shard failed)
+    while (nReady < p_nShards) {
+        nReady = 0;
+        for(int i = 0; i < p_nShards; i++) {
+            pShard_receive(&links[i], i, f_log);
+            pShard_checkExit(&links[i], i, f_log);
+            nReady += links[i].stores > 0 || links[i].isDone ? 1:0;
+            res_fun = links[i].isFailed ? 0:res_fun;
+        }
+        if(nReady < p_nShards) waitRealMs(1);
+    }
+    if(res_fun != 1) {
+        printf("[Coordinator]: a shard failed, closing the others...\n");
+        pShard_broadcast(links, p_nShards, SHARD_QUIT);
+    }
+    pShard_broadcast(links, p_nShards, SHARD_START);
+
+    //Forward signals, merge results and report progress until all the shards are done
+    while (nDone < p_nShards) {
+        sig = sigtimedwait(p_set, NULL, &timeout);
+        if(sig == SIGHUP || sig == SIGQUIT) {
+            printf("[Coordinator]: received signal %s.\n", sig == SIGHUP ? "SIGHUP":"SIGQUIT");
+            pShard_broadcast(links, p_nShards, sig == SIGHUP ? SHARD_HUP : SHARD_QUIT);
+        }
+        nDone = 0;
+        tot.users = 0;
+        for(int i = 0; i < p_nShards; i++) {
+            pShard_receive(&links[i], i, f_log);
+            pShard_checkExit(&links[i], i, f_log);
+            nDone += links[i].isDone;
+            tot.users += links[i].tot.users;
+        }
+        elapsed += SHARD_POLL_MS;
+        if(elapsed >= SHARD_PROGRESS_MS) {
+            elapsed = 0;
+            printf("[Coordinator]: users=%ld shards_done=%d/%d\n", (long) tot.users, nDone, p_nShards);
+        }
+    }
+    for(int i = 0; i < p_nShards; i++) {
+        if(links[i].pid > 0 && waitpid(links[i].pid, NULL, 0) == -1)
+            ERR_SYS_MSG("[Coordinator]: unable to wait shard %d.", i);
+        res_fun = links[i].isFailed ? 0:res_fun;
+    }
+
+    //Merge per-shard statistics
+    tot.users = 0;
+    for(int i = 0; i < p_nShards; i++) {
+        fprintf(f_log, "[Shard %d]: stores=%d users=%ld clients=%ld products=%ld closures=%ld%s\n", i, links[i].stores,
+            (long) links[i].tot.users, (long) links[i].tot.clients, (long) links[i].tot.products, (long) links[i].tot.closures,
+            links[i].isFailed ? " failed" : "");
+        nStores += links[i].stores;
+        tot.users += links[i].tot.users;
+        tot.clients += links[i].tot.clients;
+        tot.products += links[i].tot.products;
+        tot.closures += links[i].tot.closures;
+    }
+    fprintf(f_log, "[Chain]: shards=%d stores=%d users=%ld clients=%ld products=%ld closures=%ld\n", p_nShards, nStores,
+        (long) tot.users, (long) tot.clients, (long) tot.products, (long) tot.closures);
+    printf("[Chain]: shards=%d stores=%d users=%ld clients=%ld products=%ld closures=%ld\n", p_nShards, nStores,
+        (long) tot.users, (long) tot.clients, (long) tot.products, (long) tot.closures);
+    if(f_log != stdout) fclose(f_log);
+    munmap(mem, memSize);
+    free(links);
+    return res_fun;
+}
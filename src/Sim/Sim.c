@@ -0,0 +1,739 @@
+/**
+ * @file Sim.c
+ * @brief   Virtual-time engine: stores are simulated as logical processes (see SimModel.c) which exchange
+ *          timestamped events, without threads for users or desks and without waiting real time.
+ *
+ *          The sequential engine keeps a single event list for all the processes.
+ *          The conservative engine splits the processes among worker threads, each one with its own event list.
+ *          Every event sent to another process is at least #Sim.lookahead in the future, so all the events in
+ *          [T; T + lookahead), where T is the first pending event, can be processed in parallel: workers
+ *          process their window, exchange the events sent to other workers and agree on the next T (two
+ *          barriers per window). Each process receives its events in the same order with both engines
+ *          (see #SimEvent_before), so the results are identical.
+ *
+ *          The optimistic engine (Time Warp) does not wait: each worker processes its events as soon as they
+ *          arrive. When a process receives an event earlier than the last one it processed (a straggler), it
+ *          rolls back: the saved state is restored (see #SIM_SAVE), the events it sent are cancelled with
+ *          anti-messages and the undone events are processed again. Workers periodically agree on the GVT,
+ *          the time of the earliest event still pending or in transit: nothing earlier can be rolled back, so
+ *          older history is discarded, and the run ends when the GVT reaches the end of the simulation.
+ */
+#include <Sim.h>
+#include <utilities.h>
+#include <Config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#define SIM_CANCEL_CAP 1024 /**< Initial capacity of the cancelled events sets */
+
+/**
+ * @brief Make room for one more element in a growing array.
+ */
+#define SIM_GROW(p_arr, p_n, p_cap) do { if((p_n) == (p_cap)) pSim_grow((void **) &(p_arr), &(p_cap), sizeof(*(p_arr))); } while(0)
+
+//Private functions
+/**
+ * @brief Read the configuration files listed in a chain file (same syntax as Chain.c).
+ * @return int: number of files, -1 if an error occurred.
+ */
+static int pSim_readChain(const char * p_chain, char *** p_confs) {
+    char line[MAX_DIM_STR_CONF];
+    char ** aux = NULL;
+    FILE * f = NULL;
+    size_t len = 0;
+    int n = 0, cap = 0, res = 1;
+    *p_confs = NULL;
+    if((f = fopen(p_chain, "r")) == NULL) {
+        ERR_SYS_MSG("Unable to open chain file %s. Check the path and try again.", p_chain);
+        return -1;
+    }
+    while (fgets(line, MAX_DIM_STR_CONF, f) != NULL) {
+        len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' ')) line[--len] = '\0';
+        if(len == 0 || strncmp(line, "//", 2) == 0) continue;
+        if(n == cap) {
+            cap = cap * 2 + 16;
+            if((aux = realloc(*p_confs, cap * sizeof(char *))) == NULL) {res = 0; break;}
+            *p_confs = aux;
+        }
+        if(((*p_confs)[n] = malloc(len + 1)) == NULL) {res = 0; break;}
+        strcpy((*p_confs)[n++], line);
+    }
+    fclose(f);
+    if(res) return n;
+    ERR_MSG("An error occurred during memory allocation.\n");
+    for(int i = 0; i < n; i++) free((*p_confs)[i]);
+    free(*p_confs);
+    *p_confs = NULL;
+    return -1;
+}
+
+/**
+ * @brief Process an event at its receiver.
+ */
+static void pSim_dispatch(Sim * p_s, const SimEvent * p_e) {
+    SimLP * lp = &p_s->lps[p_e->dst];
+    lp->now = p_e->t;
+    SimModel_handle(p_s, lp, p_e);
+}
+
+static void pSim_grow(void ** p_arr, long * p_cap, size_t p_size) {
+    void * aux = NULL;
+    if((aux = realloc(*p_arr, (*p_cap * 2 + 64) * p_size)) == NULL)
+        ERR_QUIT("An error occurred during memory allocation. (sim)");
+    *p_arr = aux;
+    *p_cap = *p_cap * 2 + 64;
+}
+
+static void pSim_outboxPush(SimOutbox * p_o, const SimEvent * p_e) {
+    SIM_GROW(p_o->ev, p_o->n, p_o->cap);
+    p_o->ev[p_o->n++] = *p_e;
+}
+
+/**
+ * @brief Schedule the first event of every process and close the accounts at the end of the run.
+ */
+static void pSim_start(Sim * p_s) {
+    for(int i = 0; i < p_s->nLPs; i++) SimModel_start(p_s, &p_s->lps[i]);
+    p_s->isStarted = 1;
+}
+static void pSim_finish(Sim * p_s, int64_t p_tStart) {
+    for(int i = 0; i < p_s->nLPs; i++) SimModel_finish(&p_s->lps[i], p_s->end);
+    p_s->wallTime = (double)(getCurrentTimeNs() - p_tStart) / 1e9;
+    p_s->isRun = 1;
+}
+
+/**
+ * @brief Worker of the conservative engine.
+ */
+static void * pSim_conservativeWorker(void * p_arg) {
+    SimWorker * w = (SimWorker *) p_arg;
+    Sim * s = w->sim;
+    SimEvent e;
+    SimTime t = 0, windowEnd = 0;
+    while (1) {
+        //Next window: all the workers compute the same value from the published times
+        t = SIM_TIME_MAX;
+        for(int i = 0; i < s->nWorkers; i++) if(s->workers[i].next < t) t = s->workers[i].next;
+        if(t >= s->end) break;
+        windowEnd = t + s->lookahead < s->end ? t + s->lookahead : s->end;
+        if(w->id == 0) s->windows++;
+
+        while (SimCalendar_next(&w->pending) < windowEnd) {
+            SimCalendar_pop(&w->pending, &e);
+            pSim_dispatch(s, &e);
+            w->events++;
+        }
+        pthread_barrier_wait(&s->barrier);
+        //Events sent by the other workers can't fall in the window just processed
+        for(int i = 0; i < s->nWorkers; i++) {
+            SimOutbox * o = &s->workers[i].out[w->id];
+            for(long j = 0; j < o->n; j++)
+                if(SimCalendar_push(&w->pending, &o->ev[j]) != 1) ERR_QUIT("An error occurred during memory allocation. (sim calendar)");
+            o->n = 0;
+        }
+        w->next = SimCalendar_next(&w->pending);
+        pthread_barrier_wait(&s->barrier);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Optimistic engine: deliver an event (or an anti-message) to the worker of its receiver.
+ *        The outbox of a worker towards itself is only used by its own thread.
+ */
+static void pSim_deliver(Sim * p_s, int p_worker, const SimEvent * p_e) {
+    int to = p_s->lps[p_e->dst].worker;
+    SimOutbox * o = &p_s->workers[p_worker].out[to];
+    if(to == p_worker) pSim_outboxPush(o, p_e);
+    else {
+        Lock(&o->lock);
+        pSim_outboxPush(o, p_e);
+        Unlock(&o->lock);
+    }
+}
+
+static int pSim_same(const SimEvent * p_a, const SimEvent * p_b) {
+    return p_a->t == p_b->t && p_a->src == p_b->src && p_a->seq == p_b->seq && p_a->dst == p_b->dst &&
+        p_a->type == p_b->type && p_a->a == p_b->a && p_a->b == p_b->b;
+}
+
+static long pSim_cancelSlot(const SimCancelSet * p_c, const SimEvent * p_e) {
+    uint64_t h = ((uint64_t) p_e->src << 40 ^ (uint64_t) p_e->seq) * 0x9E3779B97F4A7C15ULL;
+    return (long) (h >> 32) & (p_c->cap - 1);
+}
+
+/**
+ * @brief Add a pending event to the set of cancelled ones (p_e is the event, not its anti-message).
+ */
+static void pSim_cancelAdd(SimCancelSet * p_c, const SimEvent * p_e) {
+    SimCancelSet bigger;
+    long i = 0;
+    if(2 * (p_c->n + 1) > p_c->cap) {
+        bigger.cap = p_c->cap > 0 ? p_c->cap * 2 : SIM_CANCEL_CAP;
+        bigger.n = 0;
+        if((bigger.ev = malloc(bigger.cap * sizeof(SimEvent))) == NULL)
+            ERR_QUIT("An error occurred during memory allocation. (sim cancel set)");
+        for(i = 0; i < bigger.cap; i++) bigger.ev[i].dst = -1;
+        for(i = 0; i < p_c->cap; i++) if(p_c->ev[i].dst >= 0) pSim_cancelAdd(&bigger, &p_c->ev[i]);
+        free(p_c->ev);
+        *p_c = bigger;
+    }
+    for(i = pSim_cancelSlot(p_c, p_e); p_c->ev[i].dst >= 0; i = (i + 1) & (p_c->cap - 1));
+    p_c->ev[i] = *p_e;
+    p_c->n++;
+}
+
+/**
+ * @brief Remove p_e from the set of cancelled events.
+ * @return int: 1 if p_e was cancelled (and must be skipped), 0 otherwise.
+ */
+static int pSim_cancelTake(SimCancelSet * p_c, const SimEvent * p_e) {
+    long mask = p_c->cap - 1, i = 0, j = 0, k = 0;
+    if(p_c->n == 0) return 0;
+    for(i = pSim_cancelSlot(p_c, p_e); p_c->ev[i].dst >= 0 && !pSim_same(&p_c->ev[i], p_e); i = (i + 1) & mask);
+    if(p_c->ev[i].dst < 0) return 0;
+    //Backward shift: the entries after i which could be in i move back
+    for(j = (i + 1) & mask; p_c->ev[j].dst >= 0; j = (j + 1) & mask) {
+        k = pSim_cancelSlot(p_c, &p_c->ev[j]);
+        if(i <= j ? (i < k && k <= j) : (i < k || k <= j)) continue;
+        p_c->ev[i] = p_c->ev[j];
+        i = j;
+    }
+    p_c->ev[i].dst = -1;
+    p_c->n--;
+    return 1;
+}
+
+/**
+ * @brief Undo the events processed by p_lp after p_to (and p_to itself if p_isInclusive, which is then dropped).
+ *        The other undone events go back to the pending events of the worker.
+ */
+static void pSim_rollback(SimWorker * p_w, SimLP * p_lp, const SimEvent * p_to, int p_isInclusive) {
+    SimHistory * h = p_lp->hist;
+    SimDone * d = NULL;
+    SimUndo * u = NULL;
+    SimEvent anti;
+    p_w->rollbacks++;
+    while (h->nDone > 0) {
+        d = &h->done[h->nDone - 1];
+        if(p_isInclusive ? SimEvent_before(&d->e, p_to) : !SimEvent_before(p_to, &d->e)) break;
+        for(long i = h->nUndo - 1; i >= d->undo; i--) {
+            u = &h->undo[i];
+            memcpy(u->addr, h->bytes + u->off, u->size);
+        }
+        if(h->nUndo > d->undo) h->nBytes = h->undo[d->undo].off;
+        h->nUndo = d->undo;
+        for(long i = d->out; i < h->nOut; i++) {
+            anti = h->out[i];
+            anti.type = SIM_ANTI(anti.type);
+            pSim_deliver(p_w->sim, p_lp->worker, &anti);
+            p_w->antis++;
+        }
+        h->nOut = d->out;
+        p_lp->seq = d->seq;
+        if(!p_isInclusive || !pSim_same(&d->e, p_to))
+            if(SimCalendar_push(&p_w->pending, &d->e) != 1) ERR_QUIT("An error occurred during memory allocation. (sim calendar)");
+        h->nDone--;
+        p_w->rolledBack++;
+    }
+}
+
+/**
+ * @brief Receive an event or an anti-message sent to a process of the worker.
+ */
+static void pSim_receive(SimWorker * p_w, const SimEvent * p_e) {
+    SimLP * lp = &p_w->sim->lps[p_e->dst];
+    SimHistory * h = lp->hist;
+    SimEvent e = *p_e;
+    if(e.type >= 0) {
+        if(h->nDone > 0 && SimEvent_before(&e, &h->done[h->nDone - 1].e)) pSim_rollback(p_w, lp, &e, 0);
+        if(SimCalendar_push(&p_w->pending, &e) != 1) ERR_QUIT("An error occurred during memory allocation. (sim calendar)");
+        return;
+    }
+    //Anti-message: the event was either processed (undo it) or is still pending (skip it when popped)
+    e.type = SIM_ANTI(e.type);
+    for(long i = h->nDone - 1; i >= 0 && h->done[i].e.t >= e.t; i--)
+        if(pSim_same(&h->done[i].e, &e)) {
+            pSim_rollback(p_w, lp, &e, 1);
+            return;
+        }
+    pSim_cancelAdd(&p_w->cancelled, &e);
+}
+
+/**
+ * @brief Receive the events sent to the worker since the last call.
+ */
+static void pSim_drain(SimWorker * p_w) {
+    Sim * s = p_w->sim;
+    SimOutbox * o = NULL;
+    SimEvent * ev = NULL;
+    long cap = 0;
+    for(int i = 0; i < s->nWorkers; i++) {
+        o = &s->workers[i].out[p_w->id];
+        if(i != p_w->id) Lock(&o->lock);
+        //Swap the buffers: the senders go on with an empty one
+        ev = o->ev;
+        cap = o->cap;
+        p_w->inbox.n = o->n;
+        o->ev = p_w->inbox.ev;
+        o->cap = p_w->inbox.cap;
+        o->n = 0;
+        p_w->inbox.ev = ev;
+        p_w->inbox.cap = cap;
+        if(i != p_w->id) Unlock(&o->lock);
+        for(long j = 0; j < p_w->inbox.n; j++) pSim_receive(p_w, &p_w->inbox.ev[j]);
+        p_w->inbox.n = 0;
+    }
+}
+
+/**
+ * @brief Discard the history of p_lp earlier than p_gvt (fossil collection).
+ */
+static void pSim_fossil(SimLP * p_lp, SimTime p_gvt) {
+    SimHistory * h = p_lp->hist;
+    long k = 0, undo = 0, out = 0, bytes = 0;
+    while (k < h->nDone && h->done[k].e.t < p_gvt) k++;
+    if(k == 0) return;
+    undo = k < h->nDone ? h->done[k].undo : h->nUndo;
+    out = k < h->nDone ? h->done[k].out : h->nOut;
+    bytes = undo < h->nUndo ? h->undo[undo].off : h->nBytes;
+    memmove(h->done, h->done + k, (h->nDone - k) * sizeof(SimDone));
+    h->nDone -= k;
+    memmove(h->undo, h->undo + undo, (h->nUndo - undo) * sizeof(SimUndo));
+    h->nUndo -= undo;
+    memmove(h->bytes, h->bytes + bytes, h->nBytes - bytes);
+    h->nBytes -= bytes;
+    memmove(h->out, h->out + out, (h->nOut - out) * sizeof(SimEvent));
+    h->nOut -= out;
+    for(long i = 0; i < h->nDone; i++) {
+        h->done[i].undo -= undo;
+        h->done[i].out -= out;
+    }
+    for(long i = 0; i < h->nUndo; i++) h->undo[i].off -= bytes;
+}
+
+/**
+ * @brief GVT round, run by all the workers together.
+ * @return SimTime: the GVT.
+ */
+static SimTime pSim_gvt(SimWorker * p_w) {
+    Sim * s = p_w->sim;
+    SimOutbox * o = NULL;
+    SimTime t = 0, gvt = SIM_TIME_MAX;
+    pthread_barrier_wait(&s->barrier);
+    //Nobody sends now: the events in transit are in the outboxes
+    if(p_w->id == 0) {
+        atomic_store(&s->gvtRequest, 0);
+        s->windows++;
+    }
+    t = SimCalendar_next(&p_w->pending);
+    for(int i = 0; i < s->nWorkers; i++) {
+        o = &p_w->out[i];
+        for(long j = 0; j < o->n; j++) if(o->ev[j].t < t) t = o->ev[j].t;
+    }
+    p_w->next = t;
+    pthread_barrier_wait(&s->barrier);
+    for(int i = 0; i < s->nWorkers; i++) if(s->workers[i].next < gvt) gvt = s->workers[i].next;
+    if(p_w->id == 0) s->gvt = gvt;
+    for(int i = 0; i < s->nLPs; i++) if(s->lps[i].worker == p_w->id) pSim_fossil(&s->lps[i], gvt);
+    //Nobody reads the published times again before the next round
+    pthread_barrier_wait(&s->barrier);
+    return gvt;
+}
+
+/**
+ * @brief Worker of the optimistic engine.
+ */
+static void * pSim_optimisticWorker(void * p_arg) {
+    SimWorker * w = (SimWorker *) p_arg;
+    Sim * s = w->sim;
+    SimHistory * h = NULL;
+    SimDone * d = NULL;
+    SimLP * lp = NULL;
+    SimEvent e;
+    int64_t tGvt = getCurrentTimeNs();
+    SimTime gvt = 0;
+    long processed = 0;
+    while (1) {
+        pSim_drain(w);
+        if(atomic_load(&s->gvtRequest)) {
+            if((gvt = pSim_gvt(w)) >= s->end) break;
+            processed = 0;
+            tGvt = getCurrentTimeNs();
+            continue;
+        }
+        if(SimCalendar_next(&w->pending) >= s->end) {
+            //Nothing to do: wait for stragglers, or for the end of the run
+            if(getCurrentTimeNs() - tGvt >= SIM_GVT_IDLE_NS) atomic_store(&s->gvtRequest, 1);
+            else sched_yield();
+            continue;
+        }
+        if(SimCalendar_next(&w->pending) >= gvt + SIM_OPTIMISM * s->lookahead) {
+            //Too far ahead of the others: most of the work would be rolled back
+            atomic_store(&s->gvtRequest, 1);
+            continue;
+        }
+        SimCalendar_pop(&w->pending, &e);
+        if(pSim_cancelTake(&w->cancelled, &e)) continue;
+        lp = &s->lps[e.dst];
+        h = lp->hist;
+        SIM_GROW(h->done, h->nDone, h->capDone);
+        d = &h->done[h->nDone++];
+        d->e = e;
+        d->seq = lp->seq;
+        d->undo = h->nUndo;
+        d->out = h->nOut;
+        pSim_dispatch(s, &e);
+        w->events++;
+        if(++processed == SIM_GVT_EVENTS) atomic_store(&s->gvtRequest, 1);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Create a simulation.
+ *
+ * @param p_path market configuration file, or chain file (list of configuration files) if p_isChain is 1.
+ * @param p_isChain 1 if p_path is a chain file.
+ * @param p_end duration of the simulation (virtual time).
+ * @param p_seed seed of the random streams: runs with the same seed give the same results with every engine.
+ * @return Sim* pointer to the new simulation, NULL if a problem occurred.
+ */
+Sim * Sim_init(const char * p_path, int p_isChain, SimTime p_end, uint64_t p_seed) {
+    Sim * aux = NULL;
+    SimParams * params = NULL;
+    char ** confs = NULL;
+    char * single[1];
+    int nConfs = 0, isArenaInit = 0, lp = 0;
+    SimTime lookahead = 0;
+
+    if(p_isChain) {
+        if((nConfs = pSim_readChain(p_path, &confs)) <= 0) {
+            if(nConfs == 0) ERR_MSG("The chain file %s has no stores.\n", p_path);
+            goto err;
+        }
+    } else {
+        single[0] = (char *) p_path;
+        nConfs = 1;
+    }
+    if((aux = malloc(sizeof(Sim))) == NULL || (params = malloc(nConfs * sizeof(SimParams))) == NULL) {
+        ERR_SYS_MSG("An error occurred during memory allocation.");
+        goto err;
+    }
+    aux->nStores = nConfs;
+    aux->nLPs = 0;
+    aux->end = p_end;
+    aux->lookahead = SIM_TIME_MAX;
+    aux->engine = SIM_SEQUENTIAL;
+    aux->workers = NULL;
+    aux->nWorkers = 0;
+    aux->pending.bucket = NULL;
+    aux->events = aux->windows = 0;
+    aux->rolledBack = aux->rollbacks = aux->antis = 0;
+    atomic_init(&aux->gvtRequest, 0);
+    aux->gvt = 0;
+    aux->isStarted = 0;
+    aux->trace = NULL;
+    aux->nTrace = aux->capTrace = 0;
+    aux->wallTime = 0;
+    aux->isRun = 0;
+    for(int i = 0; i < nConfs; i++) {
+        if(SimModel_load(p_isChain ? confs[i] : single[0], &params[i]) != 1) goto err;
+        aux->nLPs += 1 + (int) params[i].K;
+        if((lookahead = SimModel_lookahead(&params[i])) < aux->lookahead) aux->lookahead = lookahead;
+    }
+    if(Arena_init(&aux->arena, SIM_ARENA_CHUNK) != 1) goto err;
+    isArenaInit = 1;
+    if((aux->lps = Arena_alloc(&aux->arena, aux->nLPs * sizeof(SimLP))) == NULL ||
+        (aux->stores = Arena_alloc(&aux->arena, nConfs * sizeof(int))) == NULL)
+        goto err;
+    for(int i = 0; i < nConfs; i++) {
+        aux->stores[i] = lp;
+        for(int k = -1; k < params[i].K; k++, lp++) {
+            aux->lps[lp].id = lp;
+            aux->lps[lp].store = i;
+            aux->lps[lp].desk = k;
+            aux->lps[lp].worker = 0;
+            aux->lps[lp].seq = 0;
+            aux->lps[lp].now = 0;
+            aux->lps[lp].hist = NULL;
+            if((k < 0 ? SimModel_initFront(&aux->lps[lp], &params[i], &aux->arena, p_seed) :
+                SimModel_initDesk(&aux->lps[lp], &params[i], k, &aux->arena, p_seed)) != 1)
+                goto err;
+        }
+    }
+    free(params);
+    if(p_isChain) {
+        for(int i = 0; i < nConfs; i++) free(confs[i]);
+        free(confs);
+    }
+    return aux;
+err:
+    ERR_MSG("An error occurred during simulation setup.\n");
+    if(confs != NULL) {
+        for(int i = 0; i < nConfs; i++) free(confs[i]);
+        free(confs);
+    }
+    free(params);
+    if(isArenaInit) Arena_release(&aux->arena);
+    free(aux);
+    return NULL;
+}
+
+/**
+ * @brief Dealloc a simulation.
+ */
+void Sim_delete(Sim * p_s) {
+    if(p_s == NULL) return;
+    if(p_s->pending.bucket != NULL) SimCalendar_delete(&p_s->pending);
+    for(int i = 0; i < p_s->nWorkers; i++) {
+        SimCalendar_delete(&p_s->workers[i].pending);
+        for(int j = 0; j < p_s->nWorkers && p_s->workers[i].out != NULL; j++) {
+            if(p_s->engine == SIM_OPTIMISTIC) pthread_mutex_destroy(&p_s->workers[i].out[j].lock);
+            free(p_s->workers[i].out[j].ev);
+        }
+        free(p_s->workers[i].out);
+        free(p_s->workers[i].inbox.ev);
+        free(p_s->workers[i].cancelled.ev);
+    }
+    free(p_s->workers);
+    free(p_s->trace);
+    for(int i = 0; i < p_s->nLPs; i++) {
+        SimHistory * h = p_s->lps[i].hist;
+        if(h == NULL) continue;
+        free(h->done);
+        free(h->undo);
+        free(h->bytes);
+        free(h->out);
+        free(h);
+    }
+    Arena_release(&p_s->arena);
+    free(p_s);
+}
+
+/**
+ * @brief Run the simulation with a single event list.
+ * @return int: 1 good, 0 error (a simulation can be run only once)
+ */
+int Sim_runSequential(Sim * p_s) {
+    int64_t tStart = getCurrentTimeNs();
+    SimEvent e;
+    if(p_s->isRun || SimCalendar_init(&p_s->pending) != 1) return 0;
+    p_s->engine = SIM_SEQUENTIAL;
+    pSim_start(p_s);
+    while (SimCalendar_next(&p_s->pending) < p_s->end) {
+        SimCalendar_pop(&p_s->pending, &e);
+        pSim_dispatch(p_s, &e);
+        p_s->events++;
+    }
+    pSim_finish(p_s, tStart);
+    return 1;
+}
+
+/**
+ * @brief Run the simulation with the conservative engine.
+ *        With at least as many stores as workers each store is owned by a single worker, so only the
+ *        synchronization is shared; otherwise the processes are dealt round robin.
+ *
+ * @param p_s simulation to run.
+ * @param p_workers number of worker threads (1..#SIM_MAX_WORKERS).
+ * @return int: 1 good, 0 error (a simulation can be run only once)
+ */
+int Sim_runConservative(Sim * p_s, int p_workers) {
+    int64_t tStart = getCurrentTimeNs();
+    int res = 1;
+    if(p_s->isRun || p_workers < 1 || p_workers > SIM_MAX_WORKERS) return 0;
+    if((p_s->workers = calloc(p_workers, sizeof(SimWorker))) == NULL) return 0;
+    p_s->nWorkers = p_workers;
+    p_s->engine = SIM_CONSERVATIVE;
+    for(int i = 0; i < p_workers; i++) {
+        p_s->workers[i].id = i;
+        p_s->workers[i].sim = p_s;
+        if(SimCalendar_init(&p_s->workers[i].pending) != 1 ||
+            (p_s->workers[i].out = calloc(p_workers, sizeof(SimOutbox))) == NULL)
+            return 0;
+    }
+    for(int i = 0; i < p_s->nLPs; i++)
+        p_s->lps[i].worker = p_s->nStores >= p_workers ? p_s->lps[i].store % p_workers : i % p_workers;
+    pSim_start(p_s);
+    for(int i = 0; i < p_workers; i++) p_s->workers[i].next = SimCalendar_next(&p_s->workers[i].pending);
+
+    if(pthread_barrier_init(&p_s->barrier, NULL, p_workers) != 0) return 0;
+    for(int i = 1; i < p_workers; i++)
+        if(pthread_create(&p_s->workers[i].thread, NULL, pSim_conservativeWorker, &p_s->workers[i]) != 0)
+            ERR_QUIT("An error occurred during creation of simulation worker %d.", i);
+    pSim_conservativeWorker(&p_s->workers[0]);
+    for(int i = 1; i < p_workers; i++)
+        if(pthread_join(p_s->workers[i].thread, NULL) != 0) res = 0;
+    pthread_barrier_destroy(&p_s->barrier);
+    for(int i = 0; i < p_workers; i++) p_s->events += p_s->workers[i].events;
+    pSim_finish(p_s, tStart);
+    return res;
+}
+
+/**
+ * @brief Run the simulation with the optimistic engine (same split of the processes as the conservative one).
+ *        #Sim.events counts the committed events; the events undone by rollbacks are in #Sim.rolledBack.
+ *
+ * @param p_s simulation to run.
+ * @param p_workers number of worker threads (1..#SIM_MAX_WORKERS).
+ * @return int: 1 good, 0 error (a simulation can be run only once)
+ */
+int Sim_runOptimistic(Sim * p_s, int p_workers) {
+    int64_t tStart = getCurrentTimeNs();
+    int res = 1;
+    if(p_s->isRun || p_workers < 1 || p_workers > SIM_MAX_WORKERS) return 0;
+    if((p_s->workers = calloc(p_workers, sizeof(SimWorker))) == NULL) return 0;
+    p_s->nWorkers = p_workers;
+    p_s->engine = SIM_OPTIMISTIC;
+    for(int i = 0; i < p_workers; i++) {
+        p_s->workers[i].id = i;
+        p_s->workers[i].sim = p_s;
+        if(SimCalendar_init(&p_s->workers[i].pending) != 1 ||
+            (p_s->workers[i].out = calloc(p_workers, sizeof(SimOutbox))) == NULL)
+            return 0;
+        for(int j = 0; j < p_workers; j++)
+            if(pthread_mutex_init(&p_s->workers[i].out[j].lock, NULL) != 0) return 0;
+    }
+    for(int i = 0; i < p_s->nLPs; i++) {
+        p_s->lps[i].worker = p_s->nStores >= p_workers ? p_s->lps[i].store % p_workers : i % p_workers;
+        if((p_s->lps[i].hist = calloc(1, sizeof(SimHistory))) == NULL) return 0;
+    }
+    pSim_start(p_s);
+
+    if(pthread_barrier_init(&p_s->barrier, NULL, p_workers) != 0) return 0;
+    for(int i = 1; i < p_workers; i++)
+        if(pthread_create(&p_s->workers[i].thread, NULL, pSim_optimisticWorker, &p_s->workers[i]) != 0)
+            ERR_QUIT("An error occurred during creation of simulation worker %d.", i);
+    pSim_optimisticWorker(&p_s->workers[0]);
+    for(int i = 1; i < p_workers; i++)
+        if(pthread_join(p_s->workers[i].thread, NULL) != 0) res = 0;
+    pthread_barrier_destroy(&p_s->barrier);
+    for(int i = 0; i < p_workers; i++) {
+        p_s->events += p_s->workers[i].events - p_s->workers[i].rolledBack;
+        p_s->rolledBack += p_s->workers[i].rolledBack;
+        p_s->rollbacks += p_s->workers[i].rollbacks;
+        p_s->antis += p_s->workers[i].antis;
+    }
+    pSim_finish(p_s, tStart);
+    return res;
+}
+
+/**
+ * @brief Save p_size bytes at p_addr before p_lp modifies them, so that a rollback can restore them.
+ *        Does nothing outside the optimistic engine (see #SIM_SAVE).
+ */
+void Sim_save(SimLP * p_lp, void * p_addr, long p_size) {
+    SimHistory * h = p_lp->hist;
+    if(h == NULL) return;
+    SIM_GROW(h->undo, h->nUndo, h->capUndo);
+    while (h->nBytes + p_size > h->capBytes) pSim_grow((void **) &h->bytes, &h->capBytes, 1);
+    h->undo[h->nUndo].addr = p_addr;
+    h->undo[h->nUndo].off = h->nBytes;
+    h->undo[h->nUndo++].size = p_size;
+    memcpy(h->bytes + h->nBytes, p_addr, p_size);
+    h->nBytes += p_size;
+}
+
+/**
+ * @brief Record the delays of the first p_max events sent during a sequential run (call it before the run).
+ *        They are the distribution of event times seen by the pending-event set (see BenchQueue.c).
+ * @return int: 1 good, 0 allocation error
+ */
+int Sim_trace(Sim * p_s, long p_max) {
+    if((p_s->trace = malloc(p_max * sizeof(SimTime))) == NULL) return 0;
+    p_s->capTrace = p_max;
+    p_s->nTrace = 0;
+    return 1;
+}
+
+/**
+ * @brief Send an event. Called by the model while p_from is processing an event.
+ *
+ * @param p_s simulation.
+ * @param p_from sender.
+ * @param p_dst receiver (p_from->id to schedule an event of the sender itself).
+ * @param p_t time of the event: > p_from->now, and >= p_from->now + #Sim.lookahead if p_dst is another process
+ *            (only the first events of the processes are scheduled at their current time).
+ * @param p_type type of event.
+ * @param p_a payload.
+ * @param p_b payload.
+ */
+void Sim_send(Sim * p_s, SimLP * p_from, int p_dst, SimTime p_t, int p_type, int32_t p_a, int64_t p_b) {
+    SimEvent e;
+    SimLP * to = &p_s->lps[p_dst];
+    e.t = p_t;
+    e.seq = p_from->seq++;
+    e.src = p_from->id;
+    e.dst = p_dst;
+    e.type = p_type;
+    e.a = p_a;
+    e.b = p_b;
+    if(p_dst != p_from->id && p_t < p_from->now + p_s->lookahead)
+        ERR_QUIT("Lookahead violated: event %d from process %d to %d.", p_type, p_from->id, p_dst);
+    if(p_s->isStarted && p_t <= p_from->now)
+        ERR_QUIT("Event %d from process %d scheduled at the current time.", p_type, p_from->id);
+    if(p_s->nTrace < p_s->capTrace && p_s->isStarted && p_s->engine == SIM_SEQUENTIAL) p_s->trace[p_s->nTrace++] = p_t - p_from->now;
+    if(p_s->engine == SIM_OPTIMISTIC) {
+        if(p_s->isStarted) {
+            SIM_GROW(p_from->hist->out, p_from->hist->nOut, p_from->hist->capOut);
+            p_from->hist->out[p_from->hist->nOut++] = e;
+        }
+        pSim_deliver(p_s, p_from->worker, &e);
+    } else if(p_s->engine == SIM_SEQUENTIAL) {
+        if(SimCalendar_push(&p_s->pending, &e) != 1) ERR_QUIT("An error occurred during memory allocation. (sim calendar)");
+    } else if(to->worker == p_from->worker) {
+        if(SimCalendar_push(&p_s->workers[p_from->worker].pending, &e) != 1) ERR_QUIT("An error occurred during memory allocation. (sim calendar)");
+    } else pSim_outboxPush(&p_s->workers[p_from->worker].out[to->worker], &e);
+}
+
+/**
+ * @brief Results of store p_i.
+ */
+void Sim_storeStats(Sim * p_s, int p_i, SimStoreStats * p_st) {
+    SimModel_storeStats(&p_s->lps[p_s->stores[p_i]], p_st);
+}
+
+/**
+ * @brief Hash of the results of all the stores: runs with equal digests have the same results.
+ */
+uint64_t Sim_digest(Sim * p_s) {
+    SimStoreStats st;
+    uint64_t h = 0;
+    for(int i = 0; i < p_s->nStores; i++) {
+        Sim_storeStats(p_s, i, &st);
+        h = (h ^ st.digest) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/**
+ * @brief Write the results of each store and a summary of the run.
+ */
+void Sim_log(Sim * p_s, FILE * p_f) {
+    SimStoreStats st;
+    long users = 0, clients = 0, products = 0, closures = 0;
+    const char * engines[] = {"sequential", "conservative", "optimistic"};
+    for(int i = 0; i < p_s->nStores; i++) {
+        Sim_storeStats(p_s, i, &st);
+        fprintf(p_f, "[Store %d]: users=%ld clients=%ld products=%ld closures=%ld queue_visited=%ld avg_time_market=%.3f avg_time_queue=%.3f digest=%016llx\n",
+            i, st.users, st.clients, st.products, st.closures, st.queueChanges,
+            st.users > 0 ? (double) st.sumMarket / st.users / 1e9 : 0,
+            st.users > 0 ? (double) st.sumQueue / st.users / 1e9 : 0,
+            (unsigned long long) st.digest);
+        users += st.users;
+        clients += st.clients;
+        products += st.products;
+        closures += st.closures;
+    }
+    fprintf(p_f, "[Sim]: engine=%s workers=%d stores=%d processes=%d time=%.3f lookahead=%.3f users=%ld clients=%ld products=%ld closures=%ld digest=%016llx\n",
+        engines[p_s->engine], p_s->nWorkers > 0 ? p_s->nWorkers : 1, p_s->nStores, p_s->nLPs,
+        (double) p_s->end / 1e9, (double) p_s->lookahead / 1e6, users, clients, products, closures,
+        (unsigned long long) Sim_digest(p_s));
+    fprintf(p_f, "[Sim]: events=%lld windows=%lld wall_time=%.3f events_per_s=%.0f\n",
+        p_s->events, p_s->windows, p_s->wallTime, p_s->wallTime > 0 ? p_s->events / p_s->wallTime : 0);
+    if(p_s->engine == SIM_OPTIMISTIC)
+        fprintf(p_f, "[Sim]: rolled_back=%lld rollbacks=%lld anti_messages=%lld\n", p_s->rolledBack, p_s->rollbacks, p_s->antis);
+}
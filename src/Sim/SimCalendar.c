@@ -0,0 +1,163 @@
+/**
+ * @file SimCalendar.c
+ * @brief Calendar queue of pending events used by the virtual-time engine.
+ *
+ *        Inside a bucket events are ordered by #SimEvent_before, so the calendar pops exactly the same
+ *        sequence as a single #SimHeap.
+ */
+#include <SimEvent.h>
+#include <stdlib.h>
+
+#define SIM_CAL_MIN_BUCKETS 16 /**< The calendar never shrinks below this */
+#define SIM_CAL_WIDTH SIM_MS(1) /**< Day width before the first tuning */
+#define SIM_CAL_SAMPLE 25 /**< Events sampled to tune the width */
+#define SIM_CAL_MAX_STEPS 8 /**< Average empty days scanned per operation above which the width is tuned again */
+
+//Private functions
+static long pSimCalendar_bucketOf(const SimCalendar * p_c, SimTime p_t) {
+    return (long) (p_t / p_c->width) & (p_c->nBuckets - 1);
+}
+
+/**
+ * @brief Move the current day to the one of p_t.
+ */
+static void pSimCalendar_moveTo(SimCalendar * p_c, SimTime p_t) {
+    p_c->cur = pSimCalendar_bucketOf(p_c, p_t);
+    p_c->top = (p_t / p_c->width + 1) * p_c->width;
+}
+
+/**
+ * @brief Move the current day to the one of the next event.
+ * @return int: 1 found, 0 the calendar is empty
+ */
+static int pSimCalendar_locate(SimCalendar * p_c) {
+    SimHeap * b = NULL;
+    SimEvent * best = NULL;
+    if(p_c->n == 0) return 0;
+    for(long i = 0; i < p_c->nBuckets; i++) {
+        b = &p_c->bucket[p_c->cur];
+        if(b->n > 0 && b->ev[0].t < p_c->top) return 1;
+        p_c->cur = (p_c->cur + 1) & (p_c->nBuckets - 1);
+        p_c->top += p_c->width;
+        p_c->steps++;
+    }
+    //A whole year without events: jump to the earliest one
+    for(long i = 0; i < p_c->nBuckets; i++) {
+        b = &p_c->bucket[i];
+        if(b->n > 0 && (best == NULL || SimEvent_before(&b->ev[0], best))) best = &b->ev[0];
+    }
+    pSimCalendar_moveTo(p_c, best->t);
+    return 1;
+}
+
+/**
+ * @brief Rebuild the calendar with p_nBuckets buckets and a width tuned on the next events: 3 times their
+ *        average spacing, leaving out spacings larger than twice the average (Brown's rule).
+ *        The new buckets are filled completely before the old ones are freed.
+ * @return int: 1 good, 0 allocation error (the calendar is unchanged)
+ */
+static int pSimCalendar_resize(SimCalendar * p_c, long p_nBuckets) {
+    SimEvent sample[SIM_CAL_SAMPLE];
+    SimCalendar fresh = *p_c; //layout being built (until it is complete it also keeps the current day of p_c)
+    long k = 0, cnt = 0, b = 0, i = 0;
+    SimTime avg = 0, sum = 0, gap = 0;
+    int res = 1;
+    if((fresh.bucket = calloc(p_nBuckets, sizeof(SimHeap))) == NULL) return 0;
+    fresh.nBuckets = p_nBuckets;
+    //Sample the next events with the old layout (a pop never shrinks a bucket: they can always be put back)
+    for(; k < SIM_CAL_SAMPLE && pSimCalendar_locate(p_c); p_c->n--) SimHeap_pop(&p_c->bucket[p_c->cur], &sample[k++]);
+    if(k >= 2 && (avg = (sample[k - 1].t - sample[0].t) / (k - 1)) > 0) {
+        for(i = 1; i < k; i++)
+            if((gap = sample[i].t - sample[i - 1].t) <= 2 * avg) {
+                sum += gap;
+                cnt++;
+            }
+        if(sum > 0) fresh.width = 3 * sum / cnt;
+    }
+    for(b = 0; b < p_c->nBuckets && res; b++)
+        for(i = 0; i < p_c->bucket[b].n && res; i++)
+            res = SimHeap_push(&fresh.bucket[pSimCalendar_bucketOf(&fresh, p_c->bucket[b].ev[i].t)], &p_c->bucket[b].ev[i]);
+    for(i = 0; i < k && res; i++)
+        res = SimHeap_push(&fresh.bucket[pSimCalendar_bucketOf(&fresh, sample[i].t)], &sample[i]);
+    if(res != 1) {
+        //Put the sample back in the old layout and drop the new one
+        for(i = 0; i < k; i++, p_c->n++) SimHeap_push(&p_c->bucket[pSimCalendar_bucketOf(p_c, sample[i].t)], &sample[i]);
+        p_c->cur = fresh.cur;
+        p_c->top = fresh.top;
+        p_c->steps = fresh.steps;
+        SimCalendar_delete(&fresh);
+        return 0;
+    }
+    fresh.n = p_c->n + k;
+    SimCalendar_delete(p_c);
+    *p_c = fresh;
+    if(k > 0) pSimCalendar_moveTo(p_c, sample[0].t);
+    p_c->ops = p_c->steps = 0;
+    p_c->resizes++;
+    return 1;
+}
+
+/**
+ * @brief Tune the width again when pops scan too many empty days.
+ */
+static int pSimCalendar_check(SimCalendar * p_c) {
+    int res = 1;
+    if(++p_c->ops < p_c->nBuckets) return 1;
+    if(p_c->steps > SIM_CAL_MAX_STEPS * p_c->ops) res = pSimCalendar_resize(p_c, p_c->nBuckets);
+    p_c->ops = p_c->steps = 0;
+    return res;
+}
+
+/**
+ * @brief Init an empty calendar.
+ * @return int: 1 good, 0 allocation error
+ */
+int SimCalendar_init(SimCalendar * p_c) {
+    p_c->nBuckets = SIM_CAL_MIN_BUCKETS;
+    p_c->width = SIM_CAL_WIDTH;
+    p_c->cur = 0;
+    p_c->top = p_c->width;
+    p_c->n = p_c->ops = p_c->steps = p_c->resizes = 0;
+    return (p_c->bucket = calloc(p_c->nBuckets, sizeof(SimHeap))) != NULL;
+}
+
+void SimCalendar_delete(SimCalendar * p_c) {
+    for(long b = 0; b < p_c->nBuckets && p_c->bucket != NULL; b++) SimHeap_delete(&p_c->bucket[b]);
+    free(p_c->bucket);
+    p_c->bucket = NULL;
+    p_c->n = 0;
+}
+
+/**
+ * @brief Insert a copy of p_e.
+ * @return int: 1 good, 0 allocation error
+ */
+int SimCalendar_push(SimCalendar * p_c, const SimEvent * p_e) {
+    if(SimHeap_push(&p_c->bucket[pSimCalendar_bucketOf(p_c, p_e->t)], p_e) != 1) return 0;
+    //An event before the current day (or in an empty calendar) becomes the current day
+    if(p_c->n++ == 0 || p_e->t < p_c->top - p_c->width) pSimCalendar_moveTo(p_c, p_e->t);
+    if(p_c->n > 2 * p_c->nBuckets) return pSimCalendar_resize(p_c, 2 * p_c->nBuckets);
+    return pSimCalendar_check(p_c);
+}
+
+/**
+ * @brief Remove the next event.
+ * @return int: 1 the event is placed in p_e, 0 the calendar is empty
+ */
+int SimCalendar_pop(SimCalendar * p_c, SimEvent * p_e) {
+    if(!pSimCalendar_locate(p_c)) return 0;
+    SimHeap_pop(&p_c->bucket[p_c->cur], p_e);
+    p_c->n--;
+    //A failed rebuild leaves the calendar as it was
+    if(p_c->nBuckets > SIM_CAL_MIN_BUCKETS && p_c->n < p_c->nBuckets / 2) pSimCalendar_resize(p_c, p_c->nBuckets / 2);
+    else pSimCalendar_check(p_c);
+    return 1;
+}
+
+/**
+ * @brief Time of the next event, #SIM_TIME_MAX if the calendar is empty.
+ *        It moves the current day forward, so the following pop is immediate.
+ */
+SimTime SimCalendar_next(SimCalendar * p_c) {
+    return pSimCalendar_locate(p_c) ? p_c->bucket[p_c->cur].ev[0].t : SIM_TIME_MAX;
+}
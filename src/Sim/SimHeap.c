@@ -0,0 +1,68 @@
+/**
+ * @file SimHeap.c
+ * @brief Binary heap of pending events used by the virtual-time engine.
+ */
+#include <SimEvent.h>
+#include <stdlib.h>
+
+/**
+ * @brief Init an empty heap.
+ *
+ * @param p_h heap to init.
+ * @param p_cap initial capacity (> 0), it grows when needed.
+ * @return int: 1 good, 0 allocation error
+ */
+int SimHeap_init(SimHeap * p_h, long p_cap) {
+    p_h->n = 0;
+    p_h->cap = p_cap;
+    return (p_h->ev = malloc(p_cap * sizeof(SimEvent))) != NULL;
+}
+
+void SimHeap_delete(SimHeap * p_h) {
+    free(p_h->ev);
+    p_h->ev = NULL;
+    p_h->n = p_h->cap = 0;
+}
+
+/**
+ * @brief Insert a copy of p_e.
+ * @return int: 1 good, 0 allocation error
+ */
+int SimHeap_push(SimHeap * p_h, const SimEvent * p_e) {
+    SimEvent * aux = NULL;
+    long i = p_h->n, parent = 0;
+    if(p_h->n == p_h->cap) {
+        if((aux = realloc(p_h->ev, (p_h->cap > 0 ? 2 * p_h->cap : 4) * sizeof(SimEvent))) == NULL) return 0;
+        p_h->ev = aux;
+        p_h->cap = p_h->cap > 0 ? 2 * p_h->cap : 4;
+    }
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if(!SimEvent_before(p_e, &p_h->ev[parent])) break;
+        p_h->ev[i] = p_h->ev[parent];
+        i = parent;
+    }
+    p_h->ev[i] = *p_e;
+    p_h->n++;
+    return 1;
+}
+
+/**
+ * @brief Remove the next event.
+ * @return int: 1 the event is placed in p_e, 0 the heap is empty
+ */
+int SimHeap_pop(SimHeap * p_h, SimEvent * p_e) {
+    SimEvent last;
+    long i = 0, child = 0;
+    if(p_h->n == 0) return 0;
+    *p_e = p_h->ev[0];
+    last = p_h->ev[--p_h->n];
+    while ((child = 2 * i + 1) < p_h->n) {
+        if(child + 1 < p_h->n && SimEvent_before(&p_h->ev[child + 1], &p_h->ev[child])) child++;
+        if(!SimEvent_before(&p_h->ev[child], &last)) break;
+        p_h->ev[i] = p_h->ev[child];
+        i = child;
+    }
+    p_h->ev[i] = last;
+    return 1;
+}
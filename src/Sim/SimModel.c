@@ -0,0 +1,465 @@
+/**
+ * @file SimModel.c
+ * @brief   Store model of the virtual-time engine.
+ *          A store is split in 1 + K logical processes: the front (shopping area, authorization queue and
+ *          director) and one process for each desk. They share nothing and interact only through events,
+ *          each one delayed by at least the lookahead of the store:
+ *              - users choose a desk SIM_WALK_MS before the end of shopping (the minimum shopping time)
+ *                and join its queue when shopping ends;
+ *              - director commands reach the desk after SIM_WALK_MS, and users in the queue of a closed desk
+ *                take SIM_WALK_MS to reach another one;
+ *              - a desk knows when a service ends as soon as it starts, at least SIM_SERVICE_MIN_MS + NP before;
+ *              - the desk status sent every TD is read by the director at the next notification.
+ *          Apart from these delays the rules are the ones of the threaded market (see PayArea.c and TDirector.c).
+ *          Every modification of the state is preceded by #SIM_SAVE, so that the optimistic engine can undo it.
+ */
+#include <Sim.h>
+#include <SimModel.h>
+#include <Config.h>
+#include <utilities.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FNV_PRIME 0x100000001b3ULL
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+
+/**
+ * @brief An event which can't happen: fatal, unless the optimistic engine is running ahead on events which
+ *        will be cancelled. Then the event is ignored and counted, and the rollback undoes the count too.
+ */
+#define SIM_INVALID(p_lp, p_invalid, ...) do { if((p_lp)->hist == NULL) ERR_QUIT(__VA_ARGS__); (p_invalid)++; } while(0)
+
+//Private functions
+/**
+ * @brief splitmix64: seed of each logical process, so that streams of different processes are unrelated.
+ */
+static uint64_t pSimModel_seed(uint64_t p_x) {
+    p_x += 0x9E3779B97F4A7C15ULL;
+    p_x = (p_x ^ (p_x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    p_x = (p_x ^ (p_x >> 27)) * 0x94D049BB133111EBULL;
+    p_x ^= p_x >> 31;
+    return p_x != 0 ? p_x : 1;
+}
+/**
+ * @brief xorshift64*: uniform value in [p_lower; p_upper] from the stream p_rng.
+ */
+static long pSimModel_random(uint64_t * p_rng, long p_lower, long p_upper) {
+    *p_rng ^= *p_rng >> 12;
+    *p_rng ^= *p_rng << 25;
+    *p_rng ^= *p_rng >> 27;
+    return p_lower + (long)((*p_rng * 0x2545F4914F6CDD1DULL) % (uint64_t)(p_upper - p_lower + 1));
+}
+static uint64_t pSimModel_hash(uint64_t p_h, int64_t p_x) {
+    for(int i = 0; i < 8; i++) p_h = (p_h ^ ((uint64_t)p_x >> (8 * i) & 0xff)) * FNV_PRIME;
+    return p_h;
+}
+static int pSimModel_getLong(FILE * p_f, const char * p_key, long * p_x) {
+    char str_aux[MAX_DIM_STR_CONF];
+    if(Config_getValue(p_f, p_key, str_aux) != 1 || Config_parseLong(p_x, str_aux) != 1) {
+        ERR_MSG("The property %s is not defined or it has a wrong value format.\n", p_key);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Random desk (as seen by the director) which is open (p_open = 1) or closed (p_open = 0).
+ *        Requirements: at least one desk in that state.
+ */
+static int pFront_randomDesk(SimFront * p_f, int p_open) {
+    int n = p_open ? p_f->nOpen : (int) p_f->p.K - p_f->nOpen;
+    int k = (int) pSimModel_random(&p_f->rng, 0, n - 1);
+    for(int i = 0; i < p_f->p.K; i++)
+        if(p_f->open[i] == p_open && k-- == 0) return i;
+    ERR_QUIT("An error occurred during desk search.");
+}
+
+/**
+ * @brief The user in p_slot walks to a random open desk.
+ */
+static void pFront_toDesk(Sim * p_s, SimLP * p_lp, SimFront * p_f, int p_slot) {
+    int desk = pFront_randomDesk(p_f, 1);
+    SIM_SAVE(p_lp, p_f->changes[p_slot]);
+    p_f->changes[p_slot]++;
+    Sim_send(p_s, p_lp, p_lp->id + 1 + desk, p_lp->now + SIM_MS(SIM_WALK_MS), SIM_EV_JOIN, p_slot, p_f->products[p_slot]);
+}
+/**
+ * @brief The user in p_slot chooses a desk and joins its queue at the end of shopping.
+ */
+static void pFront_choose(Sim * p_s, SimLP * p_lp, SimFront * p_f, int p_slot) {
+    SIM_SAVE(p_lp, p_f->tQueue[p_slot]);
+    p_f->tQueue[p_slot] = p_lp->now + SIM_MS(SIM_WALK_MS);
+    pFront_toDesk(p_s, p_lp, p_f, p_slot);
+}
+
+/**
+ * @brief p_n users enter the shopping area.
+ */
+static void pFront_admit(Sim * p_s, SimLP * p_lp, SimFront * p_f, int p_n) {
+    int slot = 0;
+    long shopping = 0;
+    for(int i = 0; i < p_n && p_f->nFree > 0; i++) {
+        slot = p_f->freeSlots[--p_f->nFree];
+        SIM_SAVE(p_lp, p_f->id[slot]);
+        SIM_SAVE(p_lp, p_f->products[slot]);
+        SIM_SAVE(p_lp, p_f->changes[slot]);
+        SIM_SAVE(p_lp, p_f->tEntry[slot]);
+        p_f->id[slot] = p_f->nextId++;
+        p_f->products[slot] = (int32_t) pSimModel_random(&p_f->rng, 0, p_f->p.P);
+        shopping = pSimModel_random(&p_f->rng, 10, p_f->p.T);
+        p_f->changes[slot] = 0;
+        p_f->tEntry[slot] = p_lp->now;
+        //Events can't be scheduled at the current time: with the shortest shopping the desk is chosen now
+        if(p_f->products[slot] > 0 && shopping == SIM_WALK_MS)
+            pFront_choose(p_s, p_lp, p_f, slot);
+        else if(p_f->products[slot] > 0)
+            Sim_send(p_s, p_lp, p_lp->id, p_lp->now + SIM_MS(shopping - SIM_WALK_MS), SIM_EV_CHOOSE, slot, 0);
+        else
+            Sim_send(p_s, p_lp, p_lp->id, p_lp->now + SIM_MS(shopping), SIM_EV_AUTH, slot, 0);
+    }
+}
+
+/**
+ * @brief The user in p_slot leaves the market: its record is accounted and, every E exits, E users enter.
+ */
+static void pFront_exit(Sim * p_s, SimLP * p_lp, SimFront * p_f, int p_slot) {
+    SimTime market = p_lp->now - p_f->tEntry[p_slot];
+    SimTime queue = p_lp->now - p_f->tQueue[p_slot];
+    if(p_f->nFree == p_f->p.C) {
+        SIM_INVALID(p_lp, p_f->invalid, "User of slot %d of store %d exited twice.", p_slot, p_lp->store);
+        return;
+    }
+    p_f->users++;
+    p_f->productsOut += p_f->products[p_slot];
+    p_f->queueChanges += p_f->changes[p_slot];
+    p_f->sumMarket += market;
+    p_f->sumQueue += queue;
+    p_f->digest = pSimModel_hash(p_f->digest, p_f->id[p_slot]);
+    p_f->digest = pSimModel_hash(p_f->digest, market);
+    p_f->digest = pSimModel_hash(p_f->digest, queue);
+    p_f->digest = pSimModel_hash(p_f->digest, p_f->changes[p_slot]);
+    SIM_SAVE(p_lp, p_f->freeSlots[p_f->nFree]);
+    p_f->freeSlots[p_f->nFree++] = p_slot;
+    if(p_f->nFree >= p_f->p.E) pFront_admit(p_s, p_lp, p_f, (int) p_f->p.E);
+}
+
+/**
+ * @brief Director decision, taken when all the desks have reported their status (see #Director_main).
+ */
+static void pFront_decide(Sim * p_s, SimLP * p_lp, SimFront * p_f) {
+    int noWork = 0, tryOpen = 0, desk = 0;
+    Sim_save(p_lp, p_f->hasReport, p_f->p.K);
+    for(int i = 0; i < p_f->p.K; i++) {
+        if(p_f->repOpen[i] && p_f->repUsers[i] <= 1) noWork++;
+        if(p_f->repOpen[i] && p_f->repUsers[i] >= p_f->p.S2) tryOpen = 1;
+        p_f->hasReport[i] = 0;
+    }
+    p_f->nReports = 0;
+    if(tryOpen && p_f->nOpen != p_f->p.K) {
+        desk = pFront_randomDesk(p_f, 0);
+        SIM_SAVE(p_lp, p_f->open[desk]);
+        p_f->open[desk] = 1;
+        p_f->nOpen++;
+        Sim_send(p_s, p_lp, p_lp->id + 1 + desk, p_lp->now + SIM_MS(SIM_WALK_MS), SIM_EV_OPEN, 0, 0);
+    }
+    if(noWork >= p_f->p.S1 && p_f->nOpen >= 2) {
+        desk = pFront_randomDesk(p_f, 1);
+        SIM_SAVE(p_lp, p_f->open[desk]);
+        p_f->open[desk] = 0;
+        p_f->nOpen--;
+        Sim_send(p_s, p_lp, p_lp->id + 1 + desk, p_lp->now + SIM_MS(SIM_WALK_MS), SIM_EV_CLOSE, 0, 0);
+    }
+}
+
+static void pFront_handle(Sim * p_s, SimLP * p_lp, const SimEvent * p_e) {
+    SimFront * f = p_lp->state.front;
+    int desk = 0;
+    //Counters and random state are saved as a whole, arrays only where they are modified
+    SIM_SAVE(p_lp, *f);
+    switch (p_e->type) {
+        case SIM_EV_START:
+            pFront_admit(p_s, p_lp, f, (int) f->p.C);
+            break;
+        case SIM_EV_CHOOSE:
+            pFront_choose(p_s, p_lp, f, p_e->a);
+            break;
+        case SIM_EV_BOUNCE:
+            pFront_toDesk(p_s, p_lp, f, p_e->a);
+            break;
+        case SIM_EV_AUTH:
+            SIM_SAVE(p_lp, f->tQueue[p_e->a]);
+            f->tQueue[p_e->a] = p_lp->now;
+            pFront_exit(p_s, p_lp, f, p_e->a);
+            break;
+        case SIM_EV_EXIT:
+            pFront_exit(p_s, p_lp, f, p_e->a);
+            break;
+        case SIM_EV_REPORT:
+            desk = p_e->src - p_lp->id - 1;
+            SIM_SAVE(p_lp, f->hasReport[desk]);
+            SIM_SAVE(p_lp, f->repOpen[desk]);
+            SIM_SAVE(p_lp, f->repUsers[desk]);
+            if(!f->hasReport[desk]) {
+                f->hasReport[desk] = 1;
+                f->nReports++;
+            }
+            f->repOpen[desk] = (uint8_t) p_e->a;
+            f->repUsers[desk] = (int32_t) p_e->b;
+            if(f->nReports == f->p.K) pFront_decide(p_s, p_lp, f);
+            break;
+        default:
+            ERR_QUIT("Unexpected event %d for the front of store %d.", p_e->type, p_lp->store);
+    }
+}
+
+/**
+ * @brief Start serving the first user in queue, if any.
+ */
+static void pDesk_serve(Sim * p_s, SimLP * p_lp, SimDesk * p_d) {
+    int slot = 0, products = 0;
+    SimTime service = 0;
+    if(p_d->qLen == 0) return;
+    slot = p_d->qSlot[p_d->qHead];
+    products = p_d->qProducts[p_d->qHead];
+    p_d->qHead = (p_d->qHead + 1) % p_d->qCap;
+    p_d->qLen--;
+    service = SIM_MS(p_d->serviceConst + products * p_d->NP);
+    p_d->clients++;
+    p_d->products += products;
+    p_d->serviceTime += service;
+    p_d->busy = 1;
+    Sim_send(p_s, p_lp, p_lp->id - 1 - p_lp->desk, p_lp->now + service, SIM_EV_EXIT, slot, 0);
+    Sim_send(p_s, p_lp, p_lp->id, p_lp->now + service, SIM_EV_DONE, 0, 0);
+}
+
+static void pDesk_handle(Sim * p_s, SimLP * p_lp, const SimEvent * p_e) {
+    SimDesk * d = p_lp->state.desk;
+    int front = p_lp->id - 1 - p_lp->desk;
+    int tail = 0;
+    SIM_SAVE(p_lp, *d);
+    switch (p_e->type) {
+        case SIM_EV_JOIN:
+            if(!d->open) {
+                Sim_send(p_s, p_lp, front, p_lp->now + SIM_MS(SIM_WALK_MS), SIM_EV_BOUNCE, p_e->a, 0);
+                break;
+            }
+            if(d->qLen == d->qCap) {
+                SIM_INVALID(p_lp, d->invalid, "Queue of desk %d of store %d is full.", p_lp->desk, p_lp->store);
+                break;
+            }
+            tail = (d->qHead + d->qLen++) % d->qCap;
+            SIM_SAVE(p_lp, d->qSlot[tail]);
+            SIM_SAVE(p_lp, d->qProducts[tail]);
+            d->qSlot[tail] = p_e->a;
+            d->qProducts[tail] = (int32_t) p_e->b;
+            if(!d->busy) pDesk_serve(p_s, p_lp, d);
+            break;
+        case SIM_EV_DONE:
+            d->busy = 0;
+            if(d->open) pDesk_serve(p_s, p_lp, d);
+            break;
+        case SIM_EV_OPEN:
+            if(!d->open) {
+                d->open = 1;
+                d->lastOpen = p_lp->now;
+            }
+            if(!d->busy) pDesk_serve(p_s, p_lp, d);
+            break;
+        case SIM_EV_CLOSE:
+            if(d->open) {
+                d->open = 0;
+                d->closures++;
+                d->openTime += p_lp->now - d->lastOpen;
+            }
+            //Users in queue move to other desks, the one being served completes the payment
+            for(; d->qLen > 0; d->qLen--, d->qHead = (d->qHead + 1) % d->qCap)
+                Sim_send(p_s, p_lp, front, p_lp->now + SIM_MS(SIM_WALK_MS), SIM_EV_BOUNCE, d->qSlot[d->qHead], 0);
+            break;
+        case SIM_EV_TICK:
+            Sim_send(p_s, p_lp, front, p_lp->now + d->TD, SIM_EV_REPORT, d->open, d->qLen);
+            Sim_send(p_s, p_lp, p_lp->id, p_lp->now + d->TD, SIM_EV_TICK, 0, 0);
+            break;
+        default:
+            ERR_QUIT("Unexpected event %d for desk %d of store %d.", p_e->type, p_lp->desk, p_lp->store);
+    }
+}
+
+/**
+ * @brief Read the parameters of a store from a market configuration file and check them as #Market_init does.
+ *
+ * @param p_conf configuration file.
+ * @param p_p where the parameters are placed.
+ * @return int: 1 good, 0 the file can't be read or it is not valid
+ */
+int SimModel_load(const char * p_conf, SimParams * p_p) {
+    FILE * f = NULL;
+    int res = 1;
+    if((f = fopen(p_conf, "r")) == NULL) {
+        ERR_SYS_MSG("Unable to open configuration file %s. Check the path and try again.", p_conf);
+        return 0;
+    }
+    if(Config_checkFile(f, NULL) != 1) res = 0;
+    res = pSimModel_getLong(f, "K", &p_p->K) && res;
+    res = pSimModel_getLong(f, "KS", &p_p->KS) && res;
+    res = pSimModel_getLong(f, "C", &p_p->C) && res;
+    res = pSimModel_getLong(f, "E", &p_p->E) && res;
+    res = pSimModel_getLong(f, "T", &p_p->T) && res;
+    res = pSimModel_getLong(f, "P", &p_p->P) && res;
+    res = pSimModel_getLong(f, "S1", &p_p->S1) && res;
+    res = pSimModel_getLong(f, "S2", &p_p->S2) && res;
+    res = pSimModel_getLong(f, "NP", &p_p->NP) && res;
+    res = pSimModel_getLong(f, "TD", &p_p->TD) && res;
+    fclose(f);
+    if(res && (p_p->K <= 0 || p_p->KS <= 0 || p_p->KS > p_p->K || p_p->C < 1 || p_p->E <= 0 || p_p->E > p_p->C ||
+        p_p->T <= 10 || p_p->P <= 0 || p_p->S1 <= 0 || p_p->S1 > p_p->K || p_p->S2 <= 0 || p_p->S2 > p_p->C ||
+        p_p->NP <= 0 || p_p->TD <= 0)) {
+        ERR_MSG("The configuration file %s does not satisfy the constraints of the market.\n", p_conf);
+        res = 0;
+    }
+    return res;
+}
+
+/**
+ * @brief Minimum delay of the events exchanged by the processes of a store.
+ */
+SimTime SimModel_lookahead(const SimParams * p_p) {
+    SimTime l = SIM_MS(SIM_WALK_MS);
+    if(SIM_MS(p_p->TD) < l) l = SIM_MS(p_p->TD);
+    if(SIM_MS(SIM_SERVICE_MIN_MS + p_p->NP) < l) l = SIM_MS(SIM_SERVICE_MIN_MS + p_p->NP);
+    return l;
+}
+
+/**
+ * @brief Init the front of a store.
+ *
+ * @param p_lp process of the front.
+ * @param p_p parameters of the store.
+ * @param p_a arena where the state is allocated.
+ * @param p_seed seed of the simulation.
+ * @return int: 1 good, 0 allocation error
+ */
+int SimModel_initFront(SimLP * p_lp, const SimParams * p_p, Arena * p_a, uint64_t p_seed) {
+    SimFront * f = NULL;
+    int C = (int) p_p->C, K = (int) p_p->K;
+    if((f = Arena_alloc(p_a, sizeof(SimFront))) == NULL ||
+        (f->id = Arena_alloc(p_a, C * sizeof(int32_t))) == NULL ||
+        (f->products = Arena_alloc(p_a, C * sizeof(int32_t))) == NULL ||
+        (f->changes = Arena_alloc(p_a, C * sizeof(int32_t))) == NULL ||
+        (f->tEntry = Arena_alloc(p_a, C * sizeof(SimTime))) == NULL ||
+        (f->tQueue = Arena_alloc(p_a, C * sizeof(SimTime))) == NULL ||
+        (f->freeSlots = Arena_alloc(p_a, C * sizeof(int32_t))) == NULL ||
+        (f->open = Arena_alloc(p_a, K)) == NULL ||
+        (f->hasReport = Arena_alloc(p_a, K)) == NULL ||
+        (f->repOpen = Arena_alloc(p_a, K)) == NULL ||
+        (f->repUsers = Arena_alloc(p_a, K * sizeof(int32_t))) == NULL)
+        return 0;
+    f->p = *p_p;
+    f->rng = pSimModel_seed(p_seed ^ ((uint64_t) p_lp->id << 32));
+    //Slot 0 is used first
+    for(int i = 0; i < C; i++) f->freeSlots[i] = C - 1 - i;
+    f->nFree = C;
+    f->nextId = 0;
+    for(int i = 0; i < K; i++) {
+        f->open[i] = i < p_p->KS;
+        f->hasReport[i] = 0;
+        f->repOpen[i] = 0;
+        f->repUsers[i] = 0;
+    }
+    f->nOpen = (int) p_p->KS;
+    f->nReports = 0;
+    f->users = f->productsOut = f->queueChanges = 0;
+    f->sumMarket = f->sumQueue = 0;
+    f->digest = FNV_OFFSET;
+    f->invalid = 0;
+    p_lp->state.front = f;
+    return 1;
+}
+
+/**
+ * @brief Init a desk of a store.
+ *
+ * @param p_lp process of the desk.
+ * @param p_p parameters of the store.
+ * @param p_desk desk number.
+ * @param p_a arena where the state is allocated.
+ * @param p_seed seed of the simulation.
+ * @return int: 1 good, 0 allocation error
+ */
+int SimModel_initDesk(SimLP * p_lp, const SimParams * p_p, int p_desk, Arena * p_a, uint64_t p_seed) {
+    SimDesk * d = NULL;
+    uint64_t rng = pSimModel_seed(p_seed ^ ((uint64_t) p_lp->id << 32));
+    if((d = Arena_alloc(p_a, sizeof(SimDesk))) == NULL ||
+        (d->qSlot = Arena_alloc(p_a, p_p->C * sizeof(int32_t))) == NULL ||
+        (d->qProducts = Arena_alloc(p_a, p_p->C * sizeof(int32_t))) == NULL)
+        return 0;
+    d->open = p_desk < p_p->KS;
+    d->busy = 0;
+    d->serviceConst = pSimModel_random(&rng, SIM_SERVICE_MIN_MS, SIM_SERVICE_MAX_MS);
+    d->NP = p_p->NP;
+    d->TD = SIM_MS(p_p->TD);
+    d->qHead = d->qLen = 0;
+    d->qCap = (int) p_p->C;
+    d->clients = d->products = d->closures = 0;
+    d->openTime = d->lastOpen = d->serviceTime = 0;
+    d->invalid = 0;
+    p_lp->state.desk = d;
+    return 1;
+}
+
+/**
+ * @brief Schedule the first events of a process (time 0).
+ */
+void SimModel_start(Sim * p_s, SimLP * p_lp) {
+    p_lp->now = 0;
+    if(p_lp->desk < 0) Sim_send(p_s, p_lp, p_lp->id, 0, SIM_EV_START, 0, 0);
+    else Sim_send(p_s, p_lp, p_lp->id, 0, SIM_EV_TICK, 0, 0);
+}
+
+/**
+ * @brief Process an event. The process can only change its own state and send events with #Sim_send.
+ */
+void SimModel_handle(Sim * p_s, SimLP * p_lp, const SimEvent * p_e) {
+    if(p_lp->desk < 0) pFront_handle(p_s, p_lp, p_e);
+    else pDesk_handle(p_s, p_lp, p_e);
+}
+
+/**
+ * @brief Close the accounts of a process at the end of the simulation.
+ *        Impossible events still counted at the end were not speculative: the run is not valid.
+ */
+void SimModel_finish(SimLP * p_lp, SimTime p_end) {
+    if((p_lp->desk < 0 ? p_lp->state.front->invalid : p_lp->state.desk->invalid) > 0)
+        ERR_QUIT("Process %d of store %d met impossible events.", p_lp->id, p_lp->store);
+    if(p_lp->desk >= 0 && p_lp->state.desk->open) {
+        p_lp->state.desk->openTime += p_end - p_lp->state.desk->lastOpen;
+        p_lp->state.desk->lastOpen = p_end;
+    }
+}
+
+/**
+ * @brief Results of a store.
+ *
+ * @param p_front process of the front of the store, followed by the processes of its desks.
+ * @param p_st where the results are placed.
+ */
+void SimModel_storeStats(SimLP * p_front, SimStoreStats * p_st) {
+    SimFront * f = p_front->state.front;
+    SimDesk * d = NULL;
+    p_st->users = f->users;
+    p_st->queueChanges = f->queueChanges;
+    p_st->sumMarket = f->sumMarket;
+    p_st->sumQueue = f->sumQueue;
+    p_st->clients = p_st->products = p_st->closures = 0;
+    p_st->openTime = 0;
+    p_st->digest = f->digest;
+    for(int i = 1; i <= f->p.K; i++) {
+        d = p_front[i].state.desk;
+        p_st->clients += d->clients;
+        p_st->products += d->products;
+        p_st->closures += d->closures;
+        p_st->openTime += d->openTime;
+        p_st->digest = pSimModel_hash(p_st->digest, d->clients);
+        p_st->digest = pSimModel_hash(p_st->digest, d->closures);
+        p_st->digest = pSimModel_hash(p_st->digest, d->openTime);
+    }
+}
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
+#include <pthread.h>
+#include <Arena.h>
+#include <SQueue.h>
+#include <TMarket.h>
+#include <utilities.h>
+
+#define TEST_CONF "configFiles/Test/config_arena.txt"
+#define TEST_BAD_CONF "configFiles/Test/config_badscale.txt"
+#define TEST_LOG "log_test_arena.txt"
+
+atomic_int sig_hup=0; /**< SIGHUP signal indicator */
+atomic_int sig_quit=0; /**< SIGQUIT signal indicator */
+
+//Testing variables
+static int testId = 0;
+static int err = 0; //test cases error counter
+static int pass = 0; //test cases passed counter
+
+//Heap calls made by the objects under test (the executable is linked with --wrap=malloc,calloc,realloc)
+static long g_heapCalls = 0;
+void * __real_malloc(size_t p_size);
+void * __real_calloc(size_t p_n, size_t p_size);
+void * __real_realloc(void * p_ptr, size_t p_size);
+void * __wrap_malloc(size_t p_size) { __atomic_add_fetch(&g_heapCalls, 1, __ATOMIC_RELAXED); return __real_malloc(p_size); }
+void * __wrap_calloc(size_t p_n, size_t p_size) { __atomic_add_fetch(&g_heapCalls, 1, __ATOMIC_RELAXED); return __real_calloc(p_n, p_size); }
+void * __wrap_realloc(void * p_ptr, size_t p_size) { __atomic_add_fetch(&g_heapCalls, 1, __ATOMIC_RELAXED); return __real_realloc(p_ptr, p_size); }
+static long heapCalls() { return __atomic_load_n(&g_heapCalls, __ATOMIC_RELAXED); }
+
+void setupTest(){
+    testId = 0;
+    err = 0; //test cases error counter
+    pass = 0; //test cases passed counter
+}
+
+void testCaseExe(int p_exp);
+
+void testCaseExe(int p_exp) {
+    printf("Test %3d: ",testId);
+    if(p_exp){ printf("passed.\n"); pass++;}
+    else {printf("failed.\n"); err++;}
+    testId++;
+}
+
+void printSummary(){
+    int tot = pass + err;
+    printf("Test summary:\n -passed: %d/%d\n -failed: %d/%d\n",pass, tot, err, tot);
+}
+
+void test_Pool(){
+    Arena a;
+    Pool * p = NULL;
+    void * b[10];
+    void * x = NULL;
+    long calls = 0, nChunks = 0;
+
+    setupTest();
+    printf("**START TEST - test_Pool**\n");
+    testCaseExe(Arena_init(&a, 4096) == 1);
+    testCaseExe((p = Pool_init(&a, 24, 10, 5)) != NULL);
+    testCaseExe(p->blockSize % ARENA_ALIGN == 0 && p->nTot == 10 && p->nFree == 10);
+    calls = heapCalls();
+    for(int i=0;i<10;i++) b[i] = Pool_alloc(p);
+    testCaseExe(p->nFree == 0 && heapCalls() == calls);
+    testCaseExe(((uintptr_t) b[3]) % ARENA_ALIGN == 0);
+    Pool_free(p, b[3]);
+    testCaseExe((x = Pool_alloc(p)) == b[3]); //freed blocks are reused
+    testCaseExe(Pool_alloc(p) != NULL && p->nTot == 15); //empty pool grows by 5 blocks
+    testCaseExe(heapCalls() == calls); //...taken from the current chunk
+    testCaseExe(Arena_alloc(&a, 10000) != NULL && a.nChunks == 2); //big requests get their own chunk
+    x = Arena_alloc(&a, 8);
+    testCaseExe(((uintptr_t) (b[0] = Arena_allocAligned(&a, 100, CACHE_LINE))) % CACHE_LINE == 0 && b[0] > x);
+    nChunks = a.nChunks;
+    testCaseExe(((uintptr_t) Arena_allocAligned(&a, 5000, CACHE_LINE)) % CACHE_LINE == 0 && a.nChunks == nChunks + 1);
+    Arena_release(&a);
+    printf("**END TEST - test_Pool**\n");
+    printSummary();
+}
+
+void test_SQueuePool(){
+    Arena a;
+    Pool * p = NULL;
+    SQueue * q = NULL;
+    void * aux = NULL;
+    long calls = 0;
+    int x = 0;
+
+    setupTest();
+    printf("**START TEST - test_SQueuePool**\n");
+    testCaseExe(Arena_init(&a, 64 * 1024) == 1);
+    testCaseExe((p = Pool_init(&a, sizeof(Node), 16, 16)) != NULL);
+    testCaseExe((q = SQueue_initPool(-1, p)) != NULL);
+    calls = heapCalls();
+    for(int round=0;round<100;round++) {
+        for(int i=0;i<200;i++) SQueue_push(q, &x);
+        for(int i=0;i<200;i++) SQueue_pop(q, &aux);
+    }
+    testCaseExe(SQueue_isEmpty(q) == 1);
+    testCaseExe(p->nTot == 208); //pool grown only in the first round
+    testCaseExe(q->nSpare == SQUEUE_SPARE_MAX);
+    testCaseExe(heapCalls() == calls);
+    testCaseExe(SQueue_deleteQueue(q, NULL) == 1);
+    testCaseExe(p->nFree == p->nTot);
+    Arena_release(&a);
+    printf("**END TEST - test_SQueuePool**\n");
+    printSummary();
+}
+
+void test_MarketSteadyState(){
+    Market * m = NULL;
+    long calls = 0;
+
+    setupTest();
+    printf("**START TEST - test_MarketSteadyState**\n");
+    unlink(TEST_LOG);
+    //A rejected config doesn't set the time scale of the process
+    testCaseExe(Market_init(TEST_BAD_CONF, TEST_LOG, NULL) == NULL && canSetTimeScale(3) == 1);
+    unlink(TEST_LOG);
+    testCaseExe((m = Market_init(TEST_CONF, TEST_LOG, NULL)) != NULL);
+    if(m == NULL) return;
+    testCaseExe(Market_startThread(m) == 0);
+    waitMs(1000); //warm-up: all threads started, pools reached their working size
+    calls = heapCalls();
+    waitMs(2000);
+    printf("Heap calls in steady state: %ld\n", heapCalls() - calls);
+    testCaseExe(heapCalls() == calls);
+    sig_hup = 1;
+    Market_Signal(m);
+    testCaseExe(Market_joinThread(m) == 0);
+    testCaseExe(Market_delete(m) == 1);
+    unlink(TEST_LOG);
+    printf("**END TEST - test_MarketSteadyState**\n");
+    printSummary();
+}
+
+int main() {
+    test_Pool();
+    test_SQueuePool();
+    test_MarketSteadyState();
+    return 0;
+}
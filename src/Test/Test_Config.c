@@ -40,7 +40,7 @@ static void runTest(void (test_fun)(char *), char * p_title){
 static void test1(){
     //Check if all the str_auxues are correctly retrieved from config file
     openFile("./configFiles/Test/config_test1.txt");
-    testCaseExe(1,Config_checkFile(f)==1);
+    testCaseExe(1,Config_checkFile(f, NULL)==1);
     testCaseExe(2, Config_getValue(f, "K", str_aux) == 1 && Config_parseLong(&val, str_aux) == 1 && val == 6 );
     testCaseExe(3, Config_getValue(f, "KS", str_aux) == 1 && Config_parseLong(&val, str_aux) == 1 && val == 3 );
     testCaseExe(4, Config_getValue(f, "C", str_aux) == 1 && Config_parseLong(&val, str_aux) == 1 && val == 50 );
@@ -58,19 +58,19 @@ static void test1(){
 static void test2(){
     //Comment check 
     openFile("./configFiles/Test/config_test2.txt");
-    testCaseExe(1,Config_checkFile(f)==0);
+    testCaseExe(1,Config_checkFile(f, NULL)==0);
 }
 
 static void test3(){
     //Check if duplication of config elements is
     openFile("./configFiles/Test/config_test3.txt");
-    testCaseExe(1,Config_checkFile(f)==0);
+    testCaseExe(1,Config_checkFile(f, NULL)==0);
 }
 
 static void test4(){
     //Check if some config elements are missing
     openFile("./configFiles/Test/config_test4.txt");
-    testCaseExe(1,Config_checkFile(f)==1);
+    testCaseExe(1,Config_checkFile(f, NULL)==1);
     testCaseExe(2, Config_getValue(f, "KS", str_aux) == 0);
     testCaseExe(3, Config_getValue(f, "P", str_aux) == 0);
     testCaseExe(4, Config_getValue(f, "NP", str_aux) == 0);
@@ -80,13 +80,13 @@ static void test4(){
 static void test5(){
     //Empty File
     openFile("./configFiles/Test/config_test5.txt");
-    testCaseExe(1,Config_checkFile(f)==1);
+    testCaseExe(1,Config_checkFile(f, NULL)==1);
 }
 
 static void test6(){
     //Wrong format
     openFile("./configFiles/Test/config_test6.txt");
-    testCaseExe(1,Config_checkFile(f)==0);
+    testCaseExe(1,Config_checkFile(f, NULL)==0);
     testCaseExe(2, Config_getValue(f, "KS", str_aux) == 0);
 
 }
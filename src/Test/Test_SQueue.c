@@ -3,7 +3,17 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <SQueue.h>
+#include <SRing.h>
+#include <Mailbox.h>
+#include <UQueue.h>
+#include <WSDeque.h>
+#include <TExecutor.h>
+#include <DeskBoard.h>
+#include <utilities.h>
+#include <stddef.h>
+#include <Arena.h>
 #include <pthread.h>
+#include <sched.h>
 
 //Testing variables
 static int testId = 0;
@@ -203,8 +213,462 @@ void test_MultiThread(){
     printf("Test summary:\n -passed: %d/%d\n -failed: %d/%d\n",pass, tot, err, tot);
 }
 
+void test_Bulk(){
+    int tot=0;
+    int v[5] = {1,2,3,4,5};
+    void * in[5] = {&v[0], &v[1], &v[2], &v[3], &v[4]};
+    void * out[5];
+    SQueue * q = NULL;
+
+    setupTest();
+    printf("**START TEST - test_Bulk**\n");
+    testCaseExe((q = SQueue_init(4))!= NULL );
+    testCaseExe(SQueue_pushAll(q, in, 5) == -2); //No room for all: nothing is added
+    testCaseExe(SQueue_dim(q) == 0);
+    testCaseExe(SQueue_pushAll(q, in, 3) == 1);
+    testCaseExe(SQueue_pushAll(q, in, 0) == 1);
+    testCaseExe(SQueue_dim(q) == 3);
+    testCaseExe(SQueue_popAll(q, out, 2) == 2);
+    testCaseExe(*(int *)out[0] == 1 && *(int *)out[1] == 2);
+    testCaseExe(SQueue_popAll(q, out, 5) == 1);
+    testCaseExe(*(int *)out[0] == 3);
+    testCaseExe(SQueue_popAll(q, out, 5) == 0);
+    testCaseExe(SQueue_popAll(NULL, out, 5) == -1);
+    testCaseExe(SQueue_popAll(q, NULL, 5) == -3);
+    SQueue_deleteQueue(q, NULL);
+    printf("**END TEST - test_Bulk**\n");
+
+    tot = pass + err;
+    printf("Test summary:\n -passed: %d/%d\n -failed: %d/%d\n",pass, tot, err, tot);
+}
+
+#define RING_N 100000
+static void * ringProducer(void * p_arg) {
+    SRing * r = (SRing *) p_arg;
+    for(long i = 0; i < RING_N; i++)
+        while (SRing_push(r, &i) != 1) sched_yield();
+    return NULL;
+}
+
+void test_SRing(){
+    int tot=0;
+    void * mem = NULL;
+    SRing * r = NULL;
+    long x = 0, expected = 0;
+    int isOrdered = 1;
+    pthread_t th;
+
+    setupTest();
+    printf("**START TEST - test_SRing**\n");
+    testCaseExe((mem = aligned_alloc(SRING_CACHE_LINE, SRing_size(8, sizeof(long)))) != NULL);
+    testCaseExe(SRing_init(mem, 6, sizeof(long)) == NULL); //capacity must be a power of 2
+    testCaseExe((r = SRing_init(mem, 8, sizeof(long))) != NULL);
+    testCaseExe(SRing_pop(r, &x) == 0);
+    for(x = 0; x < 8; x++) SRing_push(r, &x);
+    testCaseExe(SRing_push(r, &x) == 0); //full
+    testCaseExe(SRing_pop(r, &x) == 1 && x == 0);
+    testCaseExe(SRing_push(r, &x) == 1); //wrap around
+    //One producer and one consumer
+    while (SRing_pop(r, &x) == 1) ;
+    testCaseExe(pthread_create(&th, NULL, ringProducer, r) == 0);
+    while (expected < RING_N) {
+        if(SRing_pop(r, &x) != 1) {
+            sched_yield(); //the producer may run on the same core
+            continue;
+        }
+        if(x != expected) isOrdered = 0;
+        expected++;
+    }
+    pthread_join(th, NULL);
+    testCaseExe(isOrdered == 1 && SRing_pop(r, &x) == 0);
+    free(mem);
+    printf("**END TEST - test_SRing**\n");
+
+    tot = pass + err;
+    printf("Test summary:\n -passed: %d/%d\n -failed: %d/%d\n",pass, tot, err, tot);
+}
+
+#define MAILBOX_N 20000
+typedef struct {
+    SQueue * q;
+    Mailbox * b;
+} MailboxArg;
+
+static void * mailboxProducer(void * p_arg) {
+    MailboxArg * a = (MailboxArg *) p_arg;
+    for(long i = 0; i < MAILBOX_N; i++) {
+        SQueue_push(a->q, (void *) i);
+        Mailbox_post(a->b, MAILBOX_USER);
+        if(i % 1000 == 0) sched_yield(); //let the consumer sleep sometimes
+    }
+    return NULL;
+}
+
+void test_Mailbox(){
+    int tot=0;
+    Mailbox b;
+    MailboxArg a;
+    void * data = NULL;
+    long expected = 0;
+    int isOrdered = 1;
+    pthread_t th;
+
+    setupTest();
+    printf("**START TEST - test_Mailbox**\n");
+    Mailbox_init(&b);
+    testCaseExe(Mailbox_take(&b) == 0);
+    Mailbox_post(&b, MAILBOX_USER);
+    Mailbox_post(&b, MAILBOX_STATE);
+    testCaseExe(Mailbox_wait(&b) == (MAILBOX_USER | MAILBOX_STATE)); //news already posted: no wait
+    testCaseExe(Mailbox_take(&b) == 0);
+    //The consumer sleeps only when the queue is empty, and no wakeup is lost
+    testCaseExe((a.q = SQueue_init(-1)) != NULL);
+    a.b = &b;
+    testCaseExe(pthread_create(&th, NULL, mailboxProducer, &a) == 0);
+    while (expected < MAILBOX_N) {
+        if(SQueue_pop(a.q, &data) != 1) {
+            Mailbox_wait(&b);
+            continue;
+        }
+        if((long) data != expected) isOrdered = 0;
+        expected++;
+    }
+    pthread_join(th, NULL);
+    testCaseExe(isOrdered == 1 && SQueue_isEmpty(a.q) == 1);
+    SQueue_deleteQueue(a.q, NULL);
+    printf("**END TEST - test_Mailbox**\n");
+
+    tot = pass + err;
+    printf("Test summary:\n -passed: %d/%d\n -failed: %d/%d\n",pass, tot, err, tot);
+}
+
+void test_UQueue(){
+    int tot=0;
+    Arena a;
+    UQueueLinks * l = NULL;
+    UQueue q, r;
+    int u = -1;
+    int expected[] = {1, 3, 5, 6};
+    int32_t visits[8] = {0};
+    int isOrdered = 1;
+
+    setupTest();
+    printf("**START TEST - test_UQueue**\n");
+    testCaseExe(Arena_init(&a, 4096) == 1 && (l = UQueueLinks_init(&a, 8)) != NULL);
+    testCaseExe(UQueue_init(&q, 0, l) == 1 && UQueue_init(&r, 1, l) == 1);
+    testCaseExe(UQueue_isEmpty(&q) == 1 && UQueue_pop(&q, &u) == 0);
+    for(int i = 0; i < 8; i++) UQueue_push(&q, i);
+    testCaseExe(UQueue_dim(&q) == 8);
+    //Removal from the head, the tail and the middle
+    testCaseExe(UQueue_remove(&q, 0) == 1 && UQueue_remove(&q, 7) == 1 && UQueue_remove(&q, 4) == 1);
+    testCaseExe(UQueue_remove(&q, 4) == 0 && UQueue_dim(&q) == 5);
+    //A user moves to another queue of the group
+    testCaseExe(UQueue_remove(&r, 2) == 0 && UQueue_remove(&q, 2) == 1);
+    UQueue_push(&r, 2);
+    testCaseExe(UQueue_remove(&q, 2) == 0 && UQueue_dim(&r) == 1);
+    for(int i = 0; i < 4; i++) isOrdered = UQueue_pop(&q, &u) == 1 && u == expected[i] ? isOrdered : 0;
+    testCaseExe(isOrdered == 1 && UQueue_isEmpty(&q) == 1 && q.head == UQUEUE_NONE && q.tail == UQUEUE_NONE);
+    UQueue_push(&q, 0);
+    testCaseExe(UQueue_pop(&r, &u) == 1 && u == 2 && UQueue_pop(&q, &u) == 1 && u == 0);
+    //A whole queue is spliced at the tail of another one, in order (each user counts one more queue visited)
+    l->visits = visits;
+    for(int i = 0; i < 3; i++) UQueue_push(&q, i);
+    UQueue_push(&r, 7);
+    testCaseExe(UQueue_detach(&q, &u) == 3 && u == 0 && UQueue_isEmpty(&q) == 1 && UQueue_remove(&q, 1) == 0);
+    testCaseExe(UQueue_pushChain(&r, 0, 2) == 3 && UQueue_dim(&r) == 4 && UQueue_remove(&r, 1) == 1);
+    testCaseExe(visits[0] == 2 && visits[1] == 2 && visits[7] == 1 && visits[3] == 0);
+    expected[0] = 7; expected[1] = 0; expected[2] = 2;
+    for(int i = 0; i < 3; i++) isOrdered = UQueue_pop(&r, &u) == 1 && u == expected[i] ? isOrdered : 0;
+    testCaseExe(isOrdered == 1 && UQueue_isEmpty(&r) == 1);
+    UQueue_delete(&q);
+    UQueue_delete(&r);
+    Arena_release(&a);
+    printf("**END TEST - test_UQueue**\n");
+
+    tot = pass + err;
+    printf("Test summary:\n -passed: %d/%d\n -failed: %d/%d\n",pass, tot, err, tot);
+}
+
+#define WSDEQUE_N 200000
+typedef struct {
+    WSDeque * d;
+    atomic_int * taken;
+    atomic_int isDone;
+} WSDequeArg;
+
+static void * wsdequeThief(void * p_arg) {
+    WSDequeArg * a = (WSDequeArg *) p_arg;
+    void * x = NULL;
+    while (!atomic_load(&a->isDone) || WSDeque_dim(a->d) > 0) {
+        if((x = WSDeque_steal(a->d)) == NULL || x == WSDEQUE_ABORT) continue;
+        atomic_fetch_add(&a->taken[(long) x - 1], 1);
+    }
+    return NULL;
+}
+
+void test_WSDeque(){
+    int tot=0;
+    WSDeque * d = NULL;
+    WSDequeArg a;
+    pthread_t th[2];
+    void * x = NULL;
+    int isOrdered = 1, isOnce = 1;
+
+    setupTest();
+    printf("**START TEST - test_WSDeque**\n");
+    testCaseExe((d = aligned_alloc(CACHE_LINE, sizeof(WSDeque))) != NULL && WSDeque_init(d, 4) == 1);
+    testCaseExe(WSDeque_pop(d) == NULL && WSDeque_steal(d) == NULL);
+    //The owner pops the newest item, thieves steal the oldest one (the array grows from 16 items)
+    for(long i = 1; i <= 100; i++) WSDeque_push(d, (void *) i);
+    testCaseExe(WSDeque_dim(d) == 100 && atomic_load(&d->array)->cap == 128);
+    testCaseExe(WSDeque_steal(d) == (void *) 1 && WSDeque_pop(d) == (void *) 100);
+    for(long i = 99; i >= 2; i--) isOrdered = WSDeque_pop(d) == (void *) i ? isOrdered : 0;
+    testCaseExe(isOrdered == 1 && WSDeque_pop(d) == NULL && WSDeque_dim(d) == 0);
+    //Two thieves and the owner: each item is taken exactly once
+    a.d = d;
+    a.taken = calloc(WSDEQUE_N, sizeof(atomic_int));
+    atomic_init(&a.isDone, 0);
+    for(int i = 0; i < 2; i++) pthread_create(&th[i], NULL, wsdequeThief, &a);
+    for(long i = 1; i <= WSDEQUE_N; i++) {
+        WSDeque_push(d, (void *) i);
+        if(i % 3 == 0 && (x = WSDeque_pop(d)) != NULL) atomic_fetch_add(&a.taken[(long) x - 1], 1);
+        if(i % 1000 == 0) sched_yield();
+    }
+    while ((x = WSDeque_pop(d)) != NULL) atomic_fetch_add(&a.taken[(long) x - 1], 1);
+    atomic_store(&a.isDone, 1);
+    for(int i = 0; i < 2; i++) pthread_join(th[i], NULL);
+    for(long i = 0; i < WSDEQUE_N; i++) isOnce = atomic_load(&a.taken[i]) == 1 ? isOnce : 0;
+    testCaseExe(isOnce == 1);
+    free(a.taken);
+    WSDeque_delete(d);
+    free(d);
+    printf("**END TEST - test_WSDeque**\n");
+
+    tot = pass + err;
+    printf("Test summary:\n -passed: %d/%d\n -failed: %d/%d\n",pass, tot, err, tot);
+}
+
+#define EXECUTOR_N 2000
+#define EXECUTOR_TICKS 10
+typedef struct {
+    ExecTask task;
+    Executor * e;
+    Mailbox * done; /**< posted when all the tasks ended */
+    atomic_int * nLeft; /**< tasks not ended yet */
+    int children; /**< tasks still to be submitted by this one */
+    int ticks; /**< timed runs still to do */
+    int isLate; /**< 1: a timed run started before its time */
+    SQueue * q; /**< mailbox test: items to take */
+    Mailbox box; /**< mailbox test: mailbox of the task */
+    long taken; /**< mailbox test: items taken */
+} ExecArg;
+
+static void pExecEnd(ExecArg * p_a) {
+    if(atomic_fetch_sub(p_a->nLeft, 1) == 1) Mailbox_post(p_a->done, MAILBOX_WAKE);
+}
+
+//A task that submits a child on its own deque (stolen by the idle workers), then ends
+static void pExecSpawn(ExecTask * p_t) {
+    ExecArg * a = (ExecArg *) p_t;
+    if(a->children > 0) {
+        a->children--;
+        Executor_submit(a->e, p_t);
+        return;
+    }
+    pExecEnd(a);
+}
+
+//A task run every ms, EXECUTOR_TICKS times
+static void pExecTick(ExecTask * p_t) {
+    ExecArg * a = (ExecArg *) p_t;
+    if(p_t->due > 0 && getCurrentTimeNs() < p_t->due) a->isLate = 1;
+    if(a->ticks-- > 0) Executor_submitAt(a->e, p_t, getCurrentTimeNs() + 1000000);
+    else pExecEnd(a);
+}
+
+//A task that takes all the items of its queue, then parks on its mailbox
+static void pExecTake(ExecTask * p_t) {
+    ExecArg * a = (ExecArg *) p_t;
+    void * x = NULL;
+    while (1) {
+        Mailbox_take(&a->box);
+        while (SQueue_pop(a->q, &x) == 1) a->taken++;
+        if(a->taken == MAILBOX_N) {
+            pExecEnd(a);
+            return;
+        }
+        if(Mailbox_park(&a->box)) return;
+    }
+}
+
+static void pExecWake(void * p_arg) {
+    ExecArg * a = (ExecArg *) p_arg;
+    Executor_submit(a->e, &a->task);
+}
+
+static void * execPoster(void * p_arg) {
+    ExecArg * a = (ExecArg *) p_arg;
+    for(long i = 0; i < MAILBOX_N; i++) {
+        SQueue_push(a->q, (void *) i);
+        Mailbox_post(&a->box, MAILBOX_USER);
+        if(i % 1000 == 0) sched_yield(); //let the task park sometimes
+    }
+    return NULL;
+}
+
+void test_Executor(){
+    int tot=0;
+    Executor * e = NULL;
+    ExecArg * args = NULL, take;
+    Mailbox done;
+    atomic_int nLeft;
+    pthread_t th;
+    int isLate = 0;
+
+    setupTest();
+    printf("**START TEST - test_Executor**\n");
+    testCaseExe(Executor_init(0) == NULL);
+    testCaseExe((e = Executor_init(3)) != NULL && Executor_startThreads(e) == 0 && (args = calloc(EXECUTOR_N, sizeof(ExecArg))) != NULL);
+    Mailbox_init(&done);
+    //Tasks submitted from out of the pool, which submit again themselves from the workers
+    atomic_init(&nLeft, EXECUTOR_N);
+    for(int i = 0; i < EXECUTOR_N; i++) {
+        args[i] = (ExecArg) {{pExecSpawn, NULL, 0}, e, &done, &nLeft, 5, 0, 0, NULL, {0}, 0};
+        Executor_submit(e, &args[i].task);
+    }
+    while (atomic_load(&nLeft) > 0) Mailbox_wait(&done);
+    testCaseExe(args[0].children == 0 && args[EXECUTOR_N - 1].children == 0);
+    //Timed tasks never run before their time
+    atomic_store(&nLeft, 50);
+    for(int i = 0; i < 50; i++) {
+        args[i] = (ExecArg) {{pExecTick, NULL, 0}, e, &done, &nLeft, 0, EXECUTOR_TICKS, 0, NULL, {0}, 0};
+        Executor_submitAt(e, &args[i].task, getCurrentTimeNs() + 1000000);
+    }
+    while (atomic_load(&nLeft) > 0) Mailbox_wait(&done);
+    for(int i = 0; i < 50; i++) isLate |= args[i].isLate || args[i].ticks != -1;
+    testCaseExe(isLate == 0);
+    //A task parked on a mailbox is run again by the first post, and no post is lost
+    atomic_store(&nLeft, 1);
+    take = (ExecArg) {{pExecTake, NULL, 0}, e, &done, &nLeft, 0, 0, 0, SQueue_init(-1), {0}, 0};
+    Mailbox_initTask(&take.box, pExecWake, &take);
+    testCaseExe(pthread_create(&th, NULL, execPoster, &take) == 0);
+    Executor_submit(e, &take.task);
+    while (atomic_load(&nLeft) > 0) Mailbox_wait(&done);
+    pthread_join(th, NULL);
+    testCaseExe(take.taken == MAILBOX_N && SQueue_isEmpty(take.q) == 1);
+    SQueue_deleteQueue(take.q, NULL);
+    testCaseExe(Executor_delete(e) == 1);
+    free(args);
+    printf("**END TEST - test_Executor**\n");
+
+    tot = pass + err;
+    printf("Test summary:\n -passed: %d/%d\n -failed: %d/%d\n",pass, tot, err, tot);
+}
+
+#define DESKBOARD_N 4099 //prime, not a multiple of the SIMD width
+#define DESKBOARD_S2 5
+#define DESKBOARD_ROUNDS 200
+
+//Count done by the director before the board: a scan of the last status of every desk
+static void pDeskBoardScan(const int * p_open, const int * p_users, int p_n, int * p_noWork, int * p_busy) {
+    *p_noWork = *p_busy = 0;
+    for(int i = 0; i < p_n; i++) {
+        if(p_open[i] && p_users[i] <= 1) (*p_noWork)++;
+        if(p_open[i] && p_users[i] >= DESKBOARD_S2) (*p_busy)++;
+    }
+}
+
+//Time of a decision after each report of p_k desks: with the board, and with a scan of the desks
+static void pDeskBoardBench(Arena * p_a, int p_k, int * p_open, int * p_users) {
+    DeskBoard b;
+    int64_t start = 0, tBoard = 0, tScan = 0;
+    int noWork = 0, busy = 0, sink = 0;
+    int boardRounds = 200000 / p_k + 1, scanRounds = 3; //the scan is O(K) per report: few rounds are enough
+    if(DeskBoard_init(&b, p_a, p_k, DESKBOARD_S2) != 1) return;
+    start = getCurrentTimeNs();
+    for(int r = 0; r < boardRounds; r++) {
+        for(int i = 0; i < p_k; i++) {
+            DeskBoard_report(&b, i, 1, (i + r) % 8);
+            sink += b.nNoWork + b.nBusy;
+        }
+        DeskBoard_nextRound(&b);
+    }
+    tBoard = getCurrentTimeNs() - start;
+    start = getCurrentTimeNs();
+    for(int r = 0; r < scanRounds; r++) {
+        for(int i = 0; i < p_k; i++) {
+            p_open[i] = 1;
+            p_users[i] = (i + r) % 8;
+            pDeskBoardScan(p_open, p_users, p_k, &noWork, &busy);
+            sink += noWork + busy;
+        }
+    }
+    tScan = getCurrentTimeNs() - start;
+    printf("K=%d: %.1f ns per decision with the board, %.1f ns with a scan (%d)\n", p_k,
+        (double) tBoard / ((double) boardRounds * p_k), (double) tScan / ((double) scanRounds * p_k), sink & 1);
+}
+
+void test_DeskBoard(){
+    int tot=0;
+    Arena a;
+    DeskBoard b;
+    int * open = NULL, * users = NULL;
+    int noWork = 0, busy = 0, expNoWork = 0, expBusy = 0;
+    int isExact = 1, isComplete = 0, id = 0, next = 0;
+    unsigned seed = 1;
+
+    setupTest();
+    printf("**START TEST - test_DeskBoard**\n");
+    testCaseExe(Arena_init(&a, 4096) == 1 && DeskBoard_init(&b, &a, DESKBOARD_N, DESKBOARD_S2) == 1);
+    testCaseExe((open = calloc(DESKBOARD_N, sizeof(int))) != NULL && (users = calloc(DESKBOARD_N, sizeof(int))) != NULL);
+    DeskBoard_count(&b, &noWork, &busy);
+    testCaseExe(noWork == 0 && busy == 0 && b.nReported == 0);
+    //Random reports, some desks reporting more than once: the aggregates match a scan of the last reports
+    for(int r = 0; r < DESKBOARD_ROUNDS; r++) {
+        for(int i = 0; i < DESKBOARD_N; i++) open[i] = 0; //desks not reported yet don't count
+        next = 0;
+        do {
+            //Desks report in a different order each round (DESKBOARD_N is prime), with repeated reports
+            if(next < DESKBOARD_N && rand_r(&seed) % 4 != 0) id = (int) (((long) next++ * (r + 1) + r) % DESKBOARD_N);
+            else id = rand_r(&seed) % DESKBOARD_N;
+            open[id] = rand_r(&seed) % 4 != 0;
+            users[id] = rand_r(&seed) % (2 * DESKBOARD_S2);
+            isComplete = DeskBoard_report(&b, id, open[id], users[id]);
+            if(isComplete == 0 && rand_r(&seed) % 1024 == 0) {
+                DeskBoard_count(&b, &noWork, &busy);
+                pDeskBoardScan(open, users, DESKBOARD_N, &expNoWork, &expBusy);
+                isExact &= noWork == expNoWork && busy == expBusy && b.nNoWork == noWork && b.nBusy == busy;
+            }
+        } while (isComplete == 0);
+        pDeskBoardScan(open, users, DESKBOARD_N, &expNoWork, &expBusy);
+        isExact &= b.nReported == DESKBOARD_N && b.nNoWork == expNoWork && b.nBusy == expBusy && DeskBoard_verify(&b) == 1;
+        DeskBoard_nextRound(&b);
+    }
+    testCaseExe(isExact == 1);
+    //A wrong aggregate is found and corrected
+    DeskBoard_report(&b, 0, 1, 0);
+    b.nNoWork += 3;
+    testCaseExe(DeskBoard_verify(&b) == 0 && b.nNoWork == 1 && DeskBoard_verify(&b) == 1);
+    pDeskBoardBench(&a, 16, open, users);
+    pDeskBoardBench(&a, 4096, open, users);
+    free(open);
+    free(users);
+    Arena_release(&a);
+    printf("**END TEST - test_DeskBoard**\n");
+
+    tot = pass + err;
+    printf("Test summary:\n -passed: %d/%d\n -failed: %d/%d\n",pass, tot, err, tot);
+}
+
 int main() {
     test_SingleThread();
+    test_Bulk();
+    test_SRing();
+    test_Mailbox();
+    test_UQueue();
+    test_WSDeque();
+    test_Executor();
+    test_DeskBoard();
     test_MultiThread();
     return 0;
 }
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <Sim.h>
+#include <utilities.h>
+
+#define TEST_CONF "configFiles/config_test.txt"
+#define TEST_CHAIN "configFiles/Test/chain_sim.txt"
+#define TEST_END SIM_MS(20000)
+
+//Testing variables
+static int testId = 0;
+static int err = 0; //test cases error counter
+static int pass = 0; //test cases passed counter
+
+void setupTest(){
+    testId = 0;
+    err = 0; //test cases error counter
+    pass = 0; //test cases passed counter
+}
+
+void testCaseExe(int p_exp);
+
+void testCaseExe(int p_exp) {
+    printf("Test %3d: ",testId);
+    if(p_exp){ printf("passed.\n"); pass++;}
+    else {printf("failed.\n"); err++;}
+    testId++;
+}
+
+void printSummary(){
+    int tot = pass + err;
+    printf("Test summary:\n -passed: %d/%d\n -failed: %d/%d\n",pass, tot, err, tot);
+}
+
+void test_SimHeap(){
+    SimHeap h;
+    SimEvent e, last;
+    int isOrdered = 1;
+
+    setupTest();
+    printf("**START TEST - test_SimHeap**\n");
+    testCaseExe(SimHeap_init(&h, 4) == 1);
+    testCaseExe(SimHeap_next(&h) == SIM_TIME_MAX);
+    testCaseExe(SimHeap_pop(&h, &e) == 0);
+    //Equal times are ordered by sender and sequence number
+    for(int i = 0; i < 1000; i++) {
+        e.t = (i * 7919) % 97;
+        e.src = i % 3;
+        e.seq = i;
+        e.dst = e.type = e.a = 0;
+        e.b = 0;
+        SimHeap_push(&h, &e);
+    }
+    testCaseExe(h.n == 1000);
+    SimHeap_pop(&h, &last);
+    while (SimHeap_pop(&h, &e) == 1) {
+        if(SimEvent_before(&e, &last)) isOrdered = 0;
+        last = e;
+    }
+    testCaseExe(isOrdered);
+    testCaseExe(h.n == 0);
+    SimHeap_delete(&h);
+    printf("**END TEST - test_SimHeap**\n");
+    printSummary();
+}
+
+void test_SimCalendar(){
+    SimCalendar c;
+    SimHeap h;
+    SimEvent e, f;
+    int isSame = 1;
+    long n = 0;
+
+    setupTest();
+    printf("**START TEST - test_SimCalendar**\n");
+    testCaseExe(SimCalendar_init(&c) == 1 && SimHeap_init(&h, 4) == 1);
+    testCaseExe(SimCalendar_next(&c) == SIM_TIME_MAX);
+    testCaseExe(SimCalendar_pop(&c, &e) == 0);
+    //Same sequence as the heap while the calendar grows, shrinks and gets events before the current day
+    e.dst = e.type = e.a = 0;
+    e.b = 0;
+    for(int i = 0; i < 20000; i++) {
+        if(i % 3 != 2 || c.n == 0) {
+            e.t = SIM_MS((i * 7919L) % 1500) + (i % 5 == 0 ? 0 : i % 4);
+            e.src = i % 7;
+            e.seq = i;
+            SimCalendar_push(&c, &e);
+            SimHeap_push(&h, &e);
+        } else {
+            SimCalendar_pop(&c, &e);
+            SimHeap_pop(&h, &f);
+            if(e.t != f.t || e.src != f.src || e.seq != f.seq) isSame = 0;
+        }
+    }
+    testCaseExe(c.n == h.n && c.resizes > 0);
+    while (SimCalendar_next(&c) == SimHeap_next(&h) && SimCalendar_pop(&c, &e) == 1) {
+        SimHeap_pop(&h, &f);
+        if(e.t != f.t || e.src != f.src || e.seq != f.seq) isSame = 0;
+        n++;
+    }
+    testCaseExe(isSame && c.n == 0 && h.n == 0 && n > 0);
+    SimCalendar_delete(&c);
+    SimHeap_delete(&h);
+    printf("**END TEST - test_SimCalendar**\n");
+    printSummary();
+}
+
+void test_Engines(){
+    Sim * seq = NULL;
+    Sim * par = NULL;
+    Sim * other = NULL;
+    SimStoreStats st;
+    int isSame = 1;
+
+    setupTest();
+    printf("**START TEST - test_Engines**\n");
+    testCaseExe((seq = Sim_init(TEST_CONF, 0, TEST_END, 7)) != NULL);
+    testCaseExe(Sim_runSequential(seq) == 1);
+    testCaseExe(Sim_runSequential(seq) == 0);
+    Sim_storeStats(seq, 0, &st);
+    testCaseExe(st.users > 0 && st.clients > 0 && st.clients <= st.users);
+    //Same results with the conservative engine, whatever the number of workers
+    for(int w = 1; w <= 7; w += 2) {
+        testCaseExe((par = Sim_init(TEST_CONF, 0, TEST_END, 7)) != NULL && Sim_runConservative(par, w) == 1);
+        isSame = Sim_digest(par) == Sim_digest(seq) && par->events == seq->events;
+        testCaseExe(isSame);
+        Sim_delete(par);
+    }
+    //And with the optimistic one: only committed events are counted
+    for(int w = 1; w <= 4; w++) {
+        testCaseExe((par = Sim_init(TEST_CONF, 0, TEST_END, 7)) != NULL && Sim_runOptimistic(par, w) == 1);
+        testCaseExe(Sim_digest(par) == Sim_digest(seq) && par->events == seq->events);
+        Sim_delete(par);
+    }
+    //Another seed gives another run
+    testCaseExe((other = Sim_init(TEST_CONF, 0, TEST_END, 8)) != NULL && Sim_runSequential(other) == 1);
+    testCaseExe(Sim_digest(other) != Sim_digest(seq));
+    Sim_delete(other);
+    Sim_delete(seq);
+
+    //Chain: stores split among workers or processes dealt round robin
+    testCaseExe((seq = Sim_init(TEST_CHAIN, 1, TEST_END, 3)) != NULL && Sim_runSequential(seq) == 1);
+    testCaseExe(seq->nStores == 3);
+    for(int w = 2; w <= 4; w += 2) {
+        testCaseExe((par = Sim_init(TEST_CHAIN, 1, TEST_END, 3)) != NULL && Sim_runConservative(par, w) == 1);
+        testCaseExe(Sim_digest(par) == Sim_digest(seq) && par->events == seq->events);
+        Sim_delete(par);
+        testCaseExe((par = Sim_init(TEST_CHAIN, 1, TEST_END, 3)) != NULL && Sim_runOptimistic(par, w) == 1);
+        testCaseExe(Sim_digest(par) == Sim_digest(seq) && par->events == seq->events);
+        Sim_delete(par);
+    }
+    Sim_delete(seq);
+    printf("**END TEST - test_Engines**\n");
+    printSummary();
+}
+
+int main(){
+    test_SimHeap();
+    test_SimCalendar();
+    test_Engines();
+    return 0;
+}
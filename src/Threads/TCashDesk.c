@@ -9,26 +9,142 @@
 #include <utilities.h>
 #include <Config.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <EventLog.h>
 
 #define MAX_DESK_STR 2048 /**< Max length of a string used to rapresent a CashDesk object*/
 
 //Private functions
-static void pDeallocUser(void * p_arg){
-	User * u = (User *) p_arg;
-	User_delete(u);
-}
 static void pCashDesk_toString(CashDesk * p_c, char * p_buff){
-    sprintf(p_buff, "[CashDesk %d]: products=%d clients=%d open_time=%.3f avg_service_time=%.3f closures=%d\n", 
+    //Simulated seconds, with the resolution chosen by LOG_TIME
+    int digits = p_c->market->logDigits;
+    sprintf(p_buff, "[CashDesk %d]: products=%d clients=%d open_time=%.*f avg_service_time=%.*f closures=%d\n", 
             p_c->id,
             p_c->productsProcessed, 
             p_c->usersProcessed,
-            (double)(p_c->totOpenTime > 0 ? (double)p_c->totOpenTime/1000:0),
-            (double)(p_c->avgServiceTime > 0 ? (double)p_c->avgServiceTime/1000:0),
+            digits, p_c->totOpenTime > 0 ? toSimSeconds(p_c->totOpenTime):0,
+            digits, p_c->usersProcessed > 0 ? toSimSeconds(p_c->totServiceTime / p_c->usersProcessed):0,
             p_c->numClosure);
 }
 
+//Executor: a desk wakes up submitting its task (see #Mailbox_initTask)
+static void pCashDesk_wake(void * p_arg) {
+    CashDesk * c = (CashDesk *) p_arg;
+    Executor_submit(c->market->executor, &c->task);
+}
+
+//Executor: one of the tasks of the desk ended, the last one wakes up the market (see #CashDesk_isEnded)
+static void pCashDesk_endTask(CashDesk * p_c) {
+    if(atomic_fetch_sub(&p_c->nTasks, 1) == 1) Market_Signal(p_c->market);
+}
+
+//Executor: start serving p_u, task runs again when the service ends
+static void pCashDesk_startService(CashDesk * p_c, int p_u) {
+    Market * m = p_c->market;
+    UserStore * us = m->users;
+    long ms = p_c->serviceConst + us->products[p_u] * m->NP;
+    printf("[CashDesk %d]: started to serve user %d (time required: %ld).\n", p_c->id, us->id[p_u], ms);
+    EVENT_RECORD(EV_USER_SERVICE, us->id[p_u], p_c->id, 0);
+    p_c->usersProcessed++;
+    p_c->productsProcessed += us->products[p_u];
+    p_c->servedUser = p_u;
+    p_c->isServing = 1;
+    p_c->tService = getCurrentTimeNs();
+    Executor_submitAt(m->executor, &p_c->task, p_c->tService + toRealNs((int64_t) ms * 1000000));
+}
+
+//Executor: end of the service started by pCashDesk_startService
+static void pCashDesk_endService(CashDesk * p_c) {
+    Market * m = p_c->market;
+    UserStore * us = m->users;
+    int64_t now = getCurrentTimeNs();
+    timerFired(TIMER_SERVICE, p_c->task.due - p_c->tService, now - p_c->task.due);
+    p_c->totServiceTime += now - p_c->tService;
+    p_c->isServing = 0;
+    printf("[CashDesk %d]: user %d served.\n", p_c->id, us->id[p_c->servedUser]);
+    EVENT_RECORD(EV_USER_SERVED, us->id[p_c->servedUser], p_c->id, 0);
+    Market_moveToExit(m, p_c->servedUser);
+}
+
+/**
+ * @brief Executor: serving task of a desk, the same loop of #CashDesk_main without blocking.
+ *        Instead of sleeping in a service the task is submitted again at its end, instead of waiting for news
+ *        it parks on the mailbox. A desk has at most one run of its task at a time, so its queue is served in order.
+ */
+static void pCashDesk_step(ExecTask * p_t) {
+    CashDesk * c = (CashDesk *) ((char *) p_t - offsetof(CashDesk, task));
+    Market * m = c->market;
+    UserStore * us = m->users;
+    CashDeskState currentState = DESK_OPEN;
+    int u = 0;
+
+    if(c->isServing) pCashDesk_endService(c);
+    while (1) {
+        Mailbox_take(&c->mailbox);
+        if(Market_isClosing(m) || sig_quit == 1) {
+            //Empties the user desk queue until no other users are in shopping area
+            if(UQueue_pop(&c->usersPay, &u) == 1) {
+                if(Market_isClosing(m) && CashDesk_getState(c) == DESK_OPEN) {//Serve users only if it is a slow closing and cash dek is open
+                    pCashDesk_startService(c, u);
+                    return;
+                }
+                printf("[CashDesk %d]: user %d exit without paying.\n", c->id, us->id[u]);
+                Market_moveToExit(m, u);
+                continue;
+            }
+            if(Market_inShopping(m) == 0 && UQueue_isEmpty(&c->usersPay) == 1) {
+                if(CashDesk_getState(c) == DESK_OPEN)
+                    c->totOpenTime += getCurrentTimeNs() - c->lastOpenTime;
+                printf("[CashDesk %d]: end of thread.\n", c->id);
+                pCashDesk_endTask(c);
+                return;
+            }
+        } else {
+            if((currentState = CashDesk_getState(c)) != c->lastState) {//Desk state change
+                c->lastState = currentState;
+                printf("[CashDesk %d]:  now is %s.\n", c->id, currentState==DESK_OPEN ? "OPEN":"CLOSE");
+                if(currentState == DESK_OPEN){
+                    c->lastOpenTime = getCurrentTimeNs();
+                } else{//DESK_CLOSE
+                    c->totOpenTime += getCurrentTimeNs() - c->lastOpenTime;
+                    c->numClosure++;
+                }
+            }
+            if(currentState == DESK_OPEN && UQueue_pop(&c->usersPay, &u) == 1) {
+                pCashDesk_startService(c, u);
+                return;
+            }
+        }
+        //Nothing to do: a closure signal, a state change or new users in queue will run the task again
+        if(Mailbox_park(&c->mailbox)) return;
+    }
+}
+
+//Executor: notification task of a desk, submitted again every notifyInterval ms
+static void pCashDesk_notifyStep(ExecTask * p_t) {
+    CashDesk * c = (CashDesk *) ((char *) p_t - offsetof(CashDesk, notifyTask));
+    int64_t interval = toRealNs((int64_t) c->notifyInterval * 1000000), now = getCurrentTimeNs();
+    timerFired(TIMER_NOTIFY, interval, now - p_t->due);
+    if(CashDesk_notify(c) == 0) {
+        pCashDesk_endTask(c);
+        return;
+    }
+    //Do not try to recover the ticks missed by a late worker
+    Executor_submitAt(c->market->executor, p_t, p_t->due + interval > now ? p_t->due + interval : now + interval);
+}
+
 void CashDesk_Lock(CashDesk * p_c){Lock(&p_c->lock);}
 void CashDesk_Unlock(CashDesk * p_c) {Unlock(&p_c->lock);}
+/**
+ * @brief State of the desk. The acquire load pairs with #CashDesk_setState: a desk seen open or closed is seen
+ *        with all the changes of the pay area made before its state changed.
+ */
+CashDeskState CashDesk_getState(CashDesk * p_c) {return atomic_load_explicit(&p_c->state, memory_order_acquire);}
+void CashDesk_setState(CashDesk * p_c, CashDeskState p_state) {atomic_store_explicit(&p_c->state, p_state, memory_order_release);}
+/**
+ * @brief Wake up the desk thread to look at its state and at the market closure (see #Mailbox).
+ */
+void CashDesk_Signal(CashDesk * p_c) {Mailbox_post(&p_c->mailbox, MAILBOX_WAKE);}
 
 /**
  * @brief Create a new CashDesk object.
@@ -38,37 +154,44 @@ void CashDesk_Unlock(CashDesk * p_c) {Unlock(&p_c->lock);}
  * @param p_serviceConst service costant time for each users served
  * @param p_state starting state
  * @param p_notifyInterval notify interval to inform director thread in ms
+ * @param p_links links of the users shared by the desk queues of the pay area
  * @return int: result codes
  * 1: Good init
  */
-CashDesk * CashDesk_init(Market * p_m, int p_id, int p_serviceConst, int p_notifyInterval, CashDeskState p_state) {
+CashDesk * CashDesk_init(Market * p_m, int p_id, int p_serviceConst, int p_notifyInterval, CashDeskState p_state, UQueueLinks * p_links) {
     CashDesk * aux = NULL;
-    int isLockInit = 0;
+    int isLockInit = 0, isQueueInit = 0;
 
-    if((aux = malloc(sizeof(CashDesk))) == NULL) {
+    if((aux = Arena_allocAligned(&p_m->arena, sizeof(CashDesk), CACHE_LINE)) == NULL) {
 		ERR_MSG("An error occurred during cash desk creation. ");
 		goto err;
 	}
 
     aux->id = p_id;
-    aux->usersPay = NULL;
     aux->serviceConst = p_serviceConst;
-    aux->state = p_state;
+    atomic_init(&aux->state, p_state);
     aux->market = p_m;
     aux->productsProcessed = 0;
     aux->usersProcessed = 0;
     aux->numClosure = 0;
     aux->totOpenTime = 0;
-    aux->avgServiceTime = 0;
+    aux->totServiceTime = 0;
     aux->notifyInterval = p_notifyInterval;
+    aux->task.fun = pCashDesk_step;
+    aux->notifyTask.fun = pCashDesk_notifyStep;
+    aux->isServing = 0;
+    atomic_init(&aux->nTasks, 0);
+    //A desk run by an executor is woken up submitting its task, otherwise through a futex
+    if(p_m->executor != NULL) Mailbox_initTask(&aux->mailbox, pCashDesk_wake, aux);
+    else Mailbox_init(&aux->mailbox);
 
-    if((aux->usersPay = SQueue_init(-1)) == NULL) {
+    if(UQueue_init(&aux->usersPay, p_id, p_links) != 1) {
         ERR_MSG("An error occurred during creation of queue. Impossible to setup CashDesk.");
         goto err;
     }
+    isQueueInit = 1;
 	//Init lock system
-	if (pthread_mutex_init(&(aux->lock), NULL) != 0 ||
-        pthread_cond_init(&aux->cv_DeskNews, NULL) != 0) {
+	if (pthread_mutex_init(&(aux->lock), NULL) != 0) {
 		ERR_MSG("An error occurred during locking system initialization. Impossible to setup CashDesk.");
 		goto err;
 	}
@@ -77,18 +200,14 @@ CashDesk * CashDesk_init(Market * p_m, int p_id, int p_serviceConst, int p_notif
     return aux;
 err:
     if(aux != NULL) {
-        if(aux->usersPay != NULL) SQueue_deleteQueue(aux->usersPay, NULL);
-        if(isLockInit) {
-            pthread_mutex_destroy(&aux->lock);
-            pthread_cond_destroy(&aux->cv_DeskNews);
-        }
-        free(aux);
+        if(isQueueInit) UQueue_delete(&aux->usersPay);
+        if(isLockInit) pthread_mutex_destroy(&aux->lock);
     }
     return NULL;
 }
 
 /**
- * @brief Dealloc a CashDesk object.
+ * @brief Dealloc a CashDesk object. Its memory belongs to the arena of the market and it is released with it.
  * 
  * @warning This function should be called by only one thread when no other thread is working on p_c object.
  *          Typically the main thread call this function after all slave threads have terminated.
@@ -100,44 +219,71 @@ err:
  */
 int CashDesk_delete(CashDesk * p_c){
     if(p_c == NULL) return -1;
-    SQueue_deleteQueue(p_c->usersPay, pDeallocUser);
+    UQueue_delete(&p_c->usersPay); //Users belong to the store of the market
     pthread_mutex_destroy(&p_c->lock);
-    pthread_cond_destroy(&p_c->cv_DeskNews);
-    free(p_c);
     return 1;
 }
 
 /**
- * @brief Start CashDesk thread.
+ * @brief Start CashDesk thread, or submit its serving and notification tasks if the market has an executor.
  *        The behaviour is undefined if p_u has not been previously initialized with #CashDesk_init.
  * 
  * @param p_u Requirements: p_d != NULL and must refer to a CashDesk object created with #CashDesk_init. Target CashDesk.
- * @return int: result pf pthread_create call
+ * @return int: result pf pthread_create call (0 with an executor)
  */
 int CashDesk_startThread(CashDesk * p_d){
-	return pthread_create(&p_d->thread, NULL, CashDesk_main, p_d);
+    Market * m = p_d->market;
+    if(m->executor == NULL) return pthread_create(&p_d->thread, NULL, CashDesk_main, p_d);
+    p_d->lastState = CashDesk_getState(p_d);
+    p_d->lastOpenTime = getCurrentTimeNs();
+    atomic_store(&p_d->nTasks, 2);
+    Executor_submitAt(m->executor, &p_d->notifyTask, getCurrentTimeNs() + toRealNs((int64_t) p_d->notifyInterval * 1000000));
+    printf("[CashDesk %d]: start of thread.\n", p_d->id);
+    Executor_submit(m->executor, &p_d->task);
+    return 0;
 }
 
 /**
- * @brief Join the CashDesk thread
+ * @brief Join the CashDesk thread (market without an executor, see #CashDesk_isEnded otherwise)
  * 
  * @param p_c Requirements: p_c != NULL and must refer to a User object created with #CashDesk_init. Target CashDesk.
  * @return int result of pthread_join
  */
 int CashDesk_joinThread(CashDesk * p_c){
-	return pthread_join(p_c->thread, NULL);
+    return pthread_join(p_c->thread, NULL);
+}
+
+/**
+ * @brief Check if the tasks of a desk run by an executor ended. The last one to end wakes up the market.
+ * 
+ * @param p_c Requirements: p_c != NULL and must refer to a User object created with #CashDesk_init. Target CashDesk.
+ * @return int: 1 if the desk ended, 0 otherwise
+ */
+int CashDesk_isEnded(CashDesk * p_c){
+    return atomic_load(&p_c->nTasks) == 0;
 }
 
 /**
  * @brief Add user to queue.
  * 
  * @param p_c Requirements: p_c != NULL and must refer to a User object created with #CashDesk_init. Target CashDesk.
- * @param p_u User to add in queue
+ * @param p_u User (index in the store of the market) to add in queue
+ */
+void CashDesk_addUser(CashDesk * p_c, int p_u) {
+    UQueue_push(&p_c->usersPay, p_u);
+    Mailbox_post(&p_c->mailbox, MAILBOX_USER);
+}
+
+/**
+ * @brief Add to queue, with a single lock and a single wakeup, the users linked from p_first to p_last (see #UQueue_pushChain).
+ * 
+ * @param p_c Requirements: p_c != NULL and must refer to a User object created with #CashDesk_init. Target CashDesk.
+ * @param p_first first user of the chain
+ * @param p_last last user of the chain
  */
-void CashDesk_addUser(CashDesk * p_c, User * p_u) {
-    if(SQueue_push(p_c->usersPay, p_u) != 1)
-        ERR_QUIT("Impossible to add user to queue of cash desk %d", p_c->id);
-    Signal(&p_c->market->cv_MarketNews);
+void CashDesk_addUsers(CashDesk * p_c, int p_first, int p_last) {
+    UQueue_pushChain(&p_c->usersPay, p_first, p_last);
+    Mailbox_post(&p_c->mailbox, MAILBOX_USER);
 }
 
 void CashDesk_log(CashDesk * p_c) {
@@ -149,30 +295,46 @@ void CashDesk_log(CashDesk * p_c) {
 }
 
 /**
- * @brief Subthread used to periodically notify the director thread about current desk status.
+ * @brief Notify the director thread about current desk status.
+ *        It is called periodically by the desk notifier thread or by the notification task of the desk (see #Market).
  * 
  * @param p_arg is expected as CashDesk * object.
- * @return void *
+ * @return int: 1 if the desk must keep notifying, 0 if the market is closing (nothing sent)
  */
-void * CashDesk_notifyDirector(void * p_arg) {
+int CashDesk_notify(void * p_arg) {
     CashDesk * c = (CashDesk *) p_arg;
     Market * m = c->market;
     Director * d = m->director;
     CashDeskNotify * msg = NULL;
+    if(Market_isClosing(m) || sig_quit) return 0;
+    //Prepare info for director thread
+    if((msg = Pool_alloc(m->poolMsgs)) == NULL)
+        ERR_QUIT("An error occurred during notify message allocation.");
+    msg->id = c->id;
+    msg->state = CashDesk_getState(c);
+    msg->users = UQueue_dim(&c->usersPay);
+    //Send info to director thread
+    SQueue_push(d->notifications, msg);
+    Director_SignalDesks(d);
+    return 1;
+}
+
+/**
+ * @brief Subthread used to periodically notify the director thread about current desk status.
+ * 
+ * @param p_arg is expected as CashDesk * object.
+ * @return void *
+ */
+void * CashDesk_notifyDirector(void * p_arg) {
+    CashDesk * c = (CashDesk *) p_arg;
+    TRACE_THREAD_NAME(TH_NOTIFIER, c->id);
     while (1) {
-        if(sig_hup || sig_quit) break;
-        if(waitMs(c->notifyInterval) == -1)
+        if(Market_isClosing(c->market) || sig_quit) break;
+        TRACE_BEGIN(PH_NOTIFY_SLEEP);
+        if(waitTimer(c->notifyInterval, TIMER_NOTIFY) == -1)
             ERR_SYS_QUIT("[User %d]: an error occurred during waiting to notify director thread.\n", c->id);
-        //Prepare info for director thread
-        msg = NULL;
-        if((msg = malloc(sizeof(CashDeskNotify))) == NULL)
-            ERR_QUIT("An error occurred during malloc for notify message allocation.");
-        msg->id = c->id;
-        msg->state = c->state;
-        msg->users = SQueue_dim(c->usersPay);
-        //Send info to director thread
-        SQueue_push(d->notifications, msg);
-        Signal(&d->cv_Director_DesksNews);
+        TRACE_END(PH_NOTIFY_SLEEP);
+        if(CashDesk_notify(c) == 0) break;
     }
     return (void *)NULL;
 }
@@ -186,57 +348,89 @@ void * CashDesk_notifyDirector(void * p_arg) {
 void * CashDesk_main(void * p_arg){
 	CashDesk * c = (CashDesk *) p_arg;
     Market * m = c->market;
-	User * servedUser = NULL;
-    void * data = NULL;
-    CashDeskState lastState = c->state;
+	int servedUser = 0;
+	UserStore * us = m->users;
+    CashDeskState lastState = CashDesk_getState(c);
     CashDeskState currentState = lastState;
-    struct timespec lastOpenTime = getCurrentTime();
+    int64_t lastOpenTime = getCurrentTimeNs();
+    int64_t tService = 0;
+    int isServing = 0;
     pthread_t thNotifyHandler;
 
-    lastState = c->state;
-    currentState = lastState;
-    lastOpenTime = getCurrentTime();
+    //Pinned before the notifier thread is created, so that it shares the cpu of its desk
+    Placement_pinDesk(&m->placement, c->id);
 
-    //Create sub thread used to notify director thread
+    //Create the sub thread that notifies the director
     if(pthread_create(&thNotifyHandler, NULL, CashDesk_notifyDirector, c) !=0)
         ERR_QUIT("[Director]: an error occurred during creation of notify thread."); 
 
     printf("[CashDesk %d]: start of thread.\n", c->id);
+    TRACE_THREAD_NAME(TH_DESK, c->id);
     
     while (1) {
-       	//Wait a closure signal or new user in desk queue to proceed
-		Lock(&c->lock);
-		while ( sig_hup != 1 && sig_quit != 1 && SQueue_isEmpty(c->usersPay)==1 && 
-                (currentState = c->state) == lastState) 
-			pthread_cond_wait(&c->cv_DeskNews, &c->lock);
-        Unlock(&c->lock);
+        //An open desk serves its queue without waiting: the mailbox is read only when there is nothing to do,
+        //so a busy desk takes a single queue lock for each user served
+        isServing = 0;
+        if(!Market_isClosing(m) && sig_quit != 1 && (currentState = CashDesk_getState(c)) == lastState &&
+            (currentState != DESK_OPEN || (isServing = UQueue_pop(&c->usersPay, &servedUser) == 1) == 0)) {
+            //Wait a closure signal, a state change or new users in desk queue to proceed
+            TRACE_BEGIN(PH_IDLE);
+            Mailbox_wait(&c->mailbox);
+            TRACE_END(PH_IDLE);
+            continue;
+        }
+        if(isServing) {
+            printf("[CashDesk %d]: started to serve user %d (time required: %ld).\n", c->id, us->id[servedUser], c->serviceConst + us->products[servedUser] * m->NP);
+            EVENT_RECORD(EV_USER_SERVICE, us->id[servedUser], c->id, 0);
+            c->usersProcessed++;
+            c->productsProcessed+=us->products[servedUser];       
+            tService = getCurrentTimeNs();
+            TRACE_BEGIN(PH_SERVE);
+            if(waitTimer(c->serviceConst + us->products[servedUser] * m->NP, TIMER_SERVICE) == -1)
+                ERR_SYS_QUIT("[User %d]: an error occurred during waiting for shopping time.\n", us->id[servedUser]);
+            TRACE_END(PH_SERVE);
+            c->totServiceTime += getCurrentTimeNs() - tService;
+            printf("[CashDesk %d]: user %d served.\n", c->id, us->id[servedUser]);  
+            EVENT_RECORD(EV_USER_SERVED, us->id[servedUser], c->id, 0);
+            Market_moveToExit(m, servedUser);
+            continue;
+        }
        
-		if(sig_hup == 1 || sig_quit == 1) {
-            //Empties the user desk queue and wait until no other users are in the market
-            while (SQueue_isEmpty(c->usersPay) != 1 || SQueue_isEmpty(c->market->usersShopping) != 1) {
-                if(SQueue_pop(c->usersPay, &data) == 1) {
-                    servedUser = (User *)data;
-                    
-                    if(sig_hup == 1 && c->state == DESK_OPEN) {//Serve users only if it is a slow closing and cash dek is open
-                        printf("[CashDesk %d]: started to serve user %d (time required: %ld).\n", c->id, servedUser->id, c->serviceConst + servedUser->products * m->NP);
+		if(Market_isClosing(m) || sig_quit == 1) {
+            TRACE_BEGIN(PH_DRAIN);
+            //Empties the user desk queue until no other users are in shopping area.
+            //When the queue is empty the desk sleeps: it is woken by new users or when shopping area becomes empty.
+            while (1) {
+                if(UQueue_pop(&c->usersPay, &servedUser) != 1) {
+                    while (UQueue_isEmpty(&c->usersPay) == 1 && Market_inShopping(m) > 0)
+                        Mailbox_wait(&c->mailbox);
+                    if(UQueue_isEmpty(&c->usersPay) == 1) break;
+                } else {
+                    if(Market_isClosing(m) && CashDesk_getState(c) == DESK_OPEN) {//Serve users only if it is a slow closing and cash dek is open
+                        printf("[CashDesk %d]: started to serve user %d (time required: %ld).\n", c->id, us->id[servedUser], c->serviceConst + us->products[servedUser] * m->NP);
+                        EVENT_RECORD(EV_USER_SERVICE, us->id[servedUser], c->id, 0);
                         c->usersProcessed++;
-                        c->productsProcessed+=servedUser->products;            
-                        c->avgServiceTime += c->serviceConst + servedUser->products * m->NP;
-                        if(waitMs(c->serviceConst + servedUser->products * m->NP) == -1)
-                            ERR_SYS_QUIT("[User %d]: an error occurred during waiting for shopping time.\n", servedUser->id);
-                        printf("[CashDesk %d]: user served %d.\n", c->id, servedUser->id);
+                        c->productsProcessed+=us->products[servedUser];            
+                        tService = getCurrentTimeNs();
+                        TRACE_BEGIN(PH_SERVE);
+                        if(waitTimer(c->serviceConst + us->products[servedUser] * m->NP, TIMER_SERVICE) == -1)
+                            ERR_SYS_QUIT("[User %d]: an error occurred during waiting for shopping time.\n", us->id[servedUser]);
+                        TRACE_END(PH_SERVE);
+                        c->totServiceTime += getCurrentTimeNs() - tService;
+                        printf("[CashDesk %d]: user served %d.\n", c->id, us->id[servedUser]);
+                        EVENT_RECORD(EV_USER_SERVED, us->id[servedUser], c->id, 0);
 
                     }else {
-                        printf("[CashDesk %d]: user %d exit without paying.\n", c->id, servedUser->id);
+                        printf("[CashDesk %d]: user %d exit without paying.\n", c->id, us->id[servedUser]);
                     }
                     
                     Market_moveToExit(m, servedUser);
                 }
             }
-            if(c->state == DESK_OPEN)
-                c->totOpenTime += elapsedTime(lastOpenTime, getCurrentTime());
-            
-            c->avgServiceTime=c->avgServiceTime/c->usersProcessed;
+            if(CashDesk_getState(c) == DESK_OPEN)
+                c->totOpenTime += getCurrentTimeNs() - lastOpenTime;
+
+            TRACE_END(PH_DRAIN);
             break;
         }
         //Market is not closing
@@ -244,28 +438,15 @@ void * CashDesk_main(void * p_arg){
             lastState = currentState;
             printf("[CashDesk %d]:  now is %s.\n", c->id, currentState==DESK_OPEN ? "OPEN":"CLOSE");
             if(currentState == DESK_OPEN){
-                lastOpenTime = getCurrentTime();
+                lastOpenTime = getCurrentTimeNs();
             } else{//DESK_CLOSE
-                c->totOpenTime += elapsedTime(lastOpenTime, getCurrentTime());
+                c->totOpenTime += getCurrentTimeNs() - lastOpenTime;
                 c->numClosure++;
             }
         }        
-        if(c->state == DESK_OPEN) {
-            if(SQueue_pop(c->usersPay, &data) == 1) {
-                servedUser = (User *)data;
-                printf("[CashDesk %d]: started to serve user %d (time required: %ld).\n", c->id, servedUser->id, c->serviceConst + servedUser->products * m->NP);
-                c->usersProcessed++;
-                c->productsProcessed+=servedUser->products;       
-                c->avgServiceTime += c->serviceConst + servedUser->products * m->NP;               
-                if(waitMs(c->serviceConst + servedUser->products * m->NP) == -1)
-                    ERR_SYS_QUIT("[User %d]: an error occurred during waiting for shopping time.\n", servedUser->id);
-                printf("[CashDesk %d]: user %d served.\n", c->id, servedUser->id);  
-                Market_moveToExit(m, servedUser);
-            }
-        }
     }
     if(pthread_join(thNotifyHandler, NULL) !=0)
-        ERR_QUIT("[Director]: an error occurred during join of notify thread."); 
+        ERR_QUIT("[Director]: an error occurred during join of notify thread.");
 
 	printf("[CashDesk %d]: end of thread.\n", c->id);
     return (void *)NULL;
@@ -9,11 +9,120 @@
 #include <TMarket.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <utilities.h>
 #include <TCashDesk.h>
+#include <EventLog.h>
+#include <DeskBoard.h>
+
+//Private functions
+/**
+ * @brief Copy the status sent by a desk in the board and, once all desks reported, try to open or close a desk.
+ */
+static void pDirector_report(Director * p_d, CashDeskNotify * p_msg) {
+    Market * m = p_d->market;
+    DeskBoard * board = &p_d->board;
+    printf("[Director]: received notification from desk %d\n", p_msg->id);
+    //The status is copied in the board, so the message can be given back at once
+    if(DeskBoard_report(board, p_msg->id, p_msg->state == DESK_OPEN, p_msg->users) == 0) {
+        Pool_free(m->poolMsgs, p_msg);
+        return;
+    }
+    Pool_free(m->poolMsgs, p_msg);
+    //All desk have communicated their status. Now it's time to take a decision.
+    TRACE_BEGIN(PH_DECIDE);
+    //The aggregates are kept up to date by each report: once in a while they are checked against a full count
+    if(board->round % DIRECTOR_VERIFY_ROUNDS == 0) DeskBoard_verify(board);
+    //Check if it's time to close/open a desk
+    if(board->nBusy > 0){
+        //Try to open a desk
+        printf("[Director]: Try to open a desk\n");
+        PayArea_tryOpenDesk(m->payArea);
+    }
+    if(board->nNoWork >= m->S1){
+        //Try to close a desk
+        printf("[Director]: Try to close a desk\n");
+        PayArea_tryCloseDesk(m->payArea);
+    }
+    //Reset
+    DeskBoard_nextRound(board);
+    TRACE_END(PH_DECIDE);
+}
+
+//Executor: the director wakes up submitting its task (see #Mailbox_initTask)
+static void pDirector_wake(void * p_arg) {
+    Director * d = (Director *) p_arg;
+    Executor_submit(d->market->executor, &d->task);
+}
+
+//Executor: one of the tasks of the director ended, the last one wakes up the market (see #Director_isEnded)
+static void pDirector_endTask(Director * p_d) {
+    if(atomic_fetch_sub(&p_d->nTasks, 1) == 1) Market_Signal(p_d->market);
+}
+
+/**
+ * @brief Executor: task of the director, the loops of #Director_handleAuth and #Director_main without blocking.
+ *        It authorizes the users waiting in the auth queue and handles the desk notifications, then it parks
+ *        on the mailbox. On closing it empties the auth queue and ends when no other users are in shopping area.
+ */
+static void pDirector_step(ExecTask * p_t) {
+    Director * d = (Director *) ((char *) p_t - offsetof(Director, task));
+    Market * m = d->market;
+    SQueue * auth = m->usersAuthQueue;
+    void * data = NULL;
+    int user = 0;
+
+    while (1) {
+        Mailbox_take(&d->mailbox);
+        if(Market_isClosing(m) || sig_quit == 1) {
+            //Empties the user auth queue until no other users are in shopping area
+            while (SQueue_pop(auth, &data) == 1) Market_moveToExit(m, USER_FROM_PTR(data));
+            if(Market_inShopping(m) == 0 && SQueue_isEmpty(auth) == 1) {
+                printf("[Director]: end of thread.\n");
+                pDirector_endTask(d);
+                return;
+            }
+        } else {
+            while (SQueue_pop(auth, &data) == 1) {
+                user = USER_FROM_PTR(data);
+                printf("[Director]: user %d is authorized for exit.\n", m->users->id[user]);
+                Market_moveToExit(m, user);
+            }
+            while (SQueue_pop(d->notifications, &data) == 1) pDirector_report(d, (CashDeskNotify *) data);
+        }
+        //Nothing to do: new users in auth queue, desk notifications or the closure will run the task again
+        if(Mailbox_park(&d->mailbox)) return;
+    }
+}
+
+//Executor: queue change task of the director, submitted again every S ms
+static void pDirector_jockeyStep(ExecTask * p_t) {
+    Director * d = (Director *) ((char *) p_t - offsetof(Director, jockeyTask));
+    Market * m = d->market;
+    int64_t interval = toRealNs((int64_t) m->S * 1000000), now = getCurrentTimeNs();
+    timerFired(TIMER_JOCKEY, interval, now - p_t->due);
+    if(PayArea_jockey(m->payArea) == 0) {
+        pDirector_endTask(d);
+        return;
+    }
+    //Do not try to recover the ticks missed by a late worker
+    Executor_submitAt(m->executor, p_t, p_t->due + interval > now ? p_t->due + interval : now + interval);
+}
 
 void Director_Lock(Director * p_d) {Lock(&p_d->lock);}
 void Director_Unlock(Director * p_d) {Unlock(&p_d->lock);}
+/**
+ * @brief Wake up the director threads. The director lock is held, so the wakeup can't be lost.
+ *        A director run by an executor is woken up through its mailbox.
+ */
+void Director_SignalAuth(Director * p_d) {
+    if(p_d->market->executor != NULL) Mailbox_post(&p_d->mailbox, MAILBOX_USER);
+    else {Director_Lock(p_d); Signal(&p_d->cv_Director_AuthNews); Director_Unlock(p_d);}
+}
+void Director_SignalDesks(Director * p_d) {
+    if(p_d->market->executor != NULL) Mailbox_post(&p_d->mailbox, MAILBOX_WAKE);
+    else {Director_Lock(p_d); Signal(&p_d->cv_Director_DesksNews); Director_Unlock(p_d);}
+}
 
 /**
  * @brief Create a new Director object.
@@ -24,13 +133,24 @@ void Director_Unlock(Director * p_d) {Unlock(&p_d->lock);}
 Director * Director_init(Market * p_m) {
     Director * aux = NULL;
     
-    if( (aux = malloc(sizeof(Director))) == NULL )
+    if( (aux = Arena_alloc(&p_m->arena, sizeof(Director))) == NULL )
 		goto err;
 	
     aux->market = p_m;
     aux->notifications = NULL;
+    aux->task.fun = pDirector_step;
+    aux->jockeyTask.fun = pDirector_jockeyStep;
+    atomic_init(&aux->nTasks, 0);
+    //A director run by an executor is woken up submitting its task, otherwise through condition variables
+    if(p_m->executor != NULL) Mailbox_initTask(&aux->mailbox, pDirector_wake, aux);
+    else Mailbox_init(&aux->mailbox);
+
+    if(DeskBoard_init(&aux->board, &p_m->arena, p_m->K, p_m->S2) != 1) {
+		ERR_MSG("An error occurred during desk board setup. Impossible to setup the director.");
+        goto err;
+	}
 
-    if((aux->notifications = SQueue_init(-1)) == NULL) {
+    if((aux->notifications = SQueue_initPool(-1, p_m->poolNodes)) == NULL) {
 		ERR_MSG("An error occurred during notification queue setup. Impossible to setup the director.");
         goto err;
 	}
@@ -45,24 +165,29 @@ Director * Director_init(Market * p_m) {
 	
     return aux;
 err:
-    if(aux != NULL) free(aux);
-    if(aux->notifications != NULL) SQueue_deleteQueue(aux->notifications, NULL);
+    if(aux != NULL && aux->notifications != NULL) SQueue_deleteQueue(aux->notifications, NULL);
     return NULL;
 }
 
 /**
- * @brief Start Director thread.
+ * @brief Start Director thread, or submit its tasks if the market has an executor.
  *        The behaviour is undefined if p_d has not been previously initialized with #Director_init.
  * 
  * @param p_d Requirements: p_d != NULL and must refer to a Director object created with #Director_init. Target Director.
- * @return int: result pf pthread_create call
+ * @return int: result pf pthread_create call (0 with an executor)
  */
 int Director_startThread(Director * p_d) {
-    return pthread_create(&p_d->thread, NULL, Director_main, p_d);
+    Market * m = p_d->market;
+    if(m->executor == NULL) return pthread_create(&p_d->thread, NULL, Director_main, p_d);
+    printf("[Director]: start of thread.\n");
+    atomic_store(&p_d->nTasks, 2);
+    Executor_submitAt(m->executor, &p_d->jockeyTask, getCurrentTimeNs() + toRealNs((int64_t) m->S * 1000000));
+    Executor_submit(m->executor, &p_d->task);
+    return 0;
 }
 
 /**
- * @brief Join the director thread
+ * @brief Join the director thread (market without an executor, see #Director_isEnded otherwise)
  * 
  * @param p_d Requirements: p_d != NULL and must refer to a Director object created with #Director_init. Target Director.
  * @return int result of pthread_join
@@ -72,7 +197,17 @@ int Director_joinThread(Director * p_d) {
 }
 
 /**
- * @brief Dealloc a Director object.
+ * @brief Check if the tasks of a director run by an executor ended. The last one to end wakes up the market.
+ * 
+ * @param p_d Requirements: p_d != NULL and must refer to a Director object created with #Director_init. Target Director.
+ * @return int: 1 if the director ended, 0 otherwise
+ */
+int Director_isEnded(Director * p_d) {
+    return atomic_load(&p_d->nTasks) == 0;
+}
+
+/**
+ * @brief Dealloc a Director object. Its memory (and pending messages) belongs to the arena of the market and it is released with it.
  *
  * @warning This function should be called by only one thread when no other thread is working on p_d object.
  *          Typically the main thread call this function after all slave threads have terminated.
@@ -87,8 +222,7 @@ int Director_delete(Director * p_d) {
     pthread_cond_destroy(&p_d->cv_Director_AuthNews);
     pthread_cond_destroy(&p_d->cv_Director_DesksNews);
     pthread_mutex_destroy(&p_d->lock);
-    SQueue_deleteQueue(p_d->notifications, free);
-	free(p_d);
+    SQueue_deleteQueue(p_d->notifications, NULL);
 	return 1;
 }
 
@@ -102,28 +236,41 @@ void * Director_handleAuth(void * p_arg) {
     Director * d = m->director;
     SQueue * auth = m->usersAuthQueue;
     void * data = NULL;
-    User * user = NULL;
+    int user = 0;
+    TRACE_THREAD_NAME(TH_AUTH, -1);
+    Placement_pinDirector(&m->placement);
     while (1) {
        	//Wait a closure signal or new user in auth queue to proceed
+        TRACE_BEGIN(PH_IDLE);
 		Lock(&d->lock);
-		while (sig_hup != 1 && sig_quit != 1 && SQueue_isEmpty(auth)==1) 
+		while (!Market_isClosing(m) && sig_quit != 1 && SQueue_isEmpty(auth)==1) 
 			pthread_cond_wait(&d->cv_Director_AuthNews, &d->lock);
 		Unlock(&d->lock);
-		if(sig_hup == 1 || sig_quit == 1) {        
-            //Empties the user auth queue and wait until no other users are in the market
-            while (SQueue_isEmpty(m->usersShopping) != 1 || SQueue_isEmpty(auth)!= 1) {
+        TRACE_END(PH_IDLE);
+		if(Market_isClosing(m) || sig_quit == 1) {        
+            TRACE_BEGIN(PH_DRAIN);
+            //Empties the user auth queue until no other users are in shopping area.
+            //When the queue is empty the thread sleeps: it is woken by new users or when shopping area becomes empty.
+            while (1) {
                 if(SQueue_pop(auth, &data) == 1) {
-                    user = (User *) data;
+                    user = USER_FROM_PTR(data);
                     //Move user to exit
                     Market_moveToExit(m, user);
+                    continue;
                 }
+                Lock(&d->lock);
+                while (SQueue_isEmpty(auth) == 1 && Market_inShopping(m) > 0)
+                    pthread_cond_wait(&d->cv_Director_AuthNews, &d->lock);
+                Unlock(&d->lock);
+                if(SQueue_isEmpty(auth) == 1) break;
             }
+            TRACE_END(PH_DRAIN);
             break;
         }
         //Market is not closing
         if(SQueue_pop(auth, &data) == 1){
-            user = (User *) data;
-            printf("[Director]: user %d is authorized for exit.\n", user->id);
+            user = USER_FROM_PTR(data);
+            printf("[Director]: user %d is authorized for exit.\n", m->users->id[user]);
             //Move user to exit
             Market_moveToExit(m, user);
         }
@@ -132,6 +279,27 @@ void * Director_handleAuth(void * p_arg) {
     return (void *) NULL;
 }
 
+/**
+ * @brief Subthread used to let users change queue every S ms (see #PayArea_jockey).
+ *
+ * @param p_arg is expected as Market * object.
+ * @return void *
+ */
+void * Director_handleJockey(void * p_arg) {
+    Market * m = (Market *) p_arg;
+    TRACE_THREAD_NAME(TH_JOCKEY, -1);
+    Placement_pinDirector(&m->placement);
+    while (1) {
+        if(Market_isClosing(m) || sig_quit) break;
+        TRACE_BEGIN(PH_IDLE);
+        if(waitTimer(m->S, TIMER_JOCKEY) == -1)
+            ERR_SYS_QUIT("[Director]: an error occurred during waiting for queue change evaluation.\n");
+        TRACE_END(PH_IDLE);
+        if(PayArea_jockey(m->payArea) == 0) break;
+    }
+    return (void *) NULL;
+}
+
 /**
  * @brief Entry point for a Diretor thread.
  * 
@@ -143,75 +311,39 @@ void * Director_main(void * p_arg){
 	Director * d = (Director *) p_arg;
     Market * m = d->market;
     void * data = NULL;
-    CashDeskNotify * msg = NULL;
-    CashDeskNotify ** lastReceivedMsg = NULL;
-    int desksMsg = 0;
-    int tryOpen = 0, tryClose = 0;
-    int numDeskNoWork = 0; //counter for the number of desk with low amount of work
 	pthread_t thAuthHandler;
+	pthread_t thJockeyHandler;
 	printf("[Director]: start of thread.\n");
-
-    if((lastReceivedMsg = calloc(d->market->K, sizeof(CashDesk **))) == NULL)
-        ERR_QUIT("Malloc error");
+    TRACE_THREAD_NAME(TH_DIRECTOR, -1);
+    Placement_pinDirector(&m->placement);
 
     //Create auxiliary thread for managing auth queue
     if(pthread_create(&thAuthHandler, NULL, Director_handleAuth, d->market) !=0)
         ERR_QUIT("[Director]: an error occurred during creation of authorizations handler thread."); 
+    //Create auxiliary thread for queue changes
+    if(pthread_create(&thJockeyHandler, NULL, Director_handleJockey, m) !=0)
+        ERR_QUIT("[Director]: an error occurred during creation of queue change thread."); 
     
     //Handle cashdesks notifications
     while (1) {
         //Wait a closure signal or new desk notification to proceed
+        TRACE_BEGIN(PH_IDLE);
 		Lock(&d->lock);
-		while (sig_hup != 1 && sig_quit != 1 && SQueue_isEmpty(d->notifications)==1) 
+		while (!Market_isClosing(m) && sig_quit != 1 && SQueue_isEmpty(d->notifications)==1) 
 			pthread_cond_wait(&d->cv_Director_DesksNews, &d->lock);
 		Unlock(&d->lock);
+        TRACE_END(PH_IDLE);
 		
-        if(sig_hup == 1 || sig_quit == 1) break;
+        if(Market_isClosing(m) || sig_quit == 1) break;
         
-        if(SQueue_pop(d->notifications, &data) == 1) {
-            //New notification received
-            msg = (CashDeskNotify *) data;
-            printf("[Director]: received notification from desk %d\n", msg->id);
-
-            if(lastReceivedMsg[msg->id] == NULL) desksMsg++;
-            else free(lastReceivedMsg[msg->id]);
-
-            lastReceivedMsg[msg->id] = msg;
-            if(desksMsg == m->K) {//All desk have communicated their status. Now it's time to take a decision.
-                desksMsg = 0;
-                tryOpen = 0;
-                tryClose = 0;
-                numDeskNoWork = 0;
-                //Check if it's time to close/open a desk
-                for(int i=0;i<m->K;i++) {
-                    if(lastReceivedMsg[i]->state == DESK_OPEN && lastReceivedMsg[i]->users<=1) numDeskNoWork++;
-                    if(lastReceivedMsg[i]->state == DESK_OPEN && lastReceivedMsg[i]->users>=m->S2) tryOpen=1;
-                }
-                if(numDeskNoWork >= m->S1) tryClose = 1;
-                
-                if(tryOpen){
-                    //Try to open a desk
-                    printf("[Director]: Try to open a desk\n");
-                    PayArea_tryOpenDesk(m->payArea);
-                }
-                if(tryClose){
-                    //Try to close a desk
-                    printf("[Director]: Try to close a desk\n");
-                    PayArea_tryCloseDesk(m->payArea);
-                }
-                //Reset
-                for(int i=0;i<m->K;i++) {free(lastReceivedMsg[i]); lastReceivedMsg[i] = NULL;}
-            }
-        }
-
+        //New notification received
+        if(SQueue_pop(d->notifications, &data) == 1) pDirector_report(d, (CashDeskNotify *) data);
     }
     
-    for(int i=0;i<m->K;i++) 
-        if(lastReceivedMsg[i] != NULL) free(lastReceivedMsg[i]);
-    free(lastReceivedMsg);
-    
     if(pthread_join(thAuthHandler, NULL) !=0)
         ERR_QUIT("[Director]: an error occurred during join of authorizations handler thread."); 
+    if(pthread_join(thJockeyHandler, NULL) !=0)
+        ERR_QUIT("[Director]: an error occurred during join of queue change thread.");
 
 	printf("[Director]: end of thread.\n");
     return (void *)NULL;
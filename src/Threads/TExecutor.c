@@ -0,0 +1,290 @@
+/**
+ * @file TExecutor.c
+ * @brief   Implementation of Executor.
+ *          Each worker runs the tasks of its own deque, then the ones submitted from out of the pool, then it steals
+ *          from a random worker. Timed tasks wait in a heap of the worker which submitted them and are moved to its
+ *          deque when due, where idle workers can steal them.
+ *          A worker goes to sleep only after announcing it in nSleeping and checking again for work under the
+ *          executor lock; a submitter wakes one up only when nSleeping is not 0, so ready tasks never cost a lock.
+ */
+#include <TExecutor.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <utilities.h>
+#include <EventLog.h>
+
+#define EXECUTOR_DEQUE_CAP 256 /**< Initial capacity of the deque of each worker */
+
+static _Thread_local ExecWorker * t_worker = NULL; /**< worker running on the current thread (NULL: not a worker) */
+
+//Private functions
+static void pTimers_push(ExecWorker * p_w, ExecTask * p_t) {
+    ExecTask ** aux = NULL;
+    int i = p_w->nTimers++;
+    if(i == p_w->capTimers) {
+        if((aux = realloc(p_w->timers, (p_w->capTimers * 2 + 16) * sizeof(ExecTask *))) == NULL)
+            ERR_QUIT("An error occurred during executor timer allocation.");
+        p_w->timers = aux;
+        p_w->capTimers = p_w->capTimers * 2 + 16;
+    }
+    for(; i > 0 && p_w->timers[(i - 1) / 2]->due > p_t->due; i = (i - 1) / 2) p_w->timers[i] = p_w->timers[(i - 1) / 2];
+    p_w->timers[i] = p_t;
+}
+
+static ExecTask * pTimers_pop(ExecWorker * p_w) {
+    ExecTask * top = p_w->timers[0], * last = p_w->timers[--p_w->nTimers];
+    int i = 0, child = 0;
+    while ((child = 2 * i + 1) < p_w->nTimers) {
+        if(child + 1 < p_w->nTimers && p_w->timers[child + 1]->due < p_w->timers[child]->due) child++;
+        if(last->due <= p_w->timers[child]->due) break;
+        p_w->timers[i] = p_w->timers[child];
+        i = child;
+    }
+    p_w->timers[i] = last;
+    return top;
+}
+
+//Wake up a sleeping worker, if any. The fence orders the publication of the task before the read of nSleeping
+static void pWake(Executor * p_e) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load(&p_e->nSleeping) == 0) return;
+    Lock(&p_e->lock);
+    Signal(&p_e->cv_ExecNews);
+    Unlock(&p_e->lock);
+}
+
+static void pInject(Executor * p_e, ExecTask * p_t) {
+    p_t->next = NULL;
+    Lock(&p_e->lock);
+    if(p_e->injectTail == NULL) p_e->injectHead = p_t;
+    else p_e->injectTail->next = p_t;
+    p_e->injectTail = p_t;
+    atomic_fetch_add(&p_e->nInjected, 1);
+    Unlock(&p_e->lock);
+}
+
+static ExecTask * pTakeInjected(Executor * p_e) {
+    ExecTask * t = NULL;
+    if(atomic_load_explicit(&p_e->nInjected, memory_order_relaxed) == 0) return NULL;
+    Lock(&p_e->lock);
+    if((t = p_e->injectHead) != NULL) {
+        if((p_e->injectHead = t->next) == NULL) p_e->injectTail = NULL;
+        atomic_fetch_sub(&p_e->nInjected, 1);
+    }
+    Unlock(&p_e->lock);
+    return t;
+}
+
+//Try each other worker once, starting from a random one
+static ExecTask * pSteal(ExecWorker * p_w) {
+    Executor * e = p_w->exec;
+    int first = rand_r(&p_w->seed) % e->nWorkers;
+    void * x = NULL;
+    for(int k = 0; k < e->nWorkers; k++) {
+        ExecWorker * victim = &e->workers[(first + k) % e->nWorkers];
+        if(victim == p_w) continue;
+        while ((x = WSDeque_steal(&victim->deque)) == WSDEQUE_ABORT);
+        if(x != NULL) {
+            atomic_store_explicit(&p_w->stolen, atomic_load_explicit(&p_w->stolen, memory_order_relaxed) + 1, memory_order_relaxed);
+            return (ExecTask *) x;
+        }
+    }
+    return NULL;
+}
+
+static int pHasWork(ExecWorker * p_w, int64_t p_now) {
+    Executor * e = p_w->exec;
+    if(atomic_load(&e->nInjected) > 0 || atomic_load(&e->isStopping)) return 1;
+    if(p_w->nTimers > 0 && p_w->timers[0]->due <= p_now) return 1;
+    for(int i = 0; i < e->nWorkers; i++)
+        if(WSDeque_dim(&e->workers[i].deque) > 0) return 1;
+    return 0;
+}
+
+static void * pExecutor_main(void * p_arg) {
+    ExecWorker * w = (ExecWorker *) p_arg;
+    Executor * e = w->exec;
+    ExecTask * t = NULL;
+    struct timespec deadline;
+    int64_t now = 0;
+    int nDue = 0;
+
+    t_worker = w;
+    g_seed = (unsigned int) time(NULL) + w->id; //Otherwise the users run by each worker would choose the same desks
+    TRACE_THREAD_NAME(TH_WORKER, w->id);
+    while (1) {
+        //Due timers become ready tasks, which other workers can steal
+        now = getCurrentTimeNs();
+        for(nDue = 0; w->nTimers > 0 && w->timers[0]->due <= now; nDue++)
+            if(WSDeque_push(&w->deque, pTimers_pop(w)) != 1) ERR_QUIT("An error occurred during executor deque growth.");
+        if(nDue > 1) pWake(e);
+        if((t = WSDeque_pop(&w->deque)) == NULL && (t = pTakeInjected(e)) != NULL && t->due > now) {
+            pTimers_push(w, t);
+            continue;
+        }
+        if(t == NULL) t = pSteal(w);
+        if(t != NULL) {
+            atomic_store_explicit(&w->executed, atomic_load_explicit(&w->executed, memory_order_relaxed) + 1, memory_order_relaxed);
+            t->fun(t);
+            continue;
+        }
+        if(atomic_load(&e->isStopping)) break;
+        //Nothing to do: sleep until the next timer or a new task
+        Lock(&e->lock);
+        atomic_fetch_add(&e->nSleeping, 1);
+        if(!pHasWork(w, getCurrentTimeNs())) {
+            if(w->nTimers == 0) pthread_cond_wait(&e->cv_ExecNews, &e->lock);
+            else {
+                deadline.tv_sec = w->timers[0]->due / 1000000000LL;
+                deadline.tv_nsec = w->timers[0]->due % 1000000000LL;
+                deadline = clockDeadline(deadline);
+                pthread_cond_timedwait(&e->cv_ExecNews, &e->lock, &deadline);
+            }
+        }
+        atomic_fetch_sub(&e->nSleeping, 1);
+        Unlock(&e->lock);
+    }
+    t_worker = NULL;
+    return (void *) NULL;
+}
+
+/**
+ * @brief Create an executor. Its workers are started by #Executor_startThreads, once the clock source and the
+ *        time scale have been set (workers read them while they wait).
+ *
+ * @param p_nWorkers number of worker threads (>0).
+ * @return Executor*: new executor, NULL if an error occurred.
+ */
+Executor * Executor_init(int p_nWorkers) {
+    Executor * aux = NULL;
+    int isLockInit = 0;
+
+    if(p_nWorkers <= 0) return NULL;
+    if((aux = malloc(sizeof(Executor))) == NULL) {
+        ERR_SYS_MSG("An error occurred during memory allocation.");
+        return NULL;
+    }
+    //Workers own a deque each, whose ends are on their own cache lines
+    if((aux->workers = aligned_alloc(CACHE_LINE, p_nWorkers * sizeof(ExecWorker))) == NULL) {
+        ERR_SYS_MSG("An error occurred during memory allocation.");
+        free(aux);
+        return NULL;
+    }
+    aux->nWorkers = aux->nStarted = 0;
+    aux->injectHead = aux->injectTail = NULL;
+    atomic_init(&aux->nSleeping, 0);
+    atomic_init(&aux->nInjected, 0);
+    atomic_init(&aux->isStopping, 0);
+    if(pthread_mutex_init(&aux->lock, NULL) != 0) goto err;
+    isLockInit = 1;
+    if(initCondClock(&aux->cv_ExecNews) != 0) goto err;
+    isLockInit = 2;
+    //Deques are ready before any worker starts, because workers steal from each other
+    for(; aux->nWorkers < p_nWorkers; aux->nWorkers++) {
+        ExecWorker * w = &aux->workers[aux->nWorkers];
+        if(WSDeque_init(&w->deque, EXECUTOR_DEQUE_CAP) != 1) goto err;
+        w->exec = aux;
+        w->id = aux->nWorkers;
+        w->seed = (unsigned) aux->nWorkers * 2654435761u + 1;
+        w->timers = NULL;
+        w->nTimers = w->capTimers = 0;
+        atomic_init(&w->executed, 0);
+        atomic_init(&w->stolen, 0);
+    }
+    return aux;
+err:
+    ERR_MSG("An error occurred during executor setup.");
+    for(int i = 0; i < aux->nWorkers; i++) WSDeque_delete(&aux->workers[i].deque);
+    if(isLockInit == 2) pthread_cond_destroy(&aux->cv_ExecNews);
+    if(isLockInit >= 1) pthread_mutex_destroy(&aux->lock);
+    free(aux->workers);
+    free(aux);
+    return NULL;
+}
+
+/**
+ * @brief Start the workers of the executor. Tasks submitted before are run as soon as the workers start.
+ *
+ * @param p_e Requirements: p_e != NULL and must refer to an Executor created with #Executor_init, not started yet.
+ * @return int: 0 good, the error code of pthread_create otherwise (the workers already started are stopped
+ *         by #Executor_delete)
+ */
+int Executor_startThreads(Executor * p_e) {
+    int res_fun = 0;
+    for(; p_e->nStarted < p_e->nWorkers; p_e->nStarted++)
+        if((res_fun = pthread_create(&p_e->workers[p_e->nStarted].thread, NULL, pExecutor_main, &p_e->workers[p_e->nStarted])) != 0)
+            return res_fun;
+    return 0;
+}
+
+/**
+ * @brief Stop the workers and dealloc the executor. Tasks still submitted are not run anymore.
+ *
+ * @param p_e Requirements: p_e != NULL and must refer to an Executor created with #Executor_init.
+ * @return int: result code:
+ * 1: good
+ * -1: p_e == NULL
+ */
+int Executor_delete(Executor * p_e) {
+    if(p_e == NULL) return -1;
+    atomic_store(&p_e->isStopping, 1);
+    Lock(&p_e->lock);
+    Broadcast(&p_e->cv_ExecNews);
+    Unlock(&p_e->lock);
+    for(int i = 0; i < p_e->nWorkers; i++) {
+        if(i < p_e->nStarted && pthread_join(p_e->workers[i].thread, NULL) != 0) ERR_QUIT("An error occurred during executor worker join.");
+        WSDeque_delete(&p_e->workers[i].deque);
+        free(p_e->workers[i].timers);
+    }
+    pthread_cond_destroy(&p_e->cv_ExecNews);
+    pthread_mutex_destroy(&p_e->lock);
+    free(p_e->workers);
+    free(p_e);
+    return 1;
+}
+
+/**
+ * @brief Run p_t as soon as possible. From a worker the task goes on its own deque, from any other thread
+ *        through the injection queue. Changes made before the call are visible to the task.
+ *
+ * @param p_e Requirements: p_e != NULL and must refer to an Executor created with #Executor_init.
+ * @param p_t task, not already submitted.
+ */
+void Executor_submit(Executor * p_e, ExecTask * p_t) {
+    p_t->due = 0;
+    if(t_worker != NULL && t_worker->exec == p_e) {
+        if(WSDeque_push(&t_worker->deque, p_t) != 1) ERR_QUIT("An error occurred during executor deque growth.");
+    } else pInject(p_e, p_t);
+    pWake(p_e);
+}
+
+/**
+ * @brief Run p_t when p_due is reached. From a worker no lock is taken: the task waits in the timers of the worker,
+ *        which looks at them before sleeping.
+ *
+ * @param p_e Requirements: p_e != NULL and must refer to an Executor created with #Executor_init.
+ * @param p_t task, not already submitted.
+ * @param p_due time (ns, clock of #getCurrentTimeNs).
+ */
+void Executor_submitAt(Executor * p_e, ExecTask * p_t, int64_t p_due) {
+    p_t->due = p_due;
+    if(t_worker != NULL && t_worker->exec == p_e) pTimers_push(t_worker, p_t);
+    else {
+        pInject(p_e, p_t);
+        pWake(p_e);
+    }
+}
+
+/**
+ * @brief Write in p_buff (at least #MAXLINE chars) the tasks run by the workers and how many were stolen.
+ */
+void Executor_log(Executor * p_e, char * p_buff) {
+    long executed = 0, stolen = 0;
+    for(int i = 0; i < p_e->nWorkers; i++) {
+        executed += atomic_load_explicit(&p_e->workers[i].executed, memory_order_relaxed);
+        stolen += atomic_load_explicit(&p_e->workers[i].stolen, memory_order_relaxed);
+    }
+    sprintf(p_buff, "[Executor]: workers=%d tasks=%ld stolen=%ld stolen_pct=%.2f", p_e->nWorkers, executed, stolen,
+        executed > 0 ? 100.0 * stolen / executed : 0);
+}
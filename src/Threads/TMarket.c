@@ -4,10 +4,16 @@
 #include <Config.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <signal.h>
 #include <PayArea.h>
 #include <utilities.h>
+#include <ArrivalTrace.h>
+#include <ArrivalProcess.h>
+#include <EventLog.h>
+#include <errno.h>
+#include <stddef.h>
 
 /**
  * @file TMarket.c
@@ -39,6 +45,28 @@ static int pGetLong(FILE * f, const char * p_key, long * p_x){
 	}
 	return 1;
 }
+/**
+ * @brief Like #pGetLong, but the property is optional: if it is not defined p_x is set to p_default.
+ * 
+ * @param f config file
+ * @param p_key key to search
+ * @param p_x where the value will be placed
+ * @param p_default value used when p_key is not defined
+ * @return int: result code:
+ * 1: p_x contain value associated to p_key in the config file or p_default
+ * -2: property is defined but it can't be parsed as long
+ */
+static int pGetLongOpt(FILE * f, const char * p_key, long * p_x, long p_default){
+	char str_aux[MAX_DIM_STR_CONF]; //Used to get string value from config file
+	
+	*p_x = p_default;
+	if(Config_getValue(f, p_key, str_aux) != 1) return 1;
+	if(Config_parseLong(p_x, str_aux) != 1){
+		ERR_MSG("The property %s is defined but it has a wrong value format.\n", p_key);
+		return -2;
+	}
+	return 1;
+}
 /**
  * @brief Check if constraint is satisfied. If it is not, display a warning message.
  * @param p_check is the result of the check.
@@ -55,11 +83,144 @@ static int pCheckContraint(int p_check, const char * p_contraint){
 	return 1;
 }
 
-static void pDeallocUser(void * p_arg){
-	User * u = (User *) p_arg;
-	User_delete(u);
+/**
+ * @brief Executor: wake up the market task at p_due, unless a wakeup is already armed (arrivals come in order,
+ *        so an armed wakeup is never later than the next arrival).
+ * 
+ * @param p_m reference to the market in which the action is performed
+ * @param p_due wakeup time (ns, clock of #getCurrentTimeNs)
+ */
+static void pArmArrival(Market * p_m, int64_t p_due){
+	if(atomic_exchange(&p_m->isArrivalArmed, 1) == 0) Executor_submitAt(p_m->executor, &p_m->arrivalTask, p_due);
+}
+
+/**
+ * @brief Get products and shopping time of the next customer allowed to enter the market.
+ *        If an arrival trace is used, next record is consumed and its arrival time is waited,
+ *        otherwise values are random. With an executor the arrival time is not waited: the record is kept
+ *        and the market task is woken up when it is due.
+ * 
+ * @param p_m reference to the market in which the action is performed
+ * @param p_products where the number of products is placed
+ * @param p_shoppingTime where the shopping time is placed
+ * @return int: result code:
+ * 1: p_products and p_shoppingTime are set
+ * 0: the arrival trace is exhausted
+ * -1: the next arrival is not due yet (executor only)
+ */
+static int pNextCustomer(Market * p_m, int * p_products, int * p_shoppingTime){
+	ArrivalRecord * rec = &p_m->nextRecord;
+	int64_t due = 0;
+	if(p_m->arrivals == NULL){
+		*p_products = getRandom(0, p_m->P);
+		*p_shoppingTime = getRandom(10, p_m->T);
+		return 1;
+	}
+	if(!p_m->isRecordPending) {
+		if(ArrivalTrace_next(p_m->arrivals, rec) != 1) return 0;
+		p_m->isRecordPending = 1;
+	}
+	if(p_m->executor == NULL) {
+		if(ArrivalTrace_waitArrival(p_m->arrivals, rec) == -1)
+			ERR_SYS_QUIT("[Market]: an error occurred during waiting for next arrival.\n");
+	} else if((due = ArrivalTrace_due(p_m->arrivals, rec)) > getCurrentTimeNs()) {
+		pArmArrival(p_m, due);
+		return -1;
+	}
+	p_m->isRecordPending = 0;
+	*p_products = rec->products;
+	*p_shoppingTime = rec->shoppingTime;
+	return 1;
+}
+
+/**
+ * @brief When the arrival trace has been fully replayed and all users are out, ask for a gracefull closure
+ *        of p_m exactly as if SIGHUP had been received. The other markets of the process (chain or shard) go on.
+ * 
+ * @param p_m reference to the market in which the action is performed
+ */
+static void pCheckReplayEnd(Market * p_m){
+	if(p_m->arrivals == NULL || p_m->isRecordPending || p_m->nParked != p_m->createdUsers ||
+		ArrivalTrace_isExhausted(p_m->arrivals) != 1) return;
+	printf("[Market]: arrival trace replayed. Market is closing...\n");
+	atomic_store(&p_m->isClosing, 1);
+	Market_Signal(p_m);
+}
+
+
+/**
+ * @brief Count p_n users entering the shopping area. Must be called before they are visible in usersShopping.
+ */
+static void pEnterShopping(Market * p_m, long p_n){
+	atomic_fetch_add(&p_m->inShopping, p_n);
+}
+
+/**
+ * @brief Count a user which left the shopping area. Must be called after the user has been placed in its next queue.
+ *        When the shopping area becomes empty, desks and director are woken up: on closing it's the moment they can stop.
+ */
+static void pLeaveShopping(Market * p_m){
+	if(atomic_fetch_sub(&p_m->inShopping, 1) == 1) {
+		PayArea_Signal(p_m->payArea);
+		Director_SignalAuth(p_m->director);
+	}
+}
+
+/**
+ * @brief Open market: admit all the arrivals already due, while there are parked users to host them.
+ *        Admitted users are taken from the tail of parked, moved in shopping area with a single insert
+ *        and woken up together. Users never admitted before have no thread yet: they lie at the head of
+ *        parked in index order (exited users are parked above them), so their threads are started as one range.
+ * 
+ * @param p_m reference to the market in which the action is performed
+ */
+static void pAdmitArrivals(Market * p_m){
+	const ArrivalRecord * rec = NULL;
+	uint64_t now = ArrivalProcess_now(p_m->process);
+	void ** parked = p_m->parked;
+	long nGroup = 0;
+	while(nGroup < p_m->nParked && (rec = ArrivalProcess_peek(p_m->process))->arrival <= now) {
+		User_reset(p_m->users, USER_FROM_PTR(parked[p_m->nParked - 1 - nGroup]), rec->products, rec->shoppingTime);
+		ArrivalProcess_pop(p_m->process, now);
+		nGroup++;
+	}
+	if(nGroup == 0) return;
+	p_m->nParked -= nGroup;
+	pEnterShopping(p_m, nGroup);
+	if(SQueue_pushAll(p_m->usersShopping, &parked[p_m->nParked], nGroup) != 1)
+		ERR_QUIT("[Market]: Impossible to move users in shopping area.");
+	User_setStateAll(p_m->users, &parked[p_m->nParked], nGroup, USR_READY);
+	if(p_m->nParked < p_m->nFresh) {
+		if(User_startAll(p_m->users, (int) p_m->nParked, (int) (p_m->nFresh - p_m->nParked)) != 1)
+			ERR_QUIT("[Market]: An error occurred during user admission. (User startThread failed)");
+		p_m->nFresh = p_m->nParked;
+	}
+}
+
+/**
+ * @brief Get the number of users in shopping area (including the ones moving to a queue).
+ * 
+ * @param p_m Requirements: p_m != NULL and must refer to a Market object created with #Market_init. Target Market.
+ * @return long: number of users
+ */
+long Market_inShopping(Market * p_m){
+	return atomic_load(&p_m->inShopping);
 }
 
+/**
+ * @brief Count users moving from a desk queue to another (see #PayArea_jockey) as a user in shopping area,
+ *        so that on closing desks and director wait for them. Every call must be followed by #Market_endMoving.
+ */
+void Market_startMoving(Market * p_m){
+	pEnterShopping(p_m, 1);
+}
+
+/**
+ * @brief End of a move started with #Market_startMoving: users moved are already in their new queue.
+ */
+void Market_endMoving(Market * p_m){
+	pLeaveShopping(p_m);
+}
 
 /**
  * @brief Move user p_u from shopping to a open cashdesk.
@@ -67,12 +228,71 @@ static void pDeallocUser(void * p_arg){
  * @param p_m reference to the market in which the action is performed
  * @param p_u user who is moving
  */
-void Market_FromShoppingToPay(Market * p_m, User * p_u) {
+void Market_FromShoppingToPay(Market * p_m, int p_u) {
 	//Remove user from shopping
-	if( SQueue_remove(p_m->usersShopping, p_u, User_compare) != 1)
-		ERR_QUIT("Impossible to find User %d in shopping area.", p_u->id);
+	if( SQueue_remove(p_m->usersShopping, USER_TO_PTR(p_u), User_compare) != 1)
+		ERR_QUIT("Impossible to find User %d in shopping area.", p_m->users->id[p_u]);
 	//Move user to a random open cash desk
 	PayArea_addUser(p_m->payArea, p_u);
+	pLeaveShopping(p_m);
+}
+
+/**
+ * @brief Log how late timers fired (process-wide): with a time scale, late timers mean that the
+ *        simulated times are no longer faithful and the scale must be lowered.
+ *        One more line for each kind of delay reports the requested delay and the distribution of the lag.
+ */
+static void pLogTimers(Market * p_m) {
+	char aux[MAXLINE];
+	TimerStats st;
+	double pct = 0;
+	getTimerStats(TIMER_ALL, &st);
+	pct = st.timers > 0 ? 100.0 * st.late / st.timers : 0;
+	sprintf(aux, "[Timers]: clock=%s scale=%ld timers=%lld late=%lld late_pct=%.2f avg_late_ms=%.3f max_late_ms=%.3f",
+		getClockSourceName(), getTimeScale(), st.timers, st.late, pct, st.late > 0 ? (double) st.sumLateNs / st.late / 1000000 : 0,
+		(double) st.maxLateNs / 1000000);
+	printf("%s\n", aux);
+	Market_log(p_m, aux);
+	for(int k = 0; k < TIMER_ALL; k++) {
+		getTimerStats(k, &st);
+		if(st.timers == 0) continue;
+		sprintf(aux, "[Timers %s]: timers=%lld avg_req_ms=%.3f avg_lag_ms=%.3f p50_lag_ms=%.3f p99_lag_ms=%.3f max_late_ms=%.3f late_pct=%.2f",
+			getTimerKindName(k), st.timers, (double) st.sumReqNs / st.timers / 1000000, (double) st.sumLagNs / st.timers / 1000000,
+			(double) timerLagPercentile(&st, 50) / 1000000, (double) timerLagPercentile(&st, 99) / 1000000,
+			(double) st.maxLateNs / 1000000, 100.0 * st.late / st.timers);
+		printf("%s\n", aux);
+		Market_log(p_m, aux);
+	}
+	if(pct > TIMER_LATE_MAX_PCT)
+		printf("[Timers]: time scale %ldx is not achievable with this configuration: %.2f%% of the timers fired late.\n",
+			getTimeScale(), pct);
+}
+
+/**
+ * @brief Compare the p99 lag of each kind of timer with LAG_TOLERANCE_MS, at most once every #MARKET_LAG_CHECK_NS.
+ *        A lagging kind is reported once, or the run is aborted with LAG_ACTION=abort: the simulated times would
+ *        not be faithful, C or K are too high for this machine.
+ */
+static void pCheckTimers(Market * p_m) {
+	TimerStats st;
+	int64_t now = 0, p99 = 0;
+	char aux[MAXLINE];
+	if(p_m->lagTolerance == 0 || (now = getCurrentTimeNs()) - p_m->lagChecked < MARKET_LAG_CHECK_NS) return;
+	p_m->lagChecked = now;
+	for(int k = 0; k < TIMER_ALL; k++) {
+		if(p_m->lagWarned & (1 << k)) continue;
+		getTimerStats(k, &st);
+		if(st.timers < TIMER_CHECK_MIN || (p99 = timerLagPercentile(&st, 99)) <= p_m->lagTolerance) continue;
+		p_m->lagWarned |= 1 << k;
+		sprintf(aux, "[Timers]: %s delays lag too much: p99_lag_ms=%.3f (tolerance %.3f) over %lld timers",
+			getTimerKindName(k), (double) p99 / 1000000, (double) p_m->lagTolerance / 1000000, st.timers);
+		printf("%s\n", aux);
+		Market_log(p_m, aux);
+		if(p_m->isLagAbort) {
+			pLogTimers(p_m);
+			ERR_QUIT("[Market]: the simulation is not faithful (LAG_ACTION=abort). Lower C, K or TIME_SCALE. Exit...");
+		}
+	}
 }
 
 /**
@@ -81,18 +301,21 @@ void Market_FromShoppingToPay(Market * p_m, User * p_u) {
  * @param p_m reference to the market in which the action is performed
  * @param p_u user who is moving
  */
-void Market_FromShoppingToExit(Market * p_m, User * p_u) {
-	struct timespec cur;
+void Market_FromShoppingToExit(Market * p_m, int p_u) {
+	UserStore * us = p_m->users;
+	int64_t cur;
 	//Remove user from shopping
-	if( SQueue_remove(p_m->usersShopping, p_u, User_compare) != 1)
-		ERR_QUIT("Impossible to find User %d in shopping area.", p_u->id);
-	cur = getCurrentTime();
-	p_u->tQueueStart = cur;
-	p_u->tMarketExit = cur;
-	p_u->products = 0;
-	if(SQueue_push(p_m->usersExit, p_u) != 1)
-		ERR_QUIT("Impossible to move User %d in exit queue.", p_u->id);
-	Signal(&p_m->cv_MarketNews);
+	if( SQueue_remove(p_m->usersShopping, USER_TO_PTR(p_u), User_compare) != 1)
+		ERR_QUIT("Impossible to find User %d in shopping area.", us->id[p_u]);
+	cur = getCurrentTimeNs();
+	us->tQueueStart[p_u] = cur;
+	us->tMarketExit[p_u] = cur;
+	us->products[p_u] = 0;
+	EVENT_RECORD(EV_USER_EXIT, us->id[p_u], 0, 0);
+	if(SQueue_push(p_m->usersExit, USER_TO_PTR(p_u)) != 1)
+		ERR_QUIT("Impossible to move User %d in exit queue.", us->id[p_u]);
+	pLeaveShopping(p_m);
+	Market_Signal(p_m);
 }
 
 /**
@@ -101,15 +324,18 @@ void Market_FromShoppingToExit(Market * p_m, User * p_u) {
  * @param p_m reference to the market in which the action is performed
  * @param p_u user who is moving
  */
-void Market_FromShoppingToAuth(Market * p_m, User * p_u) {
+void Market_FromShoppingToAuth(Market * p_m, int p_u) {
+	UserStore * us = p_m->users;
 	//Remove user from shopping
-	if( SQueue_remove(p_m->usersShopping, p_u, User_compare) != 1)
-		ERR_QUIT("Impossible to find User %d in shopping area.", p_u->id);
-	p_u->tQueueStart = getCurrentTime();
-	p_u->queueChanges++;
-	if(SQueue_push(p_m->usersAuthQueue, p_u) != 1)
-		ERR_QUIT("Impossible to move User %d in authorization queue.", p_u->id);
-	Signal(&p_m->director->cv_Director_AuthNews);
+	if( SQueue_remove(p_m->usersShopping, USER_TO_PTR(p_u), User_compare) != 1)
+		ERR_QUIT("Impossible to find User %d in shopping area.", us->id[p_u]);
+	us->tQueueStart[p_u] = getCurrentTimeNs();
+	us->queueChanges[p_u]++;
+	EVENT_RECORD(EV_USER_AUTH, us->id[p_u], 0, 0);
+	if(SQueue_push(p_m->usersAuthQueue, USER_TO_PTR(p_u)) != 1)
+		ERR_QUIT("Impossible to move User %d in authorization queue.", us->id[p_u]);
+	Director_SignalAuth(p_m->director);
+	pLeaveShopping(p_m);
 }
 
 /**
@@ -118,11 +344,13 @@ void Market_FromShoppingToAuth(Market * p_m, User * p_u) {
  * @param p_m reference to the market in which the action is performed
  * @param p_u user to move
  */
-void Market_moveToExit(Market * p_m, User * p_u){
-	p_u->tMarketExit = getCurrentTime();
-	if(SQueue_push(p_m->usersExit, p_u) != 1)
-		ERR_QUIT("Impossible to move User %d in exit queue.", p_u->id);
-	Signal(&p_m->cv_MarketNews);
+void Market_moveToExit(Market * p_m, int p_u){
+	UserStore * us = p_m->users;
+	us->tMarketExit[p_u] = getCurrentTimeNs();
+	EVENT_RECORD(EV_USER_EXIT, us->id[p_u], 0, 0);
+	if(SQueue_push(p_m->usersExit, USER_TO_PTR(p_u)) != 1)
+		ERR_QUIT("Impossible to move User %d in exit queue.", us->id[p_u]);
+	Market_Signal(p_m);
 }
 
 /**
@@ -138,20 +366,279 @@ void Market_log(Market * p_m, char * p_data) {
 }
 
 
+/**
+ * @brief Start desks and director, then create the users: all of them with random customers (admitted at once)
+ *        and with an open market (parked until their arrival), none with a trace (see #pCreateTraceUsers).
+ * 
+ * @param p_m reference to the market in which the action is performed
+ */
+static void pStartMarket(Market * p_m){
+	UserStore * us = p_m->users;
+	if((p_m->exited = Arena_alloc(&p_m->arena, p_m->C * sizeof(void *))) == NULL ||
+		(p_m->parked = Arena_alloc(&p_m->arena, p_m->C * sizeof(void *))) == NULL)
+		ERR_QUIT("[Market]: An error occurred during market startup. (exit buffers allocation failed)");
+	
+	//Start CashDesks Threads
+	PayArea_startDeskThreads(p_m->payArea);
+
+	//Start Director thread (it must be ready before users arrive, they may need an exit authorization)
+	if(Director_startThread(p_m->director) != 0)
+		ERR_QUIT("[Market]: An error occurred during desk thread start. (CashDesk startThread failed)");
+
+	//Create and add C users in shopping area
+	p_m->tStartup = getCurrentTimeNs();
+	if(p_m->process != NULL) {
+		//Open market: all users are created out of the market and recycled. A user thread is started at its
+		//first admission, so only the users the arrivals need ever become runnable
+		if(User_initAll(us, p_m->C) < 0)
+			ERR_QUIT("[Market]: An error occurred during market startup. (User init failed)");
+		for(int i = 0; i < p_m->C; i++) p_m->parked[i] = USER_TO_PTR(i);
+		p_m->nParked = p_m->nFresh = p_m->createdUsers = p_m->C;
+		ArrivalProcess_start(p_m->process);
+	} else if(p_m->arrivals == NULL) {
+		//Random customers: build all users in parallel, admit them with a single insert, then start their threads
+		if(User_initAll(us, p_m->C) < 0)
+			ERR_QUIT("[Market]: An error occurred during market startup. (User init failed)");
+		for(int i = 0; i < p_m->C; i++) p_m->exited[i] = USER_TO_PTR(i);
+		pEnterShopping(p_m, p_m->C);
+		if(SQueue_pushAll(p_m->usersShopping, p_m->exited, p_m->C) != 1)
+			ERR_QUIT("[Market]: Impossible to move users in shopping area.");
+		if(User_startAll(us, 0, p_m->C) != 1)
+			ERR_QUIT("[Market]: An error occurred during market startup. (User startThread failed)");
+		p_m->createdUsers = p_m->C;
+	}
+}
+
+/**
+ * @brief Trace replay: create the first C users, each one at its arrival time.
+ * 
+ * @param p_m reference to the market in which the action is performed
+ * @return int: 1 if all of them have been created (or the trace is exhausted), 0 if the next arrival is not due yet
+ *         (executor only: the market task is woken up at the arrival)
+ */
+static int pCreateTraceUsers(Market * p_m){
+	int u = 0, products = 0, shoppingTime = 0, res = 1;
+	while(p_m->createdUsers < p_m->C && (res = pNextCustomer(p_m, &products, &shoppingTime)) == 1) {
+		if((u = User_init(p_m->users, products, shoppingTime)) == -1)
+			ERR_QUIT("[Market]: An error occurred during market startup. (User init failed)");
+		pEnterShopping(p_m, 1);
+		SQueue_push(p_m->usersShopping, USER_TO_PTR(u));
+		if(User_startThread(p_m->users, u) != 0)
+			ERR_QUIT("[Market]: An error occurred during market startup. (User startThread failed)");
+		p_m->createdUsers++;
+	}
+	return res != -1;
+}
+
+/**
+ * @brief Log the time spent to create and admit the first users.
+ */
+static void pEndStartup(Market * p_m){
+	char aux[MAXLINE];
+	p_m->tStartup = getCurrentTimeNs() - p_m->tStartup;
+	sprintf(aux, "[Market]: users=%d startup_time=%.3f", p_m->createdUsers, (double) p_m->tStartup / 1000000);
+	printf("%s\n", aux);
+	Market_log(p_m, aux);
+	pCheckReplayEnd(p_m);
+}
+
+/**
+ * @brief Readmit a group for each E exits (with a trace, only while there are records to replay). Each group is
+ *        taken from the tail of parked, moved in shopping area with a single insert and woken up together.
+ *        With an executor a group waiting for an arrival is admitted in parts: groupIn users are already in.
+ * 
+ * @param p_m reference to the market in which the action is performed
+ */
+static void pReadmitGroups(Market * p_m){
+	UserStore * us = p_m->users;
+	long nGroup = 0;
+	int products = 0, shoppingTime = 0, res = 1;
+	while (p_m->process == NULL && p_m->numExit >= p_m->E) {
+		nGroup = 0;
+		while(p_m->groupIn + nGroup < p_m->E && nGroup < p_m->nParked &&
+			(res = pNextCustomer(p_m, &products, &shoppingTime)) == 1) {
+			//Reset user for next reuse
+			User_reset(us, USER_FROM_PTR(p_m->parked[p_m->nParked - 1 - nGroup]), products, shoppingTime);
+			nGroup++;
+		}
+		p_m->nParked -= nGroup;
+		//One lock on shopping area and one wakeup for the whole group
+		pEnterShopping(p_m, nGroup);
+		if(SQueue_pushAll(p_m->usersShopping, &p_m->parked[p_m->nParked], nGroup) != 1)
+			ERR_QUIT("[Market]: Impossible to move users in shopping area.");
+		User_setStateAll(us, &p_m->parked[p_m->nParked], nGroup, USR_READY);
+		if(res == -1) {
+			p_m->groupIn += nGroup;
+			return;
+		}
+		p_m->groupIn = 0;
+		p_m->numExit -= p_m->E;
+	}
+}
+
+/**
+ * @brief Drain the exit queue in bulk, log the whole batch at once and readmit the groups it completes.
+ * 
+ * @param p_m reference to the market in which the action is performed
+ */
+static void pDrainExits(Market * p_m){
+	long nExited = SQueue_popAll(p_m->usersExit, p_m->exited, p_m->C);
+	//A group waiting for its arrivals goes on also without new exits
+	if(nExited == 0 && !p_m->isRecordPending) return;
+	TRACE_BEGIN(PH_EXIT);
+	User_logAll(p_m->users, p_m->exited, nExited);
+	for(long i = 0; i < nExited; i++) p_m->parked[p_m->nParked++] = p_m->exited[i];
+	p_m->numExit += nExited;
+	pReadmitGroups(p_m);
+	pCheckReplayEnd(p_m);
+	TRACE_END(PH_EXIT);
+}
+
+/**
+ * @brief Closing: park the users left in the exit queue and stop all the users (desks and director ended, so
+ *        every user is out). The ones never admitted have no thread to stop.
+ * 
+ * @param p_m reference to the market in which the action is performed
+ */
+static void pStopUsers(Market * p_m){
+	long nExited = 0;
+	//Remove all users from exit queue (parked users have been already logged)
+	printf("Removing users from exit queue..\n");
+	nExited = SQueue_popAll(p_m->usersExit, p_m->exited, p_m->C);
+	User_logAll(p_m->users, p_m->exited, nExited);
+	for(long i = 0; i < nExited; i++) p_m->parked[p_m->nParked++] = p_m->exited[i];
+	User_setStateAll(p_m->users, &p_m->parked[p_m->nFresh], p_m->nParked - p_m->nFresh, USR_QUIT);
+}
+
+/**
+ * @brief Closing: log arrivals, timers and desk statistics, once all threads (or tasks) of the market ended.
+ * 
+ * @param p_m reference to the market in which the action is performed
+ */
+static void pLogClosing(Market * p_m){
+	char aux[MAXLINE];
+	printf("[Market]: Users removed: %ld\n", p_m->nParked);
+	if(p_m->process != NULL) {
+		sprintf(aux, "[Market]: arrivals=%llu avg_door_wait=%.3f", (unsigned long long) p_m->process->admitted,
+			p_m->process->admitted > 0 ? (double) p_m->process->doorWait / p_m->process->admitted : 0.0);
+		printf("%s\n", aux);
+		Market_log(p_m, aux);
+	}
+	pLogTimers(p_m);
+	//Log all cashdesks data
+	DEBUG_PRINT("Market_isEmpty: %d\n", Market_isEmpty(p_m));
+	printf("Log all cash desks statistics..\n");
+	for(int i = 0; i < p_m->K; i++) 
+		CashDesk_log(p_m->payArea->desks[i]);
+	//A shared executor is logged by the chain
+	if(p_m->executor != NULL && !p_m->isExecutorShared) {
+		Executor_log(p_m->executor, aux);
+		printf("%s\n", aux);
+		Market_log(p_m, aux);
+	}
+}
+
+//Executor: the market wakes up submitting its task (see #Mailbox_initTask)
+static void pMarket_wake(void * p_arg) {
+	Market * m = (Market *) p_arg;
+	Executor_submit(m->executor, &m->task);
+}
+
+//Executor: the next arrival is due. The timer can be armed again as soon as isArrivalArmed is cleared, so p_t is not used after
+static void pArrivalStep(ExecTask * p_t) {
+	Market * m = (Market *) ((char *) p_t - offsetof(Market, arrivalTask));
+	atomic_store(&m->isArrivalArmed, 0);
+	Market_Signal(m);
+}
+
+/**
+ * @brief Executor: task of the market, the same steps of #Market_main without blocking. Each run goes on from
+ *        the phase reached by the previous one, then it parks on the mailbox: exits, arrivals, the closure and the
+ *        end of desks, director and users run it again. Instead of joining threads, on closing it waits for the
+ *        tasks of desks and director to end, then for the ones of the users.
+ */
+static void pMarket_step(ExecTask * p_t) {
+	Market * m = (Market *) ((char *) p_t - offsetof(Market, task));
+	struct timespec deadline; //next arrival of the open market
+
+	while (1) {
+		Mailbox_take(&m->mailbox);
+		pCheckTimers(m);
+		if(m->phase == MARKET_INIT) {
+			pStartMarket(m);
+			m->phase = MARKET_STARTING;
+		}
+		if(m->phase < MARKET_CLOSING && (Market_isClosing(m) || sig_quit == 1)) {
+			printf("Market is closing...\n");
+			//When SIGHUP or SIQQUIT occurs no new users are allowed inside the market and
+			//all the users inside are waited.
+			PayArea_Signal(m->payArea);
+			Director_SignalAuth(m->director);
+			printf("Cashdesks and director termination...\n");
+			m->phase = MARKET_CLOSING;
+		}
+		if(m->phase == MARKET_STARTING && pCreateTraceUsers(m) == 1) {
+			pEndStartup(m);
+			m->phase = MARKET_OPEN;
+		}
+		if(m->phase == MARKET_OPEN) {
+			pDrainExits(m);
+			if(m->process != NULL) {
+				pAdmitArrivals(m);
+				//The next arrival is waited only if there is room for it
+				if(m->nParked > 0) {
+					deadline = ArrivalProcess_deadline(m->process, ArrivalProcess_peek(m->process));
+					pArmArrival(m, (int64_t) deadline.tv_sec * 1000000000LL + deadline.tv_nsec);
+				}
+			}
+		}
+		if(m->phase == MARKET_CLOSING && PayArea_isEnded(m->payArea) && Director_isEnded(m->director)) {
+			pStopUsers(m);
+			m->phase = MARKET_CLOSING_USERS;
+		}
+		if(m->phase == MARKET_CLOSING_USERS && UserStore_isEnded(m->users)) {
+			pLogClosing(m);
+			m->phase = MARKET_CLOSED;
+			//Ended without parking: later posts don't run the task again
+			atomic_store(&m->isDone, 1);
+			Mailbox_post(&m->done, MAILBOX_WAKE);
+			return;
+		}
+		if(Mailbox_park(&m->mailbox)) return;
+	}
+}
+
 /**
  * @brief Create a new Market object.
  * 
  * @param p_conf configuration file used to init the market.
  * @param p_log path to log file which will contain simulation results.
+ * @param p_executor workers shared with other markets (chain), which run all the actors of the market as tasks.
+ *        NULL: the market has its own executor if DESK_WORKERS>0, otherwise its own threads.
  * @return Market* pointer to new market allocated, NULL if a probelm occurred during allocation. 
  */
-Market * Market_init(const char * p_conf, const char * p_log){
+Market * Market_init(const char * p_conf, const char * p_log, Executor * p_executor){
 	Market * m = NULL;
 	FILE * f_log = NULL;
 	FILE * f_conf = NULL;
 	int res = 1;
 	char userChoice;
 	int isLockInit = 0;
+	char traceIn[MAX_DIM_STR_CONF]; //Path of arrival trace (optional)
+	char eventLog[MAX_DIM_STR_CONF]; //Path of event log (optional)
+	char arrivalRates[MAX_DIM_STR_CONF]; //Rate profile of the open market (optional)
+	long arrivalPeriod = 3600000;
+	int isArenaInit = 0;
+	long traceSpeed = 1;
+	char cpuDesks[MAX_DIM_STR_CONF]; //Cpus of the desks (optional)
+	char cpuUsers[MAX_DIM_STR_CONF]; //Cpus of the users (optional)
+	long cpuDirector = -1, cpuMarket = -1;
+	long timeScale = 1;
+	char clockSource[MAX_DIM_STR_CONF]; //Source of the time stamps (optional)
+	char logTime[MAX_DIM_STR_CONF]; //Resolution of the logged times (optional)
+	char lagAction[MAX_DIM_STR_CONF]; //What to do when timers lag (optional)
+	long lagTolerance = 0;
+	long deskWorkers = 0;
 
 	//Check the log file path
 	f_log = fopen(p_log, "r");
@@ -179,14 +666,8 @@ Market * Market_init(const char * p_conf, const char * p_log){
 		goto err;
 	}
 
-	//Read configurations
-	printf("Reading configuration file %s ...\n", p_conf);
-	if(Config_checkFile(f_conf) != 1) {
-		ERR_MSG("Impossible to setup the market, because there are some error in the config file.\nFix them and try again.");
-		goto err;
-	}
 	//Try to read from configuration file
-	if((m = malloc(sizeof(Market))) == NULL){
+	if((m = aligned_alloc(CACHE_LINE, sizeof(Market))) == NULL){
 		ERR_SYS_MSG("An error occurred during memory allocation.");
 		goto err;
 	}
@@ -197,6 +678,40 @@ Market * Market_init(const char * p_conf, const char * p_log){
 	m->usersExit = NULL;
 	m->usersAuthQueue = NULL;
 	m->payArea = NULL;
+	m->users = NULL;
+	m->arrivals = NULL;
+	m->process = NULL;
+	m->executor = NULL;
+	m->isExecutorShared = 0;
+	m->isEventLogOwner = 0;
+	m->usersOut = 0;
+	m->exited = m->parked = NULL;
+	m->nParked = m->nFresh = m->numExit = m->groupIn = 0;
+	m->createdUsers = 0;
+	m->tStartup = 0;
+	m->isRecordPending = 0;
+	m->phase = MARKET_INIT;
+	m->task.fun = pMarket_step;
+	m->arrivalTask.fun = pArrivalStep;
+	atomic_init(&m->inShopping, 0);
+	atomic_init(&m->isClosing, 0);
+	atomic_init(&m->isArrivalArmed, 0);
+	atomic_init(&m->isDone, 0);
+	Mailbox_init(&m->done);
+	//Arena init: configuration labels, users, desks, director, queue nodes and notify messages are allocated here,
+	//so that the running market never calls malloc/free once pools reached their working size
+	if(Arena_init(&m->arena, MARKET_ARENA_CHUNK) != 1){
+		ERR_MSG("An error occurred during arena creation. Impossible to setup the market.");
+		goto err;
+	}
+	isArenaInit = 1;
+
+	//Read configurations
+	printf("Reading configuration file %s ...\n", p_conf);
+	if(Config_checkFile(f_conf, &m->arena) != 1) {
+		ERR_MSG("Impossible to setup the market, because there are some error in the config file.\nFix them and try again.");
+		goto err;
+	}
 	printf("Checking if all configuration items required are defined...\n");
 	//Format check
 	res = pGetLong(f_conf, "K", &m->K) != 1 ? 0:res;
@@ -210,6 +725,23 @@ Market * Market_init(const char * p_conf, const char * p_log){
 	res = pGetLong(f_conf, "S2", &m->S2) != 1 ? 0:res;
 	res = pGetLong(f_conf, "NP", &m->NP) != 1 ? 0:res;
 	res = pGetLong(f_conf, "TD", &m->TD) != 1 ? 0:res;
+	//Optional items
+	res = pGetLongOpt(f_conf, "TRACE_SPEED", &traceSpeed, 1) != 1 ? 0:res;
+	if(Config_getValue(f_conf, "TRACE_IN", traceIn) != 1) traceIn[0] = '\0';
+	if(Config_getValue(f_conf, "EVENT_LOG", eventLog) != 1) eventLog[0] = '\0';
+	if(Config_getValue(f_conf, "ARRIVAL_RATES", arrivalRates) != 1) arrivalRates[0] = '\0';
+	res = pGetLongOpt(f_conf, "ARRIVAL_PERIOD", &arrivalPeriod, 3600000) != 1 ? 0:res;
+	res = pGetLongOpt(f_conf, "CPU_DIRECTOR", &cpuDirector, -1) != 1 ? 0:res;
+	res = pGetLongOpt(f_conf, "CPU_MARKET", &cpuMarket, -1) != 1 ? 0:res;
+	if(Config_getValue(f_conf, "CPU_DESKS", cpuDesks) != 1) cpuDesks[0] = '\0';
+	if(Config_getValue(f_conf, "CPU_USERS", cpuUsers) != 1) cpuUsers[0] = '\0';
+	res = pGetLongOpt(f_conf, "USER_STACK", &m->userStack, MARKET_USER_STACK_KB) != 1 ? 0:res;
+	res = pGetLongOpt(f_conf, "TIME_SCALE", &timeScale, 1) != 1 ? 0:res;
+	if(Config_getValue(f_conf, "CLOCK_SOURCE", clockSource) != 1) strcpy(clockSource, "monotonic");
+	if(Config_getValue(f_conf, "LOG_TIME", logTime) != 1) strcpy(logTime, "us");
+	res = pGetLongOpt(f_conf, "LAG_TOLERANCE_MS", &lagTolerance, 0) != 1 ? 0:res;
+	if(Config_getValue(f_conf, "LAG_ACTION", lagAction) != 1) strcpy(lagAction, "warn");
+	res = pGetLongOpt(f_conf, "DESK_WORKERS", &deskWorkers, 0) != 1 ? 0:res;
 
 	fclose(f_conf);
 	f_conf = NULL;
@@ -232,6 +764,24 @@ Market * Market_init(const char * p_conf, const char * p_log){
 	res = pCheckContraint(m->S2 > 0 && m->S2 <= m->C, "{0<S2<=C}") != 1 ? 0:res;
 	res = pCheckContraint(m->NP > 0, "{NP>0}") != 1 ? 0:res;
 	res = pCheckContraint(m->TD > 0, "{TD>0}") != 1 ? 0:res;
+	res = pCheckContraint(traceSpeed >= 0, "{TRACE_SPEED>=0}") != 1 ? 0:res;
+	res = pCheckContraint(arrivalPeriod > 0, "{ARRIVAL_PERIOD>0}") != 1 ? 0:res;
+	res = pCheckContraint(traceIn[0] == '\0' || arrivalRates[0] == '\0', "{TRACE_IN and ARRIVAL_RATES are exclusive}") != 1 ? 0:res;
+	res = pCheckContraint(cpuDirector < AFFINITY_MAX_CPUS && cpuMarket < AFFINITY_MAX_CPUS, "{CPU_DIRECTOR,CPU_MARKET<1024}") != 1 ? 0:res;
+	res = pCheckContraint(m->userStack >= 64 && m->userStack <= 65536, "{64<=USER_STACK<=65536}") != 1 ? 0:res;
+	res = pCheckContraint(canSetTimeScale(timeScale) == 1, "{TIME_SCALE>=1, the same for all the stores}") != 1 ? 0:res;
+	res = pCheckContraint(strcmp(logTime, "us") == 0 || strcmp(logTime, "ms") == 0, "{LOG_TIME=us|ms}") != 1 ? 0:res;
+	res = pCheckContraint((strcmp(clockSource, "monotonic") == 0 && canSetClockSource(CLOCK_SRC_MONOTONIC) == 1) ||
+		(strcmp(clockSource, "tsc") == 0 && canSetClockSource(CLOCK_SRC_TSC) == 1),
+		"{CLOCK_SOURCE=monotonic|tsc, the same for all the stores, tsc only with an invariant TSC}") != 1 ? 0:res;
+	res = pCheckContraint(lagTolerance >= 0, "{LAG_TOLERANCE_MS>=0}") != 1 ? 0:res;
+	res = pCheckContraint(strcmp(lagAction, "warn") == 0 || strcmp(lagAction, "abort") == 0, "{LAG_ACTION=warn|abort}") != 1 ? 0:res;
+	res = pCheckContraint(deskWorkers >= 0 && deskWorkers <= AFFINITY_MAX_CPUS, "{0<=DESK_WORKERS<=1024}") != 1 ? 0:res;
+	m->logDigits = strcmp(logTime, "ms") == 0 ? 3:6;
+	m->lagTolerance = (int64_t) lagTolerance * 1000000;
+	m->isLagAbort = strcmp(lagAction, "abort") == 0;
+	m->lagWarned = 0;
+	m->lagChecked = 0;
 	
 	if(res != 1) {
 		printf("Some constraint are not satisfied. Edit the configuration file and try again.\n");
@@ -239,6 +789,37 @@ Market * Market_init(const char * p_conf, const char * p_log){
 	}
 	printf("All constraints are satisfied.\n");
 
+	m->userStack *= 1024;
+	if(Placement_init(&m->placement, &m->arena, cpuDirector, cpuMarket, cpuDesks, cpuUsers) != 1){
+		ERR_MSG("CPU_DESKS and CPU_USERS must be a cpu list (for example 0-3,8) or %s. Edit the configuration file and try again.\n", AFFINITY_SPREAD);
+		goto err;
+	}
+	if( (m->poolNodes = Pool_init(&m->arena, sizeof(Node), m->C * MARKET_SPARE_NODES + 4 * SQUEUE_SPARE_MAX, m->C)) == NULL ||
+		(m->poolMsgs = Pool_init(&m->arena, sizeof(CashDeskNotify), 4 * m->K, m->K)) == NULL){
+		ERR_MSG("An error occurred during pools creation. Impossible to setup the market.");
+		goto err;
+	}
+
+	//Executor (optional): it must exist before users, desks and director, which are woken up through it
+	if(p_executor != NULL) {
+		printf("Running the market on the %d workers of the chain...\n", p_executor->nWorkers);
+		m->executor = p_executor;
+		m->isExecutorShared = 1;
+	} else if(deskWorkers > 0) {
+		printf("Running the market on %ld workers...\n", deskWorkers);
+		if((m->executor = Executor_init(deskWorkers)) == NULL){
+			ERR_MSG("An error occurred during executor creation. Impossible to setup the market.");
+			goto err;
+		}
+	}
+	if(m->executor != NULL) Mailbox_initTask(&m->mailbox, pMarket_wake, m);
+	else Mailbox_init(&m->mailbox);
+
+	//Users init
+	if((m->users = UserStore_init(m, m->C)) == NULL){
+		ERR_MSG("An error occurred during users creation. Impossible to setup the market.");
+		goto err;
+	}
 
 	//Director init
 	if((m->director = Director_init(m)) == NULL){
@@ -247,13 +828,41 @@ Market * Market_init(const char * p_conf, const char * p_log){
 	}
 	
 	//Queues init
-	if(	(m->usersShopping = SQueue_init(-1)) == NULL || 
-		(m->usersExit = SQueue_init(-1)) == NULL ||
-		(m->usersAuthQueue = SQueue_init(-1)) == NULL){
+	if(	(m->usersShopping = SQueue_initPool(-1, m->poolNodes)) == NULL || 
+		(m->usersExit = SQueue_initPool(-1, m->poolNodes)) == NULL ||
+		(m->usersAuthQueue = SQueue_initPool(-1, m->poolNodes)) == NULL){
 		ERR_MSG("An error occurred during queues creation. Impossible to setup the market.");
 		goto err;
 	}
 
+	//Arrival trace (optional)
+	if(traceIn[0] != '\0') {
+		printf("Replaying customers from arrival trace %s (speed: %ld)...\n", traceIn, traceSpeed);
+		if((m->arrivals = ArrivalTrace_open(traceIn, traceSpeed)) == NULL){
+			ERR_MSG("An error occurred opening the arrival trace. Impossible to setup the market.");
+			goto err;
+		}
+	}
+
+	//Open market (optional)
+	if(arrivalRates[0] != '\0') {
+		printf("Open market: arrival rates %s per hour, period %ld ms (speed: %ld)...\n", arrivalRates, arrivalPeriod, traceSpeed);
+		if((m->process = ArrivalProcess_init(arrivalRates, arrivalPeriod, traceSpeed, m->P, m->T)) == NULL){
+			ERR_MSG("An error occurred creating the arrival process. Impossible to setup the market.");
+			goto err;
+		}
+	}
+
+	//Event recording (optional)
+	if(eventLog[0] != '\0') {
+		printf("Recording events on %s...\n", eventLog);
+		if(EventLog_open(eventLog) != 1){
+			ERR_MSG("An error occurred opening the event log. Impossible to setup the market.");
+			goto err;
+		}
+		m->isEventLogOwner = 1;
+	}
+
 	//Init payArea
 	if( (m->payArea = PayArea_init(m, m->K, m->KS)) == NULL) {
 		ERR_MSG("An error occurred during pay area creation. Impossible to setup the market. ");
@@ -262,13 +871,20 @@ Market * Market_init(const char * p_conf, const char * p_log){
 
 	//Init lock system
 	if (pthread_mutex_init(&(m->lock), NULL) != 0 ||
-		pthread_cond_init(&m->cv_MarketNews, NULL) != 0 ||
+		initCondClock(&m->cv_MarketNews) != 0 ||
 		pthread_mutex_init(&m->lock_Logfile, NULL) != 0) {
 		ERR_MSG("An error occurred during locking system initialization. Impossible to setup the market.");
 		goto err;
 	}
 	isLockInit = 1;
 
+	//The time settings belong to the whole process: they are set only by a market which is going to be returned
+	if(setClockSource(strcmp(clockSource, "tsc") == 0 ? CLOCK_SRC_TSC : CLOCK_SRC_MONOTONIC) != 1 ||
+		setTimeScale(timeScale) != 1) {
+		ERR_MSG("The clock source %s can't be set (TSC calibration failed). Impossible to setup the market.", clockSource);
+		goto err;
+	}
+
 	printf("Done!\n");
 	printf("**Welcome to Market simulator**\n");
 	return m;
@@ -277,39 +893,53 @@ err:
 	if(f_log != NULL) fclose(f_log);
 	if(m != NULL){
 		if(m->director != NULL) Director_delete(m->director);
+		if(m->users != NULL) UserStore_delete(m->users);
 		if(m->usersShopping != NULL) SQueue_deleteQueue(m->usersShopping, NULL);
 		if(m->usersExit != NULL) SQueue_deleteQueue(m->usersExit, NULL);
 		if(m->usersAuthQueue != NULL) SQueue_deleteQueue(m->usersAuthQueue, NULL);
 		if(m->payArea != NULL) PayArea_delete(m->payArea);
+		if(m->executor != NULL && !m->isExecutorShared) Executor_delete(m->executor);
+		if(m->arrivals != NULL) ArrivalTrace_close(m->arrivals);
+		ArrivalProcess_delete(m->process);
+		if(m->isEventLogOwner) EventLog_close();
 		if(isLockInit){
 			pthread_mutex_destroy(&m->lock);
 			pthread_cond_destroy(&m->cv_MarketNews);
 			pthread_mutex_destroy(&m->lock_Logfile);
 		}
+		if(isArenaInit) Arena_release(&m->arena);
 		free(m);
 	}
 	return NULL;
 }
 
 /**
- * @brief Start Market thread.
+ * @brief Start Market thread, or submit its task if the market has an executor (whose workers are started here,
+ *        if the market owns it).
  *        The behaviour is undefined if p_u has not been previously initialized with #Market_init.
  * 
  * @param p_m Requirements: p_m != NULL and must refer to a Market object created with #Market_init. Target Market.
- * @return int: result pf pthread_create call
+ * @return int: result pf pthread_create call (0 with an executor)
  */
 int Market_startThread(Market * p_m){
-	return pthread_create(&p_m->thread, NULL, Market_main, p_m);
+	int res_fun = 0;
+	if(p_m->executor == NULL) return pthread_create(&p_m->thread, NULL, Market_main, p_m);
+	if(!p_m->isExecutorShared && (res_fun = Executor_startThreads(p_m->executor)) != 0) return res_fun;
+	Executor_submit(p_m->executor, &p_m->task);
+	return 0;
 }
 
 /**
- * @brief Join the market thread
+ * @brief Join the market thread, or wait for the end of its task if the market has an executor
+ *        (users, desks and director ended before it).
  * 
  * @param p_m Requirements: p_m != NULL and must refer to a User object created with #Market_init. Target Market.
- * @return int result of pthread_join
+ * @return int result of pthread_join (0 with an executor)
  */
 int Market_joinThread(Market * p_m){
-	return pthread_join(p_m->thread, NULL);
+	if(p_m->executor == NULL) return pthread_join(p_m->thread, NULL);
+	while (atomic_load(&p_m->isDone) == 0) Mailbox_wait(&p_m->done);
+	return 0;
 }
 
 /**
@@ -325,20 +955,45 @@ int Market_joinThread(Market * p_m){
  */
 int Market_delete(Market * p_m) {
     if(p_m == NULL) return -1; 
+	//Workers are stopped first: a timer of the market still pending (next arrival) is not run anymore
+	if(p_m->executor != NULL && !p_m->isExecutorShared) Executor_delete(p_m->executor);
 	Director_delete(p_m->director);
-	SQueue_deleteQueue(p_m->usersShopping, pDeallocUser);
-	SQueue_deleteQueue(p_m->usersExit, pDeallocUser);
-	SQueue_deleteQueue(p_m->usersAuthQueue, pDeallocUser);
+	SQueue_deleteQueue(p_m->usersShopping, NULL);
+	SQueue_deleteQueue(p_m->usersExit, NULL);
+	SQueue_deleteQueue(p_m->usersAuthQueue, NULL);
 	PayArea_delete(p_m->payArea);
+	UserStore_delete(p_m->users);
+	ArrivalTrace_close(p_m->arrivals);
+	ArrivalProcess_delete(p_m->process);
+	if(p_m->isEventLogOwner) EventLog_close();
 	pthread_mutex_destroy(&p_m->lock);
 	pthread_cond_destroy(&p_m->cv_MarketNews);
 	pthread_mutex_destroy(&p_m->lock_Logfile);
+	fclose(p_m->f_log);
+	Arena_release(&p_m->arena);
     free(p_m);
     return 1;
 }
 
 void Market_Lock(Market * p_m) {Lock(&p_m->lock);}
 void Market_Unlock(Market * p_m) {Unlock(&p_m->lock);}
+/**
+ * @brief Wake up the market thread. The market lock is held, so the wakeup can't be lost.
+ *        A market run by an executor is woken up through its mailbox.
+ */
+void Market_Signal(Market * p_m) {
+	if(p_m->executor != NULL) Mailbox_post(&p_m->mailbox, MAILBOX_WAKE);
+	else {Market_Lock(p_m); Signal(&p_m->cv_MarketNews); Market_Unlock(p_m);}
+}
+
+/**
+ * @brief Check if a gracefull closure of p_m has been requested: SIGHUP for the whole process, or the end of the
+ *        arrival trace of p_m only.
+ *
+ * @param p_m Requirements: p_m != NULL and must refer to a Market object created with #Market_init. Target Market.
+ * @return int: 1 if p_m is closing, 0 otherwise
+ */
+int Market_isClosing(Market * p_m) {return sig_hup == 1 || atomic_load(&p_m->isClosing) == 1;}
 
 /**
  * @brief Check if the market is currently empty
@@ -373,43 +1028,36 @@ int Market_isEmpty(Market * p_m){
  */
 void * Market_main(void * p_arg){
 	Market * m = (Market *) p_arg;
-	User * u_aux = NULL;
-	int numExit = 0; //count users exit until E is reached
-	void * data;
-	SQueue * newGroup = NULL;
-	int removedUsers = 0;
-
-	if((newGroup = SQueue_init(-1)) == NULL)
-		ERR_QUIT("[Market]: An error occurred during market startup. (newGroup init failed)");
-	
-	//Start CashDesks Threads
-	PayArea_startDeskThreads(m->payArea);
-
-	//Create and add C users in shopping area
-	//Lock(&m->lock);
-	for(int i = 0; i < m->C; i++){
-		if((u_aux = User_init(getRandom(0, m->P), getRandom(10, m->T), m)) == NULL)
-			ERR_QUIT("[Market]: An error occurred during market startup. (User init failed)");
-		SQueue_push(m->usersShopping, u_aux);
-		if(User_startThread(u_aux) != 0)
-			ERR_QUIT("[Market]: An error occurred during market startup. (User startThread failed)");		
-	}
-	//Unlock(&m->lock);
-
-	//Start Director thread
-	if(Director_startThread(m->director) != 0)
-		ERR_QUIT("[Market]: An error occurred during desk thread start. (CashDesk startThread failed)");
+	UserStore * us = m->users;
+	int u_aux = 0;
+	struct timespec deadline; //next arrival of the open market
 
+	TRACE_THREAD_NAME(TH_MARKET, -1);
+	Placement_pinMarket(&m->placement);
+	TRACE_BEGIN(PH_STARTUP);
+	pStartMarket(m);
+	//Trace replay: each user is created at its arrival time
+	pCreateTraceUsers(m);
+	TRACE_END(PH_STARTUP);
+	pEndStartup(m);
 
 	//Wait E users exits
 	while (1) {
 		//Wait a signal or new user in exit queue to proceed
+		TRACE_BEGIN(PH_IDLE);
+		if(m->process != NULL) deadline = clockDeadline(ArrivalProcess_deadline(m->process, ArrivalProcess_peek(m->process)));
 		Lock(&m->lock);
-		while (sig_hup != 1 && sig_quit != 1 && SQueue_isEmpty(m->usersExit)==1) 
-			pthread_cond_wait(&m->cv_MarketNews, &m->lock);
+		while (!Market_isClosing(m) && sig_quit != 1 && SQueue_isEmpty(m->usersExit)==1) {
+			//Open market: the next arrival is waited only if there is room for it
+			if(m->process == NULL || m->nParked == 0) pthread_cond_wait(&m->cv_MarketNews, &m->lock);
+			else if(pthread_cond_timedwait(&m->cv_MarketNews, &m->lock, &deadline) == ETIMEDOUT) break;
+		}
 		Unlock(&m->lock);
+		TRACE_END(PH_IDLE);
+		pCheckTimers(m);
 
-		if(sig_hup == 1 || sig_quit == 1) {
+		if(Market_isClosing(m) || sig_quit == 1) {
+			TRACE_BEGIN(PH_SHUTDOWN);
 			printf("Market is closing...\n");
 			//When SIGHUP or SIQQUIT occurs no new users are allowed inside the market and
 			//all the users inside are waited.
@@ -418,60 +1066,23 @@ void * Market_main(void * p_arg){
 			printf("Cashdesks termination...\n");
 			PayArea_joinDeskThreads(m->payArea);
 			printf("Wait director termination...\n");
-			Signal(&m->director->cv_Director_AuthNews);
-			Signal(&m->director->cv_Director_DesksNews);			
+			Director_SignalAuth(m->director);
+			Director_SignalDesks(m->director);			
 			if(Director_joinThread(m->director)!=0) ERR_QUIT("An error occurred during director thread join.");			
-			//Remove all users from exit queue
-			printf("Removing users from exit queue..\n");
-			//Move all users in newGroup into exit 
-			while(SQueue_pop(newGroup, &data) != -2) {
-				u_aux = (User *) data;
-				SQueue_push(m->usersExit, u_aux);
+			pStopUsers(m);
+			for(long i = m->nFresh; i < m->nParked; i++) {
+				u_aux = USER_FROM_PTR(m->parked[i]);
+				if(User_joinThread(us, u_aux) != 0)
+					ERR_QUIT("An error occurred joining User %d thread.", us->id[u_aux]);
 			}
-			//Delete all users
-			while(SQueue_pop(m->usersExit, &data) == 1) {		
-				u_aux = (User *) data;
-				User_log(u_aux);
-				u_aux->state = USR_QUIT;
-				Signal(&u_aux->cv_UserNews);
-				if(User_joinThread(u_aux) != 0)
-					ERR_QUIT("An error occurred joining User %d thread.", u_aux->id);
-				User_delete(u_aux);
-				removedUsers++;
-				printf("[Market]: Users removed: %d\n", removedUsers);
-			}	
-			//Log all cashdesks data
-			DEBUG_PRINT("Market_isEmpty: %d\n", Market_isEmpty(m));
-			printf("Log all cash desks statistics..\n");
-			for(int i = 0; i < m->K; i++) 
-				CashDesk_log(m->payArea->desks[i]);
-			
+			pLogClosing(m);
+			TRACE_END(PH_SHUTDOWN);
 			break;					
 		}
-		//Market is not closing
-		if(SQueue_pop(m->usersExit, &data) == 1) {
-			u_aux = (User *) data;		
-			numExit++;
-			//Log user info.
-			User_log(u_aux);	
-			//Reset user structure for next reuse
-			User_reset(u_aux, getRandom(0, m->P), getRandom(10, m->T), m);
-			SQueue_push(newGroup, u_aux);
-			if(numExit == m->E) {//E numExits
-				//Move all users in newGroup into shopping area
-				while(SQueue_pop(newGroup, &data) != -2) {
-					u_aux = (User *) data;
-					SQueue_push(m->usersShopping, u_aux);
-					u_aux->state = USR_READY;
-					Signal(&u_aux->cv_UserNews);
-				}
-				numExit = 0;
-			}
-		}
+		//Market is not closing: drain the exit queue in bulk and log the whole batch at once
+		pDrainExits(m);
+		if(m->process != NULL) pAdmitArrivals(m);
 	}
-
-	SQueue_deleteQueue(newGroup, pDeallocUser);
 		
     return (void *)NULL;
 }
-
@@ -2,22 +2,38 @@
  * @file TUser.c
  * @brief  Implementation of User.
  */
+#define _DEFAULT_SOURCE /* _SC_NPROCESSORS_ONLN */
 
 #include <TUser.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <utilities.h>
 #include <pthread.h>
+#include <stddef.h>
+#include <EventLog.h>
 
 #define MAX_USR_STR 2048
+#define USER_INIT_CHUNK 1024 /**< Minimum number of users handled by each worker of #User_initAll and #User_startAll */
+#define USER_INIT_WORKERS 64 /**< Maximum number of workers of #User_initAll and #User_startAll */
+
+/**
+ * @brief Range of users handled by a worker during bulk creation.
+ */
+typedef struct UserInitWork {
+    UserStore * store; /**< target store */
+    int from; /**< first user */
+    int to; /**< last user + 1 */
+    int firstId; /**< id of user from */
+    unsigned int seed; /**< seed used to generate customers */
+    int res; /**< 1: good, 0: an error occurred */
+} UserInitWork;
 
 static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
 static int g_UserCounter = 1; /**<  Used to track the number of users created by the application. 
                                     This is used to always generate unique ids for users.*/
 
 //Private functions
-static void pUser_Lock(User * p_u) {Lock(&p_u->lock);}
-static void pUser_Unlock(User * p_u) {Unlock(&p_u->lock);}
 static int pUser_getNextId() {
     int next = 0;
     if(pthread_mutex_lock(&g_lock) != 0) ERR_QUIT("An error occurred during locking.");
@@ -26,129 +42,401 @@ static int pUser_getNextId() {
     if(pthread_mutex_unlock(&g_lock) != 0) ERR_QUIT("An error occurred during unlocking.");
     return next;
 }
-static void pUser_toString(User * p_u, char * p_buff){
-    double marketTime = (double)elapsedTime(p_u->tMarketEntry, p_u->tMarketExit);
-    double queueTime = (double)elapsedTime(p_u->tQueueStart, p_u->tMarketExit);
-    sprintf(p_buff, "[User %d]: products=%d tot_time_market=%.3f tot_time_queue=%.3f queue_visited=%d\n", 
-            p_u->id,
-            p_u->products, 
-            (double)(marketTime > 0 ? marketTime/1000:0),
-            (double)(queueTime > 0 ? queueTime/1000:0),
-            p_u->queueChanges);
+static int pUser_getIds(int p_n) {
+    int first = 0;
+    if(pthread_mutex_lock(&g_lock) != 0) ERR_QUIT("An error occurred during locking.");
+    first = g_UserCounter;
+    g_UserCounter += p_n;
+    if(pthread_mutex_unlock(&g_lock) != 0) ERR_QUIT("An error occurred during unlocking.");
+    return first;
+}
+//Executor: a user wakes up submitting its task (see #Mailbox_initTask)
+static void pUser_wake(void * p_arg) {
+    UserThread * t = (UserThread *) p_arg;
+    Executor_submit(t->store->market->executor, &t->task);
+}
+static void pUser_step(ExecTask * p_t);
+//A user run by an executor is woken up submitting its task, otherwise through a futex
+static void pUser_initWake(UserStore * p_s, int p_u) {
+    UserThread * t = &p_s->threads[p_u];
+    t->store = p_s;
+    t->task.fun = pUser_step;
+    t->isShopping = 0;
+    if(p_s->market->executor != NULL) Mailbox_initTask(&p_s->wake[p_u], pUser_wake, t);
+    else Mailbox_init(&p_s->wake[p_u]);
+}
+static void * pUser_initRange(void * p_arg) {
+    UserInitWork * w = (UserInitWork *) p_arg;
+    UserStore * s = w->store;
+    g_seed = w->seed;
+    for(int u = w->from; u < w->to; u++) {
+        s->id[u] = w->firstId + (u - w->from);
+        atomic_init(&s->state[u], USR_READY);
+        s->products[u] = getRandom(0, s->market->P);
+        s->queueChanges[u] = 0;
+        s->shoppingTime[u] = getRandom(10, s->market->T);
+        s->tMarketEntry[u] = 0;
+        s->tMarketExit[u] = 0;
+        s->tQueueStart[u] = 0;
+        pUser_initWake(s, u);
+    }
+    w->res = 1;
+    return NULL;
+}
+static void * pUser_startRange(void * p_arg) {
+    UserInitWork * w = (UserInitWork *) p_arg;
+    w->res = 1;
+    for(int u = w->from; u < w->to && w->res == 1; u++)
+        if(User_startThread(w->store, u) != 0) w->res = 0;
+    return NULL;
+}
+/**
+ * @brief Split users [p_from; p_from+p_n) in ranges and run p_fun on each of them, in parallel on the available cores.
+ * @return int: 1 if all ranges have been handled, 0 otherwise
+ */
+static int pUser_forRanges(UserStore * p_s, int p_from, int p_n, void * (*p_fun)(void *)) {
+    UserInitWork w[USER_INIT_WORKERS];
+    pthread_t th[USER_INIT_WORKERS];
+    int isCreated[USER_INIT_WORKERS] = {0};
+    long nCpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nWork = (p_n + USER_INIT_CHUNK - 1) / USER_INIT_CHUNK;
+    int res = 1;
+    int firstId = 0;
+
+    if(p_n <= 0) return 1;
+    if(nCpu < 1) nCpu = 1;
+    if(nWork > nCpu) nWork = nCpu;
+    if(nWork > USER_INIT_WORKERS) nWork = USER_INIT_WORKERS;
+    firstId = p_fun == pUser_initRange ? pUser_getIds(p_n) : 0;
+    for(int i = 0; i < nWork; i++) {
+        w[i].store = p_s;
+        w[i].from = p_from + (int)((long)p_n * i / nWork);
+        w[i].to = p_from + (int)((long)p_n * (i + 1) / nWork);
+        w[i].firstId = firstId + (w[i].from - p_from);
+        w[i].seed = g_seed + (unsigned int) time(NULL) + i;
+        w[i].res = 0;
+    }
+    //The calling thread handles the first range, and the ones whose thread can't be created
+    for(int i = 1; i < nWork; i++)
+        if((isCreated[i] = pthread_create(&th[i], NULL, p_fun, &w[i]) == 0) == 0) p_fun(&w[i]);
+    p_fun(&w[0]);
+    for(int i = 1; i < nWork; i++)
+        if(isCreated[i]) pthread_join(th[i], NULL);
+    for(int i = 0; i < nWork; i++) res = w[i].res != 1 ? 0:res;
+    return res;
+}
+
+/**
+ * @brief User p_u enters the shopping area. On a fast closing it is moved directly to the exit queue.
+ * @return int: 1 if the user must spend its shopping time, 0 if it left the market
+ */
+static int pUser_startShopping(UserStore * p_s, int p_u) {
+    p_s->tMarketEntry[p_u] = getCurrentTimeNs();
+    EVENT_RECORD(EV_USER_SHOPPING, p_s->id[p_u], p_s->products[p_u], p_s->shoppingTime[p_u]);
+    if(sig_quit) {
+        Market_FromShoppingToExit(p_s->market, p_u);
+        return 0;
+    }
+    printf("[User %d]: start shopping!\n", p_s->id[p_u]);
+    return 1;
+}
+
+/**
+ * @brief End of the shopping time of user p_u: move it to one cashdesk or to the authorization queue,
+ *        or directly to the exit queue on a fast closing.
+ * @return int: 1 if the user joined a queue, 0 if it left the market
+ */
+static int pUser_endShopping(UserStore * p_s, int p_u) {
+    Market * m = p_s->market;
+    if(sig_quit == 1) {
+        Market_FromShoppingToExit(m, p_u);
+        return 0;
+    }
+    printf("[User %d]: end shopping!\n", p_s->id[p_u]);
+    //End of shopping, move to one cashdesk or to authorization queue
+    TRACE_BEGIN(PH_MOVE);
+    if(p_s->products[p_u] > 0){//Has something in the cart
+        printf("[User %d]: move to a open cash desk for payment.\n", p_s->id[p_u]);
+        Market_FromShoppingToPay(m, p_u);
+    }else{//Nothing in the cart
+        printf("[User %d]: move to the authorization queue.\n", p_s->id[p_u]);
+        //Move user to queue of users waiting director authorization before exit.
+        Market_FromShoppingToAuth(m, p_u);
+    }
+    TRACE_END(PH_MOVE);
+    return 1;
+}
+
+/**
+ * @brief Executor: task of a user, the same loop of #User_main without blocking.
+ *        Instead of sleeping in the shopping area the task is submitted again at the end of the shopping time,
+ *        instead of waiting for its next admission it parks on its mailbox. The task ends only when the user
+ *        is stopped (USR_QUIT), also after leaving the market on a fast closing.
+ */
+static void pUser_step(ExecTask * p_t) {
+    UserThread * t = (UserThread *) ((char *) p_t - offsetof(UserThread, task));
+    UserStore * s = t->store;
+    Market * m = s->market;
+    int u = (int)(t - s->threads);
+    int state = USR_NOT_READY;
+    int64_t now = 0;
+
+    if(t->isShopping) {
+        t->isShopping = 0;
+        now = getCurrentTimeNs();
+        timerFired(TIMER_SHOPPING, toRealNs((int64_t) s->shoppingTime[u] * 1000000), now - p_t->due);
+        pUser_endShopping(s, u);
+    }
+    while (1) {
+        //The state is set before the mailbox is posted
+        Mailbox_take(&s->wake[u]);
+        if((state = atomic_load(&s->state[u])) == USR_QUIT) {
+            printf("[User %d]: end of thread.\n", s->id[u]);
+            if(atomic_fetch_sub(&s->nTasks, 1) == 1) Market_Signal(m);
+            return;
+        }
+        if(state == USR_READY) {
+            atomic_store(&s->state[u], USR_NOT_READY);
+            if(pUser_startShopping(s, u) == 1) {
+                t->isShopping = 1;
+                now = getCurrentTimeNs();
+                Executor_submitAt(m->executor, p_t, now + toRealNs((int64_t) s->shoppingTime[u] * 1000000));
+                return;
+            }
+            continue;
+        }
+        //Nothing to do: the next admission or the market closure will run the task again
+        if(Mailbox_park(&s->wake[u])) return;
+    }
+}
+
+static void pUser_toString(UserStore * p_s, int p_u, char * p_buff){
+    //Simulated seconds, with the resolution chosen by LOG_TIME
+    double marketTime = toSimSeconds(p_s->tMarketExit[p_u] - p_s->tMarketEntry[p_u]);
+    double queueTime = toSimSeconds(p_s->tMarketExit[p_u] - p_s->tQueueStart[p_u]);
+    int digits = p_s->market->logDigits;
+    sprintf(p_buff, "[User %d]: products=%d tot_time_market=%.*f tot_time_queue=%.*f queue_visited=%d\n", 
+            p_s->id[p_u],
+            p_s->products[p_u], 
+            digits, marketTime > 0 ? marketTime:0,
+            digits, queueTime > 0 ? queueTime:0,
+            p_s->queueChanges[p_u]);
+}
+
+/**
+ * @brief Create a new UserStore object, allocated in the arena of the market.
+ * 
+ * @param p_m Reference to Market where users are.
+ * @param p_cap Requirements: p_cap > 0. Maximum number of users.
+ * @return UserStore* pointer to new store allocated, NULL if a probelm occurred during allocation. 
+ */
+UserStore * UserStore_init(Market * p_m, int p_cap){
+    UserStore * aux = NULL;
+    Arena * a = &p_m->arena;
+    
+    if( (aux = Arena_alloc(a, sizeof(UserStore))) == NULL ) return NULL;
+    aux->cap = p_cap;
+    aux->n = 0;
+    aux->market = p_m;
+    atomic_init(&aux->nTasks, 0);
+    //Each array is contiguous: a scan over a field touches only cache lines of that field
+    if( (aux->id = Arena_alloc(a, p_cap * sizeof(int32_t))) == NULL ||
+        (aux->state = Arena_alloc(a, p_cap * sizeof(atomic_uchar))) == NULL ||
+        (aux->products = Arena_alloc(a, p_cap * sizeof(int32_t))) == NULL ||
+        (aux->queueChanges = Arena_alloc(a, p_cap * sizeof(int32_t))) == NULL ||
+        (aux->shoppingTime = Arena_alloc(a, p_cap * sizeof(int32_t))) == NULL ||
+        (aux->tMarketEntry = Arena_alloc(a, p_cap * sizeof(int64_t))) == NULL ||
+        (aux->tMarketExit = Arena_alloc(a, p_cap * sizeof(int64_t))) == NULL ||
+        (aux->tQueueStart = Arena_alloc(a, p_cap * sizeof(int64_t))) == NULL ||
+        (aux->threads = Arena_alloc(a, p_cap * sizeof(UserThread))) == NULL ||
+        (aux->wake = Arena_alloc(a, p_cap * sizeof(Mailbox))) == NULL )
+        return NULL;
+    return aux;
 }
 
 /**
- * @brief Create a new User object.
+ * @brief Dealloc a UserStore object. Its memory belongs to the arena of the market and it is released with it.
+ * 
+ * @warning This function should be called by only one thread when no user thread is running.
  * 
+ * @param p_s Requirements: p_s != NULL and must refer to a UserStore object created with #UserStore_init.
+ */
+void UserStore_delete(UserStore * p_s){
+    //Mailboxes hold no resources: nothing to release besides the arena
+    (void) p_s;
+}
+
+/**
+ * @brief Check if the tasks of all the users started with #User_startThread ended (market with an executor).
+ * 
+ * @param p_s Requirements: p_s != NULL and must refer to a UserStore object created with #UserStore_init.
+ * @return int: 1 if no user task is running or waiting, 0 otherwise
+ */
+int UserStore_isEnded(UserStore * p_s){
+    return atomic_load(&p_s->nTasks) == 0;
+}
+
+/**
+ * @brief Create a new user in the store p_s.
+ * 
+ * @param p_s Requirements: p_s != NULL and must refer to a UserStore object created with #UserStore_init.
  * @param p_products Number of products in the cart.
  * @param p_shoppingTime Time to spend in shopping area.
- * @param p_m Reference to Market where the user is.
- * @return User* pointer to new user allocated, NULL if a probelm occurred during allocation. 
+ * @return int: index of the new user in p_s, -1 if the store is full.
  */
-User * User_init(int p_products, int p_shoppingTime, Market * p_m){
-    User * aux = NULL;
-    
-    if( (aux = malloc(sizeof(User))) != NULL ){
-        aux->id = pUser_getNextId();
-        aux->state = USR_READY;
-        aux->products = p_products;
-        aux->queueChanges = 0;
-        aux->shoppingTime = p_shoppingTime;
-        aux->market = p_m;
-        //Locking system setup
-        if (pthread_mutex_init(&(aux->lock), NULL) != 0 ||
-            pthread_cond_init(&aux->cv_UserNews, NULL) != 0)  goto err;
-    }
-    return aux;
-err:
-    if(aux != NULL) free(aux);
-    return NULL;
+int User_init(UserStore * p_s, int p_products, int p_shoppingTime){
+    int u = 0;
+    if(p_s->n == p_s->cap) return -1;
+    u = p_s->n++;
+    p_s->id[u] = pUser_getNextId();
+    atomic_init(&p_s->state[u], USR_READY);
+    p_s->products[u] = p_products;
+    p_s->queueChanges[u] = 0;
+    p_s->shoppingTime[u] = p_shoppingTime;
+    p_s->tMarketEntry[u] = 0;
+    p_s->tMarketExit[u] = 0;
+    p_s->tQueueStart[u] = 0;
+    pUser_initWake(p_s, u);
+    return u;
 }
 
 /**
- * @brief Dealloc a User object.
+ * @brief Create p_n new users with random customers (see #Market) in the store p_s.
+ *        Users are initialized in parallel on the available cores. They are ready but their threads are not started.
  * 
- * @warning This function should be called by only one thread when no other thread is working on p_u object.
- *          Typically the main thread call this function after all slave threads have terminated.
+ * @param p_s Requirements: p_s != NULL and must refer to a UserStore object created with #UserStore_init.
+ * @param p_n number of users to create.
+ * @return int: index of the first new user in p_s (the others follow), -1 if the store has not room for p_n users
+ *         or a user can't be created.
+ */
+int User_initAll(UserStore * p_s, int p_n){
+    int first = p_s->n;
+    if(p_n < 0 || p_s->cap - p_s->n < p_n) return -1;
+    if(pUser_forRanges(p_s, first, p_n, pUser_initRange) != 1) return -1;
+    p_s->n += p_n;
+    return first;
+}
+
+/**
+ * @brief Start the threads of users [p_from; p_from+p_n), in parallel on the available cores.
+ *        With an executor their tasks are submitted by the calling thread.
  * 
- * @param p_u Requirements: p_u != NULL and must refer to a User object created with #SQueue_init. Target User.
+ * @param p_s Requirements: p_s != NULL and must refer to a UserStore object created with #UserStore_init.
+ * @param p_from first user
+ * @param p_n number of users
  * @return int: result code:
- *  1: p_u != NULL and the deallocation proceed witout errors. 
- *  -1: p_u == NULL
- */
-int User_delete(User * p_u) {
-    if(p_u == NULL) return -1; 
-    pthread_mutex_destroy(&p_u->lock);
-    pthread_cond_destroy(&p_u->cv_UserNews);
-    free(p_u);
-    return 1;
+ * 1: all threads started
+ * 0: an error occurred
+ */
+int User_startAll(UserStore * p_s, int p_from, int p_n){
+    if(p_s->market->executor != NULL) {
+        for(int u = p_from; u < p_from + p_n; u++) User_startThread(p_s, u);
+        return 1;
+    }
+    return pUser_forRanges(p_s, p_from, p_n, pUser_startRange);
 }
 
 /**
- * @brief   Reset the p_u structure for a next reuse.
+ * @brief   Reset user p_u for a next reuse.
  * 
- * @warning No other thread should be using p_u when thi function is called and the p_u should not be running.        
+ * @warning The user thread should not be running (state USR_NOT_READY) when this function is called.        
  * 
- * @param p_u Requirements: p_u != NULL and must refer to a User object created with #User_init. Target User.
+ * @param p_s Requirements: p_s != NULL and must refer to a UserStore object created with #UserStore_init.
+ * @param p_u Requirements: index of a user created with #User_init.
  * @param p_products Number of products in the cart.
  * @param p_shoppingTime Time to spend in shopping area.
- * @param p_m Reference to Market where the user is.
  */
-void User_reset(User * p_u, int p_products, int p_shoppingTime, Market * p_m){
-    pUser_Lock(p_u);
-    p_u->id = pUser_getNextId();
-    p_u->products = p_products;
-    p_u->queueChanges = 0;
-    p_u->shoppingTime = p_shoppingTime;
-    p_u->market = p_m;
-    pUser_Unlock(p_u);
+void User_reset(UserStore * p_s, int p_u, int p_products, int p_shoppingTime){
+    p_s->id[p_u] = pUser_getNextId();
+    p_s->products[p_u] = p_products;
+    p_s->queueChanges[p_u] = 0;
+    p_s->shoppingTime[p_u] = p_shoppingTime;
 }
 
 /**
- * @brief Log user info.
+ * @brief Set the state of a group of users and wake up their threads, and only them.
  * 
- * @param p_u Requirements: p_u != NULL and must refer to a User object created with #User_init. Target User.
+ * @param p_s Requirements: p_s != NULL and must refer to a UserStore object created with #UserStore_init.
+ * @param p_users Requirements: array of p_n users stored with #USER_TO_PTR.
+ * @param p_n number of users in p_users
+ * @param p_state new state
  */
-void User_log(User * p_u){
-    pUser_Lock(p_u);
+void User_setStateAll(UserStore * p_s, void ** p_users, long p_n, UserState p_state){
+    int u = 0;
+    for(long i = 0; i < p_n; i++) {
+        u = USER_FROM_PTR(p_users[i]);
+        //Release: a user seeing the new state sees its data too (see #User_reset), even before taking the post
+        atomic_store_explicit(&p_s->state[u], p_state, memory_order_release);
+        Mailbox_post(&p_s->wake[u], MAILBOX_STATE);
+    }
+}
+
+/**
+ * @brief Log info of a group of users, holding the log file lock only once.
+ * 
+ * @param p_s Requirements: p_s != NULL and must refer to a UserStore object created with #UserStore_init.
+ * @param p_users Requirements: array of p_n users stored with #USER_TO_PTR, which are out of the market.
+ * @param p_n number of users in p_users
+ */
+void User_logAll(UserStore * p_s, void ** p_users, long p_n){
     char aux[MAX_USR_STR];
-    pUser_toString(p_u, aux);
-    pUser_Unlock(p_u);
-    Market_log(p_u->market, aux);
+    Market * m = p_s->market;
+    if(p_n <= 0) return;
+    Lock(&m->lock_Logfile);
+    for(long i = 0; i < p_n; i++) {
+        pUser_toString(p_s, USER_FROM_PTR(p_users[i]), aux);
+        fprintf(m->f_log, "%s\n", aux);
+    }
+    m->usersOut += p_n;
+    Unlock(&m->lock_Logfile);
 }
 
 /**
- * @brief Comapre two user object by subtracting their ids.
- * @param p_1 Requirements: p_u != NULL and must refer to a User object created with #User_init.
- * @param p_2 Requirements: p_u != NULL and must refer to a User object created with #User_init.
+ * @brief Comapre two users (stored with #USER_TO_PTR) by subtracting their indexes. No user data is accessed.
+ * @param p_1 Requirements: user stored with #USER_TO_PTR.
+ * @param p_2 Requirements: user stored with #USER_TO_PTR.
  * @return int: result code
- * <0: p_u1 has a littler id then p_u2
- * >0: p_u1 has a greater id then p_u2
- * =0: p_u1 and p_u2 have the same id
+ * <0: p_u1 has a littler index then p_u2
+ * >0: p_u1 has a greater index then p_u2
+ * =0: p_u1 and p_u2 are the same user
  */
 int User_compare(void * p_1, void * p_2){
-    return ((User *) p_1)->id - ((User *) p_2)->id;
+    return USER_FROM_PTR(p_1) - USER_FROM_PTR(p_2);
 }
 
 /**
- * @brief Start User thread.
+ * @brief Start User thread, or submit its task if the market has an executor.
  *        The behaviour is undefined if p_u has not been previously initialized with #User_init.
  * 
- * @param p_u Requirements: p_u != NULL and must refer to a User object created with #User_init. Target User.
- * @return int: result pf pthread_create call
+ * @param p_s Requirements: p_s != NULL and must refer to a UserStore object created with #UserStore_init.
+ * @param p_u Requirements: index of a user created with #User_init.
+ * @return int: result pf pthread_create call (0 with an executor)
  */
-int User_startThread(User * p_u) {
-    return pthread_create(&p_u->thread, NULL, User_main, p_u);
+int User_startThread(UserStore * p_s, int p_u) {
+    pthread_attr_t attr;
+    int res_fun = 0;
+    if(p_s->market->executor != NULL) {
+        atomic_fetch_add(&p_s->nTasks, 1);
+        Executor_submit(p_s->market->executor, &p_s->threads[p_u].task);
+        return 0;
+    }
+    //Users need little stack: a smaller one keeps many markets (and many users) in one process
+    if((res_fun = pthread_attr_init(&attr)) != 0) return res_fun;
+    if((res_fun = pthread_attr_setstacksize(&attr, p_s->market->userStack)) == 0)
+        res_fun = pthread_create(&p_s->threads[p_u].thread, &attr, User_main, &p_s->threads[p_u]);
+    pthread_attr_destroy(&attr);
+    return res_fun;
 }
 
 /**
- * @brief Join the user thread
+ * @brief Join the user thread (market without an executor, see #UserStore_isEnded otherwise)
  * 
- * @param p_u Requirements: p_u != NULL and must refer to a User object created with #User_init. Target User.
+ * @param p_s Requirements: p_s != NULL and must refer to a UserStore object created with #UserStore_init.
+ * @param p_u Requirements: index of a user created with #User_init.
  * @return int result of pthread_join
  */
-int User_joinThread(User * p_u){
-    return pthread_join(p_u->thread, NULL);
+int User_joinThread(UserStore * p_s, int p_u){
+    return pthread_join(p_s->threads[p_u].thread, NULL);
 }
 
 /**
@@ -166,46 +454,34 @@ int User_joinThread(User * p_u){
  * @return void* 
  */
 void * User_main(void * p_arg) {
-    User * u = (User *)p_arg;
-    Market * m = u->market;
+    UserThread * t = (UserThread *)p_arg;
+    UserStore * s = t->store;
+    Market * m = s->market;
+    int u = (int)(t - s->threads);
+    int state = USR_NOT_READY;
+    g_seed = (unsigned int) time(NULL) + u; //Otherwise all the users would choose the same desks
+    TRACE_THREAD_NAME(TH_USER, s->id[u]);
+    Placement_pinUser(&m->placement);
     while (1) {
-        Lock(&u->lock);
-        //Wait to being ready to start next simulation
-        while (u->state == USR_NOT_READY)
-            pthread_cond_wait(&u->cv_UserNews, &u->lock);
-        Unlock(&u->lock);
+        TRACE_BEGIN(PH_IDLE);
+        //Wait to being ready to start next simulation: the state is set before the mailbox is posted
+        while ((state = atomic_load(&s->state[u])) == USR_NOT_READY)
+            Mailbox_wait(&s->wake[u]);
+        TRACE_END(PH_IDLE);
+        if(state == USR_QUIT) break;
+        atomic_store(&s->state[u], USR_NOT_READY);
 
-        if(u->state == USR_QUIT) break;
-
-        u->state = USR_NOT_READY;
         //USR_READY => Is in shopping area ready to start simulation
-        u->tMarketEntry = getCurrentTime();
-        if(sig_quit) {
-            Market_FromShoppingToExit(m, u);
-            break;
-        }
+        if(pUser_startShopping(s, u) == 0) break;
 
         //Shopping time
-        printf("[User %d]: start shopping!\n", u->id);
-        
-        if(waitMs(u->shoppingTime) == -1)
-            ERR_SYS_QUIT("[User %d]: an error occurred during waiting for shopping time.\n", u->id);
-
-        if(sig_quit == 1) {
-            Market_FromShoppingToExit(u->market, u);
-            break;
-        }
-        printf("[User %d]: end shopping!\n", u->id);
-        //End of shopping, move to one cashdesk or to authorization queue
-        if(u->products > 0){//Has something in the cart
-            printf("[User %d]: move to a open cash desk for payment.\n", u->id);
-            Market_FromShoppingToPay(u->market, u);
-        }else{//Nothing in the cart
-            printf("[User %d]: move to the authorization queue.\n", u->id);
-            //Move User struct to queue of users waiting director authorization before exit.
-            Market_FromShoppingToAuth(u->market, u);
-        }
+        TRACE_BEGIN(PH_SHOPPING);
+        if(waitTimer(s->shoppingTime[u], TIMER_SHOPPING) == -1)
+            ERR_SYS_QUIT("[User %d]: an error occurred during waiting for shopping time.\n", s->id[u]);
+        TRACE_END(PH_SHOPPING);
+
+        if(pUser_endShopping(s, u) == 0) break;
     }
-    printf("[User %d]: end of thread.\n", u->id);
+    printf("[User %d]: end of thread.\n", s->id[u]);
     return (void *)NULL;
 }
@@ -0,0 +1,281 @@
+/**
+ * @file BenchFalseShare.c
+ * @brief   Microbenchmark of the cache-line layout of the shared structures (see #CACHE_LINE).
+ *
+ *          Each scenario reproduces the accesses of the market to a structure with its current layout and with a
+ *          packed copy of the previous one, where fields written by different threads share cache lines:
+ *           - desk: the desk thread updates its counters and takes its mailbox, users read the desk state and post
+ *             to the mailbox (#CashDesk);
+ *           - market: users enter and leave the shopping area (inShopping), while the other threads keep reading
+ *             the parameters and references of the market (#Market).
+ *          Threads are pinned on different cpus (#Affinity_spread). For each run the wall time of the owner thread
+ *          is printed, with the cache misses of all the threads read from the perf counters (n/a when the kernel
+ *          or the machine does not expose them).
+ */
+#define _GNU_SOURCE /* cpu_set_t, pthread_setaffinity_np */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <TCashDesk.h>
+#include <TMarket.h>
+#include <Affinity.h>
+#include <utilities.h>
+
+#define BENCH_OPS 20000000L /**< Operations of the owner thread of each run */
+#define BENCH_THREADS 4 /**< Threads of each run (one owner and the others) */
+#define BENCH_MAX_THREADS 64 /**< Highest number of threads of a run */
+#define BENCH_POST_EVERY 16 /**< Desk scenario: a user posts to the mailbox once every this many reads */
+
+/**
+ * @brief Previous layout of #CashDesk: counters of the desk thread, state and mailbox on the same lines.
+ */
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    Mailbox mailbox;
+    int id;
+    int serviceConst;
+    int productsProcessed;
+    int usersProcessed;
+    int numClosure;
+    int64_t totOpenTime;
+    int64_t totServiceTime;
+    int notifyInterval;
+    atomic_int state;
+    UQueue usersPay;
+    Market * market;
+} PackedDesk;
+
+/**
+ * @brief Previous layout of the #Market fields around inShopping.
+ */
+typedef struct {
+    long NP;
+    long TD;
+    FILE * f_log;
+    Director * director;
+    SQueue * usersShopping;
+    SQueue * usersExit;
+    SQueue * usersAuthQueue;
+    PayArea * payArea;
+    UserStore * users;
+    atomic_long inShopping;
+    ArrivalTrace * arrivals;
+    ArrivalProcess * process;
+} PackedMarket;
+
+/**
+ * @brief Fields used by a run, taken from one of the two layouts.
+ */
+typedef struct {
+    atomic_int * state;
+    Mailbox * mailbox;
+    int * products;
+    int * users;
+    int64_t * service;
+    long * np;
+    UserStore ** store;
+    atomic_long * inShopping;
+} Fields;
+
+typedef struct {
+    Fields * f;
+    int cpu;
+    int isOwner;
+    long ops;
+    atomic_int * isDone;
+    void (*fun)(void *);
+    long long misses; /**< cache misses of the thread, -1: not available */
+    long long l1Misses; /**< L1 data load misses of the thread, -1: not available */
+    int64_t ns; /**< wall time of the thread */
+} Worker;
+
+static atomic_long g_sink;
+
+//Open a counter of the calling thread, -1 if not available
+static int pOpenCounter(uint32_t p_type, uint64_t p_config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = p_type;
+    attr.config = p_config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long pReadCounter(int p_fd) {
+    long long v = 0;
+    if(p_fd < 0 || read(p_fd, &v, sizeof(v)) != sizeof(v)) return -1;
+    close(p_fd);
+    return v;
+}
+
+static void pDeskOwner(void * p_arg) {
+    Worker * w = (Worker *) p_arg;
+    Fields * f = w->f;
+    for(long i = 0; i < w->ops; i++) {
+        if(atomic_load_explicit(f->state, memory_order_acquire) == DESK_OPEN) {
+            (*(volatile int *) f->users)++;
+            (*(volatile int *) f->products) += 3;
+            (*(volatile int64_t *) f->service) += i;
+        }
+        if(i % BENCH_POST_EVERY == 0) Mailbox_take(f->mailbox);
+    }
+}
+
+static void pDeskOther(void * p_arg) {
+    Worker * w = (Worker *) p_arg;
+    long n = 0, open = 0;
+    while (!atomic_load_explicit(w->isDone, memory_order_relaxed)) {
+        open += atomic_load_explicit(w->f->state, memory_order_acquire) == DESK_OPEN;
+        if(++n % BENCH_POST_EVERY == 0) Mailbox_post(w->f->mailbox, MAILBOX_USER);
+    }
+    atomic_fetch_add(&g_sink, open);
+}
+
+static void pMarketOwner(void * p_arg) {
+    Worker * w = (Worker *) p_arg;
+    Fields * f = w->f;
+    long sum = 0;
+    for(long i = 0; i < w->ops; i++) sum += *(volatile long *) f->np + (long) (*(UserStore * volatile *) f->store != NULL);
+    atomic_fetch_add(&g_sink, sum);
+}
+
+static void pMarketOther(void * p_arg) {
+    Worker * w = (Worker *) p_arg;
+    while (!atomic_load_explicit(w->isDone, memory_order_relaxed)) {
+        atomic_fetch_add(w->f->inShopping, 1);
+        atomic_fetch_sub(w->f->inShopping, 1);
+    }
+}
+
+static void * pWorker_main(void * p_arg) {
+    Worker * w = (Worker *) p_arg;
+    cpu_set_t set;
+    int fdMiss = -1, fdL1 = -1;
+    int64_t t0 = 0;
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    fdMiss = pOpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fdL1 = pOpenCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    t0 = getCurrentTimeNs();
+    w->fun(w);
+    w->ns = getCurrentTimeNs() - t0;
+    w->misses = pReadCounter(fdMiss);
+    w->l1Misses = pReadCounter(fdL1);
+    if(w->isOwner) atomic_store(w->isDone, 1);
+    return NULL;
+}
+
+/**
+ * @brief Run p_nThreads threads on f: the first one runs p_owner for p_ops operations, the others run p_other until it ends.
+ */
+static void pRun(const char * p_name, const char * p_layout, Fields * p_f, int * p_cpus, int p_nCpus, int p_nThreads,
+    long p_ops, void (*p_owner)(void *), void (*p_other)(void *)) {
+    Worker w[BENCH_MAX_THREADS];
+    pthread_t th[BENCH_MAX_THREADS];
+    atomic_int isDone;
+    long long misses = 0, l1Misses = 0;
+    atomic_init(&isDone, 0);
+    for(int i = 0; i < p_nThreads; i++) {
+        w[i].f = p_f;
+        w[i].cpu = p_cpus[i % p_nCpus];
+        w[i].isOwner = i == 0;
+        w[i].ops = p_ops;
+        w[i].isDone = &isDone;
+        w[i].fun = i == 0 ? p_owner : p_other;
+        if(pthread_create(&th[i], NULL, pWorker_main, &w[i]) != 0) ERR_QUIT("Unable to create a benchmark thread.");
+    }
+    for(int i = 0; i < p_nThreads; i++) {
+        pthread_join(th[i], NULL);
+        misses = misses < 0 || w[i].misses < 0 ? -1 : misses + w[i].misses;
+        l1Misses = l1Misses < 0 || w[i].l1Misses < 0 ? -1 : l1Misses + w[i].l1Misses;
+    }
+    printf("%-7s %-7s threads=%d ns_per_op=%7.2f", p_name, p_layout, p_nThreads, (double) w[0].ns / p_ops);
+    if(misses < 0) printf(" cache_misses=n/a");
+    else printf(" cache_misses=%lld per_op=%.3f", misses, (double) misses / p_ops);
+    if(l1Misses < 0) printf(" l1d_misses=n/a\n");
+    else printf(" l1d_misses=%lld per_op=%.3f\n", l1Misses, (double) l1Misses / p_ops);
+}
+
+/**
+ * @brief Print a message on stderr to explain how to correctly use the program.
+ *
+ * @param p_argv parameters passed to the program.
+ */
+static void useInfo(char * p_argv[]){
+    fprintf(stderr, "See the expected call:\n");
+    fprintf(stderr, "	%s [--threads <n>] [--ops <n>]\n", p_argv[0]);
+}
+
+int main(int argc, char * argv[]) {
+    int cpus[AFFINITY_MAX_CPUS];
+    int nCpus = 0, nThreads = BENCH_THREADS;
+    long ops = BENCH_OPS;
+    PackedDesk * pd = NULL;
+    CashDesk * cd = NULL;
+    PackedMarket * pm = NULL;
+    Market * m = NULL;
+    Fields f;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) nThreads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--ops") == 0 && i + 1 < argc) ops = atol(argv[++i]);
+        else {
+            useInfo(argv);
+            ERR_QUIT("Exit...");
+        }
+    }
+    if(nThreads < 2 || nThreads > BENCH_MAX_THREADS || ops <= 0) {
+        useInfo(argv);
+        ERR_QUIT("Exit...");
+    }
+    if((nCpus = Affinity_spread(cpus, AFFINITY_MAX_CPUS)) <= 0) ERR_QUIT("Unable to read the available cpus.");
+    if(nCpus < nThreads)
+        printf("Only %d cpus for %d threads: threads share cpus, so false sharing can't be measured.\n", nCpus, nThreads);
+    if((pd = aligned_alloc(CACHE_LINE, sizeof(PackedDesk) + CACHE_LINE)) == NULL ||
+        (cd = aligned_alloc(CACHE_LINE, sizeof(CashDesk))) == NULL ||
+        (pm = aligned_alloc(CACHE_LINE, sizeof(PackedMarket) + CACHE_LINE)) == NULL ||
+        (m = aligned_alloc(CACHE_LINE, sizeof(Market))) == NULL)
+        ERR_QUIT("An error occurred during memory allocation.");
+    memset(pd, 0, sizeof(PackedDesk));
+    memset(cd, 0, sizeof(CashDesk));
+    memset(pm, 0, sizeof(PackedMarket));
+    memset(m, 0, sizeof(Market));
+
+    //Desk: previous layout, then current one
+    atomic_init(&pd->state, DESK_OPEN);
+    Mailbox_init(&pd->mailbox);
+    f = (Fields) {&pd->state, &pd->mailbox, &pd->productsProcessed, &pd->usersProcessed, &pd->totServiceTime, NULL, NULL, NULL};
+    pRun("desk", "packed", &f, cpus, nCpus, nThreads, ops, pDeskOwner, pDeskOther);
+    atomic_init(&cd->state, DESK_OPEN);
+    Mailbox_init(&cd->mailbox);
+    f = (Fields) {&cd->state, &cd->mailbox, &cd->productsProcessed, &cd->usersProcessed, &cd->totServiceTime, NULL, NULL, NULL};
+    pRun("desk", "aligned", &f, cpus, nCpus, nThreads, ops, pDeskOwner, pDeskOther);
+
+    //Market: previous layout, then current one
+    pm->NP = m->NP = 2;
+    pm->users = m->users = (UserStore *) pm;
+    atomic_init(&pm->inShopping, 0);
+    atomic_init(&m->inShopping, 0);
+    f = (Fields) {NULL, NULL, NULL, NULL, NULL, &pm->NP, &pm->users, &pm->inShopping};
+    pRun("market", "packed", &f, cpus, nCpus, nThreads, ops, pMarketOwner, pMarketOther);
+    f = (Fields) {NULL, NULL, NULL, NULL, NULL, &m->NP, &m->users, &m->inShopping};
+    pRun("market", "aligned", &f, cpus, nCpus, nThreads, ops, pMarketOwner, pMarketOther);
+
+    free(pd);
+    free(cd);
+    free(pm);
+    free(m);
+    return atomic_load(&g_sink) == -1;
+}
@@ -0,0 +1,181 @@
+/**
+ * @file BenchQueue.c
+ * @brief   Microbenchmark of the pending-event sets of the virtual-time engine: binary heap (SimHeap.c),
+ *          pairing heap (below) and calendar queue (SimCalendar.c).
+ *
+ *          A sequential simulation is run first to record the delays of the events sent by the model. Then
+ *          each set is measured with the hold model: it is filled with n events and every operation pops the
+ *          next event and pushes it again after the following recorded delay. All the sets must pop the same
+ *          sequence, which is checked with a hash of the popped keys.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Sim.h>
+#include <utilities.h>
+
+#define BENCH_TRACE (1L << 20) /**< Delays recorded */
+#define BENCH_SRCS 64 /**< Senders of the events of the hold model */
+
+/**
+ * @brief Pairing heap (two-pass pop) on a pool of nodes.
+ */
+typedef struct {
+    SimEvent e;
+    long child, sibling;
+} PNode;
+typedef struct {
+    PNode * node;
+    long * pairs; /**< roots of the first pass of pop */
+    long cap, free, root, n;
+} PHeap;
+
+static long pHeap_meld(PHeap * p_h, long p_a, long p_b) {
+    long aux = 0;
+    if(p_a < 0) return p_b;
+    if(p_b < 0) return p_a;
+    if(SimEvent_before(&p_h->node[p_b].e, &p_h->node[p_a].e)) {
+        aux = p_a;
+        p_a = p_b;
+        p_b = aux;
+    }
+    p_h->node[p_b].sibling = p_h->node[p_a].child;
+    p_h->node[p_a].child = p_b;
+    return p_a;
+}
+static void pHeap_init(PHeap * p_h, long p_cap) {
+    if((p_h->node = malloc(p_cap * sizeof(PNode))) == NULL || (p_h->pairs = malloc(p_cap * sizeof(long))) == NULL)
+        ERR_QUIT("An error occurred during memory allocation. (pairing heap)");
+    for(long i = 0; i < p_cap; i++) p_h->node[i].sibling = i + 1 < p_cap ? i + 1 : -1;
+    p_h->cap = p_cap;
+    p_h->free = 0;
+    p_h->root = -1;
+    p_h->n = 0;
+}
+static void pHeap_push(PHeap * p_h, const SimEvent * p_e) {
+    long i = p_h->free;
+    if(i < 0) ERR_QUIT("Pairing heap full.");
+    p_h->free = p_h->node[i].sibling;
+    p_h->node[i].e = *p_e;
+    p_h->node[i].child = p_h->node[i].sibling = -1;
+    p_h->root = pHeap_meld(p_h, p_h->root, i);
+    p_h->n++;
+}
+static int pHeap_pop(PHeap * p_h, SimEvent * p_e) {
+    long r = p_h->root, c = 0, next = 0, np = 0, res = -1;
+    if(r < 0) return 0;
+    *p_e = p_h->node[r].e;
+    //Pairs left to right, then meld the pairs right to left
+    for(c = p_h->node[r].child; c >= 0; c = next) {
+        next = p_h->node[c].sibling;
+        p_h->node[c].sibling = -1;
+        if(next >= 0) {
+            long after = p_h->node[next].sibling;
+            p_h->node[next].sibling = -1;
+            p_h->pairs[np++] = pHeap_meld(p_h, c, next);
+            next = after;
+        } else p_h->pairs[np++] = c;
+    }
+    while (np > 0) res = pHeap_meld(p_h, res, p_h->pairs[--np]);
+    p_h->root = res;
+    p_h->node[r].sibling = p_h->free;
+    p_h->free = r;
+    p_h->n--;
+    return 1;
+}
+
+typedef enum {BENCH_HEAP, BENCH_PAIRING, BENCH_CALENDAR} BenchSet;
+
+/**
+ * @brief Hold model on one set.
+ *
+ * @param p_set set to measure.
+ * @param p_n events in the set.
+ * @param p_ops pop + push operations measured.
+ * @param p_delays recorded delays, used in a cycle.
+ * @param p_nDelays number of delays.
+ * @param p_hash hash of the popped keys.
+ * @return double: ns per operation.
+ */
+static double bench(BenchSet p_set, long p_n, long p_ops, const SimTime * p_delays, long p_nDelays, uint64_t * p_hash) {
+    SimHeap heap;
+    PHeap pairing;
+    SimCalendar calendar;
+    SimEvent e;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    long d = 0;
+    int64_t tStart = 0;
+    if((p_set == BENCH_HEAP && SimHeap_init(&heap, p_n) != 1) || (p_set == BENCH_CALENDAR && SimCalendar_init(&calendar) != 1))
+        ERR_QUIT("An error occurred during memory allocation.");
+    if(p_set == BENCH_PAIRING) pHeap_init(&pairing, p_n);
+    memset(&e, 0, sizeof(e));
+    for(long i = 0; i < p_n; i++) {
+        e.t = p_delays[d++ % p_nDelays];
+        e.src = (int32_t) (i % BENCH_SRCS);
+        e.seq = i;
+        if(p_set == BENCH_HEAP) SimHeap_push(&heap, &e);
+        else if(p_set == BENCH_PAIRING) pHeap_push(&pairing, &e);
+        else SimCalendar_push(&calendar, &e);
+    }
+    tStart = getCurrentTimeNs();
+    for(long i = 0; i < p_ops; i++) {
+        if(p_set == BENCH_HEAP) SimHeap_pop(&heap, &e);
+        else if(p_set == BENCH_PAIRING) pHeap_pop(&pairing, &e);
+        else SimCalendar_pop(&calendar, &e);
+        h = (h ^ (uint64_t) e.t ^ ((uint64_t) e.src << 48) ^ (uint64_t) e.seq) * 0x100000001b3ULL;
+        e.t += p_delays[d++ % p_nDelays];
+        e.seq = p_n + i;
+        if(p_set == BENCH_HEAP) SimHeap_push(&heap, &e);
+        else if(p_set == BENCH_PAIRING) pHeap_push(&pairing, &e);
+        else SimCalendar_push(&calendar, &e);
+    }
+    tStart = getCurrentTimeNs() - tStart;
+    if(p_set == BENCH_HEAP) SimHeap_delete(&heap);
+    else if(p_set == BENCH_PAIRING) {
+        free(pairing.node);
+        free(pairing.pairs);
+    } else SimCalendar_delete(&calendar);
+    *p_hash = h;
+    return (double) tStart / p_ops;
+}
+
+/**
+ * @brief Print a message on stderr to explain how to correctly use the program.
+ *
+ * @param p_argv parameters passed to the program.
+ */
+static void useInfo(char * p_argv[]){
+	fprintf(stderr, "See the expected call:\n");
+	fprintf(stderr, "	%s <duration_ms> <config_file> [<pending_events> ...]\n", p_argv[0]);
+	fprintf(stderr, "The simulation of the config file gives the event delays, default sizes are 1000 100000 1000000.\n");
+}
+
+int main(int argc, char * argv[]) {
+	const char * names[] = {"binary_heap", "pairing_heap", "calendar"};
+	long defaults[] = {1000, 100000, 1000000};
+	Sim * s = NULL;
+	uint64_t hash[3];
+	double ns[3];
+	long n = 0, ops = 0;
+	int nSizes = argc > 3 ? argc - 3 : 3;
+
+	if(argc < 3 || atol(argv[1]) <= 0) {
+		printf("Wrong use.");
+		useInfo(argv);
+		ERR_QUIT("Exit...");
+	}
+	if((s = Sim_init(argv[2], 0, SIM_MS(atol(argv[1])), 1)) == NULL || Sim_trace(s, BENCH_TRACE) != 1 ||
+		Sim_runSequential(s) != 1 || s->nTrace == 0)
+		ERR_QUIT("An error occurred during the simulation. Exit...");
+	printf("[Bench]: delays=%ld from %lld events\n", s->nTrace, s->events);
+	for(int i = 0; i < nSizes; i++) {
+		if((n = argc > 3 ? atol(argv[3 + i]) : defaults[i]) <= 0) continue;
+		ops = n * 10 > 2000000 ? n * 10 : 2000000;
+		for(int q = BENCH_HEAP; q <= BENCH_CALENDAR; q++) ns[q] = bench(q, n, ops, s->trace, s->nTrace, &hash[q]);
+		for(int q = BENCH_HEAP; q <= BENCH_CALENDAR; q++)
+			printf("[Bench]: set=%-12s pending=%-8ld ops=%-9ld ns_per_op=%-8.1f same_order=%s\n", names[q], n, ops, ns[q],
+				hash[q] == hash[BENCH_HEAP] ? "yes" : "NO");
+	}
+	Sim_delete(s);
+	return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file EventTool.c
+ * @brief   Offline processing of event logs recorded with the EVENT_LOG config item.
+ *
+ *          Supported commands:
+ *              - dump: merge events of all threads by timestamp and print them as text.
+ *              - arrivals: extract the customer stream (arrival time, products, shopping time)
+ *                as a binary arrival trace, which can be replayed with the TRACE_IN config item.
+ *              - chrome: export thread activity in Trace Event Format (JSON), which can be loaded
+ *                in chrome://tracing or in the Perfetto UI.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EventLog.h>
+#include <ArrivalTrace.h>
+#include <utilities.h>
+
+/**
+ * @brief Print a message on stderr to explain how to correctly use the program.
+ *
+ * @param p_argv parameters passed to the program.
+ */
+static void useInfo(char * p_argv[]){
+	fprintf(stderr, "See the expected call:\n");
+	fprintf(stderr, "	%s dump <event_log>\n", p_argv[0]);
+	fprintf(stderr, "	%s arrivals <event_log> <binary_trace>\n", p_argv[0]);
+	fprintf(stderr, "	%s chrome <event_log> <json_trace>\n", p_argv[0]);
+}
+
+/**
+ * @brief Print all events merged by timestamp. Times are in us from the first event.
+ */
+static void dump(Event * p_events, size_t p_n){
+	uint64_t t0 = p_n > 0 ? p_events[0].ts : 0;
+	for(size_t i = 0; i < p_n; i++) {
+		printf("%12.3f T%-4u %-10s id=%d arg=%d arg2=%d\n",
+			(double)(p_events[i].ts - t0) / 1000,
+			p_events[i].tid,
+			EventLog_typeName(p_events[i].type),
+			p_events[i].id, p_events[i].arg, p_events[i].arg2);
+	}
+}
+
+/**
+ * @brief Write an arrival trace with one record for each user entering the shopping area.
+ */
+static void arrivals(Event * p_events, size_t p_n, const char * p_out){
+	FILE * f = NULL;
+	ArrivalTraceHeader h;
+	ArrivalRecord rec;
+	uint64_t t0 = 0;
+	int isFirst = 1;
+
+	if((f = fopen(p_out, "wb")) == NULL)
+		ERR_SYS_QUIT("Unable to open output file %s.\n", p_out);
+	h.magic = ARRIVAL_TRACE_MAGIC;
+	h.version = ARRIVAL_TRACE_VERSION;
+	h.count = 0;
+	if(fwrite(&h, sizeof(h), 1, f) != 1) ERR_SYS_QUIT("Write error on %s.\n", p_out);
+	for(size_t i = 0; i < p_n; i++) {
+		if(p_events[i].type != EV_USER_SHOPPING) continue;
+		if(isFirst) { t0 = p_events[i].ts; isFirst = 0; }
+		rec.arrival = (p_events[i].ts - t0) / 1000000;
+		rec.products = p_events[i].arg;
+		rec.shoppingTime = p_events[i].arg2;
+		if(fwrite(&rec, sizeof(rec), 1, f) != 1) ERR_SYS_QUIT("Write error on %s.\n", p_out);
+		h.count++;
+	}
+	if(fseek(f, 0, SEEK_SET) != 0 || fwrite(&h, sizeof(h), 1, f) != 1 || fclose(f) != 0)
+		ERR_SYS_QUIT("Write error on %s.\n", p_out);
+	printf("Extracted %llu arrivals into %s.\n", (unsigned long long) h.count, p_out);
+}
+
+/**
+ * @brief Write thread activity in Trace Event Format: phases become duration events ("B"/"E"),
+ *        state transitions become instant events and each thread is named after its role.
+ */
+static void chrome(Event * p_events, size_t p_n, const char * p_out){
+	FILE * f = NULL;
+	uint64_t t0 = p_n > 0 ? p_events[0].ts : 0;
+	char name[MAXLINE];
+	int isFirst = 1;
+
+	if((f = fopen(p_out, "w")) == NULL)
+		ERR_SYS_QUIT("Unable to open output file %s.\n", p_out);
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for(size_t i = 0; i < p_n; i++) {
+		Event * e = &p_events[i];
+		double ts = (double)(e->ts - t0) / 1000;
+		if(e->type == EV_SKIP) continue;
+		fprintf(f, "%s", isFirst ? "" : ",\n");
+		isFirst = 0;
+		switch (e->type) {
+			case EV_THREAD_NAME:
+				EventLog_threadName((TraceRole) e->arg, e->id, name, sizeof(name));
+				fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n", e->tid, name);
+				fprintf(f, "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%d}}", e->tid, e->arg);
+				break;
+			case EV_SCOPE_BEGIN:
+			case EV_SCOPE_END:
+				fprintf(f, "{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+					EventLog_phaseName((TracePhase) e->arg), e->type == EV_SCOPE_BEGIN ? "B":"E", ts, e->tid);
+				break;
+			default:
+				fprintf(f, "{\"name\":\"%s\",\"cat\":\"transition\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+					"\"args\":{\"id\":%d,\"arg\":%d,\"arg2\":%d}}",
+					EventLog_typeName(e->type), ts, e->tid, e->id, e->arg, e->arg2);
+				break;
+		}
+	}
+	fprintf(f, "\n]}\n");
+	if(fclose(f) != 0) ERR_SYS_QUIT("Write error on %s.\n", p_out);
+	printf("Exported %zu events into %s.\n", p_n, p_out);
+}
+
+int main(int argc, char * argv[]) {
+	Event * events = NULL;
+	size_t n = 0;
+
+	if(argc < 3 || (strcmp(argv[1], "dump") == 0 && argc != 3) ||
+		((strcmp(argv[1], "arrivals") == 0 || strcmp(argv[1], "chrome") == 0) && argc != 4) ||
+		(strcmp(argv[1], "dump") != 0 && strcmp(argv[1], "arrivals") != 0 && strcmp(argv[1], "chrome") != 0)){//Wrong use
+		printf("Wrong use.");
+		useInfo(argv);
+		ERR_QUIT("Exit...");
+	}
+	if(EventLog_load(argv[2], &events, &n) != 1)
+		ERR_QUIT("Impossible to load event log %s.\n", argv[2]);
+
+	if(strcmp(argv[1], "dump") == 0) dump(events, n);
+	else if(strcmp(argv[1], "arrivals") == 0) arrivals(events, n, argv[3]);
+	else chrome(events, n, argv[3]);
+
+	free(events);
+	return 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file TraceConvert.c
+ * @brief   Convert a point-of-sale CSV trace into the binary arrival trace format read by #ArrivalTrace_open.
+ *
+ *          Each CSV line must have the following structure:
+ *              <arrival_ms>,<products>,<shopping_ms>
+ *          Lines starting with '#' and a non numeric header line are ignored.
+ *          The input is streamed, so traces larger than RAM can be converted.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <ArrivalTrace.h>
+#include <utilities.h>
+
+/**
+ * @brief Print a message on stderr to explain how to correctly use the program.
+ *
+ * @param p_argv parameters passed to the program.
+ */
+static void useInfo(char * p_argv[]){
+	fprintf(stderr, "See the expected call:\n");
+	fprintf(stderr, "	%s <csv_trace> <binary_trace>\n", p_argv[0]);
+}
+
+/**
+ * @brief Parse a CSV line.
+ *
+ * @param p_line line to parse
+ * @param p_rec where the parsed record is placed
+ * @return int: result code:
+ * 1: good parsing
+ * 0: p_line has to be skipped (comment or header)
+ * -1: invalid format
+ */
+static int parseLine(char * p_line, ArrivalRecord * p_rec){
+	unsigned long long arrival = 0;
+	unsigned long products = 0, shopping = 0;
+	char * s = p_line;
+
+	while(isspace((unsigned char)*s)) s++;
+	if(*s == '\0' || *s == '#' || isalpha((unsigned char)*s)) return 0;
+	if(sscanf(s, "%llu , %lu , %lu", &arrival, &products, &shopping) != 3) return -1;
+	if(products > UINT32_MAX || shopping > UINT32_MAX) return -1;
+	p_rec->arrival = arrival;
+	p_rec->products = products;
+	p_rec->shoppingTime = shopping;
+	return 1;
+}
+
+int main(int argc, char * argv[]) {
+	FILE * f_in = NULL;
+	FILE * f_out = NULL;
+	char line[MAXLINE];
+	ArrivalTraceHeader h;
+	ArrivalRecord rec;
+	uint64_t lastArrival = 0;
+	long lineCount = 0;
+	int res = 0;
+
+	if(argc != 3){//Wrong use
+		printf("Wrong use.");
+		useInfo(argv);
+		ERR_QUIT("Exit...");
+	}
+	if((f_in = fopen(argv[1], "r")) == NULL)
+		ERR_SYS_QUIT("Unable to open CSV trace %s.\n", argv[1]);
+	if((f_out = fopen(argv[2], "wb")) == NULL)
+		ERR_SYS_QUIT("Unable to open output file %s.\n", argv[2]);
+
+	//Header is rewritten with the right count at the end
+	h.magic = ARRIVAL_TRACE_MAGIC;
+	h.version = ARRIVAL_TRACE_VERSION;
+	h.count = 0;
+	if(fwrite(&h, sizeof(h), 1, f_out) != 1) ERR_SYS_QUIT("Write error on %s.\n", argv[2]);
+
+	while (fgets(line, MAXLINE, f_in) != NULL) {
+		lineCount++;
+		if((res = parseLine(line, &rec)) == 0) continue;
+		if(res == -1) ERR_QUIT("Parsing error [line: %ld]: expected <arrival_ms>,<products>,<shopping_ms>.\n", lineCount);
+		if(rec.arrival < lastArrival) ERR_QUIT("Parsing error [line: %ld]: arrivals must be sorted by time.\n", lineCount);
+		lastArrival = rec.arrival;
+		if(fwrite(&rec, sizeof(rec), 1, f_out) != 1) ERR_SYS_QUIT("Write error on %s.\n", argv[2]);
+		h.count++;
+	}
+	if(ferror(f_in)) ERR_SYS_QUIT("Read error on %s.\n", argv[1]);
+
+	if(fseek(f_out, 0, SEEK_SET) != 0 || fwrite(&h, sizeof(h), 1, f_out) != 1)
+		ERR_SYS_QUIT("Write error on %s.\n", argv[2]);
+	fclose(f_in);
+	if(fclose(f_out) != 0) ERR_SYS_QUIT("Write error on %s.\n", argv[2]);
+
+	printf("Converted %llu records into %s.\n", (unsigned long long) h.count, argv[2]);
+	return 0;
+}
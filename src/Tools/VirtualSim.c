@@ -0,0 +1,72 @@
+/**
+ * @file VirtualSim.c
+ * @brief   Run stores in virtual time with the discrete-event engine (see Sim.c).
+ *
+ *          Results of each store and a summary of the run are written in the log file. With --check the
+ *          simulation is also run with the sequential engine and the program fails if the results differ.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Sim.h>
+#include <utilities.h>
+
+/**
+ * @brief Print a message on stderr to explain how to correctly use the program.
+ *
+ * @param p_argv parameters passed to the program.
+ */
+static void useInfo(char * p_argv[]){
+	fprintf(stderr, "See the expected call:\n");
+	fprintf(stderr, "	%s [--workers <n> [--optimistic]] [--seed <n>] [--check] <duration_ms> <config_file> <log_file>\n", p_argv[0]);
+	fprintf(stderr, "	%s [--workers <n> [--optimistic]] [--seed <n>] [--check] --chain <duration_ms> <chain_file> <log_file>\n", p_argv[0]);
+	fprintf(stderr, "Without --workers the sequential engine is used, otherwise the conservative one with n workers\n");
+	fprintf(stderr, "(the optimistic one with --optimistic).\n");
+}
+
+int main(int argc, char * argv[]) {
+	Sim * s = NULL;
+	Sim * ref = NULL;
+	FILE * f_log = NULL;
+	int workers = 0, isCheck = 0, isChain = 0, isOptimistic = 0, i = 1, res = 0;
+	unsigned long long seed = 1;
+	long duration = 0;
+
+	for(; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+		if(strcmp(argv[i], "--workers") == 0 && i + 1 < argc) workers = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "--check") == 0) isCheck = 1;
+		else if(strcmp(argv[i], "--chain") == 0) isChain = 1;
+		else if(strcmp(argv[i], "--optimistic") == 0) isOptimistic = 1;
+		else break;
+	}
+	if(argc - i != 3 || (duration = atol(argv[i])) <= 0 || workers < 0 || workers > SIM_MAX_WORKERS || (isOptimistic && workers == 0)){//Wrong use
+		printf("Wrong use.");
+		useInfo(argv);
+		ERR_QUIT("Exit...");
+	}
+	if((f_log = fopen(argv[i + 2], "w")) == NULL)
+		ERR_SYS_QUIT("Unable to open log file %s.\n", argv[i + 2]);
+	if((s = Sim_init(argv[i + 1], isChain, SIM_MS(duration), seed)) == NULL)
+		ERR_QUIT("An error occurred during simulation setup. Exit...");
+
+	if(isOptimistic) res = Sim_runOptimistic(s, workers);
+	else res = workers > 0 ? Sim_runConservative(s, workers) : Sim_runSequential(s);
+	if(res != 1) ERR_QUIT("An error occurred during the simulation. Exit...");
+	Sim_log(s, f_log);
+	Sim_log(s, stdout);
+
+	if(isCheck) {
+		if((ref = Sim_init(argv[i + 1], isChain, SIM_MS(duration), seed)) == NULL || Sim_runSequential(ref) != 1)
+			ERR_QUIT("An error occurred during the reference simulation. Exit...");
+		res = Sim_digest(ref) == Sim_digest(s) && ref->events == s->events;
+		printf("[Check]: sequential digest=%016llx events=%lld wall_time=%.3f: %s\n", (unsigned long long) Sim_digest(ref),
+			ref->events, ref->wallTime, res ? "same results" : "DIFFERENT RESULTS");
+		fprintf(f_log, "[Check]: sequential digest=%016llx events=%lld: %s\n", (unsigned long long) Sim_digest(ref),
+			ref->events, res ? "same results" : "DIFFERENT RESULTS");
+		Sim_delete(ref);
+	}
+	fclose(f_log);
+	Sim_delete(s);
+	return res ? 0 : 1;
+}
@@ -13,15 +13,18 @@
 #include <SQueue.h>
 #include <Config.h>
 #include <TMarket.h>
+#include <Chain.h>
+#include <Shard.h>
 
-volatile sig_atomic_t sig_hup=0; /**< SIGHUP signal indicator */
-volatile sig_atomic_t sig_quit=0; /**< SIGQUIT signal indicator */
+atomic_int sig_hup=0; /**< SIGHUP signal indicator (set by the signal handler or by the shard link, read by all the threads) */
+atomic_int sig_quit=0; /**< SIGQUIT signal indicator (set by the signal handler or by the shard link, read by all the threads) */
 /**
  * @brief Data struct used to pass paramters to signal handler thread
  * 
  */
 typedef struct _input_handler_par_t {
 	Market * m; /**<reference to market interested into getting notified about signals.*/
+	Chain * c; /**<reference to chain interested into getting notified about signals (NULL if a single market is simulated).*/
 	sigset_t * set;	/**< set of signal handled*/
 } input_handler_par_t;
 
@@ -31,36 +34,55 @@ typedef struct _input_handler_par_t {
  * It handles the following signals:
  *  - SIGQUIT: set sig_quit = 1 and notify Market thread that will start a fast-closure.
  * 	- SIHUP: set sig_hup = 1 and notify Market thread that will start a gracefull-closure.
+ * When the markets close by themselves (end of their arrival traces) no signal comes: the thread is then cancelled
+ * while it waits (see #stopSigHandler).
  * @param p_arg this argument is expected to be a input_handler_par_t *
  * @return void* 
  */
 static void * sigHandler(void * p_arg) {
 	sigset_t * set = ((input_handler_par_t *) p_arg)->set;
 	Market * m = ((input_handler_par_t *) p_arg)->m;
+	Chain * c = ((input_handler_par_t *) p_arg)->c;
     int sig;
 
     while (1) {
         if (sigwait(set, &sig) != 0) ERR_QUIT("sigwait");
+		//A signal is being handled: the thread can be cancelled only in sigwait
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
         switch (sig) {
 			case SIGQUIT:
 				printf("Received signal SIGQUIT.\n");
 				sig_quit = 1;
-				Signal(&m->cv_MarketNews);
+				if(c != NULL) Chain_Signal(c);
+				else Market_Signal(m);
 				return (void *) NULL;			
 				break;
 			case SIGHUP:
 				printf("Received signal SIGHUP.\n");
 				sig_hup = 1;
-				Signal(&m->cv_MarketNews);
+				if(c != NULL) Chain_Signal(c);
+				else Market_Signal(m);
 				return (void *) NULL;
 				break;       
 			default:
 				ERR_MSG("Received unknown signal: %d!\n", sig);
 				break;
         }
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
     }	
 }
 
+/**
+ * @brief Stop the signal handler thread once the markets are closed, whether a signal closed them or not.
+ * 
+ * @param p_th signal handler thread.
+ */
+static void stopSigHandler(pthread_t p_th) {
+	pthread_cancel(p_th); //no effect if the thread has already handled a closing signal
+	if(pthread_join(p_th, NULL) != 0)
+		ERR_QUIT("pthread_join: thSigHandler");
+}
+
 /**
  * @brief Print a message on stdout to explain how to correctly use the program.
  * 
@@ -69,17 +91,21 @@ static void * sigHandler(void * p_arg) {
 static void useInfo(char * p_argv[]){
 	fprintf(stderr, "See the expected call:\n");
 	fprintf(stderr, "	%s <config_file> <log_file>\n", p_argv[0]);
+	fprintf(stderr, "	%s --chain <chain_file> <log_file>\n", p_argv[0]);
+	fprintf(stderr, "	%s --shards <n> <chain_file> <log_file>\n", p_argv[0]);
 }
 
 int main(int argc, char * argv[]) {
 	Market * m = NULL;
+	Chain * c = NULL;
 	pthread_t thSigHandler;
 	input_handler_par_t in;
 	sigset_t set;	
 
 	DEBUG_PRINT("PID: %d\n", getpid());
 
-	if(argc != 3){//Wrong use
+	if(argc != 3 && (argc != 4 || strcmp(argv[1], "--chain") != 0) && 
+		(argc != 5 || strcmp(argv[1], "--shards") != 0 || atoi(argv[2]) <= 0)){//Wrong use
 		printf("Wrong use.");
 		useInfo(argv);
 		ERR_QUIT("Exit...");
@@ -96,8 +122,36 @@ int main(int argc, char * argv[]) {
 	if(sigaddset(&set, SIGQUIT) == -1) ERR_QUIT("impossible to set mask. (3)");
 	if(pthread_sigmask(SIG_BLOCK, &set, NULL)==-1) ERR_QUIT("impossible to set mask (4)");	
 
+	if(argc == 5) {
+		//Sharded chain: this process only coordinates the shard processes
+		if(Shard_run(argv[3], argv[4], atoi(argv[2]), &set) != 1)
+			ERR_QUIT("An error occurred during the sharded run. Exit...");
+		printf("Chain closed.\n");
+		return 0;
+	}
+	if(argc == 4) {
+		//Try to init the chain: all its stores are created and then started together
+		if((c = Chain_init(argv[2], argv[3])) == NULL)
+			ERR_QUIT("An error occurred during chain initialization. Exit...");
+		if(Chain_startThreads(c) != 0)
+			ERR_QUIT("An error occurred during chain startup (1). Exit...");
+		in.m = NULL;
+		in.c = c;
+		in.set = &set;
+		if(pthread_create(&thSigHandler, NULL, sigHandler, &in) != 0)
+			ERR_QUIT("impossible to execute signal handler thread.");
+		if(Chain_joinThreads(c) != 0)
+			ERR_QUIT("An error occurred during chain startup (2). Exit...");
+		stopSigHandler(thSigHandler);
+		Chain_log(c);
+		if(Chain_delete(c) != 1)
+			ERR_QUIT( "An error occurred during chain closing. Exit...");
+		printf("Chain closed.\n");
+		return 0;
+	}
+
 	//Try to init market
-	if((m = Market_init(argv[1], argv[2])) == NULL)
+	if((m = Market_init(argv[1], argv[2], NULL)) == NULL)
 		ERR_QUIT("An error occurred during market initialization. Exit...");
 
 	//Market is correctly initialized
@@ -106,6 +160,7 @@ int main(int argc, char * argv[]) {
 
 	//Start signal handler thread
 	in.m = m;
+	in.c = NULL;
 	in.set = &set;
 	if(pthread_create(&thSigHandler, NULL, sigHandler, &in) != 0)
 		ERR_QUIT("impossible to execute signal handler thread.");
@@ -114,13 +169,12 @@ int main(int argc, char * argv[]) {
 	if(Market_joinThread(m) != 0)
 		ERR_QUIT("An error occurred during market startup (2). Exit...");
 	
+	//Wait signal handler thread (before the market is deallocated: a late signal would wake it up)
+	stopSigHandler(thSigHandler);
+
 	//Deallocate memory used by Market
 	if(Market_delete(m) != 1)
 		ERR_QUIT( "An error occurred during market closing. Exit...");
-	
-	//Wait signal handler thread
-	if(pthread_join(thSigHandler, NULL) != 0)
-		ERR_QUIT("pthread_join: thSigHandler");
 
 	printf("Market closed.\n");
 
@@ -12,13 +12,45 @@
 #include <time.h>
 #include <pthread.h>
 #include <time.h>
+#include <stdatomic.h>
+#include <math.h>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#define HAS_TSC 1 /**< The time stamp counter can be read */
+#endif
+
+#define TSC_CALIBRATION_MS 50 /**< Duration of the TSC calibration */
 
 _Thread_local unsigned int g_seed; /**< Seed variable defined for each thread (_Thread_local) used 
                                         by rand_r calls performed within #utilities.getRandom.
                                         IMPORTANT: must be initialized.*/
 
+static long g_timeScale = 1; /**< Simulated ms for each real ms (see #setTimeScale) */
+static int g_isTimeScaleSet = 0;
+static ClockSource g_clock = CLOCK_SRC_MONOTONIC; /**< Source of #getCurrentTimeNs (see #setClockSource) */
+static int g_isClockSet = 0;
+static uint64_t g_tsc0; /**< TSC clock: counter at g_ns0 */
+static int64_t g_ns0; /**< TSC clock: CLOCK_MONOTONIC ns at the end of the calibration */
+static uint64_t g_tscMult; /**< TSC clock: ns per tick, fixed point with 32 fractional bits */
+
+/**
+ * @brief Counters of #TimerStats for a kind of timer.
+ */
+typedef struct TimerCounters {
+	atomic_llong timers;
+	atomic_llong late;
+	atomic_llong sumLateNs;
+	atomic_llong maxLateNs;
+	atomic_llong sumReqNs;
+	atomic_llong sumLagNs;
+	atomic_llong hist[TIMER_HIST_BUCKETS];
+} TimerCounters;
+
+static TimerCounters g_timerCnt[TIMER_ALL]; /**< Timers fired in the process, by kind */
+static const char * g_timerNames[TIMER_ALL + 1] = {"shopping", "service", "notify", "jockey", "other", "all"};
+
 /**
- * @brief Wait a specified amount of milliseconds.
+ * @brief Wait a specified amount of real milliseconds (polling and other waits outside the simulation).
  * 
  * This code has been taken from https://stackoverflow.com/questions/1157209/is-there-an-alternative-sleep-function-in-c-to-milliseconds.
  * 
@@ -27,7 +59,7 @@ _Thread_local unsigned int g_seed; /**< Seed variable defined for each thread (_
  * -1: an error occurred (errno set)
  * 	0: successfully executed
  */
-int waitMs(long p_msec){
+int waitRealMs(long p_msec){
     struct timespec ts;
     int res;
 	//Check input
@@ -50,25 +82,276 @@ int waitMs(long p_msec){
 }
 
 /**
- * @brief Return the elapsed (p_end - p_start) time in ms.
+ * @brief Wait a specified amount of simulated milliseconds: p_msec / scale real ms (see #setTimeScale).
+ *        How late the wait ends is accounted in the timer statistics (kind #TIMER_OTHER).
+ * 
+ * @param p_waitMs simulated milliseconds to wait.
+ * @return int: error code:
+ * -1: an error occurred (errno set)
+ * 	0: successfully executed
+ */
+int waitMs(long p_msec){
+	return waitTimer(p_msec, TIMER_OTHER);
+}
+
+/**
+ * @brief As #waitMs, accounting the wait in the statistics of p_kind.
+ */
+int waitTimer(long p_msec, TimerKind p_kind){
+    struct timespec ts;
+    int64_t real = 0, start = 0;
+    int res;
+    if (p_msec < 0){
+        errno = EINVAL;
+        return -1;
+    }
+    real = toRealNs((int64_t) p_msec * 1000000);
+    ts.tv_sec = real / 1000000000LL;
+    ts.tv_nsec = real % 1000000000LL;
+    start = getCurrentTimeNs();
+    do {
+        res = nanosleep(&ts, &ts);
+    } while (res && errno == EINTR);
+    if(res == 0) timerFired(p_kind, real, getCurrentTimeNs() - start - real);
+    return res;
+}
+
+/**
+ * @brief Return the elapsed (p_end - p_start) time in simulated ms (real ms * scale, see #setTimeScale).
  * 
  * @param p_start start time
  * @param p_end end time
  * @return long 
  */
 long elapsedTime(struct timespec p_start, struct timespec p_end) {
-	return (p_end.tv_sec - p_start.tv_sec) * 1000 + (p_end.tv_nsec - p_start.tv_nsec) / 1000000;
+	int64_t ns = (int64_t)(p_end.tv_sec - p_start.tv_sec) * 1000000000LL + (p_end.tv_nsec - p_start.tv_nsec);
+	return (long) (ns * g_timeScale / 1000000);
 }
+static int64_t pMonotonicNs() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
 /**
- * @brief Get the current time as struct timespec
+ * @brief Get the current time as struct timespec, on the clock of #getCurrentTimeNs
  * @return struct timespec set with current time
  */
 struct timespec getCurrentTime(){
 	struct timespec now;
-	clock_gettime(CLOCK_REALTIME, &now);
+	int64_t ns = getCurrentTimeNs();
+	now.tv_sec = ns / 1000000000LL;
+	now.tv_nsec = ns % 1000000000LL;
 	return now;
 }
 
+/**
+ * @brief Get the current time as ns from a monotonic clock (it does not jump with NTP adjustments).
+ *        Only differences are meaningful. With the TSC source the time is computed from the counter, without
+ *        a clock_gettime call.
+ * @return int64_t current time (ns)
+ */
+int64_t getCurrentTimeNs(){
+#ifdef HAS_TSC
+	if(g_clock == CLOCK_SRC_TSC)
+		return g_ns0 + (int64_t)(((unsigned __int128)(__rdtsc() - g_tsc0) * g_tscMult) >> 32);
+#endif
+	return pMonotonicNs();
+}
+
+/**
+ * @brief Check that the TSC ticks at a constant rate, also in deep sleep states (/proc/cpuinfo flags).
+ */
+static int pIsTscInvariant() {
+	char line[MAXLINE];
+	FILE * f = NULL;
+	int res = 0;
+	if((f = fopen("/proc/cpuinfo", "r")) == NULL) return 0;
+	while (fgets(line, MAXLINE, f) != NULL)
+		if(strncmp(line, "flags", 5) == 0) {
+			res = strstr(line, " constant_tsc") != NULL && strstr(line, " nonstop_tsc") != NULL;
+			break;
+		}
+	fclose(f);
+	return res;
+}
+
+/**
+ * @brief Check, without selecting it, that p_src can be the source of #getCurrentTimeNs (see #setClockSource).
+ *
+ * @return int: 1 the source can be set, 0 it is not available or different from the one already set
+ */
+int canSetClockSource(ClockSource p_src) {
+	if(g_isClockSet) return p_src == g_clock;
+#ifdef HAS_TSC
+	return p_src != CLOCK_SRC_TSC || pIsTscInvariant();
+#else
+	return p_src != CLOCK_SRC_TSC;
+#endif
+}
+
+/**
+ * @brief Select the source of #getCurrentTimeNs. The TSC is calibrated against CLOCK_MONOTONIC here.
+ *        It must be called before threads are started, and every store of the process must use the same source.
+ *
+ * @param p_src clock source.
+ * @return int: 1 good, 0 the source is not available or different from the one already set
+ */
+int setClockSource(ClockSource p_src) {
+	if(g_isClockSet) return p_src == g_clock;
+	if(p_src == CLOCK_SRC_TSC) {
+#ifdef HAS_TSC
+		int64_t ns = 0;
+		uint64_t tsc = 0;
+		if(!pIsTscInvariant()) return 0;
+		ns = pMonotonicNs();
+		tsc = __rdtsc();
+		waitRealMs(TSC_CALIBRATION_MS);
+		g_ns0 = pMonotonicNs();
+		g_tsc0 = __rdtsc();
+		if(g_tsc0 <= tsc) return 0;
+		g_tscMult = (uint64_t)((((unsigned __int128)(g_ns0 - ns)) << 32) / (g_tsc0 - tsc));
+#else
+		return 0;
+#endif
+	}
+	g_clock = p_src;
+	g_isClockSet = 1;
+	return 1;
+}
+
+const char * getClockSourceName() {
+	return g_clock == CLOCK_SRC_TSC ? "tsc" : "monotonic";
+}
+
+/**
+ * @brief Init a condition variable whose timed waits use CLOCK_MONOTONIC (see #clockDeadline).
+ * @return int: 0 good, an error code otherwise (as pthread_cond_init)
+ */
+int initCondClock(pthread_cond_t * p_cond) {
+	pthread_condattr_t attr;
+	int res = 0;
+	if((res = pthread_condattr_init(&attr)) != 0) return res;
+	if((res = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC)) == 0) res = pthread_cond_init(p_cond, &attr);
+	pthread_condattr_destroy(&attr);
+	return res;
+}
+
+/**
+ * @brief Convert p_t (clock of #getCurrentTime) in the deadline of a timed wait on a condition variable created
+ *        with #initCondClock. The TSC clock drifts slowly from CLOCK_MONOTONIC, so the deadline is taken relative to now.
+ */
+struct timespec clockDeadline(struct timespec p_t) {
+	int64_t ns = 0;
+	if(g_clock == CLOCK_SRC_MONOTONIC) return p_t;
+	ns = pMonotonicNs() + ((int64_t)p_t.tv_sec * 1000000000LL + p_t.tv_nsec - getCurrentTimeNs());
+	p_t.tv_sec = ns / 1000000000LL;
+	p_t.tv_nsec = ns % 1000000000LL;
+	return p_t;
+}
+
+/**
+ * @brief Simulated seconds of p_realNs real ns (see #setTimeScale).
+ */
+double toSimSeconds(int64_t p_realNs) {
+	return (double) p_realNs * g_timeScale / 1e9;
+}
+
+/**
+ * @brief Check, without setting it, that p_scale can be the time scale of the process (see #setTimeScale).
+ *
+ * @return int: 1 the scale can be set, 0 it is invalid or different from the scale already set
+ */
+int canSetTimeScale(long p_scale) {
+	return p_scale >= 1 && (!g_isTimeScaleSet || p_scale == g_timeScale);
+}
+
+/**
+ * @brief Set the time scale of the process: simulated time runs p_scale times faster than real time.
+ *        Every #waitMs and #elapsedTime is scaled, so logged times stay in simulated ms.
+ *        It must be called before threads are started, and every store of the process must use the same scale.
+ *
+ * @param p_scale simulated ms for each real ms (>= 1).
+ * @return int: 1 good, 0 invalid or different from the scale already set
+ */
+int setTimeScale(long p_scale) {
+	if(!canSetTimeScale(p_scale)) return 0;
+	g_timeScale = p_scale;
+	g_isTimeScaleSet = 1;
+	return 1;
+}
+
+long getTimeScale() {
+	return g_timeScale;
+}
+
+/**
+ * @brief Real duration of p_simNs simulated ns.
+ */
+int64_t toRealNs(int64_t p_simNs) {
+	return p_simNs / g_timeScale;
+}
+
+static void pMax(atomic_llong * p_max, long long p_x) {
+	long long max = atomic_load_explicit(p_max, memory_order_relaxed);
+	while (p_x > max && !atomic_compare_exchange_weak_explicit(p_max, &max, p_x, memory_order_relaxed, memory_order_relaxed));
+}
+
+/**
+ * @brief Account a timer of kind p_kind, set p_reqRealNs real ns in advance, which fired p_lateRealNs real ns after its time.
+ */
+void timerFired(TimerKind p_kind, int64_t p_reqRealNs, int64_t p_lateRealNs) {
+	TimerCounters * c = &g_timerCnt[p_kind];
+	int64_t late = p_lateRealNs > 0 ? p_lateRealNs * g_timeScale : 0;
+	int b = 0;
+	for(int64_t us = late / 1000; us > 0 && b < TIMER_HIST_BUCKETS - 1; us >>= 1) b++;
+	atomic_fetch_add_explicit(&c->timers, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&c->sumReqNs, p_reqRealNs * g_timeScale, memory_order_relaxed);
+	atomic_fetch_add_explicit(&c->sumLagNs, late, memory_order_relaxed);
+	atomic_fetch_add_explicit(&c->hist[b], 1, memory_order_relaxed);
+	if(late <= TIMER_LATE_NS) return;
+	atomic_fetch_add_explicit(&c->late, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&c->sumLateNs, late, memory_order_relaxed);
+	pMax(&c->maxLateNs, late);
+}
+
+/**
+ * @brief Timers of kind p_kind fired so far in the process (#TIMER_ALL: all the kinds).
+ */
+void getTimerStats(TimerKind p_kind, TimerStats * p_st) {
+	memset(p_st, 0, sizeof(TimerStats));
+	for(int k = 0; k < TIMER_ALL; k++) {
+		TimerCounters * c = &g_timerCnt[k];
+		long long max = 0;
+		if(p_kind != TIMER_ALL && (int) p_kind != k) continue;
+		p_st->timers += atomic_load(&c->timers);
+		p_st->late += atomic_load(&c->late);
+		p_st->sumLateNs += atomic_load(&c->sumLateNs);
+		p_st->sumReqNs += atomic_load(&c->sumReqNs);
+		p_st->sumLagNs += atomic_load(&c->sumLagNs);
+		max = atomic_load(&c->maxLateNs);
+		p_st->maxLateNs = max > p_st->maxLateNs ? max : p_st->maxLateNs;
+		for(int b = 0; b < TIMER_HIST_BUCKETS; b++) p_st->hist[b] += atomic_load(&c->hist[b]);
+	}
+}
+
+/**
+ * @brief Upper bound of the p_pct percentile of the lag (simulated ns): the end of its histogram bucket,
+ *        so it is at most twice the exact value.
+ */
+int64_t timerLagPercentile(const TimerStats * p_st, double p_pct) {
+	long long n = 0;
+	long long rank = (long long) ceil(p_st->timers * p_pct / 100) - 1; //timers before the percentile
+	if(p_st->timers == 0) return 0;
+	for(int b = 0; b < TIMER_HIST_BUCKETS; b++)
+		if((n += p_st->hist[b]) > rank || b == TIMER_HIST_BUCKETS - 1) return (1LL << b) * 1000;
+	return 0;
+}
+
+const char * getTimerKindName(TimerKind p_kind) {
+	return g_timerNames[p_kind];
+}
+
 //General stuff
 /**
  * @brief 	Get a random integer value in the following range [p_lower; p_upper]